@@ -0,0 +1,897 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/OffsetsOutput.h"
+#include "../Common/PdbLines.h"
+#include "../Common/PdbPrefetch.h"
+#include "../Common/PdbTypes.h"
+#include "../Common/PeFile.h"
+#include "../Common/SignatureScan.h"
+#include "../Common/SymbolExport.h"
+#include "../Common/SymbolIndex.h"
+#include "../Common/SyntheticImage.h"
+
+struct BenchOptions
+{
+    std::vector<uint32_t> PublicCounts = { 100000 };
+    std::vector<uint32_t> BlockSizes = { 4096 };
+    uint32_t NumTypes = 10000;
+    uint32_t NumLookups = 100000;
+    uint32_t PageCacheMB = 16;
+    std::filesystem::path WorkDir;
+    bool bKeepFiles = false;
+};
+
+class LatencySamples
+{
+public:
+    void Add(std::chrono::steady_clock::duration Elapsed) { Samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Elapsed).count()); }
+
+    uint64_t Percentile(double Fraction)
+    {
+        if (Samples.empty())
+            return 0;
+
+        size_t Rank = std::min(Samples.size() - 1, static_cast<size_t>(Fraction * Samples.size()));
+
+        std::nth_element(Samples.begin(), Samples.begin() + Rank, Samples.end());
+
+        return Samples[Rank];
+    }
+
+private:
+    std::vector<uint64_t> Samples;
+};
+
+std::string FormatDuration(uint64_t Nanoseconds)
+{
+    char Buffer[32];
+
+    if (Nanoseconds < 10000)
+        snprintf(Buffer, sizeof(Buffer), "%llu ns", static_cast<unsigned long long>(Nanoseconds));
+    else if (Nanoseconds < 10000000)
+        snprintf(Buffer, sizeof(Buffer), "%.1f us", Nanoseconds / 1e3);
+    else
+        snprintf(Buffer, sizeof(Buffer), "%.2f ms", Nanoseconds / 1e6);
+
+    return Buffer;
+}
+
+void PrintLatency(const char* Name, LatencySamples& Samples)
+{
+    printf_s("    %-28s p50 %-10s p99 %s\n", Name, FormatDuration(Samples.Percentile(0.5)).c_str(), FormatDuration(Samples.Percentile(0.99)).c_str());
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point Start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+// "250", "10k" or "5M".
+bool ParseCount(const std::wstring& Text, uint32_t& Count)
+{
+    wchar_t* End = nullptr;
+    uint64_t Value = std::wcstoull(Text.c_str(), &End, 10);
+
+    if (End == Text.c_str())
+        return false;
+
+    uint64_t Scale = 1;
+
+    if (*End == L'k' || *End == L'K')
+        Scale = 1000;
+    else if (*End == L'm' || *End == L'M')
+        Scale = 1000000;
+
+    if (Scale != 1)
+        End++;
+
+    Value *= Scale;
+
+    if (*End || !Value || Value > UINT32_MAX)
+        return false;
+
+    Count = static_cast<uint32_t>(Value);
+
+    return true;
+}
+
+bool ParseCountList(const std::wstring& Text, std::vector<uint32_t>& Counts)
+{
+    size_t Start = 0;
+
+    Counts.clear();
+
+    while (Start <= Text.size())
+    {
+        size_t Comma = Text.find(L',', Start);
+        uint32_t Count;
+
+        if (!ParseCount(Text.substr(Start, Comma == std::wstring::npos ? std::wstring::npos : Comma - Start), Count))
+            return false;
+
+        Counts.push_back(Count);
+
+        if (Comma == std::wstring::npos)
+            break;
+
+        Start = Comma + 1;
+    }
+
+    return !Counts.empty();
+}
+
+bool ParseOptions(int argc, wchar_t* argv[], BenchOptions& Options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (_wcsicmp(argv[i], L"--keep") == 0)
+        {
+            Options.bKeepFiles = true;
+
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const wchar_t* Value = argv[++i];
+
+        if (_wcsicmp(argv[i - 1], L"--publics") == 0)
+        {
+            if (!ParseCountList(Value, Options.PublicCounts))
+                return false;
+        }
+        else if (_wcsicmp(argv[i - 1], L"--page-size") == 0)
+        {
+            if (!ParseCountList(Value, Options.BlockSizes))
+                return false;
+
+            // The same limits MsfFile enforces on open.
+            for (uint32_t BlockSize : Options.BlockSizes)
+            {
+                if (BlockSize < 512 || BlockSize > 65536 || (BlockSize & (BlockSize - 1)) != 0)
+                    return false;
+            }
+        }
+        else if (_wcsicmp(argv[i - 1], L"--types") == 0)
+        {
+            if (!ParseCount(Value, Options.NumTypes))
+                return false;
+        }
+        else if (_wcsicmp(argv[i - 1], L"--lookups") == 0)
+        {
+            if (!ParseCount(Value, Options.NumLookups))
+                return false;
+        }
+        else if (_wcsicmp(argv[i - 1], L"--page-cache") == 0)
+        {
+            if (!ParseCount(Value, Options.PageCacheMB) || !Options.PageCacheMB)
+                return false;
+        }
+        else if (_wcsicmp(argv[i - 1], L"--dir") == 0)
+        {
+            Options.WorkDir = Value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool BenchPe(const std::filesystem::path& PePath)
+{
+    static constexpr uint32_t Iterations = 2000;
+
+    LatencySamples Samples;
+
+    for (uint32_t i = 0; i < Iterations; i++)
+    {
+        PeDebugInfo Info;
+        std::string Error;
+        auto Start = std::chrono::steady_clock::now();
+
+        if (ReadPeDebugInfo(PePath, Info, Error) != PeStatus::Ok)
+        {
+            printf_s("[-] Failed to read generated PE: %s! :(\n", Error.c_str());
+
+            return false;
+        }
+
+        Samples.Add(std::chrono::steady_clock::now() - Start);
+    }
+
+    PrintLatency("PE debug info", Samples);
+
+    return true;
+}
+
+// Lookups go to random generated names, every tenth one to a name that doesn't exist.
+std::vector<std::pair<std::string, uint32_t>> MakeLookups(uint32_t NumPublics, uint32_t NumLookups)
+{
+    std::mt19937 Random(42);
+    std::vector<std::pair<std::string, uint32_t>> Lookups;
+
+    Lookups.reserve(NumLookups);
+
+    for (uint32_t i = 0; i < NumLookups; i++)
+    {
+        uint32_t Index = Random() % NumPublics;
+
+        if (i % 10 == 9)
+            Lookups.emplace_back("MissingBenchSymbol" + std::to_string(Index), 0);
+        else
+            Lookups.emplace_back(GetSyntheticPublicName(Index), GetSyntheticPublicRva(Index));
+    }
+
+    return Lookups;
+}
+
+template <typename Lookup>
+uint32_t BenchLookups(const char* Name, const std::vector<std::pair<std::string, uint32_t>>& Lookups, Lookup&& Find)
+{
+    LatencySamples Samples;
+    uint32_t Wrong = 0;
+
+    for (const auto& [Symbol, Rva] : Lookups)
+    {
+        PdbSymbol Result;
+        auto Start = std::chrono::steady_clock::now();
+        bool bFound = Find(Symbol, Result);
+
+        Samples.Add(std::chrono::steady_clock::now() - Start);
+
+        if (bFound != (Rva != 0) || (bFound && Result.Rva != Rva))
+            Wrong++;
+    }
+
+    PrintLatency(Name, Samples);
+
+    return Wrong;
+}
+
+void BenchBatch(const SymbolIndex& Index, const std::vector<std::pair<std::string, uint32_t>>& Lookups, uint32_t NumThreads)
+{
+    std::vector<std::thread> Threads;
+    std::atomic<uint32_t> Found = 0;
+    auto Start = std::chrono::steady_clock::now();
+
+    for (uint32_t t = 0; t < NumThreads; t++)
+    {
+        Threads.emplace_back([&, t]()
+        {
+            uint32_t Local = 0;
+
+            for (size_t i = t; i < Lookups.size(); i += NumThreads)
+            {
+                PdbSymbol Symbol;
+
+                Local += Index.Find(Lookups[i].first, Symbol);
+            }
+
+            Found += Local;
+        });
+    }
+
+    for (std::thread& Thread : Threads)
+        Thread.join();
+
+    double Seconds = SecondsSince(Start);
+    char Name[48];
+
+    snprintf(Name, sizeof(Name), "Batch resolve (%u thread%s)", NumThreads, NumThreads > 1 ? "s" : "");
+    printf_s("    %-28s %.2f M names/s (%u found)\n", Name, Lookups.size() / Seconds / 1e6, Found.load());
+}
+
+// Random addresses inside the generated functions; every hit must name the function and the offset into it.
+uint32_t BenchAddresses(const SymbolIndex& Index, uint32_t NumPublics, uint32_t NumLookups)
+{
+    std::mt19937 Random(11);
+    std::vector<uint32_t> Publics(NumLookups);
+    std::vector<uint32_t> Rvas(NumLookups);
+    std::vector<SymbolAddressMatch> Matches(NumLookups);
+
+    for (uint32_t i = 0; i < NumLookups; i++)
+    {
+        Publics[i] = Random() % NumPublics;
+        Rvas[i] = GetSyntheticPublicRva(Publics[i]) + Random() % (GetSyntheticPublicRva(1) - GetSyntheticPublicRva(0));
+    }
+
+    double Seconds[2] = {};
+
+    // The two passes take turns going first, so neither runs on caches the other one warmed; the best round counts.
+    for (uint32_t Round = 0; Round < 4; Round++)
+    {
+        for (uint32_t Pass = 0; Pass < 2; Pass++)
+        {
+            bool bBatched = (Round + Pass) % 2;
+            auto Start = std::chrono::steady_clock::now();
+
+            if (bBatched)
+            {
+                Index.FindAddresses(Rvas.data(), Rvas.size(), Matches.data());
+            }
+            else
+            {
+                for (uint32_t i = 0; i < NumLookups; i++)
+                    Index.FindAddresses(&Rvas[i], 1, &Matches[i]);
+            }
+
+            double Elapsed = SecondsSince(Start);
+
+            Seconds[bBatched] = Round ? std::min(Seconds[bBatched], Elapsed) : Elapsed;
+        }
+    }
+
+    printf_s("    %-28s %.2f M addresses/s\n", "Address lookup (single)", NumLookups / Seconds[0] / 1e6);
+    printf_s("    %-28s %.2f M addresses/s\n", "Address lookup (batched)", NumLookups / Seconds[1] / 1e6);
+
+    uint32_t Wrong = 0;
+
+    for (uint32_t i = 0; i < NumLookups; i++)
+    {
+        Wrong += Matches[i].Entry == UINT32_MAX || Index.GetName(Index.GetEntry(Matches[i].Entry)) != GetSyntheticPublicName(Publics[i]) ||
+            Matches[i].Displacement != Rvas[i] - GetSyntheticPublicRva(Publics[i]);
+    }
+
+    return Wrong;
+}
+
+// Random addresses again, now mapped to source lines. The first pass decodes the line table of every module it
+// lands in, the second one only searches.
+uint32_t BenchLines(const PdbFile& Pdb, uint32_t NumPublics, uint32_t NumLookups)
+{
+    PdbLines Lines;
+
+    if (!Lines.Open(Pdb))
+    {
+        printf_s("[-] Generated PDB has no line information! :(\n");
+
+        return 1;
+    }
+
+    std::mt19937 Random(13);
+    std::vector<uint32_t> Publics(NumLookups);
+    std::vector<uint32_t> Rvas(NumLookups);
+    std::vector<PdbSourceLine> Found(NumLookups);
+
+    for (uint32_t i = 0; i < NumLookups; i++)
+    {
+        Publics[i] = Random() % NumPublics;
+        Rvas[i] = GetSyntheticPublicRva(Publics[i]) + Random() % (GetSyntheticPublicRva(1) - GetSyntheticPublicRva(0));
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+
+    Lines.FindLines(Rvas.data(), Rvas.size(), Found.data());
+    printf_s("    %-28s %.2f M addresses/s (%u modules decoded)\n", "Line lookup (cold)", NumLookups / SecondsSince(Start) / 1e6,
+        Lines.GetDecodedModules());
+
+    Start = std::chrono::steady_clock::now();
+    Lines.FindLines(Rvas.data(), Rvas.size(), Found.data());
+    printf_s("    %-28s %.2f M addresses/s\n", "Line lookup (warm)", NumLookups / SecondsSince(Start) / 1e6);
+
+    uint32_t Wrong = 0;
+
+    for (uint32_t i = 0; i < NumLookups; i++)
+    {
+        Wrong += Found[i].Line != GetSyntheticLine(Publics[i], Rvas[i] - GetSyntheticPublicRva(Publics[i])) ||
+            Found[i].File != GetSyntheticSourceFile(Publics[i] / SyntheticPublicsPerModule);
+    }
+
+    return Wrong;
+}
+
+// Whole symbol table export in both formats; the columnar file is read back and has to list every public in RVA
+// order with its name and the spacing of the generator as size.
+uint32_t BenchExport(const PdbFile& Pdb, const std::filesystem::path& WorkDir, uint32_t NumPublics)
+{
+    uint32_t Spacing = GetSyntheticPublicRva(1) - GetSyntheticPublicRva(0);
+
+    for (SymbolExportFormat Format : { SymbolExportFormat::Columnar, SymbolExportFormat::Csv })
+    {
+        std::filesystem::path Path = WorkDir / (Format == SymbolExportFormat::Csv ? L"bench.csv" : L"bench.syms");
+        SymbolExportResult Result;
+        std::string Error;
+        auto Start = std::chrono::steady_clock::now();
+
+        if (!ExportSymbols(Pdb, Path, Format, Result, Error))
+        {
+            printf_s("[-] Symbol export failed: %s! :(\n", Error.c_str());
+
+            return 1;
+        }
+
+        double Seconds = SecondsSince(Start);
+
+        printf_s("    %-28s %.2f M symbols/s (%.0f MB/s written)\n", Format == SymbolExportFormat::Csv ? "Symbol export (CSV)" : "Symbol export (columnar)",
+            Result.NumSymbols / Seconds / 1e6, Result.BytesWritten / Seconds / 1048576.0);
+    }
+
+    SymbolExportFile Exported;
+
+    if (!Exported.Open(WorkDir / L"bench.syms") || Exported.GetCount() != NumPublics)
+        return 1;
+
+    uint32_t Wrong = 0;
+
+    for (uint32_t i = 0; i < NumPublics; i++)
+    {
+        Wrong += Exported.GetName(i) != GetSyntheticPublicName(i) || Exported.GetRva(i) != GetSyntheticPublicRva(i) || Exported.GetSize(i) != Spacing ||
+            Exported.GetKind(i) != S_PUB32;
+    }
+
+    return Wrong;
+}
+
+// The PDB again through the page cache: a full symbol enumeration, which has to see every public in order, and
+// hash table lookups. The cache may never hold more than its limit, however large the PDB.
+uint32_t BenchPaged(const std::filesystem::path& PdbPath, uint32_t NumPublics, uint32_t PageCacheMB, const std::vector<std::pair<std::string, uint32_t>>& Lookups)
+{
+    PdbFile Pdb;
+    uint64_t Limit = static_cast<uint64_t>(PageCacheMB) << 20;
+
+    SetMsfPageCacheLimit(Limit);
+
+    if (!Pdb.Open(PdbPath) || !Pdb.GetMsf().IsPaged())
+    {
+        printf_s("[-] Failed to open generated PDB paged: %s! :(\n", Pdb.GetError().c_str());
+        SetMsfPageCacheLimit(0);
+
+        return 1;
+    }
+
+    MsfPageCacheStats Before = GetMsfPageCacheStats();
+    uint32_t Count = 0;
+    uint32_t Wrong = 0;
+    auto Start = std::chrono::steady_clock::now();
+
+    Pdb.EnumerateSymbols([&](const PdbSymbol& Symbol)
+    {
+        Wrong += Count >= NumPublics || Symbol.Rva != GetSyntheticPublicRva(Count) || Symbol.Name.empty();
+        Count++;
+    });
+
+    double Seconds = SecondsSince(Start);
+    MsfPageCacheStats After = GetMsfPageCacheStats();
+
+    printf_s("    %-28s %.2f M symbols/s (%.0f MB/s read, %.1f of %u MB cache used)\n", "Symbol scan (paged)", Count / Seconds / 1e6,
+        (After.Misses - Before.Misses) * Pdb.GetMsf().GetBlockSize() / Seconds / 1048576.0, After.PeakBytes / 1048576.0, PageCacheMB);
+
+    Wrong += Count != NumPublics;
+    Wrong += BenchLookups("Lookup (paged PDB)", Lookups, [&](const std::string& Name, PdbSymbol& Symbol) { return Pdb.FindSymbol(Name, Symbol); });
+
+    if (GetMsfPageCacheStats().PeakBytes > Limit)
+    {
+        printf_s("[-] Page cache grew past its limit! :(\n");
+        Wrong++;
+    }
+
+    // Later PDBs are mapped again.
+    SetMsfPageCacheLimit(0);
+
+    return Wrong;
+}
+
+// Drops a file from the OS cache, so the next reads go to the disk. False where there is no way to.
+bool EvictFromCache(const std::filesystem::path& Path)
+{
+#ifdef _WIN32
+    (void)Path;
+
+    return false;
+#else
+    int Fd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (Fd < 0)
+        return false;
+
+    // Dirty pages stay cached, freshly written files have to reach the disk first.
+    bool bEvicted = fdatasync(Fd) == 0 && posix_fadvise(Fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+
+    close(Fd);
+
+    return bEvicted;
+#endif
+}
+
+// Copies of the PDB opened and enumerated one after another from a cold cache: first on their own, then behind the
+// prefetcher with each read queue. Every open has to see all publics.
+uint32_t BenchPrefetch(const std::filesystem::path& PdbPath, const std::filesystem::path& WorkDir, uint32_t NumPublics)
+{
+    static constexpr uint32_t NumCopies = 16;
+    std::vector<std::filesystem::path> Copies;
+    std::error_code Ec;
+    uint32_t Wrong = 0;
+
+    for (uint32_t i = 0; i < NumCopies; i++)
+    {
+        Copies.push_back(WorkDir / (L"prefetch" + std::to_wstring(i) + L".pdb"));
+        std::filesystem::copy_file(PdbPath, Copies.back(), std::filesystem::copy_options::overwrite_existing, Ec);
+    }
+
+    for (int Mode = 0; Mode < 3; Mode++)
+    {
+        bool bCold = true;
+
+        for (const std::filesystem::path& Copy : Copies)
+            bCold &= EvictFromCache(Copy);
+
+        auto Start = std::chrono::steady_clock::now();
+        std::unique_ptr<PdbPrefetcher> Prefetcher;
+
+        if (Mode)
+            Prefetcher = std::make_unique<PdbPrefetcher>(Copies, Mode == 1 ? PrefetchBackend::ThreadPool : PrefetchBackend::Auto);
+
+        // Without io_uring the last pass would only repeat the thread pool.
+        if (Mode == 2 && strcmp(Prefetcher->GetBackendName(), "thread pool") == 0)
+            break;
+
+        for (uint32_t i = 0; i < NumCopies; i++)
+        {
+            PdbFile Pdb;
+            uint32_t Count = 0;
+
+            if (Prefetcher)
+                Prefetcher->Wait(i);
+
+            if (Pdb.Open(Copies[i]))
+                Pdb.EnumerateSymbols([&](const PdbSymbol&) { Count++; });
+
+            Wrong += Count != NumPublics;
+        }
+
+        char Name[64];
+
+        snprintf(Name, sizeof(Name), "PDB ingest (%s)", Prefetcher ? Prefetcher->GetBackendName() : "one by one");
+        printf_s("    %-28s %.1f ms for %u PDBs%s\n", Name, SecondsSince(Start) * 1e3, NumCopies, bCold ? " (cold cache)" : "");
+    }
+
+    for (const std::filesystem::path& Copy : Copies)
+        std::filesystem::remove(Copy, Ec);
+
+    return Wrong;
+}
+
+void BenchMembers(const PdbFile& Pdb, uint32_t NumTypes, uint32_t NumLookups)
+{
+    PdbTypes Types;
+
+    if (!NumTypes || !Types.Open(Pdb.GetMsf()))
+        return;
+
+    std::mt19937 Random(7);
+    LatencySamples Samples;
+    uint32_t Wrong = 0;
+
+    for (uint32_t i = 0; i < std::min<uint32_t>(NumLookups, 20000); i++)
+    {
+        std::string TypeName = GetSyntheticTypeName(Random() % NumTypes);
+        uint32_t Member = Random() % SyntheticMembersPerType;
+        uint64_t Offset = 0;
+        auto Start = std::chrono::steady_clock::now();
+        bool bFound = Types.FindMemberOffset(TypeName, "Field" + std::to_string(Member), Offset);
+
+        Samples.Add(std::chrono::steady_clock::now() - Start);
+        Wrong += !bFound || Offset != Member * sizeof(uint64_t);
+    }
+
+    PrintLatency("Member offset (TPI)", Samples);
+
+    if (Wrong)
+        printf_s("[-] %u member lookups returned wrong results! :(\n", Wrong);
+}
+
+void BenchOffsetsMerge(const std::filesystem::path& WorkDir, uint32_t NumPublics)
+{
+    static constexpr uint32_t NumModules = 32;
+    static constexpr uint32_t EntriesPerModule = 256;
+    static constexpr uint32_t Iterations = 5;
+
+    std::filesystem::path IniPath = GetOffsetsPath(WorkDir, OffsetsFormat::Ini);
+    OffsetSections Sections;
+    std::error_code Error;
+
+    std::filesystem::remove(IniPath, Error);
+
+    for (uint32_t Module = 0; Module < NumModules; Module++)
+    {
+        for (uint32_t i = 0; i < EntriesPerModule; i++)
+        {
+            uint32_t Index = (Module * EntriesPerModule + i) % NumPublics;
+
+            Sections[L"module" + std::to_wstring(Module) + L".sys"][Utf8ToWide(GetSyntheticPublicName(Index))] = std::to_wstring(GetSyntheticPublicRva(Index));
+        }
+    }
+
+    UpdateOffsets(IniPath, OffsetsFormat::Ini, Sections, false);
+
+    LatencySamples Samples;
+
+    // Every iteration changes one module, the rest of the file has to be carried over.
+    for (uint32_t Iteration = 0; Iteration < Iterations; Iteration++)
+    {
+        OffsetSections Updated;
+        std::wstring Module = L"module" + std::to_wstring(Iteration % NumModules) + L".sys";
+
+        for (const auto& [Name, Value] : Sections[Module])
+            Updated[Module][Name] = std::to_wstring(std::stoull(Value) + Iteration + 1);
+
+        auto Start = std::chrono::steady_clock::now();
+
+        UpdateOffsets(IniPath, OffsetsFormat::Ini, Updated, false);
+        Samples.Add(std::chrono::steady_clock::now() - Start);
+    }
+
+    PrintLatency("offsets.ini merge", Samples);
+}
+
+// Hundreds of 16-byte signatures with wildcards planted once each in 50 MB of random bytes, scanned with every
+// instruction set the CPU has; each pass must find every signature exactly once, where it was planted.
+uint32_t BenchSignatures()
+{
+    static constexpr size_t ImageSize = 50 << 20;
+    static constexpr uint32_t NumSignatures = 300;
+    static constexpr uint32_t PatternSize = 16;
+    static constexpr uint32_t NumWildcards = 4;
+
+    std::mt19937 Random(17);
+    std::vector<uint8_t> Image(ImageSize);
+    std::vector<BytePattern> Patterns(NumSignatures);
+    std::vector<size_t> Planted(NumSignatures);
+
+    for (size_t i = 0; i < ImageSize; i += sizeof(uint32_t))
+    {
+        uint32_t Value = Random();
+
+        memcpy(&Image[i], &Value, sizeof(Value));
+    }
+
+    for (uint32_t i = 0; i < NumSignatures; i++)
+    {
+        std::string Text;
+        std::string Error;
+        char Byte[4];
+
+        Planted[i] = (i + 1) * (ImageSize / (NumSignatures + 1)) + Random() % 4096;
+
+        for (uint32_t j = 0; j < PatternSize; j++)
+        {
+            // Wildcards keep the random image byte, the rest of the signature is written over it.
+            bool bWildcard = j % (PatternSize / NumWildcards) == 1;
+
+            snprintf(Byte, sizeof(Byte), "%02X ", Image[Planted[i] + j]);
+            Text += bWildcard ? "?? " : Byte;
+        }
+
+        if (!Patterns[i].Parse(Text, Error))
+        {
+            printf_s("[-] Bad generated signature: %s! :(\n", Error.c_str());
+
+            return 1;
+        }
+    }
+
+    SignatureScanner Scanner(std::move(Patterns));
+    uint32_t Wrong = 0;
+
+    for (ScanLevel Level : { ScanLevel::Scalar, ScanLevel::Sse42, ScanLevel::Avx2 })
+    {
+        if (Level > SignatureScanner::GetBestLevel())
+            break;
+
+        std::vector<uint32_t> Found(NumSignatures);
+        uint32_t Misplaced = 0;
+        char Name[64];
+        auto Start = std::chrono::steady_clock::now();
+
+        Scanner.Scan(Image.data(), Image.size(), [&](uint32_t Id, size_t Offset)
+            {
+                Found[Id]++;
+                Misplaced += Offset != Planted[Id];
+            }, Level);
+
+        double Seconds = SecondsSince(Start);
+
+        snprintf(Name, sizeof(Name), "Signature scan (%s)", SignatureScanner::GetLevelName(Level));
+        printf_s("    %-28s %.0f MB/s (%u signatures, %.1f ms)\n", Name, ImageSize / Seconds / 1048576.0, NumSignatures, Seconds * 1e3);
+
+        Wrong += Misplaced + static_cast<uint32_t>(std::count_if(Found.begin(), Found.end(), [](uint32_t Count) { return Count != 1; }));
+    }
+
+    return Wrong;
+}
+
+bool RunBenchmark(const BenchOptions& Options, uint32_t NumPublics, uint32_t BlockSize)
+{
+    SyntheticImageOptions Image;
+    std::filesystem::path PdbPath = Options.WorkDir / L"bench.pdb";
+    std::filesystem::path PePath = Options.WorkDir / L"bench.exe";
+    std::filesystem::path IndexPath = SymbolIndex::GetIndexPath(PdbPath);
+    std::string Error;
+    std::error_code Ec;
+
+    Image.NumPublics = NumPublics;
+    Image.NumTypes = Options.NumTypes;
+    Image.BlockSize = BlockSize;
+
+    printf_s("[*] %u publics, %u types, %u byte pages\n", NumPublics, Options.NumTypes, BlockSize);
+
+    auto Start = std::chrono::steady_clock::now();
+
+    if (!WriteSyntheticPdb(PdbPath, Image, Error) || !WriteSyntheticPe(PePath, Image, PdbPath.filename().string(), Error))
+    {
+        // Small pages cap the PDB size; a configuration MSF cannot hold is left out, not failed.
+        if (Error == MsfWriter::DirectoryTooLarge)
+        {
+            printf_s("[!] Skipped: a PDB this large does not fit in an MSF file with %u byte pages\n\n", BlockSize);
+
+            return true;
+        }
+
+        printf_s("[-] Failed to generate test files: %s! :(\n\n", Error.c_str());
+
+        return false;
+    }
+
+    uint64_t PdbSize = std::filesystem::file_size(PdbPath, Ec);
+
+    printf_s("    %-28s %.2f s (%.1f MB)\n", "Generate PE + PDB", SecondsSince(Start), PdbSize / 1048576.0);
+
+    if (!BenchPe(PePath))
+        return false;
+
+    LatencySamples OpenSamples;
+    PdbFile Pdb;
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        PdbFile Opened;
+
+        Start = std::chrono::steady_clock::now();
+
+        if (!Opened.Open(PdbPath))
+        {
+            printf_s("[-] Failed to open generated PDB: %s! :(\n\n", Opened.GetError().c_str());
+
+            return false;
+        }
+
+        OpenSamples.Add(std::chrono::steady_clock::now() - Start);
+    }
+
+    PrintLatency("PDB open", OpenSamples);
+    Pdb.Open(PdbPath);
+
+    std::filesystem::remove(IndexPath, Ec);
+    Start = std::chrono::steady_clock::now();
+
+    if (!SymbolIndex::Build(Pdb, PdbSize, IndexPath))
+    {
+        printf_s("[-] Failed to build symbol index! :(\n\n");
+
+        return false;
+    }
+
+    printf_s("    %-28s %s\n", "Index build", FormatDuration(static_cast<uint64_t>(SecondsSince(Start) * 1e9)).c_str());
+
+    LatencySamples IndexOpenSamples;
+    SymbolIndex Index;
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        SymbolIndex Opened;
+
+        Start = std::chrono::steady_clock::now();
+        Opened.Open(IndexPath, PdbSize, Pdb.GetGuid(), Pdb.GetAge());
+        IndexOpenSamples.Add(std::chrono::steady_clock::now() - Start);
+    }
+
+    PrintLatency("Index open", IndexOpenSamples);
+    Index.Open(IndexPath, PdbSize, Pdb.GetGuid(), Pdb.GetAge());
+
+    std::vector<std::pair<std::string, uint32_t>> Lookups = MakeLookups(NumPublics, Options.NumLookups);
+    uint32_t Wrong = BenchLookups("Lookup (PDB hash tables)", Lookups, [&](const std::string& Name, PdbSymbol& Symbol) { return Pdb.FindSymbol(Name, Symbol); });
+
+    Wrong += BenchLookups("Lookup (symbol index)", Lookups, [&](const std::string& Name, PdbSymbol& Symbol) { return Index.Find(Name, Symbol); });
+
+    Wrong += BenchAddresses(Index, NumPublics, Options.NumLookups);
+    Wrong += BenchLines(Pdb, NumPublics, Options.NumLookups);
+    Wrong += BenchExport(Pdb, Options.WorkDir, NumPublics);
+    Wrong += BenchPaged(PdbPath, NumPublics, Options.PageCacheMB, Lookups);
+    Wrong += BenchPrefetch(PdbPath, Options.WorkDir, NumPublics);
+    BenchMembers(Pdb, Options.NumTypes, Options.NumLookups);
+    BenchBatch(Index, Lookups, 1);
+
+    if (std::thread::hardware_concurrency() > 1)
+        BenchBatch(Index, Lookups, std::thread::hardware_concurrency());
+    BenchOffsetsMerge(Options.WorkDir, NumPublics);
+    Wrong += BenchSignatures();
+
+    printf_s("\n");
+
+    if (Wrong)
+    {
+        printf_s("[-] %u symbol lookups returned wrong results! :(\n\n", Wrong);
+
+        return false;
+    }
+
+    return true;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    setlocale(LC_ALL, ".UTF-8");
+    printf_s("\n------\nPDB benchmark by Aeterts\n\n");
+
+    BenchOptions Options;
+
+    if (!ParseOptions(argc, argv, Options))
+    {
+        printf_s("[!] Usage: %ls [--publics 1k,100k,5M] [--types 10k] [--page-size 512,4096] [--lookups 100k] [--page-cache 16] [--dir \"Work_dir\"] [--keep]\n", argv[0]);
+
+        return 1;
+    }
+
+    bool bTempDir = Options.WorkDir.empty();
+    std::error_code Error;
+
+    if (bTempDir)
+        Options.WorkDir = std::filesystem::temp_directory_path(Error) / L"AePDBBench";
+
+    std::filesystem::create_directories(Options.WorkDir, Error);
+
+    if (Error)
+    {
+        printf_s("[-] Cannot create work directory %ls! :(\n", Options.WorkDir.wstring().c_str());
+
+        return -1;
+    }
+
+    bool AllSuccess = true;
+
+    for (uint32_t BlockSize : Options.BlockSizes)
+    {
+        for (uint32_t NumPublics : Options.PublicCounts)
+            AllSuccess &= RunBenchmark(Options, NumPublics, BlockSize);
+    }
+
+    if (!Options.bKeepFiles)
+    {
+        for (const wchar_t* Name : { L"bench.pdb", L"bench.exe", L"bench.idx", L"bench.syms", L"bench.csv", L"offsets.ini" })
+            std::filesystem::remove(Options.WorkDir / Name, Error);
+
+        if (bTempDir)
+            std::filesystem::remove(Options.WorkDir, Error);
+    }
+
+    printf_s(AllSuccess ? "[+] Benchmark finished!\n\n------\n" : "[-] Some benchmark(s) failed! :(\n\n------\n");
+
+    return AllSuccess ? 0 : 3;
+}
+
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+    return RunWideMain(argc, argv, wmain);
+}
+#endif
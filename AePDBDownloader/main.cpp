@@ -1,250 +1,247 @@
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+
 #include <string>
-#include <urlmon.h>
-#include <iomanip>
 #include <vector>
+#include <map>
+#include <mutex>
 
-#pragma comment(lib, "urlmon.lib")
+#include "../Common/DownloadPool.h"
+#include "../Common/PeFile.h"
+#include "../Common/Stats.h"
+#include "../Common/SymbolStore.h"
 
-struct CV_INFO_PDB70
+int HandleFile(const wchar_t* FilePath, std::string& PDBFileName, std::string& FullHex)
 {
-    DWORD CvSignature;
-    GUID Signature;
-    DWORD Age;
-    char PdbFileName[1];
-};
+    PeDebugInfo Info;
+    std::string Error;
+    PeStatus Status = ReadPeDebugInfo(FilePath, Info, Error);
 
-std::wstring GetCurrentAppFolder()
-{
-    wchar_t Buffer[1024];
+    if (Status != PeStatus::Ok)
+    {
+        printf_s("[-] %s! :(\n\n", Error.c_str());
 
-    GetModuleFileNameW(NULL, Buffer, 1024);
+        switch (Status)
+        {
+        case PeStatus::NotFound: return 2;
+        case PeStatus::ReadFailed: return 3;
+        case PeStatus::BadDosHeader: return 6;
+        case PeStatus::BadNtHeaders: return 7;
+        case PeStatus::NoDebugDirectory: return 8;
+        case PeStatus::BadDebugDirectory: return 9;
+        default: return 10;
+        }
+    }
 
-    size_t Pos = std::wstring(Buffer).find_last_of(L"\\/");
+    printf_s("[+] PDB info found! Name: %s\n", Info.PdbPath.c_str());
 
-    return std::wstring(Buffer).substr(0, Pos + 1);
+    PDBFileName = Info.GetPdbFileName();
+    FullHex = Info.GetSignature();
+
+    return 0;
 }
 
-std::string GuidToString(const GUID& guid)
+bool ParseOptions(int argc, wchar_t* argv[], int& FirstFile, DownloadOptions& Options, std::wstring& SymbolPath, uint32_t& MissTtl)
 {
-    char Buffer[33];
-
-    snprintf(Buffer, sizeof(Buffer), "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X", guid.Data1, guid.Data2, guid.Data3,
-        guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+    for (FirstFile = 1; FirstFile < argc && wcsncmp(argv[FirstFile], L"--", 2) == 0; FirstFile++)
+    {
+        if (ParseStatsOption(argc, argv, FirstFile))
+            continue;
 
-    return std::string(Buffer, 32);
-}
+        std::wstring Name = argv[FirstFile];
 
-void CleanupResources(void* pBase, HANDLE hMapping, HANDLE hFile)
-{
-    if (pBase)
-        UnmapViewOfFile(pBase);
+        if (Name == L"--compressed")
+        {
+            Options.bPreferCompressed = true;
 
-    if (hMapping && hMapping != INVALID_HANDLE_VALUE)
-        CloseHandle(hMapping);
+            continue;
+        }
 
-    if (hFile && hFile != INVALID_HANDLE_VALUE)
-        CloseHandle(hFile);
-}
+        if (Name == L"--sparse")
+        {
+            Options.bSparse = true;
 
-std::wstring GenerateFileName(std::string FileName, const std::string& FullHex)
-{
-    size_t Pos = FileName.rfind(".pdb");
-    std::string Result;
+            continue;
+        }
 
-    FileName = FileName.substr(0, Pos);
-    Result = FileName + "_" + FullHex + ".pdb";
+        if (FirstFile + 1 >= argc)
+            return false;
+
+        std::wstring Value = argv[++FirstFile];
+
+        if (Name == L"--jobs")
+            Options.Workers = std::wcstoul(Value.c_str(), nullptr, 10);
+        else if (Name == L"--timeout")
+            Options.TimeoutMs = std::wcstoul(Value.c_str(), nullptr, 10) * 1000;
+        else if (Name == L"--retries")
+            Options.MaxAttempts = std::wcstoul(Value.c_str(), nullptr, 10) + 1;
+        else if (Name == L"--server")
+            SymbolPath = L"srv*" + Value;
+        else if (Name == L"--symbol-path")
+            SymbolPath = Value;
+        else if (Name == L"--miss-ttl")
+            MissTtl = std::wcstoul(Value.c_str(), nullptr, 10) * 60 * 60;
+        else
+            return false;
+    }
 
-    return std::wstring(Result.begin(), Result.end());
+    return FirstFile < argc;
 }
 
-int HandleFile(const wchar_t* FilePath)
+int wmain(int argc, wchar_t* argv[])
 {
-    if (GetFileAttributesW(FilePath) == INVALID_FILE_ATTRIBUTES)
-    {
-        printf_s("[-] File not found! :(\n\n");
-
-        return 2;
-    }
+    setlocale(LC_ALL, ".UTF-8");
+    printf_s("\n------\nPDB downloader by Aeterts\n\n");
 
-    HANDLE hFile = CreateFileW(FilePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    DownloadOptions Options;
+    std::wstring SymbolPath = L"srv*" + Utf8ToWide(DefaultSymbolServer);
+    uint32_t MissTtl = SymbolMissCache::DefaultTtlSeconds;
+    int FirstFile = 1;
 
-    if (hFile == INVALID_HANDLE_VALUE)
+    if (!ParseOptions(argc, argv, FirstFile, Options, SymbolPath, MissTtl))
     {
-        printf_s("[-] CreateFile failed! :(\n\n");
+        printf_s("[!] Usage: %ls [--jobs N] [--timeout Seconds] [--retries N] [--server Url | --symbol-path \"srv*Dir*Url;...\"] [--miss-ttl Hours] [--compressed] [--sparse] [--stats] [--trace \"Trace.json\"] \"Path_to_PE_files\"\n", argv[0]);
 
-        return 3;
+        return 1;
     }
 
-    HANDLE hMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    std::string PathError;
 
-    if (!hMapping)
+    if (!ParseSymbolPath(SymbolPath, Options.Tiers, PathError))
     {
-        CleanupResources(nullptr, nullptr, hFile);
-        printf_s("[-] CreateFileMapping failed! :( Code: %d\n\n", GetLastError());
+        printf_s("[-] %s! :(\n", PathError.c_str());
 
-        return 4;
+        return 1;
     }
 
-    void* pBase = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    SymbolStore Store;
+    SymbolMissCache Misses;
 
-    if (!pBase)
-    {
-        CleanupResources(nullptr, hMapping, hFile);
-        printf_s("[-] MapViewOfFile failed! :( Code: %d\n\n", GetLastError());
+    if (!Store.Open(GetExecutablePath().parent_path() / L"Symbols"))
+        printf_s("[!] Failed to write symbol store manifest!\n");
 
-        return 5;
-    }
-
-    PIMAGE_DOS_HEADER DosHeader = static_cast<PIMAGE_DOS_HEADER>(pBase);
+    Misses.Open(GetExecutablePath().parent_path() / L"symmisses.txt", MissTtl);
+    Options.Misses = &Misses;
 
-    if (DosHeader->e_magic != IMAGE_DOS_SIGNATURE)
-    {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] Not a valid PE file! :(\n\n");
-
-        return 6;
-    }
+    std::mutex ResultsLock;
+    std::map<std::string, DownloadResult> Results;
+    std::vector<std::pair<std::wstring, std::string>> Files;
 
-    PIMAGE_NT_HEADERS NtHeaders = reinterpret_cast<PIMAGE_NT_HEADERS>(reinterpret_cast<BYTE*>(pBase) + DosHeader->e_lfanew);
+    int Result = 0;
 
-    if (NtHeaders->Signature != IMAGE_NT_SIGNATURE)
+    DownloadPool Pool(Options, [&](const DownloadJob& Job, const DownloadResult& JobResult)
     {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] Not a valid PE file (NT signature)! :(\n\n");
+        if (JobResult.bSuccess)
+        {
+            Store.Add(WideToUtf8(Job.SavePath.filename().wstring()), WideToUtf8(Job.SavePath.parent_path().filename().wstring()),
+                !JobResult.bSparse ? PdbContents::Full : Job.bTypes ? PdbContents::SymbolsAndTypes : PdbContents::Symbols);
+
+            if (JobResult.Response.ResumedFrom)
+                printf_s("[*] Resumed %s at %llu bytes\n", Job.Key.c_str(), static_cast<unsigned long long>(JobResult.Response.ResumedFrom));
+
+            if (!JobResult.Attempts)
+                printf_s("[+] Copied %s from %s\n", Job.Key.c_str(), JobResult.Source.c_str());
+            else if (JobResult.bSparse)
+                printf_s("[+] Downloaded %s from %s (sparse, %llu of %llu bytes, attempts: %u)\n", Job.Key.c_str(), JobResult.Source.c_str(),
+                    static_cast<unsigned long long>(JobResult.Response.Bytes), static_cast<unsigned long long>(JobResult.RemoteSize), JobResult.Attempts);
+            else
+                printf_s("[+] Downloaded %s from %s (%llu bytes%s, attempts: %u)\n", Job.Key.c_str(), JobResult.Source.c_str(),
+                    static_cast<unsigned long long>(JobResult.Response.Bytes), JobResult.bCompressed ? " compressed" : "", JobResult.Attempts);
+
+            if (JobResult.WrittenBack)
+                printf_s("[*] Stored %s in %u cache director%s\n", Job.Key.c_str(), JobResult.WrittenBack, JobResult.WrittenBack == 1 ? "y" : "ies");
+        }
+        else
+        {
+            printf_s("[-] Download failed! :( %s from %s -> %s (attempts: %u)\n", Job.Key.c_str(), JobResult.Source.c_str(), JobResult.Response.Error.c_str(), JobResult.Attempts);
+        }
 
-        return 7;
-    }
+        std::lock_guard<std::mutex> Guard(ResultsLock);
 
-    DWORD DebugDirRVA = NtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG].VirtualAddress;
-    DWORD DebugDirSize = NtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG].Size;
+        Results[Job.Key] = JobResult;
+    });
 
-    if (!DebugDirRVA || !DebugDirSize)
+    for (int i = FirstFile; i < argc; i++)
     {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] No debug directory found! :(\n\n");
-
-        return 8;
-    }
+        printf_s("[*] Processing %ls file...\n", argv[i]);
 
-    PIMAGE_DEBUG_DIRECTORY DebugDir = nullptr;
-    PIMAGE_SECTION_HEADER Section = IMAGE_FIRST_SECTION(NtHeaders);
+        std::string PDBFileName;
+        std::string FullHex;
+        int Code = HandleFile(argv[i], PDBFileName, FullHex);
 
-    for (int i = 0; i < NtHeaders->FileHeader.NumberOfSections; ++i, ++Section)
-    {
-        if (DebugDirRVA >= Section->VirtualAddress && DebugDirRVA < Section->VirtualAddress + Section->Misc.VirtualSize)
+        if (Code != 0)
         {
-            DWORD offset = DebugDirRVA - Section->VirtualAddress + Section->PointerToRawData;
-            DebugDir = reinterpret_cast<PIMAGE_DEBUG_DIRECTORY>(reinterpret_cast<BYTE*>(pBase) + offset);
+            if (Result == 0)
+                Result = Code;
 
-            break;
+            continue;
         }
-    }
 
-    if (!DebugDir)
-    {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] Debug directory section not found! :(\n\n");
+        DownloadJob Job;
+        std::error_code Error;
 
-        return 9;
-    }
+        Job.Key = PDBFileName + "/" + FullHex;
+        Job.PdbName = PDBFileName;
+        Job.Signature = FullHex;
+        Job.SavePath = Store.GetPdbPath(PDBFileName, FullHex);
 
-    CV_INFO_PDB70* CvInfo = nullptr;
-    char* PDBNamePtr = nullptr;
-    GUID Guid = { 0 };
-    DWORD Age = 0;
-    std::string PDBFullName;
+        Files.emplace_back(argv[i], Job.Key);
 
-    for (DWORD i = 0; i < DebugDirSize / sizeof(IMAGE_DEBUG_DIRECTORY); i++)
-    {
-        if (DebugDir[i].Type == IMAGE_DEBUG_TYPE_CODEVIEW)
+        // The local store is the nearest tier. A sparse PDB there only does for another sparse download.
+        if (Store.Contains(PDBFileName, FullHex, Options.bSparse ? PdbContents::Symbols : PdbContents::Full) && std::filesystem::is_regular_file(Job.SavePath, Error))
         {
-            CvInfo = reinterpret_cast<CV_INFO_PDB70*>(reinterpret_cast<BYTE*>(pBase) + DebugDir[i].PointerToRawData);
+            printf_s("[+] PDB %s is already in the local store\n\n", Job.Key.c_str());
 
-            if (CvInfo && CvInfo->CvSignature == 0x53445352)
-            {
-                Guid = CvInfo->Signature;
-                Age = CvInfo->Age;
-                PDBNamePtr = CvInfo->PdbFileName;
+            std::lock_guard<std::mutex> Guard(ResultsLock);
 
-                if (PDBNamePtr)
-                    PDBFullName = PDBNamePtr;
+            Results[Job.Key].bSuccess = true;
 
-                break;
-            }
+            continue;
         }
-    }
-
-    if (PDBFullName.empty())
-    {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] No CodeView debug information found! :(\n\n");
-
-        return 10;
-    }
-
-    printf_s("[+] PDB info found! Name: %s\n", PDBFullName.c_str());
-    CleanupResources(pBase, hMapping, hFile);
-
-    size_t Pos = PDBFullName.find_last_of("\\/");
-    std::string PDBFileName = (Pos != std::string::npos) ? PDBFullName.substr(Pos + 1) : PDBFullName;
 
-    char AgeBuffer[9];
-
-    sprintf_s(AgeBuffer, "%X", Age);
-
-    std::string Url = "http://msdl.microsoft.com/download/symbols/";
-    std::string FullHex = GuidToString(Guid) + AgeBuffer;
-    Url += PDBFileName + "/" + FullHex + "/" + PDBFileName;
-
-    std::wstring SaveDir = GetCurrentAppFolder() + L"Symbols\\";
-
-    CreateDirectoryW(SaveDir.c_str(), nullptr);
-
-    std::wstring UrlW(Url.begin(), Url.end());
-    std::wstring SavePath = SaveDir + GenerateFileName(PDBFileName, FullHex);
-
-    printf_s("[*] Downloading: %ls\n", UrlW.c_str());
-
-    HRESULT hResult = URLDownloadToFileW(nullptr, UrlW.c_str(), SavePath.c_str(), 0, nullptr);
-
-    if (hResult == S_OK)
-    {
-        wprintf_s(L"[*] Saving to: %ls\n[+] Downloaded successfully!\n\n", SavePath.c_str());
-    }
-    else
-    {
-        printf_s("[-] Download failed! :( Code: 0x%X\n\n", static_cast<unsigned long>(hResult));
+        if (Pool.Submit(Job))
+            printf_s("[*] Downloading: %s\n\n", Job.Key.c_str());
+        else
+            printf_s("[*] PDB %s is already queued, sharing download\n\n", PDBFileName.c_str());
     }
 
-    return 0;
-}
+    Pool.Wait();
 
-int wmain(int argc, wchar_t* argv[])
-{
-    setlocale(LC_ALL, ".UTF-8");
-    printf_s("\n------\nPDB downloader by Aeterts\n\n");
+    if (!Store.Save())
+        printf_s("[!] Failed to write symbol store manifest!\n");
 
-    if (argc < 2)
-    {
-        printf_s("[!] Usage: %ls \"Path_to_PE_files\"\n", argv[0]);
+    if (!Misses.Save())
+        printf_s("[!] Failed to write symbol miss cache!\n");
 
-        return 1;
-    }
+    printf_s("\n");
 
-    int Result = 0;
-
-    for (int i = 1; i < argc; i++)
+    for (const auto& [File, Key] : Files)
     {
-        printf_s("[*] Processing %ls file...\n", argv[i]);
+        const DownloadResult& FileResult = Results[Key];
 
-        Result = HandleFile(argv[i]);
+        if (FileResult.bSuccess)
+        {
+            printf_s("[+] %ls -> %s\n", File.c_str(), Key.c_str());
+        }
+        else
+        {
+            printf_s("[-] %ls -> %s failed! :( %s\n", File.c_str(), Key.c_str(), FileResult.Response.Error.c_str());
 
-        if (Result != 0)
-            break;
+            if (Result == 0)
+                Result = 11;
+        }
     }
 
+    FinishStats();
     printf_s("------\n");
 
     return Result;
-}
\ No newline at end of file
+}
+
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+    return RunWideMain(argc, argv, wmain);
+}
+#endif
@@ -1,257 +1,420 @@
+#ifdef _WIN32
 #include <Windows.h>
-#include <DbgHelp.h>
+#endif
+
 #include <string>
 #include <vector>
-#include <iostream>
 #include <filesystem>
-#include <sstream>
-#include <map>
-#include <set>
 #include <fstream>
+#include <map>
 
-#pragma comment(lib, "Dbghelp.lib")
+#include "../Common/Platform.h"
+#include "../Common/OffsetsOutput.h"
+#include "../Common/PdbPrefetch.h"
+#include "../Common/Stats.h"
+#include "../Common/SymbolExport.h"
+#include "../Common/SymbolResolver.h"
+#include "../Common/SymbolServer.h"
+#include "../Common/SymbolStore.h"
 
-std::vector<std::wstring> SplitSymbols(const std::wstring& SymbolsStr)
+std::filesystem::path FindPdbInStore(const std::filesystem::path& SymbolsPath, const std::wstring& PdbPath)
 {
-    std::vector<std::wstring> Symbols;
-    std::wstringstream StrStream(SymbolsStr);
-    std::wstring Symbol;
+    std::filesystem::path Path(PdbPath);
+    std::string PdbName = WideToUtf8(Path.stem().wstring()) + ".pdb";
+    SymbolStore Store;
 
-    while (std::getline(StrStream, Symbol, L','))
-    {
-        size_t Start = Symbol.find_first_not_of(L" \t");
-        size_t End = Symbol.find_last_not_of(L" \t");
+    // Only looks: a path typed by the user is no place to create, move or write files in.
+    Store.Open(Path.has_parent_path() ? Path.parent_path() : SymbolsPath, true);
 
-        if (Start != std::wstring::npos && End != std::wstring::npos)
-            Symbol = Symbol.substr(Start, End - Start + 1);
+    std::vector<std::string> Signatures = Store.GetSignatures(PdbName);
 
-        if (!Symbol.empty())
-            Symbols.push_back(std::move(Symbol));
+    for (auto It = Signatures.rbegin(); It != Signatures.rend(); ++It)
+    {
+        std::filesystem::path Candidate = Store.GetPdbPath(PdbName, *It);
+
+        if (std::filesystem::is_regular_file(Candidate))
+            return Candidate;
     }
 
-    return Symbols;
+    return {};
 }
 
-std::wstring FindPdbFileByBaseName(const std::wstring& PdbPath)
+// Hex RVAs (0x prefix optional) separated by commas, spaces or new lines.
+bool ParseAddresses(const std::string& Text, std::vector<uint32_t>& Rvas)
 {
-    std::filesystem::path Path(PdbPath);
-    std::wstring BaseName = Path.stem().wstring();
-    std::filesystem::path Dir = Path.parent_path();
+    const char* Cursor = Text.c_str();
 
-    if (Dir.empty())
-        Dir = std::filesystem::current_path() / L"Symbols";
-
-    for (const auto& entry : std::filesystem::directory_iterator(Dir))
+    while (*Cursor)
     {
-        if (entry.is_regular_file())
+        if (*Cursor == ',' || isspace(static_cast<uint8_t>(*Cursor)))
         {
-            std::wstring fileName = entry.path().filename().wstring();
+            Cursor++;
 
-            if (fileName.size() > BaseName.size() + 1 &&
-                fileName.substr(0, BaseName.size() + 1) == BaseName + L"_" &&
-                _wcsicmp(fileName.substr(fileName.size() - 4).c_str(), L".pdb") == 0)
-            {
-                return entry.path().wstring();
-            }
+            continue;
         }
+
+        char* End;
+        unsigned long long Value = std::strtoull(Cursor, &End, 16);
+
+        if (End == Cursor || Value > UINT32_MAX || (*End && *End != ',' && !isspace(static_cast<uint8_t>(*End))))
+            return false;
+
+        Rvas.push_back(static_cast<uint32_t>(Value));
+        Cursor = End;
     }
 
-    return L"";
+    return true;
 }
 
-bool UpdateIniSections(const std::wstring& IniPath, const std::map<std::wstring, std::map<std::wstring, std::wstring>>& UpdatedSections)
+int SymbolizeAddresses(const std::filesystem::path& SymbolsPath, const wchar_t* PdbArg, const wchar_t* AddressArg, bool bLines)
 {
-    std::wstring TempPath = IniPath + L".tmp";
-    std::wofstream TempFile(TempPath, std::ios::trunc);
+    std::filesystem::path PDBPath(PdbArg);
+
+    if (!std::filesystem::is_regular_file(PDBPath))
+        PDBPath = FindPdbInStore(SymbolsPath, PdbArg);
 
-    if (!TempFile.is_open())
+    if (PDBPath.empty())
     {
-        printf_s("[-] Failed to create temporary file! :( Path: %ls\n", TempPath.c_str());
+        printf_s("[-] File not found: %ls\n", PdbArg);
 
-        return false;
+        return 3;
     }
 
-    std::wifstream IniFile(IniPath);
+    std::string Text;
 
-    std::set<std::wstring> ProcessedSections;
-    
-    std::wstring CurrentSection;
+    if (AddressArg[0] == L'@')
+    {
+        std::ifstream In(std::filesystem::path(AddressArg + 1), std::ios::binary);
 
-    bool bInSectionToSkip = false;
-    bool bFirstSectionWritten = false;
-    bool bLastLineWasSection = false;
-    bool bFileExists = IniFile.is_open();
+        if (!In.is_open())
+        {
+            printf_s("[-] Cannot read %ls! :(\n", AddressArg + 1);
 
-    if (bFileExists)
+            return 3;
+        }
+
+        Text.assign(std::istreambuf_iterator<char>(In), std::istreambuf_iterator<char>());
+    }
+    else
     {
-        std::wstring Line;
+        Text = WideToUtf8(AddressArg);
+    }
 
-        while (std::getline(IniFile, Line))
-        {
-            if (Line.size() > 2 && Line[0] == L'[' && Line.back() == L']')
-            {
-                CurrentSection = Line.substr(1, Line.size() - 2);
-                bool bIsUpdatedSection = (UpdatedSections.find(CurrentSection) != UpdatedSections.end());
+    std::vector<uint32_t> Rvas;
+
+    if (!ParseAddresses(Text, Rvas))
+    {
+        printf_s("[-] Invalid address list (expected hex RVAs)! :(\n");
 
-                if (bIsUpdatedSection)
-                {
-                    if (bFirstSectionWritten)
-                        TempFile << L"\n";
+        return 1;
+    }
 
-                    TempFile << L"[" << CurrentSection << L"]\n";
+    SymbolResolver Resolver;
 
-                    for (const auto& [Key, Value] : UpdatedSections.at(CurrentSection))
-                        TempFile << Key << L"=" << Value << L"\n";
+    if (!Resolver.Open(PDBPath))
+        return 3;
 
-                    bInSectionToSkip = true;
-                    bFirstSectionWritten = true;
-                    bLastLineWasSection = true;
+    std::vector<SymbolAddressMatch> Matches(Rvas.size());
+    auto Start = std::chrono::steady_clock::now();
 
-                    ProcessedSections.insert(CurrentSection);
+    if (!Resolver.FindAddresses(Rvas.data(), Rvas.size(), Matches.data()))
+    {
+        printf_s("[-] Address lookups need the symbol index! :(\n");
 
-                    continue;
-                }
+        return 3;
+    }
 
-                if (bFirstSectionWritten && !bLastLineWasSection)
-                    TempFile << L"\n";
+    std::vector<PdbSourceLine> SourceLines(bLines ? Rvas.size() : 0);
 
-                TempFile << Line << L"\n";
-                bLastLineWasSection = true;
-                bInSectionToSkip = false;
-            }
-            else
-            {
-                if (!Line.empty() && !std::all_of(Line.begin(), Line.end(), iswspace))
-                    bLastLineWasSection = false;
+    if (bLines && !Resolver.FindLines(Rvas.data(), Rvas.size(), SourceLines.data()))
+        printf_s("[!] The PDB has no line information\n");
+
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+    std::string Output;
+    size_t Found = 0;
+
+    for (size_t i = 0; i < Rvas.size(); i++)
+    {
+        char Line[32];
+
+        snprintf(Line, sizeof(Line), "0x%08X\t", Rvas[i]);
+        Output += Line;
 
-                if (bInSectionToSkip)
-                    continue;
+        if (Matches[i].Entry == UINT32_MAX)
+        {
+            Output += '-';
+        }
+        else
+        {
+            Output += Resolver.GetSymbolName(Matches[i].Entry);
+            Found++;
 
-                TempFile << Line << L"\n";
+            if (Matches[i].Displacement)
+            {
+                snprintf(Line, sizeof(Line), "+0x%X", Matches[i].Displacement);
+                Output += Line;
             }
         }
 
-        IniFile.close();
+        if (bLines && SourceLines[i].Line)
+        {
+            snprintf(Line, sizeof(Line), ":%u", SourceLines[i].Line);
+            Output += '\t';
+            Output += SourceLines[i].File;
+            Output += Line;
+        }
+        else if (bLines)
+        {
+            Output += "\t-";
+        }
+
+        Output += '\n';
+
+        if (Output.size() >= (1 << 20))
+        {
+            fwrite(Output.data(), 1, Output.size(), stdout);
+            Output.clear();
+        }
     }
 
-    bool bIsAddedNewSection = false;
+    fwrite(Output.data(), 1, Output.size(), stdout);
+    printf_s("\n[+] %zu of %zu addresses resolved (%.2f M lookups/s)\n\n", Found, Rvas.size(), Seconds > 0 ? Rvas.size() / Seconds / 1e6 : 0.0);
+
+    return Found == Rvas.size() ? 0 : 3;
+}
+
+int ExportPdbSymbols(const std::filesystem::path& SymbolsPath, const wchar_t* PdbArg, const wchar_t* OutputArg, SymbolExportFormat Format)
+{
+    std::filesystem::path PDBPath(PdbArg);
+
+    if (!std::filesystem::is_regular_file(PDBPath))
+        PDBPath = FindPdbInStore(SymbolsPath, PdbArg);
 
-    for (const auto& [Section, Values] : UpdatedSections)
+    if (PDBPath.empty())
     {
-        if (ProcessedSections.find(Section) == ProcessedSections.end())
-        {
-            if (bFirstSectionWritten || bIsAddedNewSection)
-                TempFile << L"\n";
+        printf_s("[-] File not found: %ls\n", PdbArg);
 
-            TempFile << L"[" << Section << L"]\n";
+        return 3;
+    }
 
-            for (const auto& [Key, Value] : Values)
-                TempFile << Key << L"=" << Value << L"\n";
+    PdbFile Pdb;
 
-            bIsAddedNewSection = true;
-            bFirstSectionWritten = true;
-        }
+    if (!Pdb.Open(PDBPath))
+    {
+        printf_s("[-] %s! :(\n", Pdb.GetError().c_str());
+
+        return 3;
     }
 
-    TempFile.close();
+    SymbolExportResult Result;
+    std::string Error;
+    auto Start = std::chrono::steady_clock::now();
 
-    if (!bFirstSectionWritten)
+    if (!ExportSymbols(Pdb, OutputArg, Format, Result, Error))
     {
-        _wremove(TempPath.c_str());
-        printf_s("[-] Nothing to write to INI file\n");
+        printf_s("[-] %s! :(\n", Error.c_str());
 
-        return false;
+        return 3;
     }
 
-    if (!MoveFileExW(TempPath.c_str(), IniPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED))
+    double Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+
+    printf_s("[+] Exported %llu symbols (%llu distinct names, %.1f MB) to %ls in %.2f s\n\n", static_cast<unsigned long long>(Result.NumSymbols),
+        static_cast<unsigned long long>(Result.NumNames), Result.BytesWritten / 1048576.0, OutputArg, Seconds);
+
+    return 0;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    setlocale(LC_ALL, ".UTF-8");
+    printf_s("\n------\nPDB parser by Aeterts\n\n");
+
+    // Options shared by every mode come first and are taken in one pass, the mode (if any) follows them.
+    OffsetsFormat Format = OffsetsFormat::Ini;
+    PrefetchBackend Prefetch = PrefetchBackend::ThreadPool;
+    int FirstArg = 1;
+
+    while (FirstArg < argc)
     {
-        DWORD Error = GetLastError();
+        if (ParseStatsOption(argc, argv, FirstArg))
+        {
+            FirstArg++;
 
-        _wremove(TempPath.c_str());
+            continue;
+        }
 
-        if (Error == ERROR_ALREADY_EXISTS)
+        if (_wcsicmp(argv[FirstArg], L"--page-cache") == 0 && FirstArg + 1 < argc)
         {
-            printf_s("[!] ERROR_ALREADY_EXISTS: Attempting fallback method...\n");
+            SetMsfPageCacheLimit(std::wcstoull(argv[FirstArg + 1], nullptr, 10) << 20);
+            FirstArg += 2;
 
-            if (DeleteFileW(IniPath.c_str()) || GetLastError() == ERROR_FILE_NOT_FOUND)
+            continue;
+        }
+
+        if (_wcsicmp(argv[FirstArg], L"--prefetch") == 0 && FirstArg + 1 < argc)
+        {
+            if (_wcsicmp(argv[FirstArg + 1], L"threads") == 0)
+                Prefetch = PrefetchBackend::ThreadPool;
+            else if (_wcsicmp(argv[FirstArg + 1], L"io_uring") == 0)
+                Prefetch = PrefetchBackend::Auto;
+            else
             {
-                if (MoveFileW(TempPath.c_str(), IniPath.c_str()))
-                {
-                    printf_s("[+] Successfully updated (fallback method): %ls\n", IniPath.c_str());
+                printf_s("[-] Unknown prefetch backend: %ls (expected threads or io_uring)\n", argv[FirstArg + 1]);
 
-                    return true;
-                }
+                return 1;
             }
+
+            FirstArg += 2;
+
+            continue;
         }
 
-        LPVOID lpMsgBuf;
-        
-        FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, Error,
-            MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPWSTR)&lpMsgBuf, 0, NULL);
+        if (_wcsicmp(argv[FirstArg], L"--format") != 0 || FirstArg + 1 >= argc)
+            break;
 
-        printf_s("[-] Failed to replace INI file! :( Path: %ls -> %ls (Error: %lu - %ls)\n", TempPath.c_str(), IniPath.c_str(), Error, (LPWSTR)lpMsgBuf);
-        LocalFree(lpMsgBuf);
+        if (!ParseOffsetsFormat(argv[FirstArg + 1], Format))
+        {
+            printf_s("[-] Unknown offsets format: %ls (expected ini, json or bin)\n", argv[FirstArg + 1]);
 
-        return false;
+            return 1;
+        }
+
+        FirstArg += 2;
     }
 
-    printf_s("[+] Successfully updated: %ls\n", IniPath.c_str());
+    int NumArgs = argc - FirstArg;
 
-    return true;
-}
+    if (NumArgs > 0 && _wcsicmp(argv[FirstArg], L"--serve") == 0)
+    {
+        std::filesystem::path ExeDir = GetExecutablePath().parent_path();
+        std::filesystem::path SocketPath = NumArgs > 1 ? std::filesystem::path(argv[FirstArg + 1]) : ExeDir / L"AePDB.sock";
+        uint64_t Budget = NumArgs > 2 ? std::wcstoull(argv[FirstArg + 2], nullptr, 10) << 20 : SymbolServer::DefaultBudget;
 
-int wmain(int argc, wchar_t* argv[])
-{
-    setlocale(LC_ALL, ".UTF-8");
-    printf_s("\n------\nPDB parser by Aeterts\n\n");
+        if (!Budget)
+        {
+            printf_s("[!] Usage: %ls [--page-cache MB] [--stats] [--trace \"Trace.json\"] --serve [\"Socket_path\"] [Cache_budget_MB]\n", argv[0]);
 
-    if (argc < 4 || (argc - 1) % 3 != 0)
+            return 1;
+        }
+
+        SymbolServer Server(ExeDir / L"Symbols", Budget);
+        bool bServed = Server.Run(SocketPath);
+
+        FinishStats();
+
+        return bServed ? 0 : -1;
+    }
+
+    if (NumArgs > 0 && _wcsicmp(argv[FirstArg], L"--addr") == 0)
     {
-        printf_s("[!] Usage: %ls \"Path_to_PDB_file1\" \"PE_file_name1\" \"Symbol1, Symbol2, ...\" \"Path_to_PDB_file2\" \"PE_file_name2\" \"Symbol1, Symbol2, ...\"...\n", argv[0]);
+        bool bLines = NumArgs > 1 && _wcsicmp(argv[FirstArg + 1], L"--lines") == 0;
+        int PdbArg = FirstArg + (bLines ? 2 : 1);
 
-        return 1;
+        if (NumArgs != (bLines ? 4 : 3))
+        {
+            printf_s("[!] Usage: %ls [--page-cache MB] [--stats] [--trace \"Trace.json\"] --addr [--lines] \"Path_to_PDB_file\" \"Rva1, Rva2, ...\" | @\"Rvas.txt\"\n", argv[0]);
+
+            return 1;
+        }
+
+        int AddrResult = SymbolizeAddresses(GetExecutablePath().parent_path() / L"Symbols", argv[PdbArg], argv[PdbArg + 1], bLines);
+
+        printf_s("------\n");
+        FinishStats();
+
+        return AddrResult;
     }
 
-    if (!SymInitializeW(GetCurrentProcess(), NULL, FALSE))
+    if (NumArgs > 0 && _wcsicmp(argv[FirstArg], L"--export") == 0)
     {
-        printf_s("[-] SymInitialize() failed! :( Code: %d", GetLastError());
+        bool bCsv = NumArgs > 1 && _wcsicmp(argv[FirstArg + 1], L"--csv") == 0;
+        int PdbArg = FirstArg + (bCsv ? 2 : 1);
+
+        if (NumArgs != (bCsv ? 4 : 3))
+        {
+            printf_s("[!] Usage: %ls [--page-cache MB] [--stats] [--trace \"Trace.json\"] --export [--csv] \"Path_to_PDB_file\" \"Output_file\"\n", argv[0]);
+
+            return 1;
+        }
+
+        int ExportResult = ExportPdbSymbols(GetExecutablePath().parent_path() / L"Symbols", argv[PdbArg], argv[PdbArg + 1],
+            bCsv ? SymbolExportFormat::Csv : SymbolExportFormat::Columnar);
 
-        return 2;
+        printf_s("------\n");
+        FinishStats();
+
+        return ExportResult;
     }
 
-    DWORD SymOptions = SymGetOptions();
-    SymOptions |= SYMOPT_LOAD_LINES | SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS;
+    if (NumArgs < 3 || NumArgs % 3 != 0 || wcsncmp(argv[FirstArg], L"--", 2) == 0)
+    {
+        printf_s("[!] Usage: %ls [--format ini|json|bin] [--page-cache MB] [--prefetch threads|io_uring] [--stats] [--trace \"Trace.json\"] \"Path_to_PDB_file1\" \"PE_file_name1\" \"Symbol1, Symbol2, ...\" \"Path_to_PDB_file2\" \"PE_file_name2\" \"Symbol1, Symbol2, ...\"...\n", argv[0]);
 
-    SymSetOptions(SymOptions);
+        return 1;
+    }
 
     bool AllSuccess = true;
-    bool bIsFirstSection = true;
 
-    std::map<std::wstring, std::map<std::wstring, std::wstring>> UpdatedSections;
+    OffsetSections UpdatedSections;
 
-    wchar_t CurrentExePath[MAX_PATH];
+    std::filesystem::path CurrentExePath = GetExecutablePath();
 
-    if (!GetModuleFileNameW(NULL, CurrentExePath, MAX_PATH))
+    if (CurrentExePath.empty())
     {
-        wprintf_s(L"[-] GetModuleFileName failed! :( (Error: %d)\n", GetLastError());
+        printf_s("[-] Failed to get executable path! :(\n");
 
         return -1;
     }
 
-    for (int i = 1; i < argc; i += 3)
+    // PDBs are looked up once, by path, by file name in the store or by store pattern. Cold runs over many PDBs: those
+    // that have no symbol index yet are read ahead all at once, each is resolved as soon as its pages are in.
+    std::filesystem::path SymbolsPath = CurrentExePath.parent_path() / L"Symbols";
+    std::vector<std::filesystem::path> PDBPaths;
+    std::vector<std::filesystem::path> PrefetchPaths;
+    size_t NumPrefetched = 0;
+
+    for (int i = FirstArg; i < argc; i += 3)
+    {
+        std::filesystem::path InputPath(argv[i]);
+        std::filesystem::path Path = SymbolsPath / InputPath.filename();
+
+        if (std::filesystem::is_regular_file(InputPath))
+            Path = InputPath;
+        else if (!std::filesystem::is_regular_file(Path))
+            Path = FindPdbInStore(SymbolsPath, argv[i]);
+
+        std::filesystem::path PrefetchPath = Path;
+        std::error_code Ec;
+
+        if (!PrefetchPath.empty() && std::filesystem::exists(SymbolIndex::GetIndexPath(PrefetchPath), Ec))
+            PrefetchPath.clear();
+
+        NumPrefetched += !PrefetchPath.empty();
+        PrefetchPaths.push_back(std::move(PrefetchPath));
+        PDBPaths.push_back(std::move(Path));
+    }
+
+    std::unique_ptr<PdbPrefetcher> Prefetcher;
+
+    if (NumPrefetched > 1)
+    {
+        Prefetcher = std::make_unique<PdbPrefetcher>(PrefetchPaths, Prefetch);
+        printf_s("[*] Prefetching %zu PDB files (%s)...\n\n", NumPrefetched, Prefetcher->GetBackendName());
+    }
+
+    for (int i = FirstArg; i < argc; i += 3)
     {
         std::filesystem::path InputPath(argv[i]);
-        std::filesystem::path PDBPath = std::filesystem::path(CurrentExePath).parent_path() / L"Symbols" / InputPath.filename();
-        bool FileExists = std::filesystem::exists(InputPath);
+        const std::filesystem::path& PDBPath = PDBPaths[(i - FirstArg) / 3];
+        bool FileExists = std::filesystem::is_regular_file(InputPath);
 
-        printf_s("[*] Processing PDB %ls file...\n", (FileExists ? InputPath.filename().c_str() : InputPath.c_str()));
+        printf_s("[*] Processing PDB %ls file...\n", (FileExists ? InputPath.filename().wstring().c_str() : argv[i]));
 
-        if (!FileExists && !std::filesystem::exists(PDBPath))
+        if (!FileExists && !std::filesystem::is_regular_file(SymbolsPath / InputPath.filename()))
         {
             printf_s("[!] File not found, search for matching pattern...\n");
 
-            PDBPath = FindPdbFileByBaseName(argv[i]);
-
             if (PDBPath.empty())
             {
                 printf_s("[-] File not found: %ls\n\n", argv[i]);
@@ -261,74 +424,53 @@ int wmain(int argc, wchar_t* argv[])
                 continue;
             }
 
-            printf_s("[+] Found matching PDB file: %ls\n", PDBPath.c_str());
+            printf_s("[+] Found matching PDB file: %ls\n", PDBPath.wstring().c_str());
         }
 
         std::vector<std::wstring> SymbolNames = SplitSymbols(argv[i + 2]);
 
         if (SymbolNames.empty())
         {
-            printf_s("[-] No valid symbols for %ls\n\n", PDBPath.c_str());
+            printf_s("[-] No valid symbols for %ls\n\n", PDBPath.wstring().c_str());
 
             AllSuccess = false;
 
             continue;
         }
 
-        DWORD FileSize = static_cast<DWORD>(std::filesystem::file_size(PDBPath.c_str()));
+        SymbolResolver Resolver;
 
-        DWORD64 BaseAddr = 0x40000;
-        DWORD64 ModBase = SymLoadModuleExW(GetCurrentProcess(), NULL, PDBPath.c_str(), NULL, BaseAddr,
-            FileSize, NULL, 0);
+        if (Prefetcher)
+            Prefetcher->Wait((i - FirstArg) / 3);
 
-        if (ModBase == 0)
+        if (!Resolver.Open(PDBPath))
         {
-            printf_s("[-] SymLoadModuleExW() failed! :( Code: 0x%X\n\n", GetLastError());
-
             AllSuccess = false;
 
             continue;
         }
 
-        SYMBOL_INFO_PACKAGEW SymInfoPackage{};
-        SymInfoPackage.si.SizeOfStruct = sizeof(SYMBOL_INFOW);
-        SymInfoPackage.si.MaxNameLen = sizeof(SymInfoPackage.name);
-
-        bool bIsFileSuccess = true;
-        bool bIsSectionWritten = false;
-
-        for (const std::wstring& Sym : SymbolNames)
-        {
-            BOOL bRet = SymFromNameW(GetCurrentProcess(), Sym.c_str(), &SymInfoPackage.si);
-
-            if (!bRet || !SymInfoPackage.si.Address)
-            {
-                printf_s("[-] Symbol '%ls' not found! :( Code: 0x%X\n\n", Sym.c_str(), GetLastError());
-
-                bIsFileSuccess = false;
-
-                continue;
-            }
-
-            ULONG64 Offset = SymInfoPackage.si.Address - ModBase;
+        std::map<std::wstring, std::wstring> Offsets;
 
-            printf_s("[+] Found symbol '%ls' -> Offset: %I64u | RVA: 0x%I64x\n", Sym.c_str(),
-                Offset, SymInfoPackage.si.Address);
+        bool bIsFileSuccess = Resolver.ResolveOffsets(SymbolNames, Offsets);
 
-            UpdatedSections[std::filesystem::path(argv[i + 1]).filename().c_str()][Sym] = std::to_wstring(Offset);
-        }
+        for (const auto& [Sym, Offset] : Offsets)
+            UpdatedSections[std::filesystem::path(argv[i + 1]).filename().wstring()][Sym] = Offset;
 
         printf_s("\n");
-        SymUnloadModule64(GetCurrentProcess(), ModBase);
 
         if (!bIsFileSuccess)
             AllSuccess = false;
     }
 
-    printf_s("%s\n", UpdatedSections.empty() ? "[+] All offsets is up to date!" :
-        (UpdateIniSections(std::filesystem::path(CurrentExePath).parent_path() / L"offsets.ini", UpdatedSections) ?
-            "[+] All offsets saved to offsets.ini!" : "[-] Failed to update offsets.ini! :("));
-    SymCleanup(GetCurrentProcess());
+    std::filesystem::path OffsetsPath = GetOffsetsPath(CurrentExePath.parent_path(), Format);
+
+    if (UpdatedSections.empty())
+        printf_s("[+] All offsets is up to date!\n");
+    else if (UpdateOffsets(OffsetsPath, Format, UpdatedSections))
+        printf_s("[+] All offsets saved to %ls!\n", OffsetsPath.filename().wstring().c_str());
+    else
+        printf_s("[-] Failed to update %ls! :(\n", OffsetsPath.filename().wstring().c_str());
 
     int FinalResult;
 
@@ -345,7 +487,15 @@ int wmain(int argc, wchar_t* argv[])
         FinalResult = 3;
     }
 
+    FinishStats();
     printf_s("------\n");
 
     return FinalResult;
-}
\ No newline at end of file
+}
+
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+    return RunWideMain(argc, argv, wmain);
+}
+#endif
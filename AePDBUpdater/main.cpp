@@ -1,362 +1,789 @@
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+
 #include <vector>
 #include <string>
 #include <sstream>
 #include <filesystem>
-
-struct CV_INFO_PDB70
+#include <fstream>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "../Common/DownloadPool.h"
+#include "../Common/NamePattern.h"
+#include "../Common/OffsetsOutput.h"
+#include "../Common/PeCache.h"
+#include "../Common/PeFile.h"
+#include "../Common/SignatureScan.h"
+#include "../Common/Stats.h"
+#include "../Common/SymbolResolver.h"
+#include "../Common/SymbolStore.h"
+#include "../Common/WorkQueue.h"
+#include "../Common/WorkStealingPool.h"
+
+struct UpdateRequest
 {
-    DWORD CvSignature;
-    GUID Signature;
-    DWORD Age;
-    char PdbFileName[1];
+    std::filesystem::path PEPath;
+    std::wstring Symbols;
+    std::string PDBFileName;
+    std::string FullHex;
+    std::filesystem::path PDBPath;
+    std::vector<std::string> OldSignatures;
+    std::string CacheKey;
+    FileIdentity Identity;
+    bool bIdentity = false;
+    uint64_t SymbolsHash = 0;
+    // What the local PDB has to hold for these symbols.
+    PdbContents Needed = PdbContents::Full;
 };
 
-std::string GuidToString(const GUID& guid)
+struct PendingPdb
 {
-    char Buffer[33];
-
-    snprintf(Buffer, sizeof(Buffer), "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X", guid.Data1, guid.Data2, guid.Data3,
-        guid.Data4[0], guid.Data4[1], guid.Data4[2], guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+    std::vector<UpdateRequest> Requests;
+    bool bDone = false;
+    bool bSuccess = false;
+    // Set once the PDB has been fetched; a PDB already in the store is parsed as it is.
+    bool bFetched = false;
+    PdbContents Contents = PdbContents::Full;
+};
 
-    return std::string(Buffer, 32);
-}
+// The offsets file of this run as it was before the run.
+struct OffsetsTarget
+{
+    std::string Path;
+    OffsetsFormat Format = OffsetsFormat::Ini;
+    OffsetSections Sections;
+};
 
-std::wstring GenerateFileName(std::string FileName, const std::string& FullHex)
+// Full PDBs unless sparse fetching was asked for; a sparse PDB has to keep the types for "Type::Member" queries.
+PdbContents GetNeededContents(const std::wstring& Symbols, bool bSparse)
 {
-    size_t Pos = FileName.rfind(".pdb");
-    std::string Result;
+    if (!bSparse)
+        return PdbContents::Full;
 
-    FileName = FileName.substr(0, Pos);
-    Result = FileName + "_" + FullHex + ".pdb";
+    for (const std::wstring& Symbol : SplitSymbols(Symbols))
+    {
+        if (SymbolResolver::IsMemberQuery(WideToUtf8(Symbol)))
+            return PdbContents::SymbolsAndTypes;
+    }
 
-    return std::wstring(Result.begin(), Result.end());
+    return PdbContents::Symbols;
 }
 
-void CleanupResources(void* pBase, HANDLE hMapping, HANDLE hFile)
+// The symbols resolved for this binary last time are still what its section in the offsets file of this run holds.
+bool IsSectionCurrent(const PeCacheRecord& Cached, const UpdateRequest& Request, const OffsetsTarget& Output)
 {
-    if (pBase)
-        UnmapViewOfFile(pBase);
+    if (Cached.SymbolsHash != Request.SymbolsHash || Cached.OutputPath != Output.Path || Cached.Format != Output.Format)
+        return false;
 
-    if (hMapping && hMapping != INVALID_HANDLE_VALUE)
-        CloseHandle(hMapping);
+    auto It = Output.Sections.find(Request.PEPath.filename().wstring());
 
-    if (hFile && hFile != INVALID_HANDLE_VALUE)
-        CloseHandle(hFile);
+    return It != Output.Sections.end() && It->second == Cached.Offsets;
 }
 
-std::wstring FindPdbFileByBaseName(const std::filesystem::path& SymbolsPath, const std::wstring& PdbPath)
+int HandleFile(const SymbolStore& Store, PeCache& Cache, const OffsetsTarget& Output, const std::filesystem::path& FilePath, UpdateRequest& Request,
+    bool bSparse, bool bReportErrors)
 {
-    std::filesystem::path Path(PdbPath);
-    std::wstring BaseName = Path.stem();
+    PeCacheRecord Cached;
+    std::error_code Ec;
+
+    Request.CacheKey = WideToUtf8(std::filesystem::absolute(FilePath, Ec).lexically_normal().wstring());
+    Request.bIdentity = GetFileIdentity(FilePath, Request.Identity);
+    Request.SymbolsHash = PeCache::HashSymbols(SplitSymbols(Request.Symbols));
+    Request.Needed = GetNeededContents(Request.Symbols, bSparse);
 
-    for (const auto& Entry : std::filesystem::directory_iterator(Path.has_parent_path() ? Path.parent_path() : SymbolsPath))
+    bool bCached = Request.bIdentity && Cache.Find(Request.CacheKey, Request.Identity, Cached);
+
+    // An unchanged binary whose PDB is still in the store is confirmed with a single stat.
+    if (bCached && Store.Contains(Cached.PdbName, Cached.Signature, Request.Needed))
     {
-        if (Entry.is_regular_file())
-        {
-            std::wstring FileName = Entry.path().filename();
+        Request.PDBFileName = Cached.PdbName;
+        Request.FullHex = Cached.Signature;
+        Request.PDBPath = Store.GetPdbPath(Cached.PdbName, Cached.Signature);
 
-            if (FileName.size() > BaseName.size() + 1 && FileName.substr(0, BaseName.size() + 1) == BaseName + L"_" &&
-                _wcsicmp(FileName.substr(FileName.size() - 4).c_str(), L".pdb") == 0)
-            {
-                return Entry.path();
-            }
-        }
+        return IsSectionCurrent(Cached, Request, Output) ? 0 : 5;
     }
 
-    return L"";
-}
+    PeDebugInfo Info;
+    std::string Error;
+    PeStatus Status = ReadPeDebugInfo(FilePath, Info, Error);
 
-int HandleFile(const std::filesystem::path& SymbolsPath, const std::filesystem::path& FilePath, std::wstring& NewPDBName, std::vector<std::wstring>& OldFiles)
-{
-    if (!std::filesystem::exists(FilePath))
+    if (Status != PeStatus::Ok)
     {
-        printf_s("[-] File not found! :(\n\n");
+        if (bReportErrors)
+            printf_s("[-] %s! :(\n\n", Error.c_str());
 
-        return 3;
+        switch (Status)
+        {
+        case PeStatus::NotFound: return 3;
+        case PeStatus::ReadFailed: return 4;
+        case PeStatus::BadDosHeader: return 7;
+        case PeStatus::BadNtHeaders: return 8;
+        case PeStatus::NoDebugDirectory: return 9;
+        case PeStatus::BadDebugDirectory: return 10;
+        default: return 11;
+        }
     }
 
-    HANDLE hFile = CreateFileW(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+    std::string PDBFileName = Info.GetPdbFileName();
+    std::string FullHex = Info.GetSignature();
+
+    Request.PDBFileName = PDBFileName;
+    Request.FullHex = FullHex;
+    Request.PDBPath = Store.GetPdbPath(PDBFileName, FullHex);
 
-    if (hFile == INVALID_HANDLE_VALUE)
+    // The PDB is here, but only offsets resolved from it for this binary and still in the output are done: a binary that
+    // changed while its PDB did not (signed or copied after the build) keeps its record, anything else is resolved from
+    // the local PDB.
+    if (Store.Contains(PDBFileName, FullHex, Request.Needed) && std::filesystem::is_regular_file(Request.PDBPath))
     {
-        printf_s("[-] CreateFile failed! :(\n\n");
+        if (Cached.PdbName != PDBFileName || Cached.Signature != FullHex || !IsSectionCurrent(Cached, Request, Output))
+            return 5;
 
-        return 4;
-    }
+        if (Request.bIdentity)
+        {
+            Cached.Identity = Request.Identity;
+            Cache.Add(Request.CacheKey, Cached);
+        }
 
-    HANDLE hMapping = CreateFileMapping(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        return 0;
+    }
 
-    if (!hMapping)
+    for (const std::string& Signature : Store.GetSignatures(PDBFileName))
     {
-        CleanupResources(nullptr, nullptr, hFile);
-        printf_s("[-] CreateFileMapping failed! :( Code: %d\n\n", GetLastError());
-
-        return 5;
+        if (Signature != FullHex)
+            Request.OldSignatures.push_back(Signature);
     }
 
-    void* pBase = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+    // A sparse PDB that holds less than these symbols need is fetched again over it.
+    return Request.OldSignatures.empty() && !Store.Contains(PDBFileName, FullHex, PdbContents::Symbols) ? 2 : 1;
+}
 
-    if (!pBase)
-    {
-        CleanupResources(nullptr, hMapping, hFile);
-        printf_s("[-] MapViewOfFile failed! :( Code: %d\n\n", GetLastError());
+struct SymbolSpec
+{
+    NamePattern FilePattern;
+    std::wstring Symbols;
+};
 
-        return 6;
-    }
+struct ScanResult
+{
+    UpdateRequest Request;
+    int CheckCode = 0;
+};
 
-    PIMAGE_DOS_HEADER DosHeader = static_cast<PIMAGE_DOS_HEADER>(pBase);
+// Written only by its own worker; aligned so neighbouring workers don't share a cache line.
+struct alignas(64) ScanWorkerResults
+{
+    std::vector<ScanResult> Files;
+    uint64_t Directories = 0;
+};
 
-    if (DosHeader->e_magic != IMAGE_DOS_SIGNATURE)
+struct ScanState
+{
+    ScanState(const SymbolStore& Store, PeCache& Cache, const OffsetsTarget& Output, bool bSparse, const std::vector<NamePattern>& Filters,
+        const std::vector<SymbolSpec>& Specs) :
+        Store(Store), Cache(Cache), Output(Output), bSparse(bSparse), Filters(Filters), Specs(Specs), Workers(Pool.GetWorkerCount())
     {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] Not a valid PE file! :(\n\n");
-
-        return 7;
     }
 
-    PIMAGE_NT_HEADERS NtHeaders = reinterpret_cast<PIMAGE_NT_HEADERS>(reinterpret_cast<BYTE*>(pBase) + DosHeader->e_lfanew);
+    const SymbolStore& Store;
+    PeCache& Cache;
+    const OffsetsTarget& Output;
+    bool bSparse;
+    const std::vector<NamePattern>& Filters;
+    const std::vector<SymbolSpec>& Specs;
+    WorkStealingPool Pool;
+    std::vector<ScanWorkerResults> Workers;
+};
 
-    if (NtHeaders->Signature != IMAGE_NT_SIGNATURE)
+std::string ToLowerAscii(std::string Str)
+{
+    for (char& Char : Str)
     {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] Not a valid PE file (NT signature)! :(\n\n");
-
-        return 8;
+        if (Char >= 'A' && Char <= 'Z')
+            Char = static_cast<char>(Char - 'A' + 'a');
     }
 
-    DWORD DebugDirRVA = NtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG].VirtualAddress;
-    DWORD DebugDirSize = NtHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG].Size;
+    return Str;
+}
+
+std::string_view TrimSpaces(std::string_view Str)
+{
+    size_t Start = Str.find_first_not_of(" \t\r");
+    size_t End = Str.find_last_not_of(" \t\r");
 
-    if (!DebugDirRVA || !DebugDirSize)
-    {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] No debug directory found! :(\n\n");
+    return Start == std::string_view::npos ? std::string_view() : Str.substr(Start, End - Start + 1);
+}
 
-        return 9;
-    }
+// One "<file pattern> = Symbol1, Symbol2, ..." per line, '#' starts a comment. Patterns match the file name
+// case-insensitively; a file gets the symbols of every line it matches.
+bool LoadSymbolSpec(const std::filesystem::path& Path, std::vector<SymbolSpec>& Specs)
+{
+    std::ifstream In(Path);
+    std::string Line;
 
-    PIMAGE_DEBUG_DIRECTORY DebugDir = nullptr;
-    PIMAGE_SECTION_HEADER Section = IMAGE_FIRST_SECTION(NtHeaders);
+    if (!In.is_open())
+        return false;
 
-    for (int i = 0; i < NtHeaders->FileHeader.NumberOfSections; ++i, ++Section)
+    for (uint32_t LineNumber = 1; std::getline(In, Line); LineNumber++)
     {
-        if (DebugDirRVA >= Section->VirtualAddress && DebugDirRVA < Section->VirtualAddress + Section->Misc.VirtualSize)
+        std::string_view Text = TrimSpaces(Line);
+        size_t Separator = Text.find('=');
+
+        if (Text.empty() || Text.front() == '#')
+            continue;
+
+        if (Separator == std::string_view::npos || TrimSpaces(Text.substr(0, Separator)).empty())
         {
-            DWORD offset = DebugDirRVA - Section->VirtualAddress + Section->PointerToRawData;
-            DebugDir = reinterpret_cast<PIMAGE_DEBUG_DIRECTORY>(reinterpret_cast<BYTE*>(pBase) + offset);
+            printf_s("[!] Ignoring line %u of %ls: expected \"<file pattern> = Symbol1, Symbol2, ...\"\n", LineNumber, Path.wstring().c_str());
 
-            break;
+            continue;
         }
+
+        Specs.push_back({ NamePattern(ToLowerAscii(std::string(TrimSpaces(Text.substr(0, Separator))))), Utf8ToWide(std::string(TrimSpaces(Text.substr(Separator + 1)))) });
     }
 
-    if (!DebugDir)
-    {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] Debug directory section not found! :(\n\n");
+    return true;
+}
 
-        return 10;
-    }
+void CheckScannedFile(ScanState& State, const std::filesystem::path& Path, std::wstring Symbols, uint32_t Worker)
+{
+    ScanResult Result;
+
+    Result.Request.PEPath = Path;
+    Result.Request.Symbols = std::move(Symbols);
+    Result.CheckCode = HandleFile(State.Store, State.Cache, State.Output, Path, Result.Request, State.bSparse, false);
 
-    CV_INFO_PDB70* CvInfo = nullptr;
-    char* PDBNamePtr = nullptr;
-    GUID Guid = {0};
-    DWORD Age = 0;
-    std::string PDBFullName;
+    State.Workers[Worker].Files.push_back(std::move(Result));
+}
 
-    for (DWORD i = 0; i < DebugDirSize / sizeof(IMAGE_DEBUG_DIRECTORY); i++)
+void ScanDirectory(ScanState& State, const std::filesystem::path& Dir, uint32_t Worker)
+{
+    std::error_code Error;
+
+    State.Workers[Worker].Directories++;
+
+    for (std::filesystem::directory_iterator It(Dir, std::filesystem::directory_options::skip_permission_denied, Error), End; !Error && It != End;
+        It.increment(Error))
     {
-        if (DebugDir[i].Type == IMAGE_DEBUG_TYPE_CODEVIEW)
+        std::error_code EntryError;
+
+        // Symlinked directories are not followed, they could lead back into the tree.
+        if (It->is_directory(EntryError) && !It->is_symlink(EntryError))
         {
-            CvInfo = reinterpret_cast<CV_INFO_PDB70*>(reinterpret_cast<BYTE*>(pBase) + DebugDir[i].PointerToRawData);
+            State.Pool.Submit([&State, Path = It->path()](uint32_t Worker) { ScanDirectory(State, Path, Worker); });
 
-            if (CvInfo && CvInfo->CvSignature == 0x53445352)
-            {
-                Guid = CvInfo->Signature;
-                Age = CvInfo->Age;
-                PDBNamePtr = CvInfo->PdbFileName;
+            continue;
+        }
 
-                if (PDBNamePtr)
-                    PDBFullName = PDBNamePtr;
+        if (!It->is_regular_file(EntryError))
+            continue;
 
-                break;
-            }
+        std::string Name = ToLowerAscii(WideToUtf8(It->path().filename().wstring()));
+
+        if (!State.Filters.empty() && std::none_of(State.Filters.begin(), State.Filters.end(), [&](const NamePattern& Filter) { return Filter.Match(Name); }))
+            continue;
+
+        std::wstring Symbols;
+
+        for (const SymbolSpec& Spec : State.Specs)
+        {
+            if (Spec.FilePattern.Match(Name) && !Spec.Symbols.empty())
+                Symbols += (Symbols.empty() ? L"" : L", ") + Spec.Symbols;
         }
+
+        if (!Symbols.empty())
+            State.Pool.Submit([&State, Path = It->path(), Symbols = std::move(Symbols)](uint32_t Worker) mutable { CheckScannedFile(State, Path, std::move(Symbols), Worker); });
     }
+}
 
-    if (PDBFullName.empty())
-    {
-        CleanupResources(pBase, hMapping, hFile);
-        printf_s("[-] No CodeView debug information found! :(\n\n");
+// Walks all roots in parallel, checking every file that passes the filters and has symbols in the spec.
+// Results are collected per worker and merged once the pool is drained, sorted by path.
+std::vector<ScanResult> ScanRoots(const SymbolStore& Store, PeCache& Cache, const OffsetsTarget& Output, bool bSparse, const std::vector<std::filesystem::path>& Roots,
+    const std::vector<NamePattern>& Filters, const std::vector<SymbolSpec>& Specs, uint64_t& NumDirectories)
+{
+    ScopedTimer Timer("Scan");
+    ScanState State(Store, Cache, Output, bSparse, Filters, Specs);
+    std::vector<ScanResult> Results;
+
+    for (const std::filesystem::path& Root : Roots)
+        State.Pool.Submit([&State, Root](uint32_t Worker) { ScanDirectory(State, Root, Worker); });
+
+    State.Pool.Wait();
+
+    NumDirectories = 0;
 
-        return 11;
+    for (ScanWorkerResults& Worker : State.Workers)
+    {
+        NumDirectories += Worker.Directories;
+        std::move(Worker.Files.begin(), Worker.Files.end(), std::back_inserter(Results));
     }
 
-    CleanupResources(pBase, hMapping, hFile);
+    std::sort(Results.begin(), Results.end(), [](const ScanResult& Left, const ScanResult& Right) { return Left.Request.PEPath < Right.Request.PEPath; });
+
+    return Results;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    setlocale(LC_ALL, ".UTF-8");
+    printf_s("\n------\nPDB updater by Aeterts\n\n");
+
+    OffsetsFormat Format = OffsetsFormat::Ini;
+    int FirstArg = 1;
+    bool bBadOption = false;
 
-    size_t Pos = PDBFullName.find_last_of("\\/");
-    std::string PDBFileName = (Pos != std::string::npos) ? PDBFullName.substr(Pos + 1) : PDBFullName;
+    std::vector<std::filesystem::path> ScanRootPaths;
+    std::vector<NamePattern> Filters;
+    std::filesystem::path SpecPath;
+    std::filesystem::path SignaturesPath;
+    std::wstring SymbolPath = L"srv*" + Utf8ToWide(DefaultSymbolServer);
+    uint32_t MissTtl = SymbolMissCache::DefaultTtlSeconds;
+    bool bSparse = false;
+
+    while (FirstArg < argc && wcsncmp(argv[FirstArg], L"--", 2) == 0 && !bBadOption)
+    {
+        if (ParseStatsOption(argc, argv, FirstArg))
+        {
+            FirstArg++;
+
+            continue;
+        }
 
-    char AgeBuffer[9];
+        if (_wcsicmp(argv[FirstArg], L"--sparse") == 0)
+        {
+            bSparse = true;
+            FirstArg++;
 
-    sprintf_s(AgeBuffer, "%X", Age);
+            continue;
+        }
 
-    std::string FullHex = GuidToString(Guid) + AgeBuffer;
+        bBadOption = FirstArg + 1 >= argc;
 
-    std::wstring FileName = GenerateFileName(PDBFileName, FullHex);
+        if (bBadOption)
+            break;
 
-    std::filesystem::path PDBPath = SymbolsPath / FileName;
+        const wchar_t* Value = argv[FirstArg + 1];
 
-    NewPDBName = FileName;
+        if (_wcsicmp(argv[FirstArg], L"--format") == 0)
+        {
+            if (!ParseOffsetsFormat(Value, Format))
+            {
+                printf_s("[-] Unknown offsets format: %ls (expected ini, json or bin)\n", Value);
 
-    if (std::filesystem::exists(PDBPath))
-        return 0;
+                return 1;
+            }
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--scan") == 0)
+        {
+            ScanRootPaths.push_back(Value);
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--filter") == 0)
+        {
+            for (const std::wstring& Filter : SplitSymbols(Value))
+                Filters.emplace_back(ToLowerAscii(WideToUtf8(Filter)));
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--spec") == 0)
+        {
+            SpecPath = Value;
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--symbol-path") == 0)
+        {
+            SymbolPath = Value;
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--miss-ttl") == 0)
+        {
+            MissTtl = std::wcstoul(Value, nullptr, 10) * 60 * 60;
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--signatures") == 0)
+        {
+            SignaturesPath = Value;
+        }
+        else if (_wcsicmp(argv[FirstArg], L"--page-cache") == 0)
+        {
+            SetMsfPageCacheLimit(std::wcstoull(Value, nullptr, 10) << 20);
+        }
+        else
+        {
+            bBadOption = true;
+        }
 
-    std::filesystem::path DownloadedPDBPath = FindPdbFileByBaseName(SymbolsPath, std::wstring(PDBFileName.begin(), PDBFileName.end()));
-    std::wstring DownloadedPDBName = DownloadedPDBPath.filename();
+        FirstArg += 2;
+    }
 
-    if (DownloadedPDBName.empty())
-        return 2;
+    if (bBadOption || ScanRootPaths.empty() != SpecPath.empty() || (ScanRootPaths.empty() && argc - FirstArg < 2) || (argc - FirstArg) % 2 != 0)
+    {
+        printf_s("[!] Usage: %ls [--format ini|json|bin] [--symbol-path \"srv*Dir*Url;...\"] [--miss-ttl Hours] [--signatures \"Signatures.txt\"] [--sparse] [--page-cache MB] [--stats] [--trace \"Trace.json\"] \"Path_to_PE_file1\" \"Symbol1, Symbol2, ...\" \"Path_to_PE_file2\" \"Symbol1, Symbol2, ...\"...\n", argv[0]);
+        printf_s("[!]        %ls [--format ini|json|bin] [--symbol-path \"srv*Dir*Url;...\"] [--miss-ttl Hours] [--signatures \"Signatures.txt\"] [--sparse] [--page-cache MB] [--stats] [--trace \"Trace.json\"] --scan \"Dir\" [--scan \"Dir2\"...] [--filter \"*.sys, *.dll\"] --spec \"Symbols.txt\" [PE/symbol pairs...]\n", argv[0]);
+
+        return 1;
+    }
 
-    size_t FirstPos = DownloadedPDBName.find_last_of('_');
-    size_t LastPos = DownloadedPDBName.find(L".pdb");
+    DownloadOptions Options;
+    std::string PathError;
 
-    if (std::wstring(FullHex.begin(), FullHex.end()) != DownloadedPDBName.substr(FirstPos + 1, LastPos - FirstPos - 1))
+    if (!ParseSymbolPath(SymbolPath, Options.Tiers, PathError))
     {
-        OldFiles.push_back(DownloadedPDBPath.wstring());
+        printf_s("[-] %s! :(\n", PathError.c_str());
 
         return 1;
     }
 
-    return 12;
-}
+    std::vector<SymbolSpec> Specs;
 
-int wmain(int argc, wchar_t* argv[])
-{
-    setlocale(LC_ALL, ".UTF-8");
-    printf_s("\n------\nPDB updater by Aeterts\n\n");
+    if (!SpecPath.empty() && !LoadSymbolSpec(SpecPath, Specs))
+    {
+        printf_s("[-] Cannot read symbol spec %ls! :(\n", SpecPath.wstring().c_str());
 
-    if (argc < 3 || argc % 2 != 1)
+        return 1;
+    }
+
+    SignatureFile Signatures;
+    std::string SignaturesError;
+
+    if (!SignaturesPath.empty() && !Signatures.Load(SignaturesPath, SignaturesError))
     {
-        printf_s("[!] Usage: %ls \"Path_to_PE_file1\" \"Symbol1, Symbol2, ...\" \"Path_to_PE_file2\" \"Symbol1, Symbol2, ...\"...\n", argv[0]);
+        printf_s("[-] %s! :(\n", SignaturesError.c_str());
 
         return 1;
     }
 
-    wchar_t CurrentExePath[MAX_PATH];
+    std::filesystem::path CurrentExePath = GetExecutablePath();
 
-    if (!GetModuleFileNameW(NULL, CurrentExePath, MAX_PATH))
+    if (CurrentExePath.empty())
     {
-        wprintf_s(L"[-] GetModuleFileName failed! :( (Error: %d)\n", GetLastError());
+        printf_s("[-] Failed to get executable path! :(\n");
 
         return -1;
     }
 
-    std::filesystem::path AePDBDir(CurrentExePath);
-    AePDBDir = AePDBDir.parent_path();
+    std::filesystem::path AePDBDir = CurrentExePath.parent_path();
+
+    SymbolStore Store;
+
+    if (!Store.Open(AePDBDir / L"Symbols"))
+        printf_s("[!] Failed to write symbol store manifest!\n");
+
+    PeCache Cache;
+
+    Cache.Open(AePDBDir / L"pecache.bin");
+
+    OffsetsTarget Output;
+    std::filesystem::path OffsetsPath = GetOffsetsPath(AePDBDir, Format);
+    std::error_code Ec;
+
+    Output.Path = WideToUtf8(std::filesystem::absolute(OffsetsPath, Ec).lexically_normal().wstring());
+    Output.Format = Format;
+    ReadOffsets(OffsetsPath, Format, Output.Sections);
+
+    SymbolMissCache Misses;
+
+    Misses.Open(AePDBDir / L"symmisses.txt", MissTtl);
+
+    std::mutex StateLock;
+    std::map<std::string, PendingPdb> Pending;
+    // PEs without a PDB to parse whose module has signatures; scanned once the pipeline has drained.
+    std::vector<UpdateRequest> SignatureRequests;
+    // PEs whose symbols all resolved; recorded in the PE cache once their offsets are written.
+    std::vector<UpdateRequest> ResolvedRequests;
+    WorkQueue<std::string> ParseQueue;
+
+    OffsetSections UpdatedSections;
 
-    std::filesystem::path SymbolsPath = AePDBDir / L"Symbols";
+    bool bDownloadFailed = false;
+    bool bParseFailed = false;
 
-    if (!std::filesystem::exists(SymbolsPath))
-        std::filesystem::create_directory(SymbolsPath);
+    Options.bSparse = bSparse;
+    Options.Misses = &Misses;
 
-    std::wstring DownloaderCmd = AePDBDir / L"AePDBDownloader.exe";
-    std::wstring ParserCmd = AePDBDir / L"AePDBParser.exe";
+    DownloadPool Pool(Options, [&](const DownloadJob& Job, const DownloadResult& Result)
+    {
+        if (Result.bSuccess && !Result.Attempts)
+            printf_s("[+] Copied %s from %s\n", Job.Key.c_str(), Result.Source.c_str());
+        else if (Result.bSuccess && Result.bSparse)
+            printf_s("[+] Downloaded %s from %s (sparse, %llu of %llu bytes)\n", Job.Key.c_str(), Result.Source.c_str(),
+                static_cast<unsigned long long>(Result.Response.Bytes), static_cast<unsigned long long>(Result.RemoteSize));
+        else if (Result.bSuccess)
+            printf_s("[+] Downloaded %s from %s (%llu bytes%s)\n", Job.Key.c_str(), Result.Source.c_str(), static_cast<unsigned long long>(Result.Response.Bytes),
+                Result.bCompressed ? " compressed" : "");
+        else
+            printf_s("[-] Download failed! :( %s from %s -> %s\n", Job.Key.c_str(), Result.Source.c_str(), Result.Response.Error.c_str());
+
+        {
+            std::lock_guard<std::mutex> Guard(StateLock);
 
-    std::vector<std::wstring> OldFiles;
+            Pending[Job.Key].bDone = true;
+            Pending[Job.Key].bSuccess = Pending[Job.Key].bFetched = Result.bSuccess;
+            Pending[Job.Key].Contents = !Result.bSparse ? PdbContents::Full : Job.bTypes ? PdbContents::SymbolsAndTypes : PdbContents::Symbols;
+        }
 
-    bool bNeedUpdate = false;
+        ParseQueue.Push(Job.Key);
+    });
 
-    for (int i = 1; i < argc; i += 2)
+    std::thread Parser([&]()
     {
-        std::filesystem::path PEPath(argv[i]);
+        std::string Key;
+
+        while (ParseQueue.Pop(Key))
+        {
+            std::vector<UpdateRequest> Requests;
+            bool bSuccess;
+            bool bFetched;
+            PdbContents Contents;
+
+            {
+                std::lock_guard<std::mutex> Guard(StateLock);
+
+                Requests.swap(Pending[Key].Requests);
+                bSuccess = Pending[Key].bSuccess;
+                bFetched = Pending[Key].bFetched;
+                Contents = Pending[Key].Contents;
+            }
+
+            if (Requests.empty())
+                continue;
+
+            if (!bSuccess)
+            {
+                bool bUncovered = false;
+
+                // PEs whose module has signatures still get their offsets, just not from a PDB.
+                for (UpdateRequest& Request : Requests)
+                {
+                    if (!Signatures.Find(Request.PEPath))
+                    {
+                        bUncovered = true;
+
+                        continue;
+                    }
+
+                    printf_s("[!] No PDB for %ls, falling back to signatures\n", Request.PEPath.filename().wstring().c_str());
+
+                    std::lock_guard<std::mutex> Guard(StateLock);
+
+                    SignatureRequests.push_back(std::move(Request));
+                }
+
+                if (bUncovered)
+                {
+                    printf_s("[-] Update failed while downloading %s, old files will not be removed! :(\n", Key.c_str());
+
+                    bDownloadFailed = true;
+                }
+
+                continue;
+            }
+
+            if (bFetched)
+                Store.Add(Requests.front().PDBFileName, Requests.front().FullHex, Contents);
+
+            for (const UpdateRequest& Request : Requests)
+            {
+                for (const std::string& OldSignature : Request.OldSignatures)
+                {
+                    printf_s("[*] Removing: %s/%s\n", Request.PDBFileName.c_str(), OldSignature.c_str());
+
+                    if (!Store.Remove(Request.PDBFileName, OldSignature))
+                        printf_s("[!] Failed to remove %s/%s\n", Request.PDBFileName.c_str(), OldSignature.c_str());
+                }
+            }
+
+            printf_s("[*] Processing PDB %s file...\n", Key.c_str());
 
-        std::wstring NewPDBName;
+            SymbolResolver Resolver;
 
-        int CheckCode = HandleFile(SymbolsPath, PEPath, NewPDBName, OldFiles);
+            if (!Resolver.Open(Requests.front().PDBPath))
+            {
+                bParseFailed = true;
+
+                continue;
+            }
+
+            for (const UpdateRequest& Request : Requests)
+            {
+                std::map<std::wstring, std::wstring> Offsets;
+
+                if (!Resolver.ResolveOffsets(SplitSymbols(Request.Symbols), Offsets))
+                    bParseFailed = true;
+                else if (Request.bIdentity)
+                    ResolvedRequests.push_back(Request);
+
+                for (const auto& [Sym, Offset] : Offsets)
+                    UpdatedSections[Request.PEPath.filename().wstring()][Sym] = Offset;
+            }
+        }
+    });
+
+    // Prints the check result and hands PEs that need work to the download/parse pipeline.
+    auto QueueRequest = [&](UpdateRequest Request, int CheckCode, bool bReportUpToDate)
+    {
         bool bUpdateCmd = false;
+        bool bLocal = false;
 
         switch (CheckCode)
         {
-        case 0: printf_s("[+] PDB for %ls is up to date!\n", PEPath.filename().c_str()); break;
-        case 1: printf_s("[!] PDB for %ls need update!\n", PEPath.filename().c_str()); bUpdateCmd = true; break;
-        case 2: printf_s("[!] PDB for %ls not exist!\n", PEPath.filename().c_str()); bUpdateCmd = true; break;
-        default: printf_s("[!] Some error occured while check for update! Code: %d\n", CheckCode); break;
+        case 0: if (bReportUpToDate) printf_s("[+] PDB for %ls is up to date!\n", Request.PEPath.filename().wstring().c_str()); break;
+        case 1: printf_s("[!] PDB for %ls need update!\n", Request.PEPath.filename().wstring().c_str()); bUpdateCmd = true; break;
+        case 2: printf_s("[!] PDB for %ls not exist!\n", Request.PEPath.filename().wstring().c_str()); bUpdateCmd = true; break;
+        case 5: printf_s("[!] Symbols for %ls not up to date, resolving from the local PDB\n", Request.PEPath.filename().wstring().c_str()); bUpdateCmd = bLocal = true; break;
+        default:
+            // No debug directory or CodeView record: nothing to download, but the module may have signatures.
+            if (CheckCode >= 9 && Signatures.Find(Request.PEPath))
+            {
+                printf_s("[!] %ls has no PDB information, falling back to signatures\n", Request.PEPath.filename().wstring().c_str());
+
+                std::lock_guard<std::mutex> Guard(StateLock);
+
+                SignatureRequests.push_back(std::move(Request));
+
+                return;
+            }
+
+            printf_s("[!] Some error occured while check for update! Code: %d\n", CheckCode);
+            break;
         }
 
-        if (bUpdateCmd)
+        if (!bUpdateCmd)
+            return;
+
+        DownloadJob Job;
+
+        Job.Key = Request.PDBFileName + "/" + Request.FullHex;
+        Job.PdbName = Request.PDBFileName;
+        Job.Signature = Request.FullHex;
+        Job.SavePath = Request.PDBPath;
+
+        Job.bTypes = Request.Needed == PdbContents::SymbolsAndTypes;
+
+        bool bAlreadyDone;
+
         {
-            bNeedUpdate = true;
+            std::lock_guard<std::mutex> Guard(StateLock);
+
+            PendingPdb& State = Pending[Job.Key];
+
+            // The PDB is already in the store; unless a download of it is still in flight it goes straight to parsing.
+            if (bLocal && !State.bDone && State.Requests.empty())
+                State.bDone = State.bSuccess = true;
 
-            DownloaderCmd += L" \"" + PEPath.wstring() + L"\"";
-            ParserCmd += L" \"" + NewPDBName + L"\"" + L" \"" + PEPath.wstring() + L"\"" + L" \"" + argv[i + 1] + L"\"";
+            State.Requests.push_back(std::move(Request));
+            bAlreadyDone = State.bDone;
         }
-    }
 
-    if (!bNeedUpdate)
+        if (bAlreadyDone)
+            ParseQueue.Push(Job.Key);
+        else if (Pool.Submit(Job))
+            printf_s("[*] Downloading: %s\n", Job.Key.c_str());
+    };
+
+    for (int i = FirstArg; i < argc; i += 2)
     {
-        printf_s("\n------\n\n");
+        UpdateRequest Request;
 
-        return 0;
-    }
+        Request.PEPath = argv[i];
+        Request.Symbols = argv[i + 1];
 
-    STARTUPINFOW DownloaderSi = { sizeof(DownloaderSi) };
-    PROCESS_INFORMATION DownloaderPi = { 0 };
+        int CheckCode = HandleFile(Store, Cache, Output, Request.PEPath, Request, bSparse, true);
+
+        QueueRequest(std::move(Request), CheckCode, true);
+    }
 
-    if (!CreateProcessW(NULL, &DownloaderCmd[0], NULL, NULL, FALSE, 0, NULL, NULL, &DownloaderSi, &DownloaderPi))
+    if (!ScanRootPaths.empty())
     {
-        wprintf_s(L"[-] CreateProcess failed (Error: %d)\n", GetLastError());
+        uint64_t NumDirectories;
+        std::vector<ScanResult> Scanned = ScanRoots(Store, Cache, Output, bSparse, ScanRootPaths, Filters, Specs, NumDirectories);
+        size_t NumUpToDate = std::count_if(Scanned.begin(), Scanned.end(), [](const ScanResult& Result) { return Result.CheckCode == 0; });
+        size_t NumUnreadable = std::count_if(Scanned.begin(), Scanned.end(), [](const ScanResult& Result) { return Result.CheckCode >= 3 && Result.CheckCode != 5; });
 
-        return false;
-    }
+        printf_s("[*] Scanned %llu director%s: %zu file(s) checked, %zu up to date, %zu without PDB information\n", static_cast<unsigned long long>(NumDirectories),
+            NumDirectories == 1 ? "y" : "ies", Scanned.size(), NumUpToDate, NumUnreadable);
 
-    DWORD DownloadResult;
+        // Files without a usable debug directory are expected in a tree scan and only counted, unless signatures cover them.
+        for (ScanResult& Result : Scanned)
+        {
+            if (Result.CheckCode < 3 || Result.CheckCode == 5 || (Result.CheckCode >= 9 && Signatures.Find(Result.Request.PEPath)))
+                QueueRequest(std::move(Result.Request), Result.CheckCode, false);
+        }
+    }
 
-    WaitForSingleObject(DownloaderPi.hProcess, INFINITE);
-    GetExitCodeProcess(DownloaderPi.hProcess, &DownloadResult);
-    CloseHandle(DownloaderPi.hProcess);
-    CloseHandle(DownloaderPi.hThread);
+    Pool.Wait();
+    ParseQueue.Close();
+    Parser.join();
 
-    if (DownloadResult != 0 && !OldFiles.empty())
+    for (const UpdateRequest& Request : SignatureRequests)
     {
-        printf_s("[-] Update faild while downloading, old files will not be removed! :( Code: %d\n", DownloadResult);
+        std::map<std::wstring, std::wstring> Offsets;
+
+        printf_s("[*] Scanning %ls for signatures...\n", Request.PEPath.filename().wstring().c_str());
+
+        if (!ResolveSignatureOffsets(Signatures, Request.PEPath, SplitSymbols(Request.Symbols), Offsets))
+            bParseFailed = true;
 
-        return DownloadResult;
+        for (const auto& [Sym, Offset] : Offsets)
+            UpdatedSections[Request.PEPath.filename().wstring()][Sym] = Offset;
     }
 
-    for (const std::wstring& OldFile : OldFiles)
+    if (!UpdatedSections.empty() && !UpdateOffsets(OffsetsPath, Format, UpdatedSections))
+    {
+        bParseFailed = true;
+    }
+    else
     {
-        printf_s("[*] Removing: %ls", OldFile.c_str());
-        std::filesystem::remove(OldFile);
+        for (const UpdateRequest& Request : ResolvedRequests)
+        {
+            Cache.Add(Request.CacheKey, { Request.Identity, Request.PDBFileName, Request.FullHex, Request.SymbolsHash, Output.Path, Format,
+                UpdatedSections[Request.PEPath.filename().wstring()] });
+        }
     }
 
-    STARTUPINFOW ParserSi = { sizeof(ParserSi) };
-    PROCESS_INFORMATION ParserPi = { 0 };
+    if (!Store.Save())
+        printf_s("[!] Failed to write symbol store manifest!\n");
+
+    if (!Cache.Save())
+        printf_s("[!] Failed to write PE cache!\n");
+
+    if (!Misses.Save())
+        printf_s("[!] Failed to write symbol miss cache!\n");
 
-    if (!CreateProcessW(NULL, &ParserCmd[0], NULL, NULL, FALSE, 0, NULL, NULL, &ParserSi, &ParserPi))
+    if (Pending.empty() && SignatureRequests.empty())
     {
-        wprintf_s(L"[-] CreateProcess failed (Error: %d)\n", GetLastError());
+        FinishStats();
+        printf_s("\n------\n\n");
 
-        return false;
+        return 0;
     }
 
-    DWORD ParseResult;
+    int Result = 0;
 
-    WaitForSingleObject(ParserPi.hProcess, INFINITE);
-    GetExitCodeProcess(ParserPi.hProcess, &ParseResult);
-    CloseHandle(ParserPi.hProcess);
-    CloseHandle(ParserPi.hThread);
+    if (bDownloadFailed)
+    {
+        printf_s("[-] Update faild while downloading! :(\n");
 
-    if (ParseResult != 0)
+        Result = 11;
+    }
+    else if (bParseFailed)
     {
-        printf_s("[-] Update faild while parsing with! :( Code: %d\n", ParseResult);
+        printf_s("[-] Update faild while parsing! :(\n");
+
+        Result = 3;
     }
     else
     {
         printf_s("\n[+] Successfully updated!\n");
     }
 
+    FinishStats();
     printf("------\n\n");
 
-    return ParseResult;
-}
\ No newline at end of file
+    return Result;
+}
+
+#ifndef _WIN32
+int main(int argc, char* argv[])
+{
+    return RunWideMain(argc, argv, wmain);
+}
+#endif
@@ -0,0 +1,577 @@
+#include "CabFile.h"
+#include "CodeView.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+enum CabHeaderFlags : uint16_t
+{
+    CabPrevCabinet = 0x0001,
+    CabNextCabinet = 0x0002,
+    CabReservePresent = 0x0004,
+};
+
+enum CabCompression : uint16_t
+{
+    CabCompressNone = 0,
+    CabCompressMszip = 1,
+    CabCompressQuantum = 2,
+    CabCompressLzx = 3,
+};
+
+static constexpr uint32_t CabHeaderSize = 36;
+static constexpr uint32_t MszipFrameSize = 32768;
+static constexpr uint32_t DeflateWindowSize = 32768;
+
+class HuffmanTable
+{
+public:
+    static constexpr uint32_t MaxBits = 15;
+    static constexpr uint32_t FastBits = 10;
+
+    bool Build(const uint8_t* Lengths, uint32_t Count)
+    {
+        uint16_t Offsets[MaxBits + 2] = {};
+
+        memset(Counts, 0, sizeof(Counts));
+        memset(Fast, 0, sizeof(Fast));
+
+        for (uint32_t i = 0; i < Count; i++)
+            Counts[Lengths[i]]++;
+
+        Counts[0] = 0;
+
+        int Left = 1;
+
+        for (uint32_t Len = 1; Len <= MaxBits; Len++)
+        {
+            Left = (Left << 1) - Counts[Len];
+
+            if (Left < 0)
+                return false;
+        }
+
+        for (uint32_t Len = 1; Len <= MaxBits; Len++)
+            Offsets[Len + 1] = Offsets[Len] + Counts[Len];
+
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            if (Lengths[i])
+                Symbols[Offsets[Lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+
+        uint32_t Code = 0;
+        uint32_t Index = 0;
+
+        for (uint32_t Len = 1; Len <= FastBits; Len++)
+        {
+            for (uint32_t i = 0; i < Counts[Len]; i++, Index++, Code++)
+            {
+                uint32_t Reversed = 0;
+
+                for (uint32_t Bit = 0; Bit < Len; Bit++)
+                    Reversed |= ((Code >> Bit) & 1) << (Len - 1 - Bit);
+
+                for (uint32_t Fill = Reversed; Fill < (1u << FastBits); Fill += 1u << Len)
+                    Fast[Fill] = static_cast<uint16_t>((Symbols[Index] << 4) | Len);
+            }
+
+            Code <<= 1;
+        }
+
+        return true;
+    }
+
+    uint16_t Counts[MaxBits + 1];
+    uint16_t Symbols[288];
+    uint16_t Fast[1 << FastBits];
+};
+
+// Raw DEFLATE decoder with a history window that survives across MSZIP frames.
+class MszipDecoder
+{
+public:
+    bool DecodeFrame(const uint8_t* Data, uint32_t Size, std::vector<uint8_t>& Output)
+    {
+        if (Size < 2 || Data[0] != 'C' || Data[1] != 'K')
+            return false;
+
+        In = Data + 2;
+        InSize = Size - 2;
+        InPos = 0;
+        BitBuffer = 0;
+        BitCount = 0;
+
+        if (Window.size() > DeflateWindowSize)
+            Window.erase(Window.begin(), Window.end() - DeflateWindowSize);
+
+        FrameStart = Window.size();
+
+        bool bFinal = false;
+
+        while (!bFinal)
+        {
+            bFinal = GetBits(1) != 0;
+
+            uint32_t Type = GetBits(2);
+            bool bResult;
+
+            if (Type == 0)
+                bResult = Stored();
+            else if (Type == 1)
+                bResult = Fixed();
+            else if (Type == 2)
+                bResult = Dynamic();
+            else
+                bResult = false;
+
+            if (!bResult || bOverrun || Window.size() - FrameStart > MszipFrameSize)
+                return false;
+        }
+
+        Output.assign(Window.begin() + FrameStart, Window.end());
+
+        return true;
+    }
+
+private:
+    uint32_t GetBits(uint32_t Count)
+    {
+        while (BitCount < Count)
+        {
+            uint32_t Byte = 0;
+
+            if (InPos < InSize)
+                Byte = In[InPos++];
+            else
+                bOverrun = true;
+
+            BitBuffer |= Byte << BitCount;
+            BitCount += 8;
+        }
+
+        uint32_t Value = BitBuffer & ((1u << Count) - 1);
+
+        BitBuffer >>= Count;
+        BitCount -= Count;
+
+        return Value;
+    }
+
+    int Decode(const HuffmanTable& Table)
+    {
+        while (BitCount < HuffmanTable::FastBits && InPos < InSize)
+        {
+            BitBuffer |= static_cast<uint32_t>(In[InPos++]) << BitCount;
+            BitCount += 8;
+        }
+
+        uint16_t Entry = Table.Fast[BitBuffer & ((1u << HuffmanTable::FastBits) - 1)];
+
+        if (Entry && (Entry & 0xF) <= BitCount)
+        {
+            BitBuffer >>= Entry & 0xF;
+            BitCount -= Entry & 0xF;
+
+            return Entry >> 4;
+        }
+
+        int Code = 0;
+        int First = 0;
+        int Index = 0;
+
+        for (uint32_t Len = 1; Len <= HuffmanTable::MaxBits; Len++)
+        {
+            Code |= static_cast<int>(GetBits(1));
+
+            int Count = Table.Counts[Len];
+
+            if (Code - Count < First)
+                return Table.Symbols[Index + (Code - First)];
+
+            Index += Count;
+            First += Count;
+            First <<= 1;
+            Code <<= 1;
+        }
+
+        return -1;
+    }
+
+    bool Stored()
+    {
+        if (bOverrun)
+            return false;
+
+        InPos -= BitCount / 8;
+        BitBuffer = 0;
+        BitCount = 0;
+
+        if (InPos + 4 > InSize)
+            return false;
+
+        uint16_t Length = LoadValue<uint16_t>(In + InPos);
+        uint16_t NotLength = LoadValue<uint16_t>(In + InPos + 2);
+
+        InPos += 4;
+
+        if (Length != static_cast<uint16_t>(~NotLength) || InPos + Length > InSize)
+            return false;
+
+        Window.insert(Window.end(), In + InPos, In + InPos + Length);
+        InPos += Length;
+
+        return true;
+    }
+
+    bool Fixed()
+    {
+        uint8_t Lengths[288 + 30];
+
+        memset(Lengths, 8, 144);
+        memset(Lengths + 144, 9, 112);
+        memset(Lengths + 256, 7, 24);
+        memset(Lengths + 280, 8, 8);
+        memset(Lengths + 288, 5, 30);
+
+        return LiteralTable.Build(Lengths, 288) && DistanceTable.Build(Lengths + 288, 30) && Codes();
+    }
+
+    bool Dynamic()
+    {
+        static const uint8_t Order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        uint32_t LiteralCount = GetBits(5) + 257;
+        uint32_t DistanceCount = GetBits(5) + 1;
+        uint32_t CodeCount = GetBits(4) + 4;
+
+        if (LiteralCount > 286 || DistanceCount > 30)
+            return false;
+
+        uint8_t Lengths[288 + 32] = {};
+
+        for (uint32_t i = 0; i < CodeCount; i++)
+            Lengths[Order[i]] = static_cast<uint8_t>(GetBits(3));
+
+        HuffmanTable LengthTable;
+
+        if (!LengthTable.Build(Lengths, 19))
+            return false;
+
+        memset(Lengths, 0, 19);
+
+        for (uint32_t i = 0; i < LiteralCount + DistanceCount;)
+        {
+            int Symbol = Decode(LengthTable);
+
+            if (Symbol < 0 || bOverrun)
+                return false;
+
+            if (Symbol < 16)
+            {
+                Lengths[i++] = static_cast<uint8_t>(Symbol);
+
+                continue;
+            }
+
+            uint8_t Value = 0;
+            uint32_t Repeat;
+
+            if (Symbol == 16)
+            {
+                if (!i)
+                    return false;
+
+                Value = Lengths[i - 1];
+                Repeat = 3 + GetBits(2);
+            }
+            else if (Symbol == 17)
+            {
+                Repeat = 3 + GetBits(3);
+            }
+            else
+            {
+                Repeat = 11 + GetBits(7);
+            }
+
+            if (i + Repeat > LiteralCount + DistanceCount)
+                return false;
+
+            while (Repeat--)
+                Lengths[i++] = Value;
+        }
+
+        if (!Lengths[256])
+            return false;
+
+        return LiteralTable.Build(Lengths, LiteralCount) && DistanceTable.Build(Lengths + LiteralCount, DistanceCount) && Codes();
+    }
+
+    bool Codes()
+    {
+        static const uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+        static const uint8_t LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+        static const uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+        static const uint8_t DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+        for (;;)
+        {
+            int Symbol = Decode(LiteralTable);
+
+            if (Symbol < 0 || bOverrun)
+                return false;
+
+            if (Symbol < 256)
+            {
+                Window.push_back(static_cast<uint8_t>(Symbol));
+
+                continue;
+            }
+
+            if (Symbol == 256)
+                return true;
+
+            Symbol -= 257;
+
+            if (Symbol >= 29)
+                return false;
+
+            uint32_t Length = LengthBase[Symbol] + GetBits(LengthExtra[Symbol]);
+            int DistanceSymbol = Decode(DistanceTable);
+
+            if (DistanceSymbol < 0 || DistanceSymbol >= 30)
+                return false;
+
+            size_t Distance = DistanceBase[DistanceSymbol] + GetBits(DistanceExtra[DistanceSymbol]);
+
+            if (Distance > Window.size() || Window.size() - FrameStart + Length > MszipFrameSize)
+                return false;
+
+            size_t From = Window.size() - Distance;
+
+            for (uint32_t i = 0; i < Length; i++)
+                Window.push_back(Window[From + i]);
+        }
+    }
+
+    const uint8_t* In = nullptr;
+    uint32_t InSize = 0;
+    uint32_t InPos = 0;
+    uint32_t BitBuffer = 0;
+    uint32_t BitCount = 0;
+    bool bOverrun = false;
+
+    std::vector<uint8_t> Window;
+    size_t FrameStart = 0;
+    HuffmanTable LiteralTable;
+    HuffmanTable DistanceTable;
+};
+
+static uint32_t CabChecksum(const uint8_t* Data, uint32_t Size, uint32_t Seed)
+{
+    uint32_t Sum = Seed;
+    uint32_t Value = 0;
+
+    for (uint32_t i = 0; i < Size / 4; i++, Data += 4)
+        Sum ^= LoadValue<uint32_t>(Data);
+
+    switch (Size & 3)
+    {
+    case 3:
+        Value |= static_cast<uint32_t>(*Data++) << 16;
+        [[fallthrough]];
+    case 2:
+        Value |= static_cast<uint32_t>(*Data++) << 8;
+        [[fallthrough]];
+    case 1:
+        Value |= *Data;
+    }
+
+    return Sum ^ Value;
+}
+
+static bool SkipString(const uint8_t* Data, uint64_t Size, uint64_t& Offset)
+{
+    while (Offset < Size && Data[Offset])
+        Offset++;
+
+    return ++Offset <= Size;
+}
+
+bool ExtractCabinet(const std::filesystem::path& CabPath, const std::filesystem::path& OutPath, std::string& Error)
+{
+    MappedFile Cab;
+
+    if (!Cab.Open(CabPath))
+    {
+        Error = "Cannot open cabinet";
+
+        return false;
+    }
+
+    const uint8_t* Data = Cab.Data();
+    uint64_t Size = Cab.Size();
+
+    if (Size < CabHeaderSize || memcmp(Data, "MSCF", 4) != 0)
+    {
+        Error = "Not a cabinet file";
+
+        return false;
+    }
+
+    uint32_t FilesOffset = LoadValue<uint32_t>(Data + 16);
+    uint16_t FolderCount = LoadValue<uint16_t>(Data + 26);
+    uint16_t FileCount = LoadValue<uint16_t>(Data + 28);
+    uint16_t Flags = LoadValue<uint16_t>(Data + 30);
+
+    uint64_t Offset = CabHeaderSize;
+    uint32_t FolderReserve = 0;
+    uint32_t DataReserve = 0;
+
+    if (Flags & CabReservePresent)
+    {
+        if (Offset + 4 > Size)
+        {
+            Error = "Truncated cabinet header";
+
+            return false;
+        }
+
+        uint16_t HeaderReserve = LoadValue<uint16_t>(Data + Offset);
+
+        FolderReserve = Data[Offset + 2];
+        DataReserve = Data[Offset + 3];
+        Offset += 4 + HeaderReserve;
+    }
+
+    if ((Flags & (CabPrevCabinet | CabNextCabinet)) || FolderCount < 1 || FileCount < 1)
+    {
+        Error = "Multi-volume or empty cabinets are not supported";
+
+        return false;
+    }
+
+    if (Offset + 8 + FolderReserve > Size || FilesOffset + 16 > Size)
+    {
+        Error = "Truncated cabinet header";
+
+        return false;
+    }
+
+    uint32_t DataOffset = LoadValue<uint32_t>(Data + Offset);
+    uint16_t BlockCount = LoadValue<uint16_t>(Data + Offset + 4);
+    uint16_t Compression = LoadValue<uint16_t>(Data + Offset + 6) & 0x000F;
+
+    uint32_t FileSize = LoadValue<uint32_t>(Data + FilesOffset);
+    uint32_t FileStart = LoadValue<uint32_t>(Data + FilesOffset + 4);
+    uint16_t FileFolder = LoadValue<uint16_t>(Data + FilesOffset + 8);
+    uint64_t NameOffset = FilesOffset + 16;
+
+    if (FileFolder != 0 || !SkipString(Data, Size, NameOffset))
+    {
+        Error = "Unsupported cabinet file entry";
+
+        return false;
+    }
+
+    if (Compression != CabCompressNone && Compression != CabCompressMszip)
+    {
+        Error = Compression == CabCompressLzx ? "LZX compressed cabinets are not supported" : "Unsupported cabinet compression";
+
+        return false;
+    }
+
+    std::ofstream Out(OutPath, std::ios::binary | std::ios::trunc);
+
+    if (!Out.is_open())
+    {
+        Error = "Cannot create output file";
+
+        return false;
+    }
+
+    MszipDecoder Decoder;
+    std::vector<uint8_t> Frame;
+    uint64_t Position = 0;
+    uint64_t FileEnd = static_cast<uint64_t>(FileStart) + FileSize;
+
+    Offset = DataOffset;
+
+    for (uint32_t Block = 0; Block < BlockCount && Position < FileEnd; Block++)
+    {
+        if (Offset + 8 + DataReserve > Size)
+        {
+            Error = "Truncated cabinet data";
+
+            return false;
+        }
+
+        uint32_t Checksum = LoadValue<uint32_t>(Data + Offset);
+        uint16_t CompressedSize = LoadValue<uint16_t>(Data + Offset + 4);
+        uint16_t UncompressedSize = LoadValue<uint16_t>(Data + Offset + 6);
+        const uint8_t* Payload = Data + Offset + 8 + DataReserve;
+
+        const uint8_t* Sizes = Data + Offset + 4;
+
+        Offset += 8 + DataReserve + CompressedSize;
+
+        if (Offset > Size)
+        {
+            Error = "Truncated cabinet data";
+
+            return false;
+        }
+
+        if (Checksum && CabChecksum(Sizes, 4, CabChecksum(Payload, CompressedSize, 0)) != Checksum)
+        {
+            Error = "Checksum mismatch in cabinet block " + std::to_string(Block);
+
+            return false;
+        }
+
+        if (Compression == CabCompressNone)
+        {
+            Frame.assign(Payload, Payload + CompressedSize);
+        }
+        else if (!Decoder.DecodeFrame(Payload, CompressedSize, Frame))
+        {
+            Error = "Corrupt MSZIP block " + std::to_string(Block);
+
+            return false;
+        }
+
+        if (Frame.size() != UncompressedSize)
+        {
+            Error = "Cabinet block size mismatch";
+
+            return false;
+        }
+
+        uint64_t FrameEnd = Position + Frame.size();
+        uint64_t CopyStart = std::max<uint64_t>(Position, FileStart);
+        uint64_t CopyEnd = std::min<uint64_t>(FrameEnd, FileEnd);
+
+        if (CopyStart < CopyEnd)
+            Out.write(reinterpret_cast<const char*>(Frame.data() + (CopyStart - Position)), static_cast<std::streamsize>(CopyEnd - CopyStart));
+
+        Position = FrameEnd;
+    }
+
+    if (Position < FileEnd)
+    {
+        Error = "Cabinet ends before the stored file";
+
+        return false;
+    }
+
+    if (!Out.good())
+    {
+        Error = "Failed to write output file";
+
+        return false;
+    }
+
+    return true;
+}
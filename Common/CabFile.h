@@ -0,0 +1,7 @@
+#pragma once
+
+#include "Platform.h"
+
+// Extracts the single file stored in a symbol server cabinet (*.pd_, *.dl_, ...).
+// Stored and MSZIP folders are supported; LZX/Quantum cabinets are reported as unsupported.
+bool ExtractCabinet(const std::filesystem::path& CabPath, const std::filesystem::path& OutPath, std::string& Error);
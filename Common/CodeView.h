@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+struct PdbGuid
+{
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+};
+
+enum CodeViewSymbolKind : uint16_t
+{
+    S_CONSTANT = 0x1107,
+    S_UDT = 0x1108,
+    S_LDATA32 = 0x110C,
+    S_GDATA32 = 0x110D,
+    S_PUB32 = 0x110E,
+    S_LPROC32 = 0x110F,
+    S_GPROC32 = 0x1110,
+    S_LTHREAD32 = 0x1112,
+    S_GTHREAD32 = 0x1113,
+    S_PROCREF = 0x1125,
+    S_DATAREF = 0x1126,
+    S_LPROCREF = 0x1127,
+    S_LPROC32_ID = 0x1146,
+    S_GPROC32_ID = 0x1147,
+};
+
+enum CodeViewTypeKind : uint16_t
+{
+    LF_MODIFIER = 0x1001,
+    LF_POINTER = 0x1002,
+    LF_FIELDLIST = 0x1203,
+    LF_BITFIELD = 0x1205,
+    LF_METHODLIST = 0x1206,
+    LF_BCLASS = 0x1400,
+    LF_VBCLASS = 0x1401,
+    LF_IVBCLASS = 0x1402,
+    LF_INDEX = 0x1404,
+    LF_VFUNCTAB = 0x1409,
+    LF_FRIENDCLS = 0x140B,
+    LF_VFUNCOFF = 0x140C,
+    LF_ENUMERATE = 0x1502,
+    LF_ARRAY = 0x1503,
+    LF_CLASS = 0x1504,
+    LF_STRUCTURE = 0x1505,
+    LF_UNION = 0x1506,
+    LF_ENUM = 0x1507,
+    LF_FRIENDFCN = 0x150C,
+    LF_MEMBER = 0x150D,
+    LF_STMEMBER = 0x150E,
+    LF_METHOD = 0x150F,
+    LF_NESTTYPE = 0x1510,
+    LF_ONEMETHOD = 0x1511,
+    LF_NESTTYPEEX = 0x1512,
+    LF_INTERFACE = 0x1519,
+    LF_BINTERFACE = 0x151A,
+};
+
+// Numeric leaves: values below LF_NUMERIC are stored inline, anything else is one of these followed by the value.
+enum CodeViewNumericKind : uint16_t
+{
+    LF_NUMERIC = 0x8000,
+    LF_CHAR = 0x8000,
+    LF_SHORT = 0x8001,
+    LF_USHORT = 0x8002,
+    LF_LONG = 0x8003,
+    LF_ULONG = 0x8004,
+    LF_QUADWORD = 0x8009,
+    LF_UQUADWORD = 0x800A,
+};
+
+// Method property, bits 2-4 of a member's attributes.
+enum CodeViewMethodProperty : uint16_t
+{
+    CV_MTvanilla = 0,
+    CV_MTvirtual = 1,
+    CV_MTstatic = 2,
+    CV_MTfriend = 3,
+    CV_MTintro = 4,
+    CV_MTpurevirt = 5,
+    CV_MTpureintro = 6,
+};
+
+inline uint16_t GetMethodProperty(uint16_t Attributes)
+{
+    return (Attributes >> 2) & 7;
+}
+
+inline bool IsIntroducingMethod(uint16_t Attributes)
+{
+    return GetMethodProperty(Attributes) == CV_MTintro || GetMethodProperty(Attributes) == CV_MTpureintro;
+}
+
+// Property bits of class, structure, union and enum records.
+enum CodeViewClassProperty : uint16_t
+{
+    CV_PROP_FWDREF = 0x0080,
+    CV_PROP_SCOPED = 0x0100,
+    CV_PROP_HASUNIQUENAME = 0x0200,
+};
+
+// C13 subsections of a module stream: a kind and a length, then the data padded to 4 bytes.
+enum CodeViewSubsectionKind : uint32_t
+{
+    DEBUG_S_LINES = 0xF2,
+    DEBUG_S_FILECHKSMS = 0xF4,
+};
+
+// Flags of a DEBUG_S_LINES header; with columns each block has a column entry per line after the lines.
+inline constexpr uint16_t CV_LINES_HAVE_COLUMNS = 0x0001;
+
+// Line numbers the compiler uses for code that has no source line.
+inline constexpr uint32_t CV_LINE_HIDDEN_1 = 0xFEEFEE;
+inline constexpr uint32_t CV_LINE_HIDDEN_2 = 0xF00F00;
+
+template <typename T>
+inline T LoadValue(const uint8_t* Ptr)
+{
+    T Value;
+
+    memcpy(&Value, Ptr, sizeof(T));
+
+    return Value;
+}
@@ -0,0 +1,347 @@
+#include "DownloadPool.h"
+#include "CabFile.h"
+#include "SparsePdb.h"
+#include "Stats.h"
+
+#include <random>
+
+static bool IsTransientFailure(const HttpResponse& Response)
+{
+    return !Response.bPermanent && (Response.StatusCode == 0 || Response.StatusCode == 408 || Response.StatusCode == 429 || Response.StatusCode >= 500);
+}
+
+DownloadPool::DownloadPool(const DownloadOptions& Options, CompletionHandler OnComplete) :
+    Options(Options), OnComplete(std::move(OnComplete))
+{
+    if (!this->Options.Workers)
+        this->Options.Workers = 1;
+
+    if (!this->Options.MaxAttempts)
+        this->Options.MaxAttempts = 1;
+
+    if (this->Options.Tiers.empty())
+        this->Options.Tiers.push_back({ {}, DefaultSymbolServer });
+}
+
+DownloadPool::~DownloadPool()
+{
+    Wait();
+}
+
+bool DownloadPool::Submit(DownloadJob Job)
+{
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+
+        if (bClosed)
+            return false;
+
+        auto [It, bInserted] = Submitted.try_emplace(Job.Key, Job.bTypes);
+
+        if (!bInserted)
+        {
+            It->second |= Job.bTypes;
+
+            return false;
+        }
+
+        Pending.push_back(std::move(Job));
+
+        if (Workers.size() < Options.Workers && Workers.size() < Submitted.size())
+            Workers.emplace_back(&DownloadPool::WorkerMain, this);
+    }
+
+    Available.notify_one();
+
+    return true;
+}
+
+void DownloadPool::Wait()
+{
+    {
+        std::lock_guard<std::mutex> Guard(Lock);
+
+        bClosed = true;
+    }
+
+    Available.notify_all();
+
+    for (std::thread& Worker : Workers)
+    {
+        if (Worker.joinable())
+            Worker.join();
+    }
+}
+
+void DownloadPool::WorkerMain()
+{
+    HttpClient Client(Options.TimeoutMs);
+
+    for (;;)
+    {
+        DownloadJob Job;
+
+        {
+            std::unique_lock<std::mutex> Guard(Lock);
+
+            Available.wait(Guard, [this]() { return bClosed || !Pending.empty(); });
+
+            if (Pending.empty())
+                return;
+
+            Job = std::move(Pending.front());
+            Job.bTypes = Submitted[Job.Key];
+            Pending.pop_front();
+        }
+
+        DownloadResult Result;
+
+        for (;;)
+        {
+            Result = Execute(Client, Job);
+
+            std::lock_guard<std::mutex> Guard(Lock);
+
+            // A job that needs the types was merged into this one while a sparse download without them ran.
+            if (!Result.bSparse || Job.bTypes == Submitted[Job.Key])
+                break;
+
+            Job.bTypes = true;
+        }
+
+        if (OnComplete)
+            OnComplete(Job, Result);
+    }
+}
+
+DownloadResult DownloadPool::Execute(HttpClient& Client, const DownloadJob& Job)
+{
+    ScopedTimer Timer("Download");
+    DownloadResult Result;
+    std::error_code Error;
+
+    std::filesystem::create_directories(Job.SavePath.parent_path(), Error);
+
+    for (size_t i = 0; i < Options.Tiers.size(); i++)
+    {
+        const SymbolTier& Tier = Options.Tiers[i];
+
+        Result.Source = Tier.Describe();
+
+        if (!Tier.IsServer())
+        {
+            if (!CopyFromDirectory(Tier, Job, Result))
+                continue;
+
+            AddStat(StatCounter::SymbolTierHits);
+        }
+        else if (Options.Misses && Options.Misses->IsMissing(Tier.Server, Job.Key))
+        {
+            AddStat(StatCounter::SymbolMissesSkipped);
+            Result.Response = {};
+            Result.Response.StatusCode = 404;
+            Result.Response.Error = "Not found (cached miss)";
+
+            continue;
+        }
+        else if (!Download(Client, Job, BuildSymbolUrl(Tier.Server, Job.PdbName, Job.Signature), Result))
+        {
+            if (Result.Response.StatusCode == 404 && Options.Misses)
+                Options.Misses->AddMiss(Tier.Server, Job.Key);
+
+            continue;
+        }
+
+        WriteBack(Job, i, Result);
+
+        return Result;
+    }
+
+    return Result;
+}
+
+bool DownloadPool::CopyFromDirectory(const SymbolTier& Tier, const DownloadJob& Job, DownloadResult& Result)
+{
+    std::filesystem::path Source = Tier.Directory / Utf8ToWide(Job.PdbName) / Utf8ToWide(Job.Signature) / Utf8ToWide(Job.PdbName);
+    std::filesystem::path TempPath = Job.SavePath;
+    std::error_code Error;
+
+    if (!std::filesystem::is_regular_file(Source, Error))
+        return false;
+
+    ScopedTimer Timer("Tier copy");
+
+    TempPath += ".part";
+
+    if (!std::filesystem::copy_file(Source, TempPath, std::filesystem::copy_options::overwrite_existing, Error))
+    {
+        Result.Response.Error = "Cannot copy " + WideToUtf8(Source.wstring()) + ": " + Error.message();
+        std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    std::filesystem::rename(TempPath, Job.SavePath, Error);
+
+    if (Error)
+    {
+        Result.Response.Error = "Cannot move copy into place: " + Error.message();
+        std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    Result.bSuccess = true;
+    Result.Attempts = 0;
+    Result.bCompressed = false;
+    Result.bSparse = false;
+    Result.Response = {};
+    Result.Response.Bytes = std::filesystem::file_size(Job.SavePath, Error);
+
+    return true;
+}
+
+void DownloadPool::WriteBack(const DownloadJob& Job, size_t HitTier, DownloadResult& Result)
+{
+    // A sparse PDB only holds the streams this tool needs and must not end up in a cache other tools read.
+    if (Result.bSparse)
+        return;
+
+    for (size_t i = 0; i < HitTier; i++)
+    {
+        const SymbolTier& Tier = Options.Tiers[i];
+
+        if (Tier.IsServer())
+            continue;
+
+        std::filesystem::path Target = Tier.Directory / Utf8ToWide(Job.PdbName) / Utf8ToWide(Job.Signature) / Utf8ToWide(Job.PdbName);
+        std::filesystem::path TempPath = Target;
+        std::error_code Error;
+
+        TempPath += ".part";
+        std::filesystem::create_directories(Target.parent_path(), Error);
+
+        // Copy under a temporary name so other readers of a shared directory never see a partial PDB.
+        if (!std::filesystem::copy_file(Job.SavePath, TempPath, std::filesystem::copy_options::overwrite_existing, Error))
+        {
+            std::filesystem::remove(TempPath, Error);
+
+            continue;
+        }
+
+        std::filesystem::rename(TempPath, Target, Error);
+
+        if (Error)
+            std::filesystem::remove(TempPath, Error);
+        else
+            Result.WrittenBack++;
+    }
+}
+
+bool DownloadPool::Download(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result)
+{
+    std::minstd_rand Random(static_cast<uint32_t>(std::hash<std::string>()(Job.Key)));
+
+    for (Result.Attempts = 1;; Result.Attempts++)
+    {
+        Result.bSuccess = Fetch(Client, Job, Url, Result);
+
+        if (Result.bSuccess || Result.Attempts >= Options.MaxAttempts || !IsTransientFailure(Result.Response))
+            return Result.bSuccess;
+
+        uint32_t Delay = Options.BackoffMs << std::min<uint32_t>(Result.Attempts - 1, 6);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(Delay / 2 + Random() % (Delay / 2 + 1)));
+    }
+}
+
+bool DownloadPool::Fetch(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result)
+{
+    Result.bCompressed = false;
+    Result.bSparse = false;
+
+    if (Options.bSparse && FetchSparse(Client, Job, Url, Result))
+        return true;
+
+    if (Options.bSparse && (IsTransientFailure(Result.Response) || Result.Response.bPermanent))
+        return false;
+
+    if (Options.bPreferCompressed && FetchCompressed(Client, Job, Url, Result))
+        return true;
+
+    if (Options.bPreferCompressed && (IsTransientFailure(Result.Response) || Result.Response.bPermanent))
+        return false;
+
+    if (Client.Download(Url, Job.SavePath, Result.Response))
+        return true;
+
+    if (!Options.bPreferCompressed && Result.Response.StatusCode == 404)
+    {
+        HttpResponse Plain = Result.Response;
+
+        if (FetchCompressed(Client, Job, Url, Result))
+            return true;
+
+        if (Result.Response.StatusCode == 404)
+            Result.Response = Plain;
+    }
+
+    return false;
+}
+
+bool DownloadPool::FetchCompressed(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result)
+{
+    if (Url.empty())
+        return false;
+
+    std::string CabUrl = Url;
+    std::filesystem::path CabPath = Job.SavePath;
+    std::filesystem::path TempPath = Job.SavePath;
+    std::error_code Error;
+
+    CabUrl.back() = '_';
+    CabPath += ".cab";
+    TempPath += ".cab.tmp"; // Not ".part": that is the resume file of a plain download of the same PDB.
+
+    if (!Client.Download(CabUrl, CabPath, Result.Response))
+        return false;
+
+    bool bExtracted;
+
+    {
+        ScopedTimer Timer("CAB extract");
+
+        bExtracted = ExtractCabinet(CabPath, TempPath, Result.Response.Error);
+    }
+
+    std::filesystem::remove(CabPath, Error);
+
+    if (bExtracted)
+        std::filesystem::rename(TempPath, Job.SavePath, Error);
+
+    if (!bExtracted || Error)
+    {
+        if (bExtracted)
+            Result.Response.Error = "Cannot move download into place: " + Error.message();
+
+        std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    Result.bCompressed = true;
+
+    return true;
+}
+
+bool DownloadPool::FetchSparse(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result)
+{
+    ScopedTimer Timer("Sparse fetch");
+    SparseFetchStats Stats;
+
+    Result.bSparse = FetchSparsePdb(Client.GetTransport(), Url, Job.SavePath, Job.bTypes, Stats, Result.Response);
+    Result.RemoteSize = Stats.RemoteSize;
+    Result.Response.Bytes = Stats.BytesFetched;
+
+    return Result.bSparse;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "HttpClient.h"
+#include "SymbolPath.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+inline constexpr char DefaultSymbolServer[] = "http://msdl.microsoft.com/download/symbols/";
+
+inline std::string BuildSymbolUrl(const std::string& Server, const std::string& PdbName, const std::string& FullHex)
+{
+    return Server + PdbName + "/" + FullHex + "/" + PdbName;
+}
+
+struct DownloadOptions
+{
+    uint32_t Workers = 8;
+    uint32_t TimeoutMs = 60000;
+    uint32_t MaxAttempts = 3;
+    uint32_t BackoffMs = 500;
+    bool bPreferCompressed = false;
+    bool bSparse = false;
+    // Sources behind the local store, nearest first; empty means the default symbol server only.
+    std::vector<SymbolTier> Tiers;
+    // Optional; servers are not asked for PDBs they recently answered 404 for.
+    SymbolMissCache* Misses = nullptr;
+};
+
+struct DownloadJob
+{
+    std::string Key;
+    std::string PdbName;
+    std::string Signature;
+    std::filesystem::path SavePath;
+    // Sparse downloads keep the type information (needed for "Type::Member" queries).
+    bool bTypes = false;
+};
+
+struct DownloadResult
+{
+    bool bSuccess = false;
+    // HTTP attempts against the last server tried; 0 when the PDB was copied from a directory tier.
+    uint32_t Attempts = 0;
+    bool bCompressed = false;
+    bool bSparse = false;
+    uint64_t RemoteSize = 0;
+    // Tier the PDB came from, or the last one tried on failure.
+    std::string Source;
+    // Number of nearer directory tiers the PDB was copied back into.
+    uint32_t WrittenBack = 0;
+    HttpResponse Response;
+};
+
+// Bounded pool of download workers. Jobs are deduplicated by Key (PDB name + GUID + age), keeping the types
+// if any of the merged jobs asks for them, and tried against the tiers in order: directory tiers are copied from, servers are downloaded from, and a hit is copied back
+// into every directory tier before it. Transient failures (network errors, 5xx, 429) are retried with
+// exponential backoff, a 404 moves on to the next tier and is remembered in the miss cache.
+// Every worker keeps its own connections alive; the CAB compressed variant (*.pd_) is fetched
+// when the plain file is missing or bPreferCompressed is set. With bSparse only the streams needed
+// for symbol lookups are fetched (see SparsePdb.h), falling back to a full download if the server
+// does not support range requests.
+class DownloadPool
+{
+public:
+    using CompletionHandler = std::function<void(const DownloadJob&, const DownloadResult&)>;
+
+    DownloadPool(const DownloadOptions& Options, CompletionHandler OnComplete);
+    DownloadPool(const DownloadPool&) = delete;
+    DownloadPool& operator=(const DownloadPool&) = delete;
+    ~DownloadPool();
+
+    bool Submit(DownloadJob Job);
+    void Wait();
+
+private:
+    void WorkerMain();
+    DownloadResult Execute(HttpClient& Client, const DownloadJob& Job);
+    bool CopyFromDirectory(const SymbolTier& Tier, const DownloadJob& Job, DownloadResult& Result);
+    void WriteBack(const DownloadJob& Job, size_t HitTier, DownloadResult& Result);
+    bool Download(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result);
+    bool Fetch(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result);
+    bool FetchCompressed(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result);
+    bool FetchSparse(HttpClient& Client, const DownloadJob& Job, const std::string& Url, DownloadResult& Result);
+
+    DownloadOptions Options;
+    CompletionHandler OnComplete;
+
+    std::mutex Lock;
+    std::condition_variable Available;
+    std::deque<DownloadJob> Pending;
+    // Key -> whether any job submitted for it keeps the type information.
+    std::unordered_map<std::string, bool> Submitted;
+    std::vector<std::thread> Workers;
+    bool bClosed = false;
+};
@@ -0,0 +1,810 @@
+#include "HttpClient.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <winhttp.h>
+
+#pragma comment(lib, "winhttp.lib")
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <unistd.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#endif
+
+static const char UserAgent[] = "Microsoft-Symbol-Server/10.0.0.0";
+
+bool ParseHttpUrl(const std::string& Url, HttpUrl& Result)
+{
+    size_t SchemeEnd = Url.find("://");
+
+    if (SchemeEnd == std::string::npos)
+        return false;
+
+    std::string Scheme = Url.substr(0, SchemeEnd);
+
+    if (Scheme == "http")
+        Result.bSecure = false;
+    else if (Scheme == "https")
+        Result.bSecure = true;
+    else
+        return false;
+
+    size_t HostStart = SchemeEnd + 3;
+    size_t PathStart = Url.find('/', HostStart);
+    std::string Authority = Url.substr(HostStart, PathStart == std::string::npos ? std::string::npos : PathStart - HostStart);
+
+    Result.Path = PathStart == std::string::npos ? "/" : Url.substr(PathStart);
+    Result.Port = Result.bSecure ? 443 : 80;
+
+    size_t PortPos = Authority.rfind(':');
+
+    if (PortPos != std::string::npos && Authority.find(']', PortPos) == std::string::npos)
+    {
+        int Port = atoi(Authority.c_str() + PortPos + 1);
+
+        if (Port <= 0 || Port > 65535)
+            return false;
+
+        Result.Port = static_cast<uint16_t>(Port);
+        Authority.resize(PortPos);
+    }
+
+    if (Authority.size() > 2 && Authority.front() == '[' && Authority.back() == ']')
+        Authority = Authority.substr(1, Authority.size() - 2);
+
+    Result.Host = Authority;
+
+    return !Result.Host.empty();
+}
+
+static std::string FormatRange(uint64_t RangeStart, uint64_t RangeSize)
+{
+    std::string Range = "bytes=" + std::to_string(RangeStart) + "-";
+
+    if (RangeSize)
+        Range += std::to_string(RangeStart + RangeSize - 1);
+
+    return Range;
+}
+
+static bool IsContentRangeAt(const std::string& ContentRange, uint64_t RangeStart)
+{
+    size_t Pos = ContentRange.find("bytes ");
+
+    return Pos != std::string::npos && strtoull(ContentRange.c_str() + Pos + 6, nullptr, 10) == RangeStart;
+}
+
+HttpClient::HttpClient(uint32_t TimeoutMs) : Transport(CreateHttpTransport(TimeoutMs))
+{
+}
+
+HttpClient::HttpClient(std::unique_ptr<HttpTransport> Transport) : Transport(std::move(Transport))
+{
+}
+
+bool HttpClient::Download(const std::string& Url, const std::filesystem::path& Path, HttpResponse& Response)
+{
+    std::filesystem::path TempPath = Path;
+    std::error_code Error;
+
+    TempPath += ".part";
+
+    for (int Attempt = 0; Attempt < 2; Attempt++)
+    {
+        uint64_t Existing = std::filesystem::exists(TempPath, Error) ? std::filesystem::file_size(TempPath, Error) : 0;
+
+        if (Error)
+            Existing = 0;
+
+        std::ofstream Out;
+
+        auto OpenOutput = [&]() -> bool
+        {
+            Response.ResumedFrom = Response.StatusCode == 206 ? Existing : 0;
+            Out.open(TempPath, std::ios::binary | (Response.StatusCode == 206 ? std::ios::app : std::ios::trunc));
+
+            if (!Out.is_open())
+                Response.Error = "Cannot create output file";
+
+            return Out.is_open();
+        };
+
+        auto OnBody = [&](const char* Data, size_t Size) -> bool
+        {
+            if (!Out.is_open() && !OpenOutput())
+                return false;
+
+            Out.write(Data, static_cast<std::streamsize>(Size));
+
+            if (!Out.good())
+                Response.Error = "Failed to write output file";
+
+            return Out.good();
+        };
+
+        bool bResult = Transport->Get(Url, Existing, 0, OnBody, Response);
+
+        AddStat(StatCounter::HttpRequests);
+        AddStat(StatCounter::BytesDownloaded, Response.Bytes);
+
+        if (bResult && !Out.is_open())
+            bResult = OpenOutput();
+
+        if (Out.is_open())
+        {
+            Out.close();
+
+            if (bResult && Out.fail())
+            {
+                Response.Error = "Failed to write output file";
+                bResult = false;
+            }
+        }
+
+        if (bResult)
+        {
+            std::filesystem::rename(TempPath, Path, Error);
+
+            if (Error)
+            {
+                Response.Error = "Cannot move download into place: " + Error.message();
+
+                return false;
+            }
+
+            return true;
+        }
+
+        // 416 means the partial file no longer matches the remote one; start over once.
+        if (Response.StatusCode == 416 && Existing)
+        {
+            std::filesystem::remove(TempPath, Error);
+
+            continue;
+        }
+
+        if (Response.StatusCode >= 400 && Response.StatusCode < 500)
+            std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    return false;
+}
+
+#ifdef _WIN32
+
+// WinHTTP keeps idle connections of a session alive on its own; connect handles are cached per host.
+class WinHttpTransport : public HttpTransport
+{
+public:
+    explicit WinHttpTransport(uint32_t TimeoutMs)
+    {
+        hSession = WinHttpOpen(Utf8ToWide(UserAgent).c_str(), WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+
+        if (hSession)
+            WinHttpSetTimeouts(hSession, TimeoutMs, TimeoutMs, TimeoutMs, TimeoutMs);
+    }
+
+    ~WinHttpTransport() override
+    {
+        for (auto& [Key, hConnect] : Connections)
+            WinHttpCloseHandle(hConnect);
+
+        if (hSession)
+            WinHttpCloseHandle(hSession);
+    }
+
+    bool Get(const std::string& Url, uint64_t RangeStart, uint64_t RangeSize, const HttpBodyHandler& OnBody, HttpResponse& Response) override;
+
+private:
+    HINTERNET hSession = nullptr;
+    std::map<std::string, HINTERNET> Connections;
+};
+
+static std::string FormatWinHttpError(const char* Operation)
+{
+    return std::string(Operation) + " failed (Error: " + std::to_string(GetLastError()) + ")";
+}
+
+bool WinHttpTransport::Get(const std::string& Url, uint64_t RangeStart, uint64_t RangeSize, const HttpBodyHandler& OnBody, HttpResponse& Response)
+{
+    Response = {};
+
+    HttpUrl Parsed;
+
+    if (!ParseHttpUrl(Url, Parsed))
+    {
+        Response.Error = "Invalid URL";
+        Response.bPermanent = true;
+
+        return false;
+    }
+
+    if (!hSession)
+    {
+        Response.Error = "WinHttpOpen failed";
+
+        return false;
+    }
+
+    std::string Key = Parsed.Host + ":" + std::to_string(Parsed.Port);
+    HINTERNET& hConnect = Connections[Key];
+
+    if (!hConnect)
+        hConnect = WinHttpConnect(hSession, Utf8ToWide(Parsed.Host).c_str(), Parsed.Port, 0);
+    else
+        Response.bReusedConnection = true;
+
+    if (!hConnect)
+    {
+        Response.Error = FormatWinHttpError("WinHttpConnect");
+        Connections.erase(Key);
+
+        return false;
+    }
+
+    HINTERNET hRequest = WinHttpOpenRequest(hConnect, L"GET", Utf8ToWide(Parsed.Path).c_str(), nullptr, WINHTTP_NO_REFERER,
+        WINHTTP_DEFAULT_ACCEPT_TYPES, Parsed.bSecure ? WINHTTP_FLAG_SECURE : 0);
+
+    std::wstring Headers = RangeStart || RangeSize ? L"Range: " + Utf8ToWide(FormatRange(RangeStart, RangeSize)) : L"";
+    bool bResult = false;
+
+    if (!hRequest)
+    {
+        Response.Error = FormatWinHttpError("WinHttpOpenRequest");
+    }
+    else if (!WinHttpSendRequest(hRequest, Headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : Headers.c_str(), static_cast<DWORD>(Headers.size()),
+        WINHTTP_NO_REQUEST_DATA, 0, 0, 0) || !WinHttpReceiveResponse(hRequest, nullptr))
+    {
+        Response.Error = FormatWinHttpError("HTTP request");
+    }
+    else
+    {
+        DWORD StatusCode = 0;
+        DWORD Size = sizeof(StatusCode);
+
+        WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER, WINHTTP_HEADER_NAME_BY_INDEX,
+            &StatusCode, &Size, WINHTTP_NO_HEADER_INDEX);
+
+        Response.StatusCode = static_cast<int>(StatusCode);
+        Response.FinalUrl = Url;
+
+        DWORD UrlSize = 0;
+
+        if (!WinHttpQueryOption(hRequest, WINHTTP_OPTION_URL, nullptr, &UrlSize) && GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+        {
+            std::wstring FinalUrl(UrlSize / sizeof(wchar_t), L'\0');
+
+            if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_URL, FinalUrl.data(), &UrlSize))
+                Response.FinalUrl = WideToUtf8(FinalUrl.c_str());
+        }
+
+        wchar_t ContentRange[128] = {};
+        DWORD ContentRangeSize = sizeof(ContentRange);
+
+        if (StatusCode == 206 && (!WinHttpQueryHeaders(hRequest, WINHTTP_QUERY_CONTENT_RANGE, WINHTTP_HEADER_NAME_BY_INDEX,
+            ContentRange, &ContentRangeSize, WINHTTP_NO_HEADER_INDEX) || !IsContentRangeAt(WideToUtf8(ContentRange), RangeStart)))
+        {
+            Response.StatusCode = 416;
+            Response.Error = "Unexpected Content-Range";
+        }
+        else if (StatusCode != 200 && StatusCode != 206)
+        {
+            Response.Error = "HTTP status " + std::to_string(StatusCode);
+        }
+        else
+        {
+            std::vector<char> Buffer(64 * 1024);
+            DWORD Read = 0;
+
+            bResult = true;
+
+            while (bResult)
+            {
+                if (!WinHttpReadData(hRequest, Buffer.data(), static_cast<DWORD>(Buffer.size()), &Read))
+                {
+                    Response.StatusCode = 0;
+                    Response.Error = FormatWinHttpError("WinHttpReadData");
+                    bResult = false;
+
+                    break;
+                }
+
+                if (!Read)
+                    break;
+
+                if (!OnBody(Buffer.data(), Read))
+                {
+                    bResult = false;
+
+                    break;
+                }
+
+                Response.Bytes += Read;
+            }
+        }
+    }
+
+    if (hRequest)
+        WinHttpCloseHandle(hRequest);
+
+    return bResult;
+}
+
+#else
+
+class SocketReader
+{
+public:
+    explicit SocketReader(int Fd) : Fd(Fd) {}
+
+    bool ReadLine(std::string& Line)
+    {
+        Line.clear();
+
+        for (;;)
+        {
+            if (Pos == Length && !Fill())
+                return false;
+
+            char Char = Buffer[Pos++];
+
+            if (Char == '\n')
+            {
+                if (!Line.empty() && Line.back() == '\r')
+                    Line.pop_back();
+
+                return true;
+            }
+
+            if (Line.size() > 16 * 1024)
+                return false;
+
+            Line += Char;
+        }
+    }
+
+    ssize_t Read(char* Out, size_t Size)
+    {
+        if (Pos == Length && !Fill())
+            return bEof ? 0 : -1;
+
+        size_t Chunk = std::min(Size, Length - Pos);
+
+        memcpy(Out, Buffer + Pos, Chunk);
+        Pos += Chunk;
+
+        return static_cast<ssize_t>(Chunk);
+    }
+
+    bool IsEof() const { return bEof; }
+
+private:
+    bool Fill()
+    {
+        ssize_t Received;
+
+        do
+        {
+            Received = recv(Fd, Buffer, sizeof(Buffer), 0);
+        } while (Received < 0 && errno == EINTR);
+
+        if (Received <= 0)
+        {
+            bEof = Received == 0;
+
+            return false;
+        }
+
+        Pos = 0;
+        Length = static_cast<size_t>(Received);
+
+        return true;
+    }
+
+    int Fd;
+    char Buffer[64 * 1024];
+    size_t Pos = 0;
+    size_t Length = 0;
+    bool bEof = false;
+};
+
+static int ConnectWithTimeout(const HttpUrl& Url, uint32_t TimeoutMs, std::string& Error)
+{
+    addrinfo Hints = {};
+    addrinfo* Addresses = nullptr;
+
+    Hints.ai_family = AF_UNSPEC;
+    Hints.ai_socktype = SOCK_STREAM;
+
+    int Status = getaddrinfo(Url.Host.c_str(), std::to_string(Url.Port).c_str(), &Hints, &Addresses);
+
+    if (Status != 0)
+    {
+        Error = std::string("Cannot resolve host: ") + gai_strerror(Status);
+
+        return -1;
+    }
+
+    int Fd = -1;
+
+    for (addrinfo* Address = Addresses; Address && Fd < 0; Address = Address->ai_next)
+    {
+        Fd = socket(Address->ai_family, Address->ai_socktype | SOCK_CLOEXEC, Address->ai_protocol);
+
+        if (Fd < 0)
+            continue;
+
+        int Flags = fcntl(Fd, F_GETFL, 0);
+
+        fcntl(Fd, F_SETFL, Flags | O_NONBLOCK);
+
+        bool bConnected = connect(Fd, Address->ai_addr, Address->ai_addrlen) == 0;
+
+        if (!bConnected && errno == EINPROGRESS)
+        {
+            pollfd Poll = { Fd, POLLOUT, 0 };
+            int SocketError = 0;
+            socklen_t Size = sizeof(SocketError);
+
+            bConnected = poll(&Poll, 1, static_cast<int>(TimeoutMs)) == 1 &&
+                getsockopt(Fd, SOL_SOCKET, SO_ERROR, &SocketError, &Size) == 0 && SocketError == 0;
+        }
+
+        if (!bConnected)
+        {
+            close(Fd);
+            Fd = -1;
+
+            continue;
+        }
+
+        fcntl(Fd, F_SETFL, Flags);
+
+        int NoDelay = 1;
+        timeval Timeout = { static_cast<time_t>(TimeoutMs / 1000), static_cast<suseconds_t>((TimeoutMs % 1000) * 1000) };
+
+        setsockopt(Fd, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+        setsockopt(Fd, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+        setsockopt(Fd, SOL_SOCKET, SO_SNDTIMEO, &Timeout, sizeof(Timeout));
+    }
+
+    freeaddrinfo(Addresses);
+
+    if (Fd < 0)
+        Error = "Cannot connect to " + Url.Host + ":" + std::to_string(Url.Port);
+
+    return Fd;
+}
+
+static bool SendAll(int Fd, const std::string& Data)
+{
+#ifdef MSG_NOSIGNAL
+    const int Flags = MSG_NOSIGNAL;
+#else
+    const int Flags = 0;
+#endif
+
+    for (size_t Sent = 0; Sent < Data.size();)
+    {
+        ssize_t Result = send(Fd, Data.data() + Sent, Data.size() - Sent, Flags);
+
+        if (Result < 0 && errno == EINTR)
+            continue;
+
+        if (Result <= 0)
+            return false;
+
+        Sent += static_cast<size_t>(Result);
+    }
+
+    return true;
+}
+
+static bool ReadBody(SocketReader& Reader, bool bChunked, int64_t ContentLength, const HttpBodyHandler& OnBody)
+{
+    std::vector<char> Buffer(64 * 1024);
+
+    auto Copy = [&](uint64_t Size) -> bool
+    {
+        while (Size)
+        {
+            ssize_t Read = Reader.Read(Buffer.data(), static_cast<size_t>(std::min<uint64_t>(Size, Buffer.size())));
+
+            if (Read <= 0 || !OnBody(Buffer.data(), static_cast<size_t>(Read)))
+                return false;
+
+            Size -= static_cast<uint64_t>(Read);
+        }
+
+        return true;
+    };
+
+    if (bChunked)
+    {
+        std::string Line;
+
+        for (;;)
+        {
+            if (!Reader.ReadLine(Line))
+                return false;
+
+            uint64_t ChunkSize = strtoull(Line.c_str(), nullptr, 16);
+
+            if (!ChunkSize)
+                break;
+
+            if (!Copy(ChunkSize) || !Reader.ReadLine(Line))
+                return false;
+        }
+
+        while (Reader.ReadLine(Line))
+        {
+            if (Line.empty())
+                return true;
+        }
+
+        return false;
+    }
+
+    if (ContentLength >= 0)
+        return Copy(static_cast<uint64_t>(ContentLength));
+
+    for (;;)
+    {
+        ssize_t Read = Reader.Read(Buffer.data(), Buffer.size());
+
+        if (Read < 0)
+            return false;
+
+        if (Read == 0)
+            return true;
+
+        if (!OnBody(Buffer.data(), static_cast<size_t>(Read)))
+            return false;
+    }
+}
+
+struct SocketConnection
+{
+    int Fd = -1;
+    std::unique_ptr<SocketReader> Reader;
+};
+
+// Plain HTTP/1.1 over sockets with one idle keep-alive connection per host:port.
+class SocketHttpTransport : public HttpTransport
+{
+public:
+    explicit SocketHttpTransport(uint32_t TimeoutMs) : TimeoutMs(TimeoutMs) {}
+
+    ~SocketHttpTransport() override
+    {
+        for (auto& [Key, Connection] : Connections)
+            close(Connection.Fd);
+    }
+
+    bool Get(const std::string& Url, uint64_t RangeStart, uint64_t RangeSize, const HttpBodyHandler& OnBody, HttpResponse& Response) override;
+
+private:
+    void Drop(const std::string& Key)
+    {
+        auto It = Connections.find(Key);
+
+        if (It != Connections.end())
+        {
+            close(It->second.Fd);
+            Connections.erase(It);
+        }
+    }
+
+    uint32_t TimeoutMs;
+    std::map<std::string, SocketConnection> Connections;
+};
+
+bool SocketHttpTransport::Get(const std::string& Url, uint64_t RangeStart, uint64_t RangeSize, const HttpBodyHandler& OnBody, HttpResponse& Response)
+{
+    std::string CurrentUrl = Url;
+
+    for (int Redirects = 0; Redirects <= 5; Redirects++)
+    {
+        Response = {};
+
+        HttpUrl Parsed;
+
+        if (!ParseHttpUrl(CurrentUrl, Parsed))
+        {
+            Response.Error = "Invalid URL";
+            Response.bPermanent = true;
+
+            return false;
+        }
+
+        if (Parsed.bSecure)
+        {
+            Response.Error = "HTTPS is not supported on this platform, use an http:// symbol server: " + CurrentUrl;
+            Response.bPermanent = true;
+
+            return false;
+        }
+
+        std::string Key = Parsed.Host + ":" + std::to_string(Parsed.Port);
+        std::string Request = "GET " + Parsed.Path + " HTTP/1.1\r\nHost: " + Key + "\r\nUser-Agent: " + UserAgent + "\r\nAccept-Encoding: identity\r\n";
+
+        if (RangeStart || RangeSize)
+            Request += "Range: " + FormatRange(RangeStart, RangeSize) + "\r\n";
+
+        Request += "Connection: keep-alive\r\n\r\n";
+
+        SocketConnection* Connection = nullptr;
+        std::string Line;
+
+        // An idle connection may have been closed by the server since its last use; retry those once on a fresh one.
+        for (int Try = 0; Try < 2 && !Connection; Try++)
+        {
+            auto It = Connections.find(Key);
+
+            Response.bReusedConnection = It != Connections.end();
+
+            if (!Response.bReusedConnection)
+            {
+                int Fd = ConnectWithTimeout(Parsed, TimeoutMs, Response.Error);
+
+                if (Fd < 0)
+                    return false;
+
+                It = Connections.emplace(Key, SocketConnection{ Fd, std::make_unique<SocketReader>(Fd) }).first;
+            }
+
+            if (SendAll(It->second.Fd, Request) && It->second.Reader->ReadLine(Line))
+            {
+                Connection = &It->second;
+
+                break;
+            }
+
+            bool bStale = Response.bReusedConnection && (It->second.Reader->IsEof() || errno == ECONNRESET || errno == EPIPE);
+
+            Response.Error = (errno == EAGAIN || errno == EWOULDBLOCK) ? "Request timed out" : "Connection failed: " + std::string(strerror(errno));
+            Drop(Key);
+
+            if (!bStale)
+                return false;
+        }
+
+        if (!Connection)
+            return false;
+
+        if (Line.compare(0, 5, "HTTP/") != 0 || Line.find(' ') == std::string::npos)
+        {
+            Response.Error = "Malformed HTTP response";
+            Drop(Key);
+
+            return false;
+        }
+
+        Response.StatusCode = atoi(Line.c_str() + Line.find(' ') + 1);
+        Response.FinalUrl = CurrentUrl;
+        Response.Error.clear();
+
+        bool bChunked = false;
+        bool bKeepAlive = Line.compare(0, 8, "HTTP/1.0") != 0;
+        int64_t ContentLength = -1;
+        std::string Location;
+        std::string ContentRange;
+
+        while (Connection->Reader->ReadLine(Line) && !Line.empty())
+        {
+            size_t Colon = Line.find(':');
+
+            if (Colon == std::string::npos)
+                continue;
+
+            std::string Name = Line.substr(0, Colon);
+            size_t ValueStart = Line.find_first_not_of(" \t", Colon + 1);
+            std::string Value = ValueStart == std::string::npos ? std::string() : Line.substr(ValueStart);
+
+            if (strcasecmp(Name.c_str(), "Content-Length") == 0)
+                ContentLength = strtoll(Value.c_str(), nullptr, 10);
+            else if (strcasecmp(Name.c_str(), "Transfer-Encoding") == 0)
+                bChunked = strcasestr(Value.c_str(), "chunked") != nullptr;
+            else if (strcasecmp(Name.c_str(), "Location") == 0)
+                Location = Value;
+            else if (strcasecmp(Name.c_str(), "Content-Range") == 0)
+                ContentRange = Value;
+            else if (strcasecmp(Name.c_str(), "Connection") == 0)
+                bKeepAlive = strcasestr(Value.c_str(), "close") ? false : bKeepAlive || strcasestr(Value.c_str(), "keep-alive");
+        }
+
+        bool bFramed = bChunked || ContentLength >= 0;
+        bool bRedirect = Response.StatusCode >= 300 && Response.StatusCode < 400 && !Location.empty();
+        bool bAccepted = Response.StatusCode == 200 || Response.StatusCode == 206;
+
+        if (Response.StatusCode == 206 && !IsContentRangeAt(ContentRange, RangeStart))
+        {
+            Response.StatusCode = 416;
+            Response.Error = "Unexpected Content-Range";
+            Drop(Key);
+
+            return false;
+        }
+
+        if (!bAccepted)
+        {
+            // Small error and redirect bodies are drained so that the connection can be reused.
+            auto Discard = [](const char*, size_t) { return true; };
+
+            if (!bKeepAlive || !bFramed || ContentLength > 64 * 1024 || !ReadBody(*Connection->Reader, bChunked, ContentLength, Discard))
+                Drop(Key);
+
+            if (bRedirect)
+            {
+                CurrentUrl = Location[0] == '/' ? "http://" + Key + Location : Location;
+
+                continue;
+            }
+
+            Response.Error = "HTTP status " + std::to_string(Response.StatusCode);
+
+            return false;
+        }
+
+        bool bSinkFailed = false;
+
+        auto Counter = [&](const char* Data, size_t Size) -> bool
+        {
+            if (!OnBody(Data, Size))
+            {
+                bSinkFailed = true;
+
+                return false;
+            }
+
+            Response.Bytes += Size;
+
+            return true;
+        };
+
+        bool bResult = ReadBody(*Connection->Reader, bChunked, ContentLength, Counter);
+
+        if (!bResult || !bKeepAlive || !bFramed)
+            Drop(Key);
+
+        if (!bResult && !bSinkFailed)
+        {
+            Response.StatusCode = 0;
+            Response.Error = "Connection lost while receiving data";
+        }
+
+        return bResult;
+    }
+
+    Response.Error = "Too many redirects";
+
+    return false;
+}
+
+#endif
+
+std::unique_ptr<HttpTransport> CreateHttpTransport(uint32_t TimeoutMs)
+{
+#ifdef _WIN32
+    return std::make_unique<WinHttpTransport>(TimeoutMs);
+#else
+    return std::make_unique<SocketHttpTransport>(TimeoutMs);
+#endif
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <functional>
+#include <memory>
+
+struct HttpResponse
+{
+    int StatusCode = 0;
+    uint64_t Bytes = 0;
+    uint64_t ResumedFrom = 0;
+    bool bReusedConnection = false;
+    bool bPermanent = false; // The request cannot be made at all (bad URL, unsupported scheme); retrying will not help.
+    std::string FinalUrl;
+    std::string Error;
+};
+
+struct HttpUrl
+{
+    bool bSecure = false;
+    std::string Host;
+    uint16_t Port = 80;
+    std::string Path;
+};
+
+bool ParseHttpUrl(const std::string& Url, HttpUrl& Result);
+
+using HttpBodyHandler = std::function<bool(const char* Data, size_t Size)>;
+
+// Blocking HTTP GET transport. Implementations keep connections alive between requests to the same host,
+// follow redirects and pass 200/206 bodies to the handler; other bodies are drained and dropped.
+// A non-zero RangeStart/RangeSize sends "Range: bytes=Start-[End]"; RangeSize 0 means up to the end of the file.
+// Timeouts apply to connect and to every send/receive, not to the whole transfer.
+class HttpTransport
+{
+public:
+    virtual ~HttpTransport() = default;
+
+    virtual bool Get(const std::string& Url, uint64_t RangeStart, uint64_t RangeSize, const HttpBodyHandler& OnBody, HttpResponse& Response) = 0;
+};
+
+std::unique_ptr<HttpTransport> CreateHttpTransport(uint32_t TimeoutMs);
+
+// Downloads into "<Path>.part" and renames it into place once complete. A leftover .part file from an
+// interrupted transfer is resumed with a Range request when the server supports it.
+class HttpClient
+{
+public:
+    explicit HttpClient(uint32_t TimeoutMs);
+    explicit HttpClient(std::unique_ptr<HttpTransport> Transport);
+    HttpClient(const HttpClient&) = delete;
+    HttpClient& operator=(const HttpClient&) = delete;
+
+    bool Download(const std::string& Url, const std::filesystem::path& Path, HttpResponse& Response);
+
+    HttpTransport& GetTransport() { return *Transport; }
+
+private:
+    std::unique_ptr<HttpTransport> Transport;
+};
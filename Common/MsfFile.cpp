@@ -0,0 +1,527 @@
+#include "MsfFile.h"
+#include "PdbFormat.h"
+#include "CodeView.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Process-wide LRU cache of MSF blocks for paged files, keyed by (file, block). A miss reads the run of physically
+// contiguous blocks the range needs in one call; when it continues where the file's previous miss ended, the run is
+// extended past the range, most streams are laid out in order and read front to back.
+class MsfPageCache
+{
+public:
+    static constexpr uint32_t MaxReadAhead = 16;
+
+    void SetLimit(uint64_t Bytes) { Limit = Bytes; }
+    uint64_t GetLimit() const { return Limit; }
+    uint32_t NewFileId() { return ++LastFileId; }
+
+    bool Read(uint32_t FileId, const ReadOnlyFile& File, uint32_t BlockSize, uint32_t NumBlocks, const uint32_t* Blocks, uint32_t BlockCount,
+        uint32_t Offset, uint32_t Size, uint8_t* Out, std::atomic<uint32_t>& NextMiss);
+    void Drop(uint32_t FileId);
+    MsfPageCacheStats GetStats();
+
+private:
+    struct Page
+    {
+        uint64_t Key;
+        std::vector<uint8_t> Data;
+    };
+
+    static uint64_t MakeKey(uint32_t FileId, uint32_t Block) { return (static_cast<uint64_t>(FileId) << 32) | Block; }
+    void Insert(uint64_t Key, const uint8_t* Data, uint32_t BlockSize);
+
+    std::atomic<uint64_t> Limit{ 0 };
+    std::atomic<uint32_t> LastFileId{ 0 };
+    std::mutex Mutex;
+    // Most recently used first.
+    std::list<Page> Lru;
+    std::unordered_map<uint64_t, std::list<Page>::iterator> Pages;
+    MsfPageCacheStats Stats;
+};
+
+static MsfPageCache PageCache;
+
+void MsfPageCache::Insert(uint64_t Key, const uint8_t* Data, uint32_t BlockSize)
+{
+    if (Pages.count(Key))
+        return;
+
+    std::vector<uint8_t> Buffer;
+
+    while (!Lru.empty() && Stats.ResidentBytes + BlockSize > Limit)
+    {
+        Page& Oldest = Lru.back();
+
+        Stats.ResidentBytes -= Oldest.Data.size();
+        Pages.erase(Oldest.Key);
+        Buffer = std::move(Oldest.Data);
+        Lru.pop_back();
+    }
+
+    Buffer.assign(Data, Data + BlockSize);
+    Lru.push_front({ Key, std::move(Buffer) });
+    Pages[Key] = Lru.begin();
+    Stats.ResidentBytes += BlockSize;
+    Stats.PeakBytes = std::max(Stats.PeakBytes, Stats.ResidentBytes);
+}
+
+bool MsfPageCache::Read(uint32_t FileId, const ReadOnlyFile& File, uint32_t BlockSize, uint32_t NumBlocks, const uint32_t* Blocks, uint32_t BlockCount,
+    uint32_t Offset, uint32_t Size, uint8_t* Out, std::atomic<uint32_t>& NextMiss)
+{
+    // A run never takes more than a quarter of the cache, so it cannot push out the pages it is meant to precede.
+    uint32_t MaxRun = static_cast<uint32_t>(std::clamp<uint64_t>(Limit / BlockSize / 4, 1, MaxReadAhead));
+    uint32_t First = Offset / BlockSize;
+    uint32_t Last = (Offset + Size - 1) / BlockSize;
+    uint32_t Copied = 0;
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    std::vector<uint8_t> RunBuffer;
+    std::unique_lock<std::mutex> Lock(Mutex);
+
+    auto CopyOut = [&](uint32_t Index, const uint8_t* Block)
+    {
+        uint32_t Start = (Index == First) ? Offset % BlockSize : 0;
+        uint32_t Chunk = std::min(BlockSize - Start, Size - Copied);
+
+        memcpy(Out + Copied, Block + Start, Chunk);
+        Copied += Chunk;
+    };
+
+    for (uint32_t i = First; i <= Last;)
+    {
+        if (Blocks[i] >= NumBlocks)
+            return false;
+
+        auto It = Pages.find(MakeKey(FileId, Blocks[i]));
+
+        if (It != Pages.end())
+        {
+            Lru.splice(Lru.begin(), Lru, It->second);
+            CopyOut(i++, It->second->Data.data());
+            Hits++;
+
+            continue;
+        }
+
+        uint32_t Run = 1;
+        uint32_t RunLimit = NextMiss.load(std::memory_order_relaxed) == Blocks[i] ? MaxRun : std::min(MaxRun, Last - i + 1);
+
+        while (Run < RunLimit && i + Run < BlockCount && Blocks[i + Run] == Blocks[i] + Run && Blocks[i + Run] < NumBlocks &&
+            !Pages.count(MakeKey(FileId, Blocks[i + Run])))
+            Run++;
+
+        // The read itself runs unlocked, other threads keep hitting the cache meanwhile.
+        RunBuffer.resize(static_cast<size_t>(Run) * BlockSize);
+        Lock.unlock();
+
+        bool bRead = File.ReadAt(static_cast<uint64_t>(Blocks[i]) * BlockSize, RunBuffer.data(), RunBuffer.size());
+
+        Lock.lock();
+
+        if (!bRead)
+            return false;
+
+        NextMiss.store(Blocks[i] + Run, std::memory_order_relaxed);
+
+        for (uint32_t j = 0; j < Run; j++)
+            Insert(MakeKey(FileId, Blocks[i + j]), RunBuffer.data() + static_cast<size_t>(j) * BlockSize, BlockSize);
+
+        for (uint32_t j = 0; j < Run && i <= Last; j++)
+            CopyOut(i++, RunBuffer.data() + static_cast<size_t>(j) * BlockSize);
+
+        Misses += Run;
+    }
+
+    Stats.Hits += Hits;
+    Stats.Misses += Misses;
+    Lock.unlock();
+
+    AddStat(StatCounter::PageCacheHits, Hits);
+    AddStat(StatCounter::PageCacheMisses, Misses);
+
+    return true;
+}
+
+void MsfPageCache::Drop(uint32_t FileId)
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    for (auto It = Lru.begin(); It != Lru.end();)
+    {
+        if (It->Key >> 32 != FileId)
+        {
+            ++It;
+
+            continue;
+        }
+
+        Stats.ResidentBytes -= It->Data.size();
+        Pages.erase(It->Key);
+        It = Lru.erase(It);
+    }
+}
+
+MsfPageCacheStats MsfPageCache::GetStats()
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+
+    return Stats;
+}
+
+void SetMsfPageCacheLimit(uint64_t Bytes)
+{
+    PageCache.SetLimit(Bytes);
+}
+
+MsfPageCacheStats GetMsfPageCacheStats()
+{
+    return PageCache.GetStats();
+}
+
+bool MsfFile::Fail(const char* Message)
+{
+    Error = Message;
+    Close();
+
+    return false;
+}
+
+bool MsfFile::Open(const std::filesystem::path& Path)
+{
+    Close();
+
+    if (PageCache.GetLimit())
+    {
+        if (!Direct.Open(Path))
+            return Fail("Cannot open file");
+
+        CacheId = PageCache.NewFileId();
+    }
+    else if (!File.Open(Path))
+        return Fail("Cannot map file");
+
+    MsfSuperBlock Super;
+
+    if (GetFileSize() < sizeof(MsfSuperBlock) || !ReadRaw(0, &Super, sizeof(Super)))
+        return Fail("File is too small for MSF superblock");
+
+    if (memcmp(Super.FileMagic, MsfMagic, sizeof(Super.FileMagic)) != 0)
+        return Fail("Not an MSF 7.00 file");
+
+    if (Super.BlockSize < 512 || Super.BlockSize > 65536 || (Super.BlockSize & (Super.BlockSize - 1)) != 0)
+        return Fail("Invalid MSF block size");
+
+    BlockSize = Super.BlockSize;
+    NumBlocks = Super.NumBlocks;
+
+    if (static_cast<uint64_t>(NumBlocks) * BlockSize > GetFileSize())
+        NumBlocks = static_cast<uint32_t>(GetFileSize() / BlockSize);
+
+    uint32_t NumDirBlocks = (Super.NumDirectoryBytes + BlockSize - 1) / BlockSize;
+    uint64_t BlockMapOffset = static_cast<uint64_t>(Super.BlockMapAddr) * BlockSize;
+
+    std::vector<uint32_t> BlockMap(NumDirBlocks);
+
+    if (!Super.NumDirectoryBytes || BlockMapOffset + NumDirBlocks * sizeof(uint32_t) > GetFileSize() ||
+        !ReadRaw(BlockMapOffset, BlockMap.data(), NumDirBlocks * sizeof(uint32_t)))
+        return Fail("Invalid MSF stream directory location");
+
+    std::vector<uint8_t> Directory(static_cast<size_t>(NumDirBlocks) * BlockSize);
+
+    for (uint32_t i = 0; i < NumDirBlocks; i++)
+    {
+        if (BlockMap[i] >= NumBlocks || !ReadRaw(static_cast<uint64_t>(BlockMap[i]) * BlockSize, Directory.data() + static_cast<size_t>(i) * BlockSize, BlockSize))
+            return Fail("MSF stream directory points outside of file");
+    }
+
+    const uint8_t* Cursor = Directory.data();
+    const uint8_t* End = Directory.data() + Super.NumDirectoryBytes;
+    uint32_t NumStreams = LoadValue<uint32_t>(Cursor);
+
+    Cursor += sizeof(uint32_t);
+
+    if (NumStreams > static_cast<uint64_t>(End - Cursor) / sizeof(uint32_t))
+        return Fail("Corrupted MSF stream directory");
+
+    StreamSizes.resize(NumStreams);
+    StreamBlockStart.resize(NumStreams + 1);
+
+    for (uint32_t i = 0; i < NumStreams; i++, Cursor += sizeof(uint32_t))
+        StreamSizes[i] = LoadValue<uint32_t>(Cursor);
+
+    for (uint32_t i = 0; i < NumStreams; i++)
+    {
+        uint32_t Size = StreamSizes[i] == NilStreamSize ? 0 : StreamSizes[i];
+        uint32_t Count = static_cast<uint32_t>((static_cast<uint64_t>(Size) + BlockSize - 1) / BlockSize);
+
+        if (Count > static_cast<uint64_t>(End - Cursor) / sizeof(uint32_t))
+            return Fail("Corrupted MSF stream directory");
+
+        StreamBlockStart[i] = static_cast<uint32_t>(BlockList.size());
+
+        for (uint32_t j = 0; j < Count; j++, Cursor += sizeof(uint32_t))
+            BlockList.push_back(LoadValue<uint32_t>(Cursor));
+    }
+
+    StreamBlockStart[NumStreams] = static_cast<uint32_t>(BlockList.size());
+
+    return true;
+}
+
+void MsfFile::Close()
+{
+    if (Direct.IsOpen())
+        PageCache.Drop(CacheId);
+
+    File.Close();
+    Direct.Close();
+    CacheId = 0;
+    NextMiss = 0;
+    BlockSize = 0;
+    NumBlocks = 0;
+    StreamSizes.clear();
+    StreamBlockStart.clear();
+    BlockList.clear();
+}
+
+uint32_t MsfFile::GetStreamSize(uint32_t Stream) const
+{
+    if (Stream >= StreamSizes.size() || StreamSizes[Stream] == NilStreamSize)
+        return 0;
+
+    return StreamSizes[Stream];
+}
+
+const uint8_t* MsfFile::GetBlock(uint32_t Block) const
+{
+    if (Block >= NumBlocks)
+        return nullptr;
+
+    return File.Data() + static_cast<uint64_t>(Block) * BlockSize;
+}
+
+bool MsfFile::ReadRaw(uint64_t Offset, void* Buffer, size_t Size) const
+{
+    if (IsPaged())
+        return Direct.ReadAt(Offset, Buffer, Size);
+
+    if (Offset > File.Size() || Size > File.Size() - Offset)
+        return false;
+
+    memcpy(Buffer, File.Data() + Offset, Size);
+
+    return true;
+}
+
+const uint8_t* MsfFile::ReadStream(uint32_t Stream, uint32_t Offset, uint32_t Size, std::vector<uint8_t>& Scratch) const
+{
+    uint32_t StreamSize = GetStreamSize(Stream);
+
+    if (Offset > StreamSize || Size > StreamSize - Offset)
+        return nullptr;
+
+    // Any non-null pointer will do for an empty range.
+    static const uint8_t Empty = 0;
+
+    if (!Size)
+        return IsPaged() ? &Empty : File.Data();
+
+    const uint32_t* Blocks = BlockList.data() + StreamBlockStart[Stream];
+    uint32_t First = Offset / BlockSize;
+    uint32_t Last = (Offset + Size - 1) / BlockSize;
+    uint32_t InBlock = Offset % BlockSize;
+    bool bContiguous = true;
+
+    AddStat(StatCounter::PagesRead, Last - First + 1);
+
+    if (IsPaged())
+    {
+        Scratch.resize(Size);
+
+        if (!PageCache.Read(CacheId, Direct, BlockSize, NumBlocks, Blocks, StreamBlockStart[Stream + 1] - StreamBlockStart[Stream], Offset, Size, Scratch.data(),
+            NextMiss))
+            return nullptr;
+
+        return Scratch.data();
+    }
+
+    for (uint32_t i = First; i < Last && bContiguous; i++)
+        bContiguous = Blocks[i + 1] == Blocks[i] + 1;
+
+    if (bContiguous)
+    {
+        if (!GetBlock(Blocks[First]) || !GetBlock(Blocks[Last]))
+            return nullptr;
+
+        return GetBlock(Blocks[First]) + InBlock;
+    }
+
+    Scratch.resize(Size);
+
+    uint32_t Copied = 0;
+
+    for (uint32_t i = First; i <= Last; i++)
+    {
+        const uint8_t* Block = GetBlock(Blocks[i]);
+
+        if (!Block)
+            return nullptr;
+
+        uint32_t Start = (i == First) ? InBlock : 0;
+        uint32_t Chunk = std::min(BlockSize - Start, Size - Copied);
+
+        memcpy(Scratch.data() + Copied, Block + Start, Chunk);
+        Copied += Chunk;
+    }
+
+    return Scratch.data();
+}
+
+uint32_t MsfWriter::AddStream(std::vector<uint8_t> Data)
+{
+    Streams.push_back(std::move(Data));
+    NilStreams.push_back(false);
+
+    return static_cast<uint32_t>(Streams.size() - 1);
+}
+
+uint32_t MsfWriter::AddNilStream()
+{
+    Streams.emplace_back();
+    NilStreams.push_back(true);
+
+    return static_cast<uint32_t>(Streams.size() - 1);
+}
+
+void MsfWriter::SetStream(uint32_t Stream, std::vector<uint8_t> Data)
+{
+    Streams[Stream] = std::move(Data);
+    NilStreams[Stream] = false;
+}
+
+bool MsfWriter::Write(const std::filesystem::path& Path, std::string& Error) const
+{
+    uint32_t NumStreams = GetStreamCount();
+    uint32_t NextBlock = 3;
+
+    // Blocks 1 and 2 of every BlockSize interval belong to the free page maps.
+    auto Allocate = [&]() -> uint32_t
+    {
+        while (NextBlock % BlockSize == 1 || NextBlock % BlockSize == 2)
+            NextBlock++;
+
+        return NextBlock++;
+    };
+
+    std::vector<std::vector<uint32_t>> StreamBlocks(NumStreams);
+    std::vector<uint8_t> Directory;
+
+    auto Append = [&Directory](uint32_t Value)
+    {
+        uint8_t Bytes[sizeof(Value)];
+
+        memcpy(Bytes, &Value, sizeof(Value));
+        Directory.insert(Directory.end(), Bytes, Bytes + sizeof(Value));
+    };
+
+    Append(NumStreams);
+
+    for (uint32_t i = 0; i < NumStreams; i++)
+    {
+        if (Streams[i].size() >= MsfFile::NilStreamSize)
+        {
+            Error = "Stream " + std::to_string(i) + " is too large";
+
+            return false;
+        }
+
+        Append(NilStreams[i] ? MsfFile::NilStreamSize : static_cast<uint32_t>(Streams[i].size()));
+
+        for (size_t j = 0; j < (Streams[i].size() + BlockSize - 1) / BlockSize; j++)
+            StreamBlocks[i].push_back(Allocate());
+    }
+
+    for (const std::vector<uint32_t>& List : StreamBlocks)
+    {
+        for (uint32_t Block : List)
+            Append(Block);
+    }
+
+    std::vector<uint32_t> DirBlocks;
+
+    for (size_t i = 0; i < (Directory.size() + BlockSize - 1) / BlockSize; i++)
+        DirBlocks.push_back(Allocate());
+
+    if (DirBlocks.size() * sizeof(uint32_t) > BlockSize)
+    {
+        Error = DirectoryTooLarge;
+
+        return false;
+    }
+
+    uint32_t BlockMapAddr = Allocate();
+    uint32_t NumBlocks = NextBlock;
+    std::ofstream Out(Path, std::ios::binary | std::ios::trunc);
+
+    if (!Out.is_open())
+    {
+        Error = "Cannot create output file";
+
+        return false;
+    }
+
+    // Blocks are written in place, gaps (the unused free page map copies) are left to the file system as zeros.
+    auto Place = [&](const std::vector<uint32_t>& List, const uint8_t* Data, size_t Size)
+    {
+        for (size_t i = 0; i < List.size(); i++)
+        {
+            Out.seekp(static_cast<std::streamoff>(List[i]) * BlockSize);
+            Out.write(reinterpret_cast<const char*>(Data + i * BlockSize), std::min<size_t>(BlockSize, Size - i * BlockSize));
+        }
+    };
+
+    MsfSuperBlock Super = {};
+
+    memcpy(Super.FileMagic, MsfMagic, sizeof(Super.FileMagic));
+    Super.BlockSize = BlockSize;
+    Super.FreeBlockMapBlock = 1;
+    Super.NumBlocks = NumBlocks;
+    Super.NumDirectoryBytes = static_cast<uint32_t>(Directory.size());
+    Super.BlockMapAddr = BlockMapAddr;
+    Out.write(reinterpret_cast<const char*>(&Super), sizeof(Super));
+
+    // Free page map: one bit per block, set for free blocks, spread over block 1 of every interval.
+    std::vector<uint8_t> FreeMap((NumBlocks + 8ull * BlockSize - 1) / (8ull * BlockSize) * BlockSize, 0xFF);
+
+    for (uint32_t Block = 0; Block < NumBlocks; Block++)
+        FreeMap[Block / 8] &= static_cast<uint8_t>(~(1u << (Block % 8)));
+
+    for (size_t Chunk = 0; Chunk * BlockSize < FreeMap.size() && Chunk * BlockSize + 1 < NumBlocks; Chunk++)
+        Place({ static_cast<uint32_t>(Chunk * BlockSize + 1) }, FreeMap.data() + Chunk * BlockSize, BlockSize);
+
+    for (uint32_t i = 0; i < NumStreams; i++)
+        Place(StreamBlocks[i], Streams[i].data(), Streams[i].size());
+
+    std::vector<uint8_t> BlockMap(BlockSize);
+
+    memcpy(BlockMap.data(), DirBlocks.data(), DirBlocks.size() * sizeof(uint32_t));
+    Place(DirBlocks, Directory.data(), Directory.size());
+    Place({ BlockMapAddr }, BlockMap.data(), BlockMap.size());
+    Out.flush();
+
+    if (!Out.good())
+    {
+        Error = "Failed to write output file";
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <atomic>
+#include <vector>
+
+// Page-level access for PDBs too large to map: with a limit set, MsfFile::Open reads files through a process-wide
+// LRU page cache of at most Bytes instead of mapping them. 0, the default, maps whole files. Set it before opening
+// the PDBs it is meant for: the mode is picked on open, the limit applies to the cache as a whole.
+void SetMsfPageCacheLimit(uint64_t Bytes);
+
+struct MsfPageCacheStats
+{
+    uint64_t Hits = 0;
+    uint64_t Misses = 0;
+    uint64_t ResidentBytes = 0;
+    uint64_t PeakBytes = 0;
+};
+
+MsfPageCacheStats GetMsfPageCacheStats();
+
+class MsfFile
+{
+public:
+    static constexpr uint32_t NilStreamSize = 0xFFFFFFFF;
+
+    MsfFile() = default;
+    MsfFile(const MsfFile&) = delete;
+    MsfFile& operator=(const MsfFile&) = delete;
+    ~MsfFile() { Close(); }
+
+    bool Open(const std::filesystem::path& Path);
+    void Close();
+
+    bool IsPaged() const { return Direct.IsOpen(); }
+    uint64_t GetFileSize() const { return IsPaged() ? Direct.Size() : File.Size(); }
+    uint32_t GetBlockSize() const { return BlockSize; }
+    uint32_t GetStreamCount() const { return static_cast<uint32_t>(StreamSizes.size()); }
+    uint32_t GetStreamSize(uint32_t Stream) const;
+    bool IsNilStream(uint32_t Stream) const { return Stream < StreamSizes.size() && StreamSizes[Stream] == NilStreamSize; }
+
+    // Returns Size bytes of the stream starting at Offset. Ranges that live in physically
+    // contiguous blocks point straight into the mapping, anything else is gathered into Scratch.
+    // Paged files always gather into Scratch, from the page cache.
+    const uint8_t* ReadStream(uint32_t Stream, uint32_t Offset, uint32_t Size, std::vector<uint8_t>& Scratch) const;
+
+    const std::string& GetError() const { return Error; }
+
+private:
+    bool Fail(const char* Message);
+    const uint8_t* GetBlock(uint32_t Block) const;
+    bool ReadRaw(uint64_t Offset, void* Buffer, size_t Size) const;
+
+    MappedFile File;
+    ReadOnlyFile Direct;
+    // Key of this file's pages in the page cache.
+    uint32_t CacheId = 0;
+    // Block right after the last page cache miss: a miss there is taken as sequential reading and reads ahead.
+    mutable std::atomic<uint32_t> NextMiss{ 0 };
+    uint32_t BlockSize = 0;
+    uint32_t NumBlocks = 0;
+    std::vector<uint32_t> StreamSizes;
+    std::vector<uint32_t> StreamBlockStart;
+    std::vector<uint32_t> BlockList;
+    std::string Error;
+};
+
+// Lays out whole streams as a new MSF 7.00 file: the blocks of every stream in order, then the stream directory
+// and its block map. The file is written block by block, nothing but the directory is assembled in memory.
+class MsfWriter
+{
+public:
+    // Write() fails with this error when the stream directory needs more than one page of block map, which caps the
+    // file size for small pages.
+    static constexpr const char* DirectoryTooLarge = "Stream directory is too large for the block size";
+
+    explicit MsfWriter(uint32_t BlockSize) : BlockSize(BlockSize) {}
+
+    uint32_t AddStream(std::vector<uint8_t> Data);
+    uint32_t AddNilStream();
+    void SetStream(uint32_t Stream, std::vector<uint8_t> Data);
+    uint32_t GetStreamCount() const { return static_cast<uint32_t>(Streams.size()); }
+
+    bool Write(const std::filesystem::path& Path, std::string& Error) const;
+
+private:
+    uint32_t BlockSize;
+    std::vector<std::vector<uint8_t>> Streams;
+    std::vector<bool> NilStreams;
+};
@@ -0,0 +1,116 @@
+#include "NamePattern.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AEPDB_SSE2 1
+#endif
+
+NamePattern::NamePattern(std::string_view Pattern) : Text(Pattern)
+{
+    std::string_view View(Text);
+    size_t Wildcard = View.find_first_of("*?");
+
+    PrefixLength = std::min(Wildcard, View.size());
+
+    for (size_t Start = Wildcard; Start < View.size();)
+    {
+        Start = View.find_first_not_of("*?", Start);
+
+        if (Start == std::string_view::npos)
+            break;
+
+        size_t End = std::min(View.find_first_of("*?", Start), View.size());
+
+        if (End - Start > InnerLength)
+        {
+            InnerStart = Start;
+            InnerLength = End - Start;
+        }
+
+        Start = End;
+    }
+}
+
+bool NamePattern::IsPattern(std::string_view Str)
+{
+    return Str.find('*') != std::string_view::npos;
+}
+
+bool NamePattern::Match(std::string_view Name) const
+{
+    size_t P = 0;
+    size_t N = 0;
+    size_t StarP = std::string::npos;
+    size_t StarN = 0;
+
+    while (N < Name.size())
+    {
+        if (P < Text.size() && (Text[P] == '?' || Text[P] == Name[N]))
+        {
+            P++;
+            N++;
+        }
+        else if (P < Text.size() && Text[P] == '*')
+        {
+            StarP = P++;
+            StarN = N;
+        }
+        else if (StarP != std::string::npos)
+        {
+            P = StarP + 1;
+            N = ++StarN;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (P < Text.size() && Text[P] == '*')
+        P++;
+
+    return P == Text.size();
+}
+
+const char* FindSubstring(const char* Data, size_t Size, std::string_view Needle)
+{
+    if (Needle.empty())
+        return Data;
+
+    if (Needle.size() > Size)
+        return nullptr;
+
+    size_t i = 0;
+
+#ifdef AEPDB_SSE2
+    // Compare the first and the last needle byte against 16 candidate positions at once, only positions where
+    // both agree are checked with memcmp.
+    const size_t Last = Needle.size() - 1;
+    const __m128i First = _mm_set1_epi8(Needle.front());
+    const __m128i Final = _mm_set1_epi8(Needle.back());
+
+    for (; i + Last + 16 <= Size; i += 16)
+    {
+        __m128i BlockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + i));
+        __m128i BlockLast = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + i + Last));
+        uint32_t Mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(BlockFirst, First), _mm_cmpeq_epi8(BlockLast, Final))));
+
+        for (; Mask; Mask &= Mask - 1)
+        {
+            const char* Candidate = Data + i + std::countr_zero(Mask);
+
+            if (Last < 2 || memcmp(Candidate + 1, Needle.data() + 1, Last - 1) == 0)
+                return Candidate;
+        }
+    }
+#endif
+
+    size_t Found = std::string_view(Data + i, Size - i).find(Needle);
+
+    return Found == std::string_view::npos ? nullptr : Data + i + Found;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Glob over symbol names: '*' matches any run of characters, '?' a single character, everything else is literal.
+// Only '*' makes a query a pattern, '?' alone is far too common in decorated C++ names.
+class NamePattern
+{
+public:
+    explicit NamePattern(std::string_view Pattern);
+
+    static bool IsPattern(std::string_view Str);
+
+    bool Match(std::string_view Name) const;
+
+    // Literal text every match starts with.
+    std::string_view GetPrefix() const { return std::string_view(Text).substr(0, PrefixLength); }
+    // Longest literal run after the prefix, empty when the prefix is the only literal.
+    std::string_view GetInnerLiteral() const { return std::string_view(Text).substr(InnerStart, InnerLength); }
+    const std::string& GetText() const { return Text; }
+
+private:
+    std::string Text;
+    size_t PrefixLength = 0;
+    size_t InnerStart = 0;
+    size_t InnerLength = 0;
+};
+
+// First occurrence of Needle in [Data, Data + Size), SSE2 on x86/x64.
+const char* FindSubstring(const char* Data, size_t Size, std::string_view Needle);
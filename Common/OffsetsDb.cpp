@@ -0,0 +1,289 @@
+#include "OffsetsDb.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+static const char OffsetsDbMagic[8] = { 'A', 'e', 'P', 'D', 'B', 'O', 'f', 's' };
+
+static uint64_t AlignTo8(uint64_t Value)
+{
+    return (Value + 7) & ~7ull;
+}
+
+void OffsetsDb::Close()
+{
+    File.Close();
+    Header = nullptr;
+}
+
+bool OffsetsDb::Open(const std::filesystem::path& Path)
+{
+    if (!File.Open(Path) || File.Size() < sizeof(OffsetsDbHeader))
+    {
+        File.Close();
+
+        return false;
+    }
+
+    const OffsetsDbHeader* Candidate = reinterpret_cast<const OffsetsDbHeader*>(File.Data());
+    uint64_t TableEnd = Candidate->ModulesOffset + static_cast<uint64_t>(Candidate->NumModules) * sizeof(OffsetsDbModule);
+
+    bool bValid = memcmp(Candidate->Magic, OffsetsDbMagic, sizeof(OffsetsDbMagic)) == 0 && Candidate->Version == Version &&
+        Candidate->UsedSize <= File.Size() && Candidate->ModulesOffset >= sizeof(OffsetsDbHeader) && !(Candidate->ModulesOffset % 8) &&
+        TableEnd <= Candidate->UsedSize;
+
+    if (bValid)
+    {
+        Modules = reinterpret_cast<const OffsetsDbModule*>(File.Data() + Candidate->ModulesOffset);
+        ModuleNames = reinterpret_cast<const char*>(File.Data() + TableEnd);
+
+        for (uint32_t i = 0; i < Candidate->NumModules && bValid; i++)
+        {
+            const OffsetsDbModule& Module = Modules[i];
+
+            bValid = TableEnd + Module.NameOffset + Module.NameLength <= Candidate->UsedSize && !(Module.BlockOffset % 8) &&
+                Module.BlockOffset >= sizeof(OffsetsDbHeader) && Module.BlockOffset + Module.BlockSize <= Candidate->ModulesOffset &&
+                static_cast<uint64_t>(Module.NumSymbols) * sizeof(OffsetsDbSymbol) <= Module.BlockSize;
+        }
+    }
+
+    if (!bValid)
+    {
+        File.Close();
+
+        return false;
+    }
+
+    Header = Candidate;
+
+    return true;
+}
+
+std::string_view OffsetsDb::GetModuleName(const OffsetsDbModule& Module) const
+{
+    return std::string_view(ModuleNames + Module.NameOffset, Module.NameLength);
+}
+
+std::string_view OffsetsDb::GetBlock(const OffsetsDbModule& Module) const
+{
+    return std::string_view(reinterpret_cast<const char*>(File.Data() + Module.BlockOffset), Module.BlockSize);
+}
+
+const OffsetsDbSymbol* OffsetsDb::GetSymbols(const OffsetsDbModule& Module) const
+{
+    return reinterpret_cast<const OffsetsDbSymbol*>(File.Data() + Module.BlockOffset);
+}
+
+std::string_view OffsetsDb::GetSymbolName(const OffsetsDbModule& Module, const OffsetsDbSymbol& Symbol) const
+{
+    uint64_t NamesSize = Module.BlockSize - static_cast<uint64_t>(Module.NumSymbols) * sizeof(OffsetsDbSymbol);
+
+    if (static_cast<uint64_t>(Symbol.NameOffset) + Symbol.NameLength > NamesSize)
+        return {};
+
+    const char* Names = reinterpret_cast<const char*>(GetSymbols(Module) + Module.NumSymbols);
+
+    return std::string_view(Names + Symbol.NameOffset, Symbol.NameLength);
+}
+
+const OffsetsDbModule* OffsetsDb::FindModule(std::string_view Module) const
+{
+    const OffsetsDbModule* End = Modules + Header->NumModules;
+    const OffsetsDbModule* It = std::lower_bound(Modules, End, Module, [&](const OffsetsDbModule& Entry, std::string_view Value)
+    {
+        return GetModuleName(Entry) < Value;
+    });
+
+    return (It != End && GetModuleName(*It) == Module) ? It : nullptr;
+}
+
+bool OffsetsDb::Find(std::string_view Module, std::string_view Symbol, uint64_t& Value) const
+{
+    const OffsetsDbModule* Entry = FindModule(Module);
+
+    if (!Entry)
+        return false;
+
+    const OffsetsDbSymbol* Symbols = GetSymbols(*Entry);
+    const OffsetsDbSymbol* End = Symbols + Entry->NumSymbols;
+    const OffsetsDbSymbol* It = std::lower_bound(Symbols, End, Symbol, [&](const OffsetsDbSymbol& Candidate, std::string_view Name)
+    {
+        return GetSymbolName(*Entry, Candidate) < Name;
+    });
+
+    if (It == End || GetSymbolName(*Entry, *It) != Symbol)
+        return false;
+
+    Value = It->Value;
+
+    return true;
+}
+
+struct OffsetsDbRecord
+{
+    uint64_t BlockOffset = 0;
+    uint32_t BlockSize = 0;
+    uint32_t NumSymbols = 0;
+    std::string Block;
+    bool bChanged = false;
+};
+
+static std::string BuildBlock(const std::map<std::wstring, std::wstring>& Values, uint32_t& NumSymbols)
+{
+    std::vector<std::pair<std::string, uint64_t>> Symbols;
+
+    for (const auto& [Key, Value] : Values)
+        Symbols.emplace_back(WideToUtf8(Key), std::wcstoull(Value.c_str(), nullptr, 10));
+
+    std::sort(Symbols.begin(), Symbols.end());
+
+    std::vector<OffsetsDbSymbol> Table;
+    std::string Names;
+
+    for (const auto& [Name, Value] : Symbols)
+    {
+        Table.push_back({ static_cast<uint32_t>(Names.size()), static_cast<uint32_t>(Name.size()), Value });
+        Names += Name;
+    }
+
+    std::string Block(reinterpret_cast<const char*>(Table.data()), Table.size() * sizeof(OffsetsDbSymbol));
+
+    Block += Names;
+    Block.resize(AlignTo8(Block.size()));
+    NumSymbols = static_cast<uint32_t>(Table.size());
+
+    return Block;
+}
+
+// Writes every block starting at Offset, then the module table, and fills in the header.
+static bool WriteBlocksAndTable(std::ostream& Out, uint64_t Offset, std::map<std::string, OffsetsDbRecord>& Records, OffsetsDbHeader& Header)
+{
+    Out.seekp(static_cast<std::streamoff>(Offset));
+
+    for (auto& [Name, Record] : Records)
+    {
+        Record.BlockOffset = Offset;
+        Record.BlockSize = static_cast<uint32_t>(Record.Block.size());
+        Out.write(Record.Block.data(), Record.Block.size());
+        Offset += Record.Block.size();
+    }
+
+    std::vector<OffsetsDbModule> Table;
+    std::string Names;
+
+    for (const auto& [Name, Record] : Records)
+    {
+        Table.push_back({ static_cast<uint32_t>(Names.size()), static_cast<uint32_t>(Name.size()), Record.NumSymbols, Record.BlockSize, Record.BlockOffset });
+        Names += Name;
+    }
+
+    Names.resize(AlignTo8(Names.size()));
+
+    Out.write(reinterpret_cast<const char*>(Table.data()), Table.size() * sizeof(OffsetsDbModule));
+    Out.write(Names.data(), Names.size());
+
+    memcpy(Header.Magic, OffsetsDbMagic, sizeof(OffsetsDbMagic));
+    Header.Version = OffsetsDb::Version;
+    Header.NumModules = static_cast<uint32_t>(Table.size());
+    Header.ModulesOffset = Offset;
+    Header.UsedSize = Offset + Table.size() * sizeof(OffsetsDbModule) + Names.size();
+
+    return Out.good();
+}
+
+bool UpdateOffsetsDb(const std::filesystem::path& DbPath, const OffsetSections& UpdatedSections, bool bReport)
+{
+    std::map<std::string, OffsetsDbRecord> Records;
+    OffsetsDb Existing;
+    std::error_code Error;
+
+    bool bExisting = Existing.Open(DbPath);
+
+    if (!bExisting && std::filesystem::exists(DbPath, Error))
+        printf_s("[!] %ls is not a valid offsets database, rewriting it\n", DbPath.filename().wstring().c_str());
+
+    if (bExisting)
+    {
+        for (uint32_t i = 0; i < Existing.GetModuleCount(); i++)
+        {
+            const OffsetsDbModule& Module = Existing.GetModule(i);
+
+            Records[std::string(Existing.GetModuleName(Module))].NumSymbols = Module.NumSymbols;
+        }
+    }
+
+    uint32_t NumChanged = 0;
+
+    for (const auto& [Section, Values] : UpdatedSections)
+    {
+        std::string Name = WideToUtf8(Section);
+        uint32_t NumSymbols = 0;
+        std::string Block = BuildBlock(Values, NumSymbols);
+
+        if (Records.count(Name) && Existing.GetBlock(*Existing.FindModule(Name)) == Block)
+            continue;
+
+        OffsetsDbRecord& Record = Records[Name];
+
+        Record.Block = std::move(Block);
+        Record.NumSymbols = NumSymbols;
+        Record.bChanged = true;
+        NumChanged++;
+    }
+
+    if (bExisting && !NumChanged)
+    {
+        if (bReport)
+            printf_s("[+] Already up to date: %ls\n", DbPath.wstring().c_str());
+
+        return true;
+    }
+
+    // Blocks that did not change are copied as they are, the rest of the file is rebuilt.
+    for (auto& [Name, Record] : Records)
+    {
+        if (!Record.bChanged)
+            Record.Block = Existing.GetBlock(*Existing.FindModule(Name));
+    }
+
+    Existing.Close();
+
+    OffsetsDbHeader Header = {};
+
+    // Written under a temporary name and renamed over the old file, so readers never see a half-written database.
+    std::filesystem::path TempPath = DbPath;
+    TempPath += L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+        if (!Out.is_open() || !WriteBlocksAndTable(Out, AlignTo8(sizeof(OffsetsDbHeader)), Records, Header))
+        {
+            Out.close();
+            std::filesystem::remove(TempPath, Error);
+            printf_s("[-] Failed to write offsets database! :( Path: %ls\n", TempPath.wstring().c_str());
+
+            return false;
+        }
+
+        Out.seekp(0);
+        Out.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+    }
+
+    std::filesystem::rename(TempPath, DbPath, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+        printf_s("[-] Failed to replace offsets database! :( Path: %ls (%s)\n", DbPath.wstring().c_str(), Error.message().c_str());
+
+        return false;
+    }
+
+    if (bReport)
+        printf_s("[+] Successfully updated: %ls (%u module(s) written)\n", DbPath.wstring().c_str(), NumChanged);
+
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "OffsetsIni.h"
+
+#include <string_view>
+
+struct OffsetsDbHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t NumModules;
+    uint64_t ModulesOffset;
+    uint64_t UsedSize;
+    uint64_t DeadBytes; // Always 0 since every merge rewrites the file; kept so the layout stays the same.
+};
+
+struct OffsetsDbModule
+{
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint32_t NumSymbols;
+    uint32_t BlockSize;
+    uint64_t BlockOffset;
+};
+
+struct OffsetsDbSymbol
+{
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint64_t Value;
+};
+
+// Binary offsets database. A sorted module table (names follow the table) points at one block per module:
+// a sorted symbol table followed by the symbol names, all names UTF-8. Consumers map the file and binary search
+// both levels. A merge rewrites the whole file under a temporary name and renames it over the old one, so readers
+// always see a complete version.
+class OffsetsDb
+{
+public:
+    static constexpr uint32_t Version = 1;
+
+    bool Open(const std::filesystem::path& Path);
+    void Close();
+    bool IsOpen() const { return File.IsOpen(); }
+
+    const OffsetsDbHeader& GetHeader() const { return *Header; }
+    uint32_t GetModuleCount() const { return Header->NumModules; }
+    const OffsetsDbModule& GetModule(uint32_t Index) const { return Modules[Index]; }
+    const OffsetsDbModule* FindModule(std::string_view Module) const;
+    bool Find(std::string_view Module, std::string_view Symbol, uint64_t& Value) const;
+
+    std::string_view GetModuleName(const OffsetsDbModule& Module) const;
+    const OffsetsDbSymbol* GetSymbols(const OffsetsDbModule& Module) const;
+    std::string_view GetBlock(const OffsetsDbModule& Module) const;
+    std::string_view GetSymbolName(const OffsetsDbModule& Module, const OffsetsDbSymbol& Symbol) const;
+
+private:
+    MappedFile File;
+    const OffsetsDbHeader* Header = nullptr;
+    const OffsetsDbModule* Modules = nullptr;
+    const char* ModuleNames = nullptr;
+};
+
+bool UpdateOffsetsDb(const std::filesystem::path& DbPath, const OffsetSections& UpdatedSections, bool bReport = true);
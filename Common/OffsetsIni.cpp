@@ -0,0 +1,190 @@
+#include "OffsetsIni.h"
+
+#include <algorithm>
+#include <cwctype>
+#include <fstream>
+#include <set>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+bool UpdateIniSections(const std::wstring& IniPath, const OffsetSections& UpdatedSections, bool bReport)
+{
+    std::wstring TempPath = IniPath + L".tmp";
+    std::wofstream TempFile(std::filesystem::path(TempPath), std::ios::trunc);
+
+    if (!TempFile.is_open())
+    {
+        printf_s("[-] Failed to create temporary file! :( Path: %ls\n", TempPath.c_str());
+
+        return false;
+    }
+
+    std::wifstream IniFile{std::filesystem::path(IniPath)};
+
+    std::set<std::wstring> ProcessedSections;
+    OffsetSections ExistingSections;
+    
+    std::wstring CurrentSection;
+
+    bool bInSectionToSkip = false;
+    bool bFirstSectionWritten = false;
+    bool bLastLineWasSection = false;
+    bool bFileExists = IniFile.is_open();
+
+    if (bFileExists)
+    {
+        std::wstring Line;
+
+        while (std::getline(IniFile, Line))
+        {
+            if (Line.size() > 2 && Line[0] == L'[' && Line.back() == L']')
+            {
+                CurrentSection = Line.substr(1, Line.size() - 2);
+                bool bIsUpdatedSection = (UpdatedSections.find(CurrentSection) != UpdatedSections.end());
+
+                if (bIsUpdatedSection)
+                {
+                    if (bFirstSectionWritten)
+                        TempFile << L"\n";
+
+                    TempFile << L"[" << CurrentSection << L"]\n";
+
+                    for (const auto& [Key, Value] : UpdatedSections.at(CurrentSection))
+                        TempFile << Key << L"=" << Value << L"\n";
+
+                    bInSectionToSkip = true;
+                    bFirstSectionWritten = true;
+                    bLastLineWasSection = true;
+
+                    ProcessedSections.insert(CurrentSection);
+
+                    continue;
+                }
+
+                if (bFirstSectionWritten && !bLastLineWasSection)
+                    TempFile << L"\n";
+
+                TempFile << Line << L"\n";
+                bLastLineWasSection = true;
+                bInSectionToSkip = false;
+            }
+            else
+            {
+                if (!Line.empty() && !std::all_of(Line.begin(), Line.end(), iswspace))
+                    bLastLineWasSection = false;
+
+                if (bInSectionToSkip)
+                {
+                    size_t Separator = Line.find(L'=');
+
+                    if (Separator != std::wstring::npos)
+                        ExistingSections[CurrentSection][Line.substr(0, Separator)] = Line.substr(Separator + 1);
+
+                    continue;
+                }
+
+                TempFile << Line << L"\n";
+            }
+        }
+
+        IniFile.close();
+    }
+
+    bool bIsAddedNewSection = false;
+
+    for (const auto& [Section, Values] : UpdatedSections)
+    {
+        if (ProcessedSections.find(Section) == ProcessedSections.end())
+        {
+            if (bFirstSectionWritten || bIsAddedNewSection)
+                TempFile << L"\n";
+
+            TempFile << L"[" << Section << L"]\n";
+
+            for (const auto& [Key, Value] : Values)
+                TempFile << Key << L"=" << Value << L"\n";
+
+            bIsAddedNewSection = true;
+            bFirstSectionWritten = true;
+        }
+    }
+
+    TempFile.close();
+
+    bool bChanged = false;
+
+    for (const auto& [Section, Values] : UpdatedSections)
+        bChanged |= !ProcessedSections.count(Section) || ExistingSections[Section] != Values;
+
+    if (!bChanged)
+    {
+        std::filesystem::remove(TempPath);
+
+        if (bReport)
+            printf_s("[+] Already up to date: %ls\n", IniPath.c_str());
+
+        return true;
+    }
+
+    if (!bFirstSectionWritten)
+    {
+        std::filesystem::remove(TempPath);
+        printf_s("[-] Nothing to write to INI file\n");
+
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExW(TempPath.c_str(), IniPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_COPY_ALLOWED))
+    {
+        DWORD Error = GetLastError();
+
+        std::filesystem::remove(TempPath);
+
+        if (Error == ERROR_ALREADY_EXISTS)
+        {
+            printf_s("[!] ERROR_ALREADY_EXISTS: Attempting fallback method...\n");
+
+            if (DeleteFileW(IniPath.c_str()) || GetLastError() == ERROR_FILE_NOT_FOUND)
+            {
+                if (MoveFileW(TempPath.c_str(), IniPath.c_str()))
+                {
+                    if (bReport)
+                        printf_s("[+] Successfully updated (fallback method): %ls\n", IniPath.c_str());
+
+                    return true;
+                }
+            }
+        }
+
+        LPVOID lpMsgBuf;
+        
+        FormatMessageW(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS, NULL, Error,
+            MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPWSTR)&lpMsgBuf, 0, NULL);
+
+        printf_s("[-] Failed to replace INI file! :( Path: %ls -> %ls (Error: %lu - %ls)\n", TempPath.c_str(), IniPath.c_str(), Error, (LPWSTR)lpMsgBuf);
+        LocalFree(lpMsgBuf);
+
+        return false;
+    }
+#else
+    std::error_code Error;
+
+    std::filesystem::rename(TempPath, IniPath, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath);
+        printf_s("[-] Failed to replace INI file! :( Path: %ls -> %ls (Error: %d - %s)\n", TempPath.c_str(), IniPath.c_str(), Error.value(), Error.message().c_str());
+
+        return false;
+    }
+#endif
+
+    if (bReport)
+        printf_s("[+] Successfully updated: %ls\n", IniPath.c_str());
+
+    return true;
+}
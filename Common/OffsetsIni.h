@@ -0,0 +1,9 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <map>
+
+using OffsetSections = std::map<std::wstring, std::map<std::wstring, std::wstring>>;
+
+bool UpdateIniSections(const std::wstring& IniPath, const OffsetSections& UpdatedSections, bool bReport = true);
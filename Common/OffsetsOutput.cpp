@@ -0,0 +1,409 @@
+#include "OffsetsOutput.h"
+#include "OffsetsDb.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+bool ParseOffsetsFormat(const std::wstring& Name, OffsetsFormat& Format)
+{
+    if (Name == L"ini")
+        Format = OffsetsFormat::Ini;
+    else if (Name == L"json")
+        Format = OffsetsFormat::Json;
+    else if (Name == L"bin")
+        Format = OffsetsFormat::Binary;
+    else
+        return false;
+
+    return true;
+}
+
+std::filesystem::path GetOffsetsPath(const std::filesystem::path& Dir, OffsetsFormat Format)
+{
+    switch (Format)
+    {
+    case OffsetsFormat::Json: return Dir / L"offsets.json";
+    case OffsetsFormat::Binary: return Dir / L"offsets.bin";
+    default: return Dir / L"offsets.ini";
+    }
+}
+
+bool UpdateOffsets(const std::filesystem::path& Path, OffsetsFormat Format, const OffsetSections& UpdatedSections, bool bReport)
+{
+    ScopedTimer Timer("Offsets write");
+
+    switch (Format)
+    {
+    case OffsetsFormat::Json: return UpdateJsonSections(Path, UpdatedSections, bReport);
+    case OffsetsFormat::Binary: return UpdateOffsetsDb(Path, UpdatedSections, bReport);
+    default: return UpdateIniSections(Path.wstring(), UpdatedSections, bReport);
+    }
+}
+
+static bool ReadIniSections(const std::filesystem::path& IniPath, OffsetSections& Sections)
+{
+    std::wifstream In(IniPath);
+    std::wstring Line;
+    std::map<std::wstring, std::wstring>* Current = nullptr;
+
+    if (!In.is_open())
+        return false;
+
+    while (std::getline(In, Line))
+    {
+        if (Line.size() > 2 && Line[0] == L'[' && Line.back() == L']')
+        {
+            Current = &Sections[Line.substr(1, Line.size() - 2)];
+
+            continue;
+        }
+
+        size_t Separator = Line.find(L'=');
+
+        if (Current && Separator != std::wstring::npos)
+            (*Current)[Line.substr(0, Separator)] = Line.substr(Separator + 1);
+    }
+
+    return true;
+}
+
+static bool ReadDbSections(const std::filesystem::path& DbPath, OffsetSections& Sections)
+{
+    OffsetsDb Db;
+
+    if (!Db.Open(DbPath))
+        return false;
+
+    for (uint32_t i = 0; i < Db.GetModuleCount(); i++)
+    {
+        const OffsetsDbModule& Module = Db.GetModule(i);
+        const OffsetsDbSymbol* Symbols = Db.GetSymbols(Module);
+        std::map<std::wstring, std::wstring>& Values = Sections[Utf8ToWide(std::string(Db.GetModuleName(Module)))];
+
+        for (uint32_t j = 0; j < Module.NumSymbols; j++)
+            Values[Utf8ToWide(std::string(Db.GetSymbolName(Module, Symbols[j])))] = std::to_wstring(Symbols[j].Value);
+    }
+
+    return true;
+}
+
+static void AppendJsonString(std::string& Out, const std::string& Str)
+{
+    Out += '"';
+
+    for (char Char : Str)
+    {
+        if (Char == '"' || Char == '\\')
+        {
+            Out += '\\';
+            Out += Char;
+        }
+        else if (static_cast<uint8_t>(Char) < 0x20)
+        {
+            char Escape[8];
+
+            snprintf(Escape, sizeof(Escape), "\\u%04X", static_cast<uint8_t>(Char));
+            Out += Escape;
+        }
+        else
+        {
+            Out += Char;
+        }
+    }
+
+    Out += '"';
+}
+
+static std::string FormatModuleLine(const std::wstring& Section, const std::map<std::wstring, std::wstring>& Values)
+{
+    std::string Line = "  ";
+
+    AppendJsonString(Line, WideToUtf8(Section));
+    Line += ": {";
+
+    for (auto It = Values.begin(); It != Values.end(); ++It)
+    {
+        std::string Value = WideToUtf8(It->second);
+
+        if (It != Values.begin())
+            Line += ", ";
+
+        AppendJsonString(Line, WideToUtf8(It->first));
+        Line += ": ";
+
+        if (!Value.empty() && std::all_of(Value.begin(), Value.end(), [](char Char) { return Char >= '0' && Char <= '9'; }))
+            Line += Value;
+        else
+            AppendJsonString(Line, Value);
+    }
+
+    Line += "}";
+
+    return Line;
+}
+
+// Length of the quoted module name at the start of a module line ("  \"name\": {...}"), 0 if it is not one.
+static size_t GetModuleKeyLength(const std::string& Line)
+{
+    if (Line.compare(0, 3, "  \"") != 0)
+        return 0;
+
+    for (size_t i = 3; i < Line.size(); i++)
+    {
+        if (Line[i] == '\\')
+            i++;
+        else if (Line[i] == '"')
+            return i + 1;
+    }
+
+    return 0;
+}
+
+// Reads a quoted string as AppendJsonString writes it, starting at Pos.
+static bool ParseJsonString(const std::string& Line, size_t& Pos, std::string& Str)
+{
+    if (Pos >= Line.size() || Line[Pos] != '"')
+        return false;
+
+    Str.clear();
+
+    for (Pos++; Pos < Line.size(); Pos++)
+    {
+        if (Line[Pos] == '"')
+        {
+            Pos++;
+
+            return true;
+        }
+
+        if (Line[Pos] != '\\')
+        {
+            Str += Line[Pos];
+        }
+        else if (Pos + 1 < Line.size() && Line[Pos + 1] == 'u' && Pos + 5 < Line.size())
+        {
+            Str += static_cast<char>(std::strtoul(Line.substr(Pos + 2, 4).c_str(), nullptr, 16));
+            Pos += 5;
+        }
+        else if (++Pos >= Line.size())
+        {
+            return false;
+        }
+        else
+        {
+            Str += Line[Pos];
+        }
+    }
+
+    return false;
+}
+
+// One module line as FormatModuleLine writes it: "  \"name\": {\"Symbol\": 123, \"Other\": \"text\"}".
+static bool ParseModuleLine(const std::string& Line, OffsetSections& Sections)
+{
+    size_t Pos = 2;
+    std::string Module;
+    std::string Key;
+    std::string Value;
+
+    if (!ParseJsonString(Line, Pos, Module) || Line.compare(Pos, 3, ": {") != 0)
+        return false;
+
+    std::map<std::wstring, std::wstring>& Values = Sections[Utf8ToWide(Module)];
+
+    for (Pos += 3; Pos < Line.size() && Line[Pos] != '}';)
+    {
+        if (!ParseJsonString(Line, Pos, Key) || Line.compare(Pos, 2, ": ") != 0)
+            return false;
+
+        Pos += 2;
+
+        if (Line[Pos] == '"')
+        {
+            if (!ParseJsonString(Line, Pos, Value))
+                return false;
+        }
+        else
+        {
+            size_t End = Line.find_first_of(",}", Pos);
+
+            if (End == std::string::npos)
+                return false;
+
+            Value = Line.substr(Pos, End - Pos);
+            Pos = End;
+        }
+
+        Values[Utf8ToWide(Key)] = Utf8ToWide(Value);
+
+        if (Line.compare(Pos, 2, ", ") == 0)
+            Pos += 2;
+    }
+
+    return Pos < Line.size();
+}
+
+static bool ReadJsonSections(const std::filesystem::path& JsonPath, OffsetSections& Sections)
+{
+    std::ifstream In(JsonPath, std::ios::binary);
+    std::string Line;
+
+    if (!In.is_open() || !std::getline(In, Line) || Line.rfind("{", 0) != 0)
+        return false;
+
+    while (std::getline(In, Line))
+    {
+        if (!Line.empty() && Line.back() == '\r')
+            Line.pop_back();
+
+        if (GetModuleKeyLength(Line) && !ParseModuleLine(Line, Sections))
+            return false;
+    }
+
+    return true;
+}
+
+bool ReadOffsets(const std::filesystem::path& Path, OffsetsFormat Format, OffsetSections& Sections)
+{
+    switch (Format)
+    {
+    case OffsetsFormat::Json: return ReadJsonSections(Path, Sections);
+    case OffsetsFormat::Binary: return ReadDbSections(Path, Sections);
+    default: return ReadIniSections(Path, Sections);
+    }
+}
+
+bool UpdateJsonSections(const std::filesystem::path& JsonPath, const OffsetSections& UpdatedSections, bool bReport)
+{
+    std::vector<std::string> Lines;
+    std::vector<std::string> NewLines;
+    std::map<std::string, const std::string*> Updated;
+    std::error_code Error;
+
+    for (const auto& [Section, Values] : UpdatedSections)
+        NewLines.push_back(FormatModuleLine(Section, Values));
+
+    for (const std::string& NewLine : NewLines)
+        Updated[NewLine.substr(0, GetModuleKeyLength(NewLine))] = &NewLine;
+
+    std::ifstream In(JsonPath, std::ios::binary);
+    bool bExisted = In.is_open();
+
+    if (bExisted)
+    {
+        std::string Line;
+
+        while (std::getline(In, Line))
+        {
+            if (!Line.empty() && Line.back() == '\r')
+                Line.pop_back();
+
+            Lines.push_back(Line);
+        }
+
+        In.close();
+
+        while (!Lines.empty() && Lines.back().empty())
+            Lines.pop_back();
+
+        if (Lines.size() < 2 || Lines.front() != "{" || Lines.back() != "}")
+        {
+            printf_s("[-] %ls is not an offsets file written by AePDB! :(\n", JsonPath.wstring().c_str());
+
+            return false;
+        }
+
+        Lines.erase(Lines.begin());
+        Lines.pop_back();
+    }
+
+    bool bChanged = !bExisted && !NewLines.empty();
+
+    for (std::string& Line : Lines)
+    {
+        size_t KeyLength = GetModuleKeyLength(Line);
+
+        if (!KeyLength)
+        {
+            printf_s("[-] %ls is not an offsets file written by AePDB! :(\n", JsonPath.wstring().c_str());
+
+            return false;
+        }
+
+        if (Line.back() == ',')
+            Line.pop_back();
+
+        auto It = Updated.find(Line.substr(0, KeyLength));
+
+        if (It == Updated.end())
+            continue;
+
+        bChanged |= Line != *It->second;
+        Line = *It->second;
+        Updated.erase(It);
+    }
+
+    for (const std::string& NewLine : NewLines)
+    {
+        if (Updated.count(NewLine.substr(0, GetModuleKeyLength(NewLine))))
+        {
+            Lines.push_back(NewLine);
+            bChanged = true;
+        }
+    }
+
+    if (!bChanged)
+    {
+        if (bReport)
+            printf_s("[+] Already up to date: %ls\n", JsonPath.wstring().c_str());
+
+        return true;
+    }
+
+    std::filesystem::path TempPath = JsonPath;
+    TempPath += L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+        if (!Out.is_open())
+        {
+            printf_s("[-] Failed to create temporary file! :( Path: %ls\n", TempPath.wstring().c_str());
+
+            return false;
+        }
+
+        Out << "{\n";
+
+        for (size_t i = 0; i < Lines.size(); i++)
+            Out << Lines[i] << (i + 1 < Lines.size() ? ",\n" : "\n");
+
+        Out << "}\n";
+
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(TempPath, Error);
+
+            return false;
+        }
+    }
+
+    std::filesystem::rename(TempPath, JsonPath, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+        printf_s("[-] Failed to replace JSON file! :( Path: %ls (%s)\n", JsonPath.wstring().c_str(), Error.message().c_str());
+
+        return false;
+    }
+
+    if (bReport)
+        printf_s("[+] Successfully updated: %ls\n", JsonPath.wstring().c_str());
+
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "OffsetsIni.h"
+
+enum class OffsetsFormat
+{
+    Ini,
+    Json,
+    Binary,
+};
+
+bool ParseOffsetsFormat(const std::wstring& Name, OffsetsFormat& Format);
+std::filesystem::path GetOffsetsPath(const std::filesystem::path& Dir, OffsetsFormat Format);
+
+// Merges the updated sections into the offsets file of the given format. Sections are replaced as a whole,
+// sections that are not updated are kept as they are, and nothing is written when no section changed. Errors are
+// always printed, the outcome only with bReport.
+bool UpdateOffsets(const std::filesystem::path& Path, OffsetsFormat Format, const OffsetSections& UpdatedSections, bool bReport = true);
+
+// Reads back every section of an offsets file of the given format; fails if it is missing or not written by AePDB.
+bool ReadOffsets(const std::filesystem::path& Path, OffsetsFormat Format, OffsetSections& Sections);
+
+// JSON object of modules, one module object per line, so a merge copies unchanged modules without parsing them.
+bool UpdateJsonSections(const std::filesystem::path& JsonPath, const OffsetSections& UpdatedSections, bool bReport = true);
@@ -0,0 +1,573 @@
+#include "PdbFile.h"
+#include "PdbFormat.h"
+#include "CodeView.h"
+
+#include <algorithm>
+
+static constexpr uint32_t GsiBitmapWords = (GsiHashTable::NumHashBuckets + 1 + 31) / 32;
+static constexpr uint32_t ModInfoHeaderSize = 64;
+static constexpr uint16_t MachineI386 = 0x014C;
+
+uint32_t GsiHashTable::HashName(const std::string& Name)
+{
+    const uint8_t* Data = reinterpret_cast<const uint8_t*>(Name.data());
+    size_t Size = Name.size();
+    uint32_t Result = 0;
+
+    for (; Size >= 4; Data += 4, Size -= 4)
+        Result ^= LoadValue<uint32_t>(Data);
+
+    if (Size >= 2)
+    {
+        Result ^= LoadValue<uint16_t>(Data);
+        Data += 2;
+        Size -= 2;
+    }
+
+    if (Size == 1)
+        Result ^= *Data;
+
+    Result |= 0x20202020;
+    Result ^= (Result >> 11);
+
+    return Result ^ (Result >> 16);
+}
+
+bool GsiHashTable::Load(const MsfFile& Msf, uint32_t Stream, uint32_t Offset, uint32_t Size)
+{
+    if (Size < sizeof(GsiHashHeader))
+        return false;
+
+    std::vector<uint8_t> Scratch;
+    const uint8_t* Data = Msf.ReadStream(Stream, Offset, sizeof(GsiHashHeader), Scratch);
+
+    if (!Data)
+        return false;
+
+    GsiHashHeader Header;
+
+    memcpy(&Header, Data, sizeof(Header));
+
+    if (Header.VerSignature != GsiHashSignature || Header.VerHdr != GsiHashVersion)
+        return false;
+
+    uint64_t BitmapOffset = sizeof(GsiHashHeader) + static_cast<uint64_t>(Header.HrSize);
+    uint64_t BucketsOffset = BitmapOffset + GsiBitmapWords * sizeof(uint32_t);
+
+    if (BucketsOffset > Size)
+        return false;
+
+    // The bitmap and the compressed buckets, at most one per hash bucket.
+    uint32_t TailSize = static_cast<uint32_t>(std::min<uint64_t>(Size - BitmapOffset, (GsiBitmapWords + NumHashBuckets + 1) * sizeof(uint32_t)));
+    const uint8_t* Bitmap = Msf.ReadStream(Stream, Offset + static_cast<uint32_t>(BitmapOffset), TailSize, Scratch);
+
+    if (!Bitmap)
+        return false;
+
+    uint32_t NumBuckets = 0;
+
+    for (uint32_t i = 0; i < GsiBitmapWords; i++)
+    {
+        uint32_t Word = LoadValue<uint32_t>(Bitmap + i * sizeof(uint32_t));
+
+        for (; Word; Word &= Word - 1)
+            NumBuckets++;
+    }
+
+    if ((GsiBitmapWords + static_cast<uint64_t>(NumBuckets)) * sizeof(uint32_t) > TailSize)
+        return false;
+
+    uint32_t NumRecords = Header.HrSize / GsiHashRecordSize;
+
+    // Paged PDBs keep the records on disk, a table of millions of symbols would otherwise be copied into memory whole.
+    if (!Msf.IsPaged())
+    {
+        Records = Msf.ReadStream(Stream, Offset + sizeof(GsiHashHeader), NumRecords * GsiHashRecordSize, Storage);
+
+        if (!Records)
+            return false;
+    }
+
+    this->Msf = &Msf;
+    this->Stream = Stream;
+    RecordsOffset = Offset + sizeof(GsiHashHeader);
+
+    const uint8_t* Buckets = Bitmap + GsiBitmapWords * sizeof(uint32_t);
+    uint32_t Next = NumRecords;
+    uint32_t Compressed = NumBuckets;
+
+    BucketStart.assign(NumHashBuckets + 2, NumRecords);
+
+    for (uint32_t i = NumHashBuckets + 1; i-- > 0;)
+    {
+        if (Bitmap[i / 8] & (1u << (i % 8)))
+        {
+            uint32_t Start = LoadValue<uint32_t>(Buckets + --Compressed * sizeof(uint32_t)) / GsiBucketOffsetScale;
+
+            Next = std::min(Start, Next);
+        }
+
+        BucketStart[i] = Next;
+    }
+
+    return true;
+}
+
+bool PdbFile::Fail(const std::string& Message)
+{
+    Error = Message;
+
+    return false;
+}
+
+bool PdbFile::Open(const std::filesystem::path& Path)
+{
+    if (!Msf.Open(Path))
+        return Fail(Msf.GetError());
+
+    std::vector<uint8_t> Scratch;
+    const uint8_t* Info = Msf.ReadStream(PdbInfoStream, 0, 28, Scratch);
+
+    if (!Info)
+        return Fail("Missing PDB info stream");
+
+    Age = LoadValue<uint32_t>(Info + 8);
+    memcpy(&Guid, Info + 12, sizeof(Guid));
+
+    return LoadDbi();
+}
+
+bool PdbFile::ReadIdentity(const std::filesystem::path& Path, PdbGuid& Guid, uint32_t& Age)
+{
+    MsfFile Msf;
+    std::vector<uint8_t> Scratch;
+    const uint8_t* Info = Msf.Open(Path) ? Msf.ReadStream(PdbInfoStream, 0, 28, Scratch) : nullptr;
+
+    if (!Info)
+        return false;
+
+    Age = LoadValue<uint32_t>(Info + 8);
+    memcpy(&Guid, Info + 12, sizeof(Guid));
+
+    return true;
+}
+
+bool PdbFile::LoadDbi()
+{
+    std::vector<uint8_t> Scratch;
+    const uint8_t* Data = Msf.ReadStream(PdbDbiStream, 0, sizeof(DbiStreamHeader), Scratch);
+
+    if (!Data)
+        return Fail("Missing DBI stream");
+
+    DbiStreamHeader Header;
+
+    memcpy(&Header, Data, sizeof(Header));
+
+    if (Header.VersionSignature != -1)
+        return Fail("Unsupported DBI stream version");
+
+    Machine = Header.Machine;
+    SymRecordStream = Header.SymRecordStream;
+    ModInfoOffset = sizeof(DbiStreamHeader);
+    ModInfoSize = static_cast<uint32_t>(Header.ModInfoSize);
+    SectionContribSize = static_cast<uint32_t>(Header.SectionContributionSize);
+
+    uint32_t PublicsSize = Msf.GetStreamSize(Header.PublicStreamIndex);
+
+    if (Header.PublicStreamIndex != NilStreamIndex && PublicsSize >= sizeof(PublicsStreamHeader))
+    {
+        const uint8_t* PublicsData = Msf.ReadStream(Header.PublicStreamIndex, 0, sizeof(PublicsStreamHeader), Scratch);
+        PublicsStreamHeader PublicsHeader = {};
+
+        if (PublicsData)
+            memcpy(&PublicsHeader, PublicsData, sizeof(PublicsHeader));
+
+        if (PublicsData && PublicsHeader.SymHash <= PublicsSize - sizeof(PublicsStreamHeader))
+            Publics.Load(Msf, Header.PublicStreamIndex, sizeof(PublicsStreamHeader), PublicsHeader.SymHash);
+    }
+
+    if (Header.GlobalStreamIndex != NilStreamIndex)
+        Globals.Load(Msf, Header.GlobalStreamIndex, 0, Msf.GetStreamSize(Header.GlobalStreamIndex));
+
+    if (!Publics.IsLoaded() && !Globals.IsLoaded())
+        return Fail("PDB has no publics or globals hash table");
+
+    uint64_t DbgHeaderOffset = GetDbiDebugHeaderOffset(Header);
+    uint32_t DbgStreams[DbgStreamCount];
+
+    std::fill(std::begin(DbgStreams), std::end(DbgStreams), NilStreamIndex);
+
+    uint32_t NumDbgStreams = std::min<uint32_t>(static_cast<uint32_t>(Header.OptionalDbgHeaderSize) / sizeof(uint16_t), DbgStreamCount);
+    const uint8_t* DbgHeader = DbgHeaderOffset <= UINT32_MAX ?
+        Msf.ReadStream(PdbDbiStream, static_cast<uint32_t>(DbgHeaderOffset), NumDbgStreams * sizeof(uint16_t), Scratch) : nullptr;
+
+    if (!DbgHeader)
+        return Fail("Corrupted DBI optional debug header");
+
+    for (uint32_t i = 0; i < NumDbgStreams; i++)
+        DbgStreams[i] = LoadValue<uint16_t>(DbgHeader + i * sizeof(uint16_t));
+
+    if (DbgStreams[DbgOmapFromSrc] != NilStreamIndex && DbgStreams[DbgSectionHdrOrig] != NilStreamIndex)
+        return LoadSections(DbgStreams[DbgSectionHdrOrig], DbgStreams[DbgOmapFromSrc]);
+
+    return LoadSections(DbgStreams[DbgSectionHdr], NilStreamIndex);
+}
+
+bool PdbFile::LoadSections(uint16_t HeaderStream, uint16_t OmapStream)
+{
+    std::vector<uint8_t> Scratch;
+    uint32_t Size = Msf.GetStreamSize(HeaderStream);
+    const uint8_t* Data = HeaderStream != NilStreamIndex ? Msf.ReadStream(HeaderStream, 0, Size, Scratch) : nullptr;
+
+    if (!Data || !Size)
+        return Fail("Missing section headers stream");
+
+    Sections.resize(Size / sizeof(PdbSectionHeader));
+    memcpy(Sections.data(), Data, Sections.size() * sizeof(PdbSectionHeader));
+
+    if (OmapStream == NilStreamIndex)
+        return true;
+
+    Size = Msf.GetStreamSize(OmapStream);
+    Data = Msf.ReadStream(OmapStream, 0, Size, Scratch);
+
+    if (!Data)
+        return Fail("Corrupted OMAP stream");
+
+    OmapFromSrc.resize(Size / sizeof(PdbOmapEntry));
+    memcpy(OmapFromSrc.data(), Data, OmapFromSrc.size() * sizeof(PdbOmapEntry));
+
+    return true;
+}
+
+bool PdbFile::SectionOffsetToRva(uint16_t Section, uint32_t Offset, uint32_t& Rva) const
+{
+    if (!Section || Section > Sections.size())
+        return false;
+
+    Rva = Sections[Section - 1].VirtualAddress + Offset;
+
+    if (OmapFromSrc.empty())
+        return true;
+
+    auto It = std::upper_bound(OmapFromSrc.begin(), OmapFromSrc.end(), Rva,
+        [](uint32_t Value, const PdbOmapEntry& Entry) { return Value < Entry.From; });
+
+    if (It == OmapFromSrc.begin() || !(It - 1)->To)
+        return false;
+
+    --It;
+    Rva = It->To + (Rva - It->From);
+
+    return true;
+}
+
+std::vector<PdbSectionContribution> PdbFile::GetSectionContributions() const
+{
+    std::vector<PdbSectionContribution> Contributions;
+    std::vector<uint8_t> Scratch;
+    uint64_t Offset = static_cast<uint64_t>(ModInfoOffset) + ModInfoSize;
+
+    if (SectionContribSize < sizeof(uint32_t) || Offset + SectionContribSize > UINT32_MAX)
+        return Contributions;
+
+    const uint8_t* Data = Msf.ReadStream(PdbDbiStream, static_cast<uint32_t>(Offset), SectionContribSize, Scratch);
+
+    if (!Data)
+        return Contributions;
+
+    uint32_t Version = LoadValue<uint32_t>(Data);
+    uint32_t EntrySize = Version == SectionContribV2 ? sizeof(SectionContribEntry) + sizeof(uint32_t) : sizeof(SectionContribEntry);
+
+    if (Version != SectionContribVer60 && Version != SectionContribV2)
+        return Contributions;
+
+    for (uint32_t Cursor = sizeof(uint32_t); Cursor + EntrySize <= SectionContribSize; Cursor += EntrySize)
+    {
+        SectionContribEntry Entry;
+        uint32_t Rva;
+
+        memcpy(&Entry, Data + Cursor, sizeof(Entry));
+
+        if (Entry.Size > 0 && Entry.Offset >= 0 && SectionOffsetToRva(Entry.Section, static_cast<uint32_t>(Entry.Offset), Rva))
+            Contributions.push_back({ Rva, static_cast<uint32_t>(Entry.Size), Entry.ModuleIndex });
+    }
+
+    std::sort(Contributions.begin(), Contributions.end(), [](const PdbSectionContribution& Left, const PdbSectionContribution& Right)
+    {
+        return Left.Rva < Right.Rva;
+    });
+
+    return Contributions;
+}
+
+bool PdbFile::FindSymbol(const std::string& Name, PdbSymbol& Symbol) const
+{
+    if (FindInTable(Publics, Name, Symbol) || FindInTable(Globals, Name, Symbol))
+        return true;
+
+    if (Machine == MachineI386)
+        return FindInTable(Publics, "_" + Name, Symbol);
+
+    return false;
+}
+
+bool PdbFile::FindInTable(const GsiHashTable& Table, const std::string& Name, PdbSymbol& Symbol) const
+{
+    if (!Table.IsLoaded())
+        return false;
+
+    std::vector<uint8_t> Scratch;
+
+    return Table.ForEachCandidate(Name, [&](uint32_t RecordOffset)
+    {
+        const uint8_t* Header = Msf.ReadStream(SymRecordStream, RecordOffset, 4, Scratch);
+
+        if (!Header)
+            return false;
+
+        uint16_t Length = LoadValue<uint16_t>(Header);
+        uint16_t Kind = LoadValue<uint16_t>(Header + 2);
+
+        if (Length < 2)
+            return false;
+
+        const uint8_t* Record = Msf.ReadStream(SymRecordStream, RecordOffset + 4, Length - 2, Scratch);
+        uint16_t RecordLength = Length - 2;
+
+        if (!Record || RecordLength < 10 + Name.size() || memcmp(Record + 10, Name.data(), Name.size()) != 0 ||
+            (RecordLength > 10 + Name.size() && Record[10 + Name.size()] != '\0'))
+            return false;
+
+        return DecodeSymbolRecord(Record, RecordLength, Kind, Symbol);
+    });
+}
+
+void PdbFile::EnumerateSymbols(const std::function<void(const PdbSymbol&)>& Callback) const
+{
+    EnumerateSymbols(0, Msf.GetStreamSize(SymRecordStream), Callback);
+}
+
+void PdbFile::EnumerateSymbols(uint32_t Begin, uint32_t End, const std::function<void(const PdbSymbol&)>& Callback) const
+{
+    std::vector<uint8_t> Scratch;
+    PdbSymbol Symbol;
+
+    End = std::min(End, Msf.GetStreamSize(SymRecordStream));
+
+    for (uint32_t Offset = Begin; Offset + 4 <= End;)
+    {
+        const uint8_t* Header = Msf.ReadStream(SymRecordStream, Offset, 4, Scratch);
+
+        if (!Header)
+            break;
+
+        uint16_t Length = LoadValue<uint16_t>(Header);
+        uint16_t Kind = LoadValue<uint16_t>(Header + 2);
+
+        if (Length < 2)
+            break;
+
+        const uint8_t* Record = Msf.ReadStream(SymRecordStream, Offset + 4, Length - 2, Scratch);
+
+        if (!Record)
+            break;
+
+        if (DecodeSymbolRecord(Record, Length - 2, Kind, Symbol))
+            Callback(Symbol);
+
+        Offset += Length + 2;
+    }
+}
+
+std::vector<uint32_t> PdbFile::SplitSymbolRecords(uint32_t NumChunks) const
+{
+    std::vector<uint8_t> Scratch;
+    uint32_t StreamSize = Msf.GetStreamSize(SymRecordStream);
+    uint64_t ChunkSize = std::max<uint64_t>(StreamSize / std::max(NumChunks, 1u), 1);
+    std::vector<uint32_t> Boundaries = { 0 };
+    uint32_t Offset = 0;
+
+    while (Offset + 4 <= StreamSize)
+    {
+        const uint8_t* Header = Msf.ReadStream(SymRecordStream, Offset, 2, Scratch);
+        uint16_t Length = Header ? LoadValue<uint16_t>(Header) : 0;
+
+        // A broken record ends the enumeration there anyway.
+        if (Length < 2)
+            break;
+
+        Offset += Length + 2;
+
+        if (Offset - Boundaries.back() >= ChunkSize && Offset < StreamSize)
+            Boundaries.push_back(Offset);
+    }
+
+    Boundaries.push_back(StreamSize);
+
+    return Boundaries;
+}
+
+uint32_t PdbFile::InferSymbolSize(uint16_t Section, uint32_t Offset, uint32_t Rva, uint32_t NextRva, const std::vector<PdbSectionContribution>& Contributions) const
+{
+    uint32_t Size = 0;
+
+    if (NextRva)
+        Size = NextRva - Rva;
+    else if (Section && Section <= Sections.size() && Offset < Sections[Section - 1].VirtualSize)
+        Size = Sections[Section - 1].VirtualSize - Offset;
+
+    // Alignment padding and code of modules without symbols of their own do not belong to the previous symbol.
+    auto Contribution = std::upper_bound(Contributions.begin(), Contributions.end(), Rva,
+        [](uint32_t Value, const PdbSectionContribution& Entry) { return Value < Entry.Rva; });
+
+    if (Contribution == Contributions.begin())
+        return Size;
+
+    --Contribution;
+
+    if (Rva - Contribution->Rva < Contribution->Size)
+        Size = std::min(Size, Contribution->Rva + Contribution->Size - Rva);
+
+    return Size;
+}
+
+bool PdbFile::DecodeSymbolRecord(const uint8_t* Record, uint16_t Length, uint16_t Kind, PdbSymbol& Symbol) const
+{
+    if (Kind != S_PUB32 && Kind != S_GDATA32 && Kind != S_LDATA32 && Kind != S_PROCREF && Kind != S_LPROCREF)
+        return false;
+
+    if (Length < 10)
+        return false;
+
+    const char* Name = reinterpret_cast<const char*>(Record + 10);
+
+    Symbol.Name.assign(Name, strnlen(Name, Length - 10));
+    Symbol.Kind = Kind;
+    Symbol.Size = 0;
+
+    if (Kind == S_PROCREF || Kind == S_LPROCREF)
+        return ResolveProcRef(LoadValue<uint16_t>(Record + 8), LoadValue<uint32_t>(Record + 4), Symbol);
+
+    Symbol.Offset = LoadValue<uint32_t>(Record + 4);
+    Symbol.Section = LoadValue<uint16_t>(Record + 8);
+
+    return SectionOffsetToRva(Symbol.Section, Symbol.Offset, Symbol.Rva);
+}
+
+void PdbFile::LoadModules() const
+{
+    std::vector<uint8_t> Scratch;
+    const uint8_t* Data = Msf.ReadStream(PdbDbiStream, ModInfoOffset, ModInfoSize, Scratch);
+
+    if (!Data)
+        return;
+
+    for (uint32_t Offset = 0; Offset + ModInfoHeaderSize <= ModInfoSize;)
+    {
+        // Module symbol stream, then the sizes of its symbol, C11 and C13 line sections.
+        Modules.push_back({ LoadValue<uint16_t>(Data + Offset + 34), LoadValue<uint32_t>(Data + Offset + 36),
+            LoadValue<uint32_t>(Data + Offset + 40), LoadValue<uint32_t>(Data + Offset + 44) });
+
+        uint32_t Cursor = Offset + ModInfoHeaderSize;
+
+        for (int i = 0; i < 2; i++)
+        {
+            while (Cursor < ModInfoSize && Data[Cursor])
+                Cursor++;
+
+            Cursor++;
+        }
+
+        Offset = (Cursor + 3) & ~3u;
+    }
+}
+
+const std::vector<PdbModule>& PdbFile::GetModules() const
+{
+    std::call_once(ModulesLoaded, [this]() { LoadModules(); });
+
+    return Modules;
+}
+
+uint32_t PdbFile::FindNamedStream(std::string_view Name) const
+{
+    std::vector<uint8_t> Scratch;
+    uint32_t Size = Msf.GetStreamSize(PdbInfoStream);
+    const uint8_t* Data = Size >= 32 && Size != MsfFile::NilStreamSize ? Msf.ReadStream(PdbInfoStream, 0, Size, Scratch) : nullptr;
+
+    if (!Data)
+        return NilStreamIndex;
+
+    // After version, signature, age and GUID: the name buffer, then a hash table of (name offset, stream) pairs
+    // whose used buckets are given by a present bit vector (a deleted bit vector follows it).
+    uint32_t NamesSize = LoadValue<uint32_t>(Data + 28);
+    uint64_t Cursor = 32ull + NamesSize;
+
+    if (Cursor + 12 > Size)
+        return NilStreamIndex;
+
+    const char* Names = reinterpret_cast<const char*>(Data + 32);
+    uint32_t Capacity = LoadValue<uint32_t>(Data + Cursor + 4);
+    uint32_t PresentWords = LoadValue<uint32_t>(Data + Cursor + 8);
+    const uint8_t* Present = Data + Cursor + 12;
+
+    Cursor += 12 + static_cast<uint64_t>(PresentWords) * 4;
+
+    if (Cursor + 4 > Size)
+        return NilStreamIndex;
+
+    Cursor += 4 + static_cast<uint64_t>(LoadValue<uint32_t>(Data + Cursor)) * 4;
+
+    for (uint32_t Bucket = 0; Bucket < Capacity && Bucket / 32 < PresentWords; Bucket++)
+    {
+        if (!(LoadValue<uint32_t>(Present + Bucket / 32 * 4) & (1u << (Bucket % 32))))
+            continue;
+
+        if (Cursor + 8 > Size)
+            return NilStreamIndex;
+
+        uint32_t NameOffset = LoadValue<uint32_t>(Data + Cursor);
+        uint32_t Stream = LoadValue<uint32_t>(Data + Cursor + 4);
+
+        Cursor += 8;
+
+        if (NameOffset < NamesSize && std::string_view(Names + NameOffset, strnlen(Names + NameOffset, NamesSize - NameOffset)) == Name)
+            return Stream;
+    }
+
+    return NilStreamIndex;
+}
+
+bool PdbFile::ResolveProcRef(uint16_t Module, uint32_t SymOffset, PdbSymbol& Symbol) const
+{
+    const std::vector<PdbModule>& Loaded = GetModules();
+
+    if (!Module || Module > Loaded.size())
+        return false;
+
+    std::vector<uint8_t> Scratch;
+    uint16_t Stream = Loaded[Module - 1].SymStream;
+    const uint8_t* Header = Msf.ReadStream(Stream, SymOffset, 4, Scratch);
+
+    if (!Header)
+        return false;
+
+    uint16_t Length = LoadValue<uint16_t>(Header);
+    uint16_t Kind = LoadValue<uint16_t>(Header + 2);
+
+    if ((Kind != S_GPROC32 && Kind != S_LPROC32 && Kind != S_GPROC32_ID && Kind != S_LPROC32_ID) || Length < 36)
+        return false;
+
+    const uint8_t* Record = Msf.ReadStream(Stream, SymOffset + 4, 34, Scratch);
+
+    if (!Record)
+        return false;
+
+    Symbol.Size = LoadValue<uint32_t>(Record + 12);
+    Symbol.Offset = LoadValue<uint32_t>(Record + 28);
+    Symbol.Section = LoadValue<uint16_t>(Record + 32);
+
+    return SectionOffsetToRva(Symbol.Section, Symbol.Offset, Symbol.Rva);
+}
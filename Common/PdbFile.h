@@ -0,0 +1,165 @@
+#pragma once
+
+#include "MsfFile.h"
+#include "CodeView.h"
+
+#include <mutex>
+#include <functional>
+#include <string_view>
+
+struct PdbSymbol
+{
+    std::string Name;
+    uint16_t Kind = 0;
+    uint16_t Section = 0;
+    uint32_t Offset = 0;
+    uint32_t Rva = 0;
+    uint32_t Size = 0;
+};
+
+struct PdbSectionHeader
+{
+    char Name[8];
+    uint32_t VirtualSize;
+    uint32_t VirtualAddress;
+    uint32_t SizeOfRawData;
+    uint32_t PointerToRawData;
+    uint32_t PointerToRelocations;
+    uint32_t PointerToLinenumbers;
+    uint16_t NumberOfRelocations;
+    uint16_t NumberOfLinenumbers;
+    uint32_t Characteristics;
+};
+
+// One contiguous piece of a section contributed by a single module (object file).
+struct PdbSectionContribution
+{
+    uint32_t Rva;
+    uint32_t Size;
+    uint16_t Module;
+};
+
+// Where a module's (object file's) records live in its stream: symbols first (including the 4-byte signature), then
+// C11 and C13 line information.
+struct PdbModule
+{
+    uint16_t SymStream;
+    uint32_t SymSize;
+    uint32_t C11Size;
+    uint32_t C13Size;
+};
+
+struct PdbOmapEntry
+{
+    uint32_t From;
+    uint32_t To;
+};
+
+// Name -> symbol record lookup through the on-disk GSI hash of the publics/globals streams. Only the bucket table is
+// kept in memory; on paged PDBs the hash records of a bucket are read through the page cache on lookup.
+class GsiHashTable
+{
+public:
+    static constexpr uint32_t NumHashBuckets = 4096;
+
+    bool Load(const MsfFile& Msf, uint32_t Stream, uint32_t Offset, uint32_t Size);
+    bool IsLoaded() const { return !BucketStart.empty(); }
+
+    template <typename Callback>
+    bool ForEachCandidate(const std::string& Name, Callback&& Fn) const
+    {
+        uint32_t Bucket = HashName(Name) % NumHashBuckets;
+        uint32_t Begin = BucketStart[Bucket];
+        uint32_t Count = BucketStart[Bucket + 1] - Begin;
+        std::vector<uint8_t> Scratch;
+        const uint8_t* BucketRecords = Records ? Records + Begin * 8 : Msf->ReadStream(Stream, RecordsOffset + Begin * 8, Count * 8, Scratch);
+
+        if (!BucketRecords)
+            return false;
+
+        for (uint32_t i = 0; i < Count; i++)
+        {
+            if (Fn(LoadValue<uint32_t>(BucketRecords + i * 8) - 1))
+                return true;
+        }
+
+        return false;
+    }
+
+    static uint32_t HashName(const std::string& Name);
+
+private:
+    // Null on paged PDBs, the records are read from Msf at RecordsOffset of Stream instead.
+    const uint8_t* Records = nullptr;
+    const MsfFile* Msf = nullptr;
+    uint32_t Stream = 0;
+    uint32_t RecordsOffset = 0;
+    std::vector<uint32_t> BucketStart;
+    std::vector<uint8_t> Storage;
+};
+
+class PdbFile
+{
+public:
+    bool Open(const std::filesystem::path& Path);
+
+    // GUID and age from the PDB info stream, without loading anything else.
+    static bool ReadIdentity(const std::filesystem::path& Path, PdbGuid& Guid, uint32_t& Age);
+
+    const PdbGuid& GetGuid() const { return Guid; }
+    uint32_t GetAge() const { return Age; }
+    uint16_t GetMachine() const { return Machine; }
+
+    bool FindSymbol(const std::string& Name, PdbSymbol& Symbol) const;
+    void EnumerateSymbols(const std::function<void(const PdbSymbol&)>& Callback) const;
+    // Symbols of the records in [Begin, End) of the symbol record stream; both have to be record boundaries.
+    void EnumerateSymbols(uint32_t Begin, uint32_t End, const std::function<void(const PdbSymbol&)>& Callback) const;
+    // About NumChunks record-aligned ranges of equal size for parallel enumeration: ascending boundaries from 0 to the
+    // stream size. Only the record lengths are read.
+    std::vector<uint32_t> SplitSymbolRecords(uint32_t NumChunks) const;
+    // Size of a symbol that has none of its own: up to the next symbol start in its section (NextRva, 0 if there is
+    // none) or the end of the section, but not past the module contribution it starts in.
+    uint32_t InferSymbolSize(uint16_t Section, uint32_t Offset, uint32_t Rva, uint32_t NextRva, const std::vector<PdbSectionContribution>& Contributions) const;
+    bool SectionOffsetToRva(uint16_t Section, uint32_t Offset, uint32_t& Rva) const;
+    // Sorted by RVA; empty when the DBI stream has no contribution substream.
+    std::vector<PdbSectionContribution> GetSectionContributions() const;
+
+    // DBI module list, read on first use; section contribution module indices are 0-based into it.
+    const std::vector<PdbModule>& GetModules() const;
+    // Stream index of a named stream ("/names", "/LinkInfo", ...) from the PDB info stream, NilStreamIndex if absent.
+    uint32_t FindNamedStream(std::string_view Name) const;
+
+    const std::vector<PdbSectionHeader>& GetSections() const { return Sections; }
+
+    const MsfFile& GetMsf() const { return Msf; }
+    const std::string& GetError() const { return Error; }
+
+private:
+    bool Fail(const std::string& Message);
+    bool LoadDbi();
+    bool LoadSections(uint16_t HeaderStream, uint16_t OmapStream);
+    bool FindInTable(const GsiHashTable& Table, const std::string& Name, PdbSymbol& Symbol) const;
+    bool DecodeSymbolRecord(const uint8_t* Record, uint16_t Length, uint16_t Kind, PdbSymbol& Symbol) const;
+    bool ResolveProcRef(uint16_t Module, uint32_t SymOffset, PdbSymbol& Symbol) const;
+    void LoadModules() const;
+
+    MsfFile Msf;
+    PdbGuid Guid = {};
+    uint32_t Age = 0;
+    uint16_t Machine = 0;
+    uint16_t SymRecordStream = 0xFFFF;
+    uint32_t ModInfoOffset = 0;
+    uint32_t ModInfoSize = 0;
+    uint32_t SectionContribSize = 0;
+
+    GsiHashTable Publics;
+    GsiHashTable Globals;
+
+    std::vector<PdbSectionHeader> Sections;
+    std::vector<PdbOmapEntry> OmapFromSrc;
+
+    mutable std::once_flag ModulesLoaded;
+    mutable std::vector<PdbModule> Modules;
+
+    std::string Error;
+};
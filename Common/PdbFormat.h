@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk structures of the MSF container and the fixed PDB streams.
+
+inline constexpr char MsfMagic[] = "Microsoft C/C++ MSF 7.00\r\n\x1A" "DS\0\0";
+
+struct MsfSuperBlock
+{
+    char FileMagic[32];
+    uint32_t BlockSize;
+    uint32_t FreeBlockMapBlock;
+    uint32_t NumBlocks;
+    uint32_t NumDirectoryBytes;
+    uint32_t Unknown;
+    uint32_t BlockMapAddr;
+};
+
+enum PdbFixedStream : uint32_t
+{
+    PdbInfoStream = 1,
+    PdbTpiStream = 2,
+    PdbDbiStream = 3,
+    PdbIpiStream = 4,
+};
+
+enum DbiDebugStream : uint32_t
+{
+    DbgFpo = 0,
+    DbgException = 1,
+    DbgFixup = 2,
+    DbgOmapToSrc = 3,
+    DbgOmapFromSrc = 4,
+    DbgSectionHdr = 5,
+    DbgTokenRidMap = 6,
+    DbgXdata = 7,
+    DbgPdata = 8,
+    DbgNewFpo = 9,
+    DbgSectionHdrOrig = 10,
+    DbgStreamCount = 11,
+};
+
+struct DbiStreamHeader
+{
+    int32_t VersionSignature;
+    uint32_t VersionHeader;
+    uint32_t Age;
+    uint16_t GlobalStreamIndex;
+    uint16_t BuildNumber;
+    uint16_t PublicStreamIndex;
+    uint16_t PdbDllVersion;
+    uint16_t SymRecordStream;
+    uint16_t PdbDllRbld;
+    int32_t ModInfoSize;
+    int32_t SectionContributionSize;
+    int32_t SectionMapSize;
+    int32_t SourceInfoSize;
+    int32_t TypeServerMapSize;
+    uint32_t MFCTypeServerIndex;
+    int32_t OptionalDbgHeaderSize;
+    int32_t ECSubstreamSize;
+    uint16_t Flags;
+    uint16_t Machine;
+    uint32_t Padding;
+};
+
+struct TpiStreamHeader
+{
+    uint32_t Version;
+    uint32_t HeaderSize;
+    uint32_t TypeIndexBegin;
+    uint32_t TypeIndexEnd;
+    uint32_t TypeRecordBytes;
+    uint16_t HashStreamIndex;
+    uint16_t HashAuxStreamIndex;
+    uint32_t HashKeySize;
+    uint32_t NumHashBuckets;
+    int32_t HashValueBufferOffset;
+    uint32_t HashValueBufferLength;
+    int32_t IndexOffsetBufferOffset;
+    uint32_t IndexOffsetBufferLength;
+    int32_t HashAdjBufferOffset;
+    uint32_t HashAdjBufferLength;
+};
+
+struct PublicsStreamHeader
+{
+    uint32_t SymHash;
+    uint32_t AddrMap;
+    uint32_t NumThunks;
+    uint32_t SizeOfThunk;
+    uint16_t ISectThunkTable;
+    uint16_t Padding;
+    uint32_t OffThunkTable;
+    uint32_t NumSections;
+};
+
+struct GsiHashHeader
+{
+    uint32_t VerSignature;
+    uint32_t VerHdr;
+    uint32_t HrSize;
+    uint32_t NumBuckets;
+};
+
+inline constexpr uint32_t GsiHashSignature = 0xFFFFFFFF;
+inline constexpr uint32_t GsiHashVersion = 0xEFFE0000 + 19990810;
+inline constexpr uint32_t GsiHashRecordSize = 8;
+// Bucket offsets are stored as if hash records were 12 bytes (their in-memory size in the MS implementation).
+inline constexpr uint32_t GsiBucketOffsetScale = 12;
+
+inline constexpr uint16_t NilStreamIndex = 0xFFFF;
+
+// DBI section contribution substream: a version word followed by fixed-size entries; V2 appends the COFF section index.
+inline constexpr uint32_t SectionContribVer60 = 0xEFFE0000 + 19970605;
+inline constexpr uint32_t SectionContribV2 = 0xEFFE0000 + 20140516;
+
+struct SectionContribEntry
+{
+    uint16_t Section;
+    uint16_t Padding1;
+    int32_t Offset;
+    int32_t Size;
+    uint32_t Characteristics;
+    uint16_t ModuleIndex;
+    uint16_t Padding2;
+    uint32_t DataCrc;
+    uint32_t RelocCrc;
+};
+
+// "/names" stream: a header and then a buffer of NUL-terminated strings referenced by byte offset.
+inline constexpr uint32_t PdbStringTableSignature = 0xEFFEEFFE;
+
+struct PdbStringTableHeader
+{
+    uint32_t Signature;
+    uint32_t HashVersion;
+    uint32_t ByteSize;
+};
+
+inline uint64_t GetDbiDebugHeaderOffset(const DbiStreamHeader& Header)
+{
+    return static_cast<uint64_t>(sizeof(DbiStreamHeader)) + static_cast<uint32_t>(Header.ModInfoSize) +
+        static_cast<uint32_t>(Header.SectionContributionSize) + static_cast<uint32_t>(Header.SectionMapSize) +
+        static_cast<uint32_t>(Header.SourceInfoSize) + static_cast<uint32_t>(Header.TypeServerMapSize) +
+        static_cast<uint32_t>(Header.ECSubstreamSize);
+}
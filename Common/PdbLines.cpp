@@ -0,0 +1,193 @@
+#include "PdbLines.h"
+#include "PdbFormat.h"
+#include "Stats.h"
+
+#include <algorithm>
+
+bool PdbLines::Open(const PdbFile& File)
+{
+    const MsfFile& Msf = File.GetMsf();
+    uint32_t NamesStream = File.FindNamedStream("/names");
+    uint32_t StreamSize = NamesStream != NilStreamIndex ? Msf.GetStreamSize(NamesStream) : 0;
+    const uint8_t* Data = StreamSize >= sizeof(PdbStringTableHeader) && StreamSize != MsfFile::NilStreamSize ?
+        Msf.ReadStream(NamesStream, 0, StreamSize, NamesScratch) : nullptr;
+    PdbStringTableHeader Header;
+
+    if (!Data)
+        return false;
+
+    memcpy(&Header, Data, sizeof(Header));
+
+    if (Header.Signature != PdbStringTableSignature || Header.ByteSize > StreamSize - sizeof(Header))
+        return false;
+
+    Contributions = File.GetSectionContributions();
+    NumModules = static_cast<uint32_t>(File.GetModules().size());
+
+    if (Contributions.empty() || !NumModules)
+        return false;
+
+    Names = reinterpret_cast<const char*>(Data + sizeof(Header));
+    NamesSize = Header.ByteSize;
+    Modules = std::make_unique<ModuleLines[]>(NumModules);
+    Pdb = &File;
+
+    return true;
+}
+
+std::string_view PdbLines::GetFileName(uint32_t NameOffset) const
+{
+    if (NameOffset >= NamesSize)
+        return {};
+
+    return std::string_view(Names + NameOffset, strnlen(Names + NameOffset, NamesSize - NameOffset));
+}
+
+const std::vector<PdbLines::LineEntry>& PdbLines::GetModuleLines(uint16_t Module) const
+{
+    ModuleLines& Lines = Modules[Module];
+
+    std::call_once(Lines.Decoded, [&]()
+    {
+        DecodeModule(Module, Lines.Entries);
+        NumDecoded.fetch_add(1, std::memory_order_relaxed);
+    });
+
+    return Lines.Entries;
+}
+
+void PdbLines::DecodeModule(uint16_t Module, std::vector<LineEntry>& Entries) const
+{
+    ScopedTimer Timer("Line table decode");
+    const PdbModule& Info = Pdb->GetModules()[Module];
+    const MsfFile& Msf = Pdb->GetMsf();
+    uint64_t Start = static_cast<uint64_t>(Info.SymSize) + Info.C11Size;
+    std::vector<uint8_t> Scratch;
+
+    if (Info.SymStream == NilStreamIndex || !Info.C13Size || Start + Info.C13Size > Msf.GetStreamSize(Info.SymStream))
+        return;
+
+    const uint8_t* Data = Msf.ReadStream(Info.SymStream, static_cast<uint32_t>(Start), Info.C13Size, Scratch);
+    uint32_t Size = Info.C13Size;
+
+    if (!Data)
+        return;
+
+    // Line blocks name their file by the offset of its entry in the checksums subsection, which may come later.
+    const uint8_t* Checksums = nullptr;
+    uint32_t ChecksumsSize = 0;
+
+    for (uint32_t Cursor = 0; Cursor + 8 <= Size;)
+    {
+        uint32_t Kind = LoadValue<uint32_t>(Data + Cursor);
+        uint32_t Length = LoadValue<uint32_t>(Data + Cursor + 4);
+
+        if (Length > Size - Cursor - 8)
+            break;
+
+        if (Kind == DEBUG_S_FILECHKSMS)
+        {
+            Checksums = Data + Cursor + 8;
+            ChecksumsSize = Length;
+        }
+
+        Cursor += 8 + ((Length + 3) & ~3u);
+    }
+
+    for (uint32_t Cursor = 0; Cursor + 8 <= Size;)
+    {
+        uint32_t Kind = LoadValue<uint32_t>(Data + Cursor);
+        uint32_t Length = LoadValue<uint32_t>(Data + Cursor + 4);
+        const uint8_t* Lines = Data + Cursor + 8;
+        uint32_t Rva;
+
+        if (Length > Size - Cursor - 8)
+            break;
+
+        Cursor += 8 + ((Length + 3) & ~3u);
+
+        // Header: offset, section, flags and code size of the covered range.
+        if (Kind != DEBUG_S_LINES || Length < 12 || !Pdb->SectionOffsetToRva(LoadValue<uint16_t>(Lines + 4), LoadValue<uint32_t>(Lines), Rva))
+            continue;
+
+        uint32_t LineStride = (LoadValue<uint16_t>(Lines + 6) & CV_LINES_HAVE_COLUMNS) ? 12 : 8;
+
+        // Blocks: file checksum offset, line count and block size, then (offset, line flags) pairs and optional columns.
+        for (uint32_t Block = 12; Block + 12 <= Length;)
+        {
+            uint32_t FileEntry = LoadValue<uint32_t>(Lines + Block);
+            uint32_t NumLines = LoadValue<uint32_t>(Lines + Block + 4);
+            uint32_t BlockSize = LoadValue<uint32_t>(Lines + Block + 8);
+
+            if (BlockSize < 12 || BlockSize > Length - Block || (BlockSize - 12) / LineStride < NumLines)
+                break;
+
+            // A checksum entry starts with the file's offset in the string table.
+            uint32_t File = Checksums && ChecksumsSize >= 4 && FileEntry <= ChecksumsSize - 4 ? LoadValue<uint32_t>(Checksums + FileEntry) : UINT32_MAX;
+
+            for (uint32_t i = 0; i < NumLines; i++)
+            {
+                const uint8_t* Line = Lines + Block + 12 + i * 8;
+                uint32_t Number = LoadValue<uint32_t>(Line + 4) & 0xFFFFFF;
+
+                if (Number == CV_LINE_HIDDEN_1 || Number == CV_LINE_HIDDEN_2)
+                    Number = 0;
+
+                Entries.push_back({ Rva + LoadValue<uint32_t>(Line), Number, File });
+            }
+
+            Block += BlockSize;
+        }
+
+        Entries.push_back({ Rva + LoadValue<uint32_t>(Lines + 8), 0, UINT32_MAX });
+    }
+
+    // At equal addresses the end of one range sorts before the first line of the next.
+    std::sort(Entries.begin(), Entries.end(), [](const LineEntry& Left, const LineEntry& Right)
+    {
+        return Left.Rva != Right.Rva ? Left.Rva < Right.Rva : (Left.Line != 0) < (Right.Line != 0);
+    });
+
+    Entries.shrink_to_fit();
+}
+
+void PdbLines::FindLines(const uint32_t* Rvas, size_t Count, PdbSourceLine* Lines) const
+{
+    const PdbSectionContribution* Contribution = nullptr;
+    const std::vector<LineEntry>* Table = nullptr;
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        uint32_t Rva = Rvas[i];
+
+        Lines[i] = {};
+
+        // Sorted or clustered batches mostly stay inside the contribution of the previous address.
+        if (!Contribution || Rva < Contribution->Rva || Rva - Contribution->Rva >= Contribution->Size)
+        {
+            auto It = std::upper_bound(Contributions.begin(), Contributions.end(), Rva,
+                [](uint32_t Value, const PdbSectionContribution& Entry) { return Value < Entry.Rva; });
+
+            if (It == Contributions.begin() || Rva - (It - 1)->Rva >= (It - 1)->Size)
+            {
+                Contribution = nullptr;
+
+                continue;
+            }
+
+            Contribution = &*(It - 1);
+            Table = Contribution->Module < NumModules ? &GetModuleLines(Contribution->Module) : nullptr;
+        }
+
+        if (!Table)
+            continue;
+
+        auto Entry = std::upper_bound(Table->begin(), Table->end(), Rva, [](uint32_t Value, const LineEntry& Line) { return Value < Line.Rva; });
+
+        if (Entry == Table->begin() || !(Entry - 1)->Line)
+            continue;
+
+        --Entry;
+        Lines[i] = { GetFileName(Entry->File), Entry->Line };
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "PdbFile.h"
+
+#include <atomic>
+#include <memory>
+
+struct PdbSourceLine
+{
+    // Points into the PDB's "/names" string table, valid while the PdbLines is open.
+    std::string_view File;
+    // 0 when no line record covers the address.
+    uint32_t Line = 0;
+};
+
+// RVA -> source file and line from the C13 DEBUG_S_LINES subsections of the module streams. The section
+// contributions tell which module covers an address; that module's line blocks are decoded the first time an address
+// lands in it and kept as one sorted (RVA, line, file) table, so modules no query touches are never read.
+class PdbLines
+{
+public:
+    bool Open(const PdbFile& File);
+    bool IsOpen() const { return Pdb != nullptr; }
+
+    // Thread-safe; each module is decoded once, whichever lookup gets there first.
+    void FindLines(const uint32_t* Rvas, size_t Count, PdbSourceLine* Lines) const;
+    uint32_t GetDecodedModules() const { return NumDecoded.load(std::memory_order_relaxed); }
+
+private:
+    // Line 0 marks the end of a line block (or code without a source line), so the gap after it has no line.
+    struct LineEntry
+    {
+        uint32_t Rva;
+        uint32_t Line;
+        uint32_t File;
+    };
+
+    struct ModuleLines
+    {
+        std::once_flag Decoded;
+        std::vector<LineEntry> Entries;
+    };
+
+    const std::vector<LineEntry>& GetModuleLines(uint16_t Module) const;
+    void DecodeModule(uint16_t Module, std::vector<LineEntry>& Entries) const;
+    std::string_view GetFileName(uint32_t NameOffset) const;
+
+    const PdbFile* Pdb = nullptr;
+    std::vector<PdbSectionContribution> Contributions;
+    std::unique_ptr<ModuleLines[]> Modules;
+    uint32_t NumModules = 0;
+
+    std::vector<uint8_t> NamesScratch;
+    const char* Names = nullptr;
+    uint32_t NamesSize = 0;
+
+    mutable std::atomic<uint32_t> NumDecoded{ 0 };
+};
@@ -0,0 +1,683 @@
+#include "PdbPrefetch.h"
+#include "CodeView.h"
+#include "MsfFile.h"
+#include "PdbFormat.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Streams are read in runs of physically contiguous blocks of at most this size.
+static constexpr uint32_t MaxReadSize = 1 << 20;
+// Reads in flight at once, for either queue.
+static constexpr uint32_t QueueDepth = 64;
+static constexpr uint32_t PoolThreads = 16;
+
+struct PdbPrefetcher::Read
+{
+    uint32_t Target = 0;
+    const ReadOnlyFile* File = nullptr;
+    uint64_t Offset = 0;
+    uint32_t Size = 0;
+    uint32_t Completed = 0;
+    // Into the target for the steps that parse what they read, a pooled buffer for pages that are only warmed.
+    uint8_t* Out = nullptr;
+    std::unique_ptr<uint8_t[]> Buffer;
+    bool bFailed = false;
+};
+
+enum class PrefetchStep
+{
+    Super,
+    BlockMap,
+    Directory,
+    DbiHeader,
+    Streams,
+    Sections,
+    Done,
+};
+
+struct PdbPrefetcher::Target
+{
+    uint32_t Index = 0;
+    ReadOnlyFile File;
+    PrefetchStep Step = PrefetchStep::Super;
+    uint32_t Pending = 0;
+    bool bFailed = false;
+    // Guarded by ReadyLock.
+    bool bReady = false;
+
+    MsfSuperBlock Super = {};
+    uint32_t NumBlocks = 0;
+    std::vector<uint32_t> BlockMap;
+    std::vector<uint8_t> Directory;
+    std::vector<uint32_t> StreamSizes;
+    // Offset of every stream's block list in Directory.
+    std::vector<size_t> StreamBlocks;
+    DbiStreamHeader Dbi = {};
+    uint16_t DbgStreams[DbgStreamCount] = {};
+};
+
+// Reads started together go out together: Start only queues, Reap hands everything queued to the OS before waiting.
+class PdbPrefetcher::ReadQueue
+{
+public:
+    virtual ~ReadQueue() = default;
+
+    bool HasRoom() const { return InFlight < QueueDepth; }
+    bool IsIdle() const { return InFlight == 0; }
+
+    virtual void Start(std::unique_ptr<Read> Item) = 0;
+    // Waits until at least one started read has finished and returns all that have. False if the queue broke down.
+    virtual bool Reap(std::vector<std::unique_ptr<Read>>& Done) = 0;
+
+protected:
+    uint32_t InFlight = 0;
+};
+
+class ThreadReadQueue : public PdbPrefetcher::ReadQueue
+{
+public:
+    ThreadReadQueue()
+    {
+        for (uint32_t i = 0; i < PoolThreads; i++)
+            Threads.emplace_back([this]() { ThreadMain(); });
+    }
+
+    ~ThreadReadQueue() override
+    {
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+
+            bStopping = true;
+        }
+
+        Changed.notify_all();
+
+        for (std::thread& Thread : Threads)
+            Thread.join();
+    }
+
+    void Start(std::unique_ptr<PdbPrefetcher::Read> Item) override
+    {
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+
+            Queued.push_back(std::move(Item));
+        }
+
+        InFlight++;
+        Changed.notify_one();
+    }
+
+    bool Reap(std::vector<std::unique_ptr<PdbPrefetcher::Read>>& Done) override
+    {
+        std::unique_lock<std::mutex> Guard(Lock);
+
+        Finished.wait(Guard, [this]() { return !Completed.empty(); });
+
+        for (std::unique_ptr<PdbPrefetcher::Read>& Item : Completed)
+            Done.push_back(std::move(Item));
+
+        InFlight -= static_cast<uint32_t>(Completed.size());
+        Completed.clear();
+
+        return true;
+    }
+
+private:
+    void ThreadMain()
+    {
+        std::unique_lock<std::mutex> Guard(Lock);
+
+        while (true)
+        {
+            Changed.wait(Guard, [this]() { return bStopping || !Queued.empty(); });
+
+            if (Queued.empty())
+                return;
+
+            std::unique_ptr<PdbPrefetcher::Read> Item = std::move(Queued.front());
+
+            Queued.pop_front();
+            Guard.unlock();
+            Item->bFailed = !Item->File->ReadAt(Item->Offset, Item->Out, Item->Size);
+            Guard.lock();
+            Completed.push_back(std::move(Item));
+            Finished.notify_one();
+        }
+    }
+
+    std::mutex Lock;
+    std::condition_variable Changed;
+    std::condition_variable Finished;
+    std::deque<std::unique_ptr<PdbPrefetcher::Read>> Queued;
+    std::vector<std::unique_ptr<PdbPrefetcher::Read>> Completed;
+    std::vector<std::thread> Threads;
+    bool bStopping = false;
+};
+
+#ifdef __linux__
+// Bare io_uring through its system calls: one submission and one completion ring, plain reads at an offset.
+class UringReadQueue : public PdbPrefetcher::ReadQueue
+{
+public:
+    UringReadQueue() = default;
+    UringReadQueue(const UringReadQueue&) = delete;
+    UringReadQueue& operator=(const UringReadQueue&) = delete;
+
+    ~UringReadQueue() override
+    {
+        if (Ring >= 0)
+            close(Ring);
+
+        if (SqRing)
+            munmap(SqRing, SqRingSize);
+
+        if (CqRing && CqRing != SqRing)
+            munmap(CqRing, CqRingSize);
+
+        if (Sqes)
+            munmap(Sqes, SqesSize);
+    }
+
+    bool Open()
+    {
+        io_uring_params Params = {};
+
+        Ring = static_cast<int>(syscall(__NR_io_uring_setup, QueueDepth, &Params));
+
+        // IORING_OP_READ came with the same kernel (5.6) as this feature flag.
+        if (Ring < 0 || !(Params.features & IORING_FEAT_RW_CUR_POS))
+            return false;
+
+        SqRingSize = Params.sq_off.array + Params.sq_entries * sizeof(uint32_t);
+        CqRingSize = Params.cq_off.cqes + Params.cq_entries * sizeof(io_uring_cqe);
+
+        if (Params.features & IORING_FEAT_SINGLE_MMAP)
+            SqRingSize = CqRingSize = std::max(SqRingSize, CqRingSize);
+
+        SqRing = Map(SqRingSize, IORING_OFF_SQ_RING);
+        CqRing = (Params.features & IORING_FEAT_SINGLE_MMAP) ? SqRing : Map(CqRingSize, IORING_OFF_CQ_RING);
+        SqesSize = Params.sq_entries * sizeof(io_uring_sqe);
+        Sqes = static_cast<io_uring_sqe*>(Map(SqesSize, IORING_OFF_SQES));
+
+        if (!SqRing || !CqRing || !Sqes)
+            return false;
+
+        uint8_t* Sq = static_cast<uint8_t*>(SqRing);
+        uint8_t* Cq = static_cast<uint8_t*>(CqRing);
+
+        SqTail = reinterpret_cast<uint32_t*>(Sq + Params.sq_off.tail);
+        SqMask = *reinterpret_cast<uint32_t*>(Sq + Params.sq_off.ring_mask);
+        SqArray = reinterpret_cast<uint32_t*>(Sq + Params.sq_off.array);
+        CqHead = reinterpret_cast<uint32_t*>(Cq + Params.cq_off.head);
+        CqTail = reinterpret_cast<uint32_t*>(Cq + Params.cq_off.tail);
+        CqMask = *reinterpret_cast<uint32_t*>(Cq + Params.cq_off.ring_mask);
+        Cqes = reinterpret_cast<io_uring_cqe*>(Cq + Params.cq_off.cqes);
+
+        return true;
+    }
+
+    void Start(std::unique_ptr<PdbPrefetcher::Read> Item) override
+    {
+        InFlight++;
+        Push(Item.release());
+    }
+
+    bool Reap(std::vector<std::unique_ptr<PdbPrefetcher::Read>>& Done) override
+    {
+        while (true)
+        {
+            long Result = syscall(__NR_io_uring_enter, Ring, ToSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+            if (Result >= 0)
+            {
+                ToSubmit -= static_cast<uint32_t>(Result);
+
+                break;
+            }
+
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                return false;
+        }
+
+        uint32_t Head = *CqHead;
+        uint32_t Tail = __atomic_load_n(CqTail, __ATOMIC_ACQUIRE);
+
+        for (; Head != Tail; Head++)
+        {
+            const io_uring_cqe& Cqe = Cqes[Head & CqMask];
+            PdbPrefetcher::Read* Item = reinterpret_cast<PdbPrefetcher::Read*>(static_cast<uintptr_t>(Cqe.user_data));
+
+            // Reads can come back short; the rest goes out again.
+            if (Cqe.res > 0 && Item->Completed + static_cast<uint32_t>(Cqe.res) < Item->Size)
+            {
+                Item->Completed += static_cast<uint32_t>(Cqe.res);
+                Push(Item);
+
+                continue;
+            }
+
+            Item->bFailed = Cqe.res <= 0;
+            Started.erase(std::find(Started.begin(), Started.end(), Item));
+            Done.emplace_back(Item);
+            InFlight--;
+        }
+
+        __atomic_store_n(CqHead, Head, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+private:
+    void* Map(size_t Size, uint64_t Offset)
+    {
+        void* Memory = mmap(nullptr, Size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Ring, static_cast<off_t>(Offset));
+
+        return Memory == MAP_FAILED ? nullptr : Memory;
+    }
+
+    void Push(PdbPrefetcher::Read* Item)
+    {
+        uint32_t Tail = *SqTail;
+        uint32_t Slot = Tail & SqMask;
+        io_uring_sqe& Sqe = Sqes[Slot];
+
+        memset(&Sqe, 0, sizeof(Sqe));
+        Sqe.opcode = IORING_OP_READ;
+        Sqe.fd = Item->File->GetDescriptor();
+        Sqe.off = Item->Offset + Item->Completed;
+        Sqe.addr = reinterpret_cast<uintptr_t>(Item->Out + Item->Completed);
+        Sqe.len = Item->Size - Item->Completed;
+        Sqe.user_data = reinterpret_cast<uintptr_t>(Item);
+        SqArray[Slot] = Slot;
+        __atomic_store_n(SqTail, Tail + 1, __ATOMIC_RELEASE);
+        ToSubmit++;
+
+        if (std::find(Started.begin(), Started.end(), Item) == Started.end())
+            Started.push_back(Item);
+    }
+
+    int Ring = -1;
+    void* SqRing = nullptr;
+    void* CqRing = nullptr;
+    io_uring_sqe* Sqes = nullptr;
+    size_t SqRingSize = 0;
+    size_t CqRingSize = 0;
+    size_t SqesSize = 0;
+    uint32_t* SqTail = nullptr;
+    uint32_t SqMask = 0;
+    uint32_t* SqArray = nullptr;
+    uint32_t* CqHead = nullptr;
+    uint32_t* CqTail = nullptr;
+    uint32_t CqMask = 0;
+    io_uring_cqe* Cqes = nullptr;
+    uint32_t ToSubmit = 0;
+    // Owned while the kernel has them. Reads only stay behind if io_uring_enter failed outright; the kernel may still
+    // write to them then, so they are leaked rather than freed.
+    std::vector<PdbPrefetcher::Read*> Started;
+};
+#endif
+
+PdbPrefetcher::PdbPrefetcher(const std::vector<std::filesystem::path>& Paths, PrefetchBackend Backend)
+{
+#ifdef __linux__
+    if (Backend == PrefetchBackend::Auto)
+    {
+        auto Uring = std::make_unique<UringReadQueue>();
+
+        if (Uring->Open())
+        {
+            Queue = std::move(Uring);
+            BackendName = "io_uring";
+        }
+    }
+#endif
+
+    if (!Queue)
+    {
+        Queue = std::make_unique<ThreadReadQueue>();
+        BackendName = "thread pool";
+    }
+
+    for (size_t i = 0; i < Paths.size(); i++)
+    {
+        Targets.push_back(std::make_unique<Target>());
+        Targets.back()->Index = static_cast<uint32_t>(i);
+
+        if (Paths[i].empty() || !Targets.back()->File.Open(Paths[i]))
+            Targets.back()->bReady = true;
+    }
+
+    Worker = std::thread([this]() { Run(); });
+}
+
+PdbPrefetcher::~PdbPrefetcher()
+{
+    bStopping = true;
+    Worker.join();
+}
+
+void PdbPrefetcher::Wait(size_t Index)
+{
+    std::unique_lock<std::mutex> Guard(ReadyLock);
+
+    ReadyChanged.wait(Guard, [&]() { return Targets[Index]->bReady; });
+}
+
+void PdbPrefetcher::Run()
+{
+    ScopedTimer Timer("PDB prefetch");
+    std::vector<std::unique_ptr<Read>> Done;
+
+    for (std::unique_ptr<Target>& Pdb : Targets)
+    {
+        if (Pdb->File.IsOpen())
+            Advance(*Pdb);
+    }
+
+    while (true)
+    {
+        // Once the owner is gone nothing new goes out, only the reads in flight are waited for.
+        if (bStopping && !Waiting.empty())
+        {
+            std::multimap<uint64_t, std::unique_ptr<Read>> Dropped;
+
+            Dropped.swap(Waiting);
+
+            for (auto& [Order, Item] : Dropped)
+            {
+                Target& Pdb = *Targets[Item->Target];
+
+                if (!--Pdb.Pending)
+                    Advance(Pdb);
+            }
+        }
+
+        while (!Waiting.empty() && Queue->HasRoom())
+        {
+            std::unique_ptr<Read> Item = std::move(Waiting.begin()->second);
+
+            Waiting.erase(Waiting.begin());
+
+            if (!Item->Out)
+            {
+                if (FreeBuffers.empty())
+                    FreeBuffers.push_back(std::make_unique_for_overwrite<uint8_t[]>(MaxReadSize));
+
+                Item->Buffer = std::move(FreeBuffers.back());
+                Item->Out = Item->Buffer.get();
+                FreeBuffers.pop_back();
+            }
+
+            Queue->Start(std::move(Item));
+        }
+
+        if (Queue->IsIdle() || !Queue->Reap(Done))
+            break;
+
+        for (std::unique_ptr<Read>& Item : Done)
+        {
+            Target& Pdb = *Targets[Item->Target];
+
+            if (Item->Buffer)
+                FreeBuffers.push_back(std::move(Item->Buffer));
+
+            if (!Item->bFailed)
+                BytesRead += Item->Size;
+
+            Pdb.bFailed |= Item->bFailed;
+            Pdb.Pending--;
+
+            if (!Pdb.Pending)
+                Advance(Pdb);
+        }
+
+        Done.clear();
+    }
+
+    AddStat(StatCounter::BytesPrefetched, BytesRead);
+
+    // Only a broken queue gets here with PDBs left; nobody may wait forever on those. Only this thread sets bReady
+    // once it runs, reading it here needs no lock.
+    for (std::unique_ptr<Target>& Pdb : Targets)
+    {
+        if (!Pdb->bReady)
+            Finish(*Pdb);
+    }
+}
+
+void PdbPrefetcher::Advance(Target& Pdb)
+{
+    // A step that queued nothing falls through to the next one right away. A failed step may have queued reads
+    // before it failed, the PDB is finished once they are back.
+    while (!Pdb.Pending)
+    {
+        if (Pdb.Step == PrefetchStep::Done || Pdb.bFailed || bStopping)
+        {
+            Finish(Pdb);
+
+            return;
+        }
+
+        Pdb.bFailed = !Step(Pdb);
+    }
+}
+
+void PdbPrefetcher::Finish(Target& Pdb)
+{
+    Pdb.Directory = {};
+    Pdb.BlockMap = {};
+    Pdb.File.Close();
+
+    {
+        std::lock_guard<std::mutex> Guard(ReadyLock);
+
+        Pdb.bReady = true;
+    }
+
+    ReadyChanged.notify_all();
+}
+
+// Uses what the finished step read to queue the reads of the next one, the same checks as MsfFile and PdbFile on
+// the way. False if the PDB turned out to be broken.
+bool PdbPrefetcher::Step(Target& Pdb)
+{
+    switch (Pdb.Step)
+    {
+    case PrefetchStep::Super:
+    {
+        QueueRead(Pdb, 0, sizeof(MsfSuperBlock), reinterpret_cast<uint8_t*>(&Pdb.Super));
+        Pdb.Step = PrefetchStep::BlockMap;
+
+        return true;
+    }
+    case PrefetchStep::BlockMap:
+    {
+        const MsfSuperBlock& Super = Pdb.Super;
+
+        if (memcmp(Super.FileMagic, MsfMagic, sizeof(Super.FileMagic)) != 0 || Super.BlockSize < 512 || Super.BlockSize > 65536 ||
+            (Super.BlockSize & (Super.BlockSize - 1)) != 0 || !Super.NumDirectoryBytes)
+            return false;
+
+        Pdb.NumBlocks = static_cast<uint32_t>(std::min<uint64_t>(Super.NumBlocks, Pdb.File.Size() / Super.BlockSize));
+
+        uint32_t NumDirBlocks = (Super.NumDirectoryBytes + Super.BlockSize - 1) / Super.BlockSize;
+        uint64_t BlockMapOffset = static_cast<uint64_t>(Super.BlockMapAddr) * Super.BlockSize;
+
+        if (BlockMapOffset + NumDirBlocks * sizeof(uint32_t) > Pdb.File.Size())
+            return false;
+
+        Pdb.BlockMap.resize(NumDirBlocks);
+        QueueRead(Pdb, BlockMapOffset, NumDirBlocks * sizeof(uint32_t), reinterpret_cast<uint8_t*>(Pdb.BlockMap.data()));
+        Pdb.Step = PrefetchStep::Directory;
+
+        return true;
+    }
+    case PrefetchStep::Directory:
+    {
+        uint32_t BlockSize = Pdb.Super.BlockSize;
+
+        Pdb.Directory.resize(Pdb.BlockMap.size() * BlockSize);
+
+        for (size_t i = 0, Run; i < Pdb.BlockMap.size(); i += Run)
+        {
+            if (Pdb.BlockMap[i] >= Pdb.NumBlocks)
+                return false;
+
+            for (Run = 1; i + Run < Pdb.BlockMap.size() && Pdb.BlockMap[i + Run] == Pdb.BlockMap[i] + Run && Run * BlockSize < MaxReadSize; Run++)
+                ;
+
+            if (Pdb.BlockMap[i + Run - 1] >= Pdb.NumBlocks)
+                return false;
+
+            QueueRead(Pdb, static_cast<uint64_t>(Pdb.BlockMap[i]) * BlockSize, static_cast<uint32_t>(Run * BlockSize), Pdb.Directory.data() + i * BlockSize);
+        }
+
+        Pdb.Step = PrefetchStep::DbiHeader;
+
+        return true;
+    }
+    case PrefetchStep::DbiHeader:
+    {
+        uint32_t BlockSize = Pdb.Super.BlockSize;
+        const uint8_t* Cursor = Pdb.Directory.data();
+        const uint8_t* End = Cursor + Pdb.Super.NumDirectoryBytes;
+        uint32_t NumStreams = LoadValue<uint32_t>(Cursor);
+
+        Cursor += sizeof(uint32_t);
+
+        if (NumStreams > static_cast<uint64_t>(End - Cursor) / sizeof(uint32_t))
+            return false;
+
+        size_t BlockOffset = sizeof(uint32_t) + NumStreams * sizeof(uint32_t);
+
+        for (uint32_t i = 0; i < NumStreams; i++, Cursor += sizeof(uint32_t))
+        {
+            uint32_t Size = LoadValue<uint32_t>(Cursor);
+
+            Size = Size == MsfFile::NilStreamSize ? 0 : Size;
+            Pdb.StreamSizes.push_back(Size);
+            Pdb.StreamBlocks.push_back(BlockOffset);
+            BlockOffset += (static_cast<uint64_t>(Size) + BlockSize - 1) / BlockSize * sizeof(uint32_t);
+
+            if (BlockOffset > Pdb.Super.NumDirectoryBytes)
+                return false;
+        }
+
+        if (!QueueStream(Pdb, PdbDbiStream, 0, sizeof(DbiStreamHeader), reinterpret_cast<uint8_t*>(&Pdb.Dbi)))
+            return false;
+
+        QueueStream(Pdb, PdbInfoStream, 0, 0, nullptr);
+        Pdb.Step = PrefetchStep::Streams;
+
+        return true;
+    }
+    case PrefetchStep::Streams:
+    {
+        const DbiStreamHeader& Dbi = Pdb.Dbi;
+        uint64_t DbgHeaderOffset = GetDbiDebugHeaderOffset(Dbi);
+        uint32_t NumDbgStreams = std::min<uint32_t>(static_cast<uint32_t>(Dbi.OptionalDbgHeaderSize) / sizeof(uint16_t), DbgStreamCount);
+
+        if (Dbi.VersionSignature != -1 || DbgHeaderOffset > UINT32_MAX)
+            return false;
+
+        std::fill(std::begin(Pdb.DbgStreams), std::end(Pdb.DbgStreams), NilStreamIndex);
+
+        if (!QueueStream(Pdb, PdbDbiStream, static_cast<uint32_t>(DbgHeaderOffset), NumDbgStreams * sizeof(uint16_t), reinterpret_cast<uint8_t*>(Pdb.DbgStreams)))
+            return false;
+
+        // Everything the open reads next: the hash tables, and the symbol records the symbol index is built from.
+        QueueStream(Pdb, Dbi.PublicStreamIndex, 0, 0, nullptr);
+        QueueStream(Pdb, Dbi.GlobalStreamIndex, 0, 0, nullptr);
+        QueueStream(Pdb, Dbi.SymRecordStream, 0, 0, nullptr);
+        Pdb.Step = PrefetchStep::Sections;
+
+        return true;
+    }
+    case PrefetchStep::Sections:
+    {
+        bool bOmap = Pdb.DbgStreams[DbgOmapFromSrc] != NilStreamIndex && Pdb.DbgStreams[DbgSectionHdrOrig] != NilStreamIndex;
+
+        QueueStream(Pdb, Pdb.DbgStreams[bOmap ? DbgSectionHdrOrig : DbgSectionHdr], 0, 0, nullptr);
+
+        if (bOmap)
+            QueueStream(Pdb, Pdb.DbgStreams[DbgOmapFromSrc], 0, 0, nullptr);
+
+        Pdb.Step = PrefetchStep::Done;
+
+        return true;
+    }
+    case PrefetchStep::Done:
+        break;
+    }
+
+    return true;
+}
+
+// Queues the reads of Size bytes of the stream at Offset, one per run of contiguous blocks; Size 0 is the whole
+// stream. Out receives the data, null only warms the pages.
+bool PdbPrefetcher::QueueStream(Target& Pdb, uint32_t Stream, uint32_t Offset, uint32_t Size, uint8_t* Out)
+{
+    if (Stream >= Pdb.StreamSizes.size())
+        return false;
+
+    uint32_t StreamSize = Pdb.StreamSizes[Stream];
+
+    if (!Size && !Out)
+        Size = StreamSize - std::min(Offset, StreamSize);
+
+    if (Offset > StreamSize || Size > StreamSize - Offset)
+        return false;
+
+    if (!Size)
+        return true;
+
+    uint32_t BlockSize = Pdb.Super.BlockSize;
+    const uint8_t* Blocks = Pdb.Directory.data() + Pdb.StreamBlocks[Stream];
+    uint32_t First = Offset / BlockSize;
+    uint32_t Last = (Offset + Size - 1) / BlockSize;
+    uint32_t Copied = 0;
+
+    for (uint32_t i = First, Run; i <= Last; i += Run)
+    {
+        uint32_t Block = LoadValue<uint32_t>(Blocks + i * sizeof(uint32_t));
+        uint32_t Start = (i == First) ? Offset % BlockSize : 0;
+        uint32_t Length = BlockSize - Start;
+
+        for (Run = 1; i + Run <= Last && LoadValue<uint32_t>(Blocks + (i + Run) * sizeof(uint32_t)) == Block + Run && (Run + 1) * BlockSize <= MaxReadSize; Run++)
+            Length += BlockSize;
+
+        if (Block + Run - 1 >= Pdb.NumBlocks || Block + Run - 1 < Block)
+            return false;
+
+        Length = std::min(Length, Size - Copied);
+        QueueRead(Pdb, static_cast<uint64_t>(Block) * BlockSize + Start, Length, Out ? Out + Copied : nullptr);
+        Copied += Length;
+    }
+
+    return true;
+}
+
+void PdbPrefetcher::QueueRead(Target& Pdb, uint64_t Offset, uint32_t Size, uint8_t* Out)
+{
+    auto Item = std::make_unique<Read>();
+
+    Item->Target = Pdb.Index;
+    Item->File = &Pdb.File;
+    Item->Offset = Offset;
+    Item->Size = Size;
+    Item->Out = Out;
+    Pdb.Pending++;
+    Waiting.emplace(Out ? 0 : Pdb.Index + 1ull, std::move(Item));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class PrefetchBackend
+{
+    // io_uring where the kernel has it, the thread pool otherwise. Opt-in: it has not beaten the thread pool yet.
+    Auto,
+    ThreadPool,
+};
+
+// Cold-cache ingestion for runs over many PDBs. A background thread walks the MSF structures of all of them at once:
+// superblock, block map, stream directory, DBI header, then the info stream, DBI debug header, publics/globals hash
+// streams and symbol records, and finally the section headers. Whatever step a PDB reaches, its reads go out together
+// with those of every other PDB, so the disk sees a deep queue instead of one seek after another. The reads only warm
+// the OS cache; the regular open that follows finds its pages there. The reads go through a pool of threads doing
+// positional reads or, when asked for and the kernel has it, through io_uring.
+class PdbPrefetcher
+{
+public:
+    // Empty paths are skipped and ready right away.
+    explicit PdbPrefetcher(const std::vector<std::filesystem::path>& Paths, PrefetchBackend Backend = PrefetchBackend::ThreadPool);
+    PdbPrefetcher(const PdbPrefetcher&) = delete;
+    PdbPrefetcher& operator=(const PdbPrefetcher&) = delete;
+    ~PdbPrefetcher();
+
+    const char* GetBackendName() const { return BackendName; }
+
+    // Blocks until the pages of Paths[Index] are in. A PDB that cannot be read is ready too, its open reports why.
+    void Wait(size_t Index);
+
+    uint64_t GetBytesRead() const { return BytesRead.load(); }
+
+    class ReadQueue;
+    struct Read;
+
+private:
+    struct Target;
+
+    void Run();
+    void Advance(Target& Pdb);
+    bool Step(Target& Pdb);
+    void Finish(Target& Pdb);
+    bool QueueStream(Target& Pdb, uint32_t Stream, uint32_t Offset, uint32_t Size, uint8_t* Out);
+    void QueueRead(Target& Pdb, uint64_t Offset, uint32_t Size, uint8_t* Out);
+
+    std::vector<std::unique_ptr<Target>> Targets;
+    std::unique_ptr<ReadQueue> Queue;
+    const char* BackendName = "";
+    // Reads waiting for a free slot in the queue. The structure reads that lead to the next step go first, in the
+    // order they came; pages that are only warmed follow PDB by PDB, in the order the PDBs are waited for.
+    std::multimap<uint64_t, std::unique_ptr<Read>> Waiting;
+    // Warm-only read buffers for reuse, so the prefetch doesn't fault in fresh memory for every read.
+    std::vector<std::unique_ptr<uint8_t[]>> FreeBuffers;
+    std::atomic<uint64_t> BytesRead{ 0 };
+    std::atomic<bool> bStopping{ false };
+
+    std::mutex ReadyLock;
+    std::condition_variable ReadyChanged;
+    std::thread Worker;
+};
@@ -0,0 +1,615 @@
+#include "PdbTypes.h"
+#include "PdbFile.h"
+
+#include <algorithm>
+
+static constexpr uint32_t MinTypeIndex = 0x1000;
+static constexpr uint32_t MaxFieldListChunks = 4096;
+static constexpr uint32_t MaxBaseDepth = 32;
+static constexpr uint32_t MaxModifierDepth = 8;
+static constexpr uint8_t LeafPadMin = 0xF0;
+
+static bool ReadNumeric(const uint8_t*& Ptr, const uint8_t* End, uint64_t& Value)
+{
+    if (End - Ptr < 2)
+        return false;
+
+    uint16_t Leaf = LoadValue<uint16_t>(Ptr);
+
+    Ptr += 2;
+
+    if (Leaf < LF_NUMERIC)
+    {
+        Value = Leaf;
+
+        return true;
+    }
+
+    ptrdiff_t Size;
+
+    switch (Leaf)
+    {
+    case LF_CHAR: Size = 1; break;
+    case LF_SHORT: case LF_USHORT: Size = 2; break;
+    case LF_LONG: case LF_ULONG: Size = 4; break;
+    case LF_QUADWORD: case LF_UQUADWORD: Size = 8; break;
+    default: return false;
+    }
+
+    if (End - Ptr < Size)
+        return false;
+
+    switch (Leaf)
+    {
+    case LF_CHAR: Value = static_cast<uint64_t>(static_cast<int8_t>(*Ptr)); break;
+    case LF_SHORT: Value = static_cast<uint64_t>(LoadValue<int16_t>(Ptr)); break;
+    case LF_USHORT: Value = LoadValue<uint16_t>(Ptr); break;
+    case LF_LONG: Value = static_cast<uint64_t>(LoadValue<int32_t>(Ptr)); break;
+    case LF_ULONG: Value = LoadValue<uint32_t>(Ptr); break;
+    default: Value = LoadValue<uint64_t>(Ptr); break;
+    }
+
+    Ptr += Size;
+
+    return true;
+}
+
+static std::string_view ReadName(const uint8_t*& Ptr, const uint8_t* End)
+{
+    const char* Name = reinterpret_cast<const char*>(Ptr);
+    size_t Length = strnlen(Name, End - Ptr);
+
+    Ptr = std::min(Ptr + Length + 1, End);
+
+    return std::string_view(Name, Length);
+}
+
+bool PdbTypes::Open(const MsfFile& File)
+{
+    std::vector<uint8_t> Scratch;
+    uint32_t Size = File.GetStreamSize(PdbTpiStream);
+    const uint8_t* Data = Size >= sizeof(TpiStreamHeader) ? File.ReadStream(PdbTpiStream, 0, sizeof(TpiStreamHeader), Scratch) : nullptr;
+
+    if (!Data)
+        return false;
+
+    memcpy(&Header, Data, sizeof(Header));
+
+    // Sparse downloads and stripped PDBs carry an empty or missing TPI stream.
+    if (Header.HeaderSize < sizeof(TpiStreamHeader) || Header.TypeIndexBegin < MinTypeIndex || Header.TypeIndexEnd <= Header.TypeIndexBegin ||
+        static_cast<uint64_t>(Header.HeaderSize) + Header.TypeRecordBytes > Size)
+        return false;
+
+    uint32_t NumTypes = Header.TypeIndexEnd - Header.TypeIndexBegin;
+    uint32_t HashSize = File.GetStreamSize(Header.HashStreamIndex);
+
+    if (Header.HashStreamIndex == NilStreamIndex || Header.HashKeySize != sizeof(uint32_t) || !Header.NumHashBuckets ||
+        Header.HashValueBufferOffset < 0 || Header.HashValueBufferLength / sizeof(uint32_t) < NumTypes ||
+        static_cast<uint64_t>(Header.HashValueBufferOffset) + Header.HashValueBufferLength > HashSize)
+        return false;
+
+    const uint8_t* Hashes = File.ReadStream(Header.HashStreamIndex, Header.HashValueBufferOffset, NumTypes * sizeof(uint32_t), Scratch);
+
+    if (!Hashes)
+        return false;
+
+    // Bucket -> type indices, laid out like a CSR matrix so a lookup only touches its own bucket.
+    BucketStart.assign(Header.NumHashBuckets + 1, 0);
+    BucketTypes.resize(NumTypes);
+
+    for (uint32_t i = 0; i < NumTypes; i++)
+    {
+        uint32_t Bucket = LoadValue<uint32_t>(Hashes + i * sizeof(uint32_t));
+
+        if (Bucket < Header.NumHashBuckets)
+            BucketStart[Bucket + 1]++;
+    }
+
+    for (uint32_t i = 0; i < Header.NumHashBuckets; i++)
+        BucketStart[i + 1] += BucketStart[i];
+
+    std::vector<uint32_t> Fill(BucketStart.begin(), BucketStart.end() - 1);
+
+    for (uint32_t i = 0; i < NumTypes; i++)
+    {
+        uint32_t Bucket = LoadValue<uint32_t>(Hashes + i * sizeof(uint32_t));
+
+        if (Bucket < Header.NumHashBuckets)
+            BucketTypes[Fill[Bucket]++] = Header.TypeIndexBegin + i;
+    }
+
+    IndexOffsets.clear();
+
+    uint32_t NumOffsets = Header.IndexOffsetBufferLength / (2 * sizeof(uint32_t));
+    const uint8_t* Offsets = nullptr;
+
+    if (NumOffsets && Header.IndexOffsetBufferOffset >= 0 &&
+        static_cast<uint64_t>(Header.IndexOffsetBufferOffset) + Header.IndexOffsetBufferLength <= HashSize)
+        Offsets = File.ReadStream(Header.HashStreamIndex, Header.IndexOffsetBufferOffset, NumOffsets * 2 * sizeof(uint32_t), Scratch);
+
+    for (uint32_t i = 0; Offsets && i < NumOffsets; i++)
+    {
+        uint32_t TypeIndex = LoadValue<uint32_t>(Offsets + i * 8);
+        uint32_t Offset = LoadValue<uint32_t>(Offsets + i * 8 + 4);
+
+        if (TypeIndex < Header.TypeIndexBegin || TypeIndex >= Header.TypeIndexEnd || Offset >= Header.TypeRecordBytes ||
+            (!IndexOffsets.empty() && (TypeIndex <= IndexOffsets.back().first || Offset <= IndexOffsets.back().second)))
+            continue;
+
+        IndexOffsets.emplace_back(TypeIndex, Offset);
+    }
+
+    Msf = &File;
+
+    return true;
+}
+
+const uint8_t* PdbTypes::ReadRecord(uint32_t TypeIndex, uint16_t& Kind, uint16_t& Length, std::vector<uint8_t>& Scratch) const
+{
+    if (TypeIndex < Header.TypeIndexBegin || TypeIndex >= Header.TypeIndexEnd)
+        return nullptr;
+
+    auto It = std::upper_bound(IndexOffsets.begin(), IndexOffsets.end(), TypeIndex,
+        [](uint32_t Value, const std::pair<uint32_t, uint32_t>& Entry) { return Value < Entry.first; });
+
+    uint32_t Current = Header.TypeIndexBegin;
+    uint64_t Offset = 0;
+
+    if (It != IndexOffsets.begin())
+    {
+        --It;
+        Current = It->first;
+        Offset = It->second;
+    }
+
+    // The index offset buffer has an entry every few KB of records, the rest is skipped by record length.
+    for (; Current < TypeIndex; Current++)
+    {
+        const uint8_t* Prefix = Offset + 2 <= Header.TypeRecordBytes ?
+            Msf->ReadStream(PdbTpiStream, static_cast<uint32_t>(Header.HeaderSize + Offset), 2, Scratch) : nullptr;
+
+        if (!Prefix)
+            return nullptr;
+
+        Offset += LoadValue<uint16_t>(Prefix) + 2ull;
+    }
+
+    const uint8_t* Prefix = Offset + 4 <= Header.TypeRecordBytes ?
+        Msf->ReadStream(PdbTpiStream, static_cast<uint32_t>(Header.HeaderSize + Offset), 4, Scratch) : nullptr;
+
+    if (!Prefix)
+        return nullptr;
+
+    uint16_t RecordLength = LoadValue<uint16_t>(Prefix);
+
+    Kind = LoadValue<uint16_t>(Prefix + 2);
+
+    if (RecordLength <= 2 || Offset + 2 + RecordLength > Header.TypeRecordBytes)
+        return nullptr;
+
+    Length = RecordLength - 2;
+
+    return Msf->ReadStream(PdbTpiStream, static_cast<uint32_t>(Header.HeaderSize + Offset + 4), Length, Scratch);
+}
+
+bool PdbTypes::LoadUdt(uint32_t TypeIndex, PdbUdt& Udt) const
+{
+    std::vector<uint8_t> Scratch;
+    uint16_t Kind;
+    uint16_t Length;
+    const uint8_t* Data = ReadRecord(TypeIndex, Kind, Length, Scratch);
+
+    if (!Data)
+        return false;
+
+    uint32_t FixedSize;
+
+    switch (Kind)
+    {
+    case LF_CLASS: case LF_STRUCTURE: case LF_INTERFACE: FixedSize = 16; break;
+    case LF_UNION: FixedSize = 8; break;
+    default: return false;
+    }
+
+    if (Length < FixedSize)
+        return false;
+
+    const uint8_t* Ptr = Data + FixedSize;
+    const uint8_t* End = Data + Length;
+
+    Udt.TypeIndex = TypeIndex;
+    Udt.Kind = Kind;
+    Udt.Property = LoadValue<uint16_t>(Data + 2);
+    Udt.FieldList = LoadValue<uint32_t>(Data + 4);
+
+    if (!ReadNumeric(Ptr, End, Udt.Size))
+        return false;
+
+    Udt.Name = ReadName(Ptr, End);
+
+    return true;
+}
+
+bool PdbTypes::FindUdt(std::string_view Name, PdbUdt& Udt) const
+{
+    if (!IsOpen())
+        return false;
+
+    // Definitions that are neither scoped nor anonymous are hashed by name, with the same hash as the GSI tables.
+    uint32_t Bucket = GsiHashTable::HashName(std::string(Name)) % Header.NumHashBuckets;
+
+    for (uint32_t i = BucketStart[Bucket]; i < BucketStart[Bucket + 1]; i++)
+    {
+        if (LoadUdt(BucketTypes[i], Udt) && !(Udt.Property & CV_PROP_FWDREF) && Udt.Name == Name)
+            return true;
+    }
+
+    return false;
+}
+
+bool PdbTypes::ResolveUdt(uint32_t TypeIndex, PdbUdt& Udt) const
+{
+    std::vector<uint8_t> Scratch;
+
+    for (uint32_t Depth = 0; Depth < MaxModifierDepth; Depth++)
+    {
+        if (LoadUdt(TypeIndex, Udt))
+        {
+            if (!(Udt.Property & CV_PROP_FWDREF))
+                return true;
+
+            std::string Name = Udt.Name;
+
+            return FindUdt(Name, Udt);
+        }
+
+        uint16_t Kind;
+        uint16_t Length;
+        const uint8_t* Data = ReadRecord(TypeIndex, Kind, Length, Scratch);
+
+        if (!Data || Kind != LF_MODIFIER || Length < sizeof(uint32_t))
+            return false;
+
+        TypeIndex = LoadValue<uint32_t>(Data);
+    }
+
+    return false;
+}
+
+bool PdbTypes::ForEachField(const PdbUdt& Udt, const std::function<bool(const PdbField&)>& Callback) const
+{
+    std::vector<uint8_t> Scratch;
+    uint32_t FieldList = Udt.FieldList;
+
+    // Field lists longer than a record continue in another LF_FIELDLIST referenced by a trailing LF_INDEX.
+    for (uint32_t Chunk = 0; FieldList && Chunk < MaxFieldListChunks; Chunk++)
+    {
+        uint16_t Kind;
+        uint16_t Length;
+        const uint8_t* Ptr = ReadRecord(FieldList, Kind, Length, Scratch);
+
+        if (!Ptr || Kind != LF_FIELDLIST)
+            return false;
+
+        const uint8_t* End = Ptr + Length;
+
+        FieldList = 0;
+
+        while (End - Ptr >= 2)
+        {
+            if (*Ptr >= LeafPadMin)
+            {
+                Ptr += std::max(*Ptr & 0x0F, 1);
+
+                continue;
+            }
+
+            PdbField Field;
+            uint64_t Value = 0;
+
+            Field.Leaf = LoadValue<uint16_t>(Ptr);
+            Ptr += 2;
+
+            switch (Field.Leaf)
+            {
+            case LF_MEMBER:
+            case LF_BCLASS:
+            case LF_BINTERFACE:
+                if (End - Ptr < 6)
+                    return false;
+
+                Field.Attributes = LoadValue<uint16_t>(Ptr);
+                Field.Type = LoadValue<uint32_t>(Ptr + 2);
+                Ptr += 6;
+
+                if (!ReadNumeric(Ptr, End, Field.Offset))
+                    return false;
+
+                if (Field.Leaf == LF_MEMBER)
+                    Field.Name = ReadName(Ptr, End);
+
+                break;
+            case LF_VBCLASS:
+            case LF_IVBCLASS:
+                // Offset is the one of the virtual base pointer, the base itself has no fixed offset.
+                if (End - Ptr < 10)
+                    return false;
+
+                Field.Attributes = LoadValue<uint16_t>(Ptr);
+                Field.Type = LoadValue<uint32_t>(Ptr + 2);
+                Ptr += 10;
+
+                if (!ReadNumeric(Ptr, End, Field.Offset) || !ReadNumeric(Ptr, End, Value))
+                    return false;
+
+                break;
+            case LF_STMEMBER:
+            case LF_METHOD:
+            case LF_NESTTYPE:
+            case LF_NESTTYPEEX:
+            case LF_FRIENDFCN:
+                // For LF_METHOD the type is the LF_METHODLIST of the overloads.
+                if (End - Ptr < 6)
+                    return false;
+
+                Field.Attributes = LoadValue<uint16_t>(Ptr);
+                Field.Type = LoadValue<uint32_t>(Ptr + 2);
+                Ptr += 6;
+                Field.Name = ReadName(Ptr, End);
+
+                break;
+            case LF_ONEMETHOD:
+                // Introducing virtual methods (pure or not) carry their vtable offset before the name.
+                if (End - Ptr < 6)
+                    return false;
+
+                Field.Attributes = LoadValue<uint16_t>(Ptr);
+                Field.Type = LoadValue<uint32_t>(Ptr + 2);
+                Ptr += 6;
+
+                if (IsIntroducingMethod(Field.Attributes))
+                {
+                    if (End - Ptr < 4)
+                        return false;
+
+                    Field.Offset = LoadValue<uint32_t>(Ptr);
+                    Ptr += 4;
+                }
+
+                Field.Name = ReadName(Ptr, End);
+
+                break;
+            case LF_ENUMERATE:
+                if (End - Ptr < 2)
+                    return false;
+
+                Field.Attributes = LoadValue<uint16_t>(Ptr);
+                Ptr += 2;
+
+                if (!ReadNumeric(Ptr, End, Field.Offset))
+                    return false;
+
+                Field.Name = ReadName(Ptr, End);
+
+                break;
+            case LF_VFUNCTAB:
+            case LF_FRIENDCLS:
+                if (End - Ptr < 6)
+                    return false;
+
+                Field.Type = LoadValue<uint32_t>(Ptr + 2);
+                Ptr += 6;
+
+                break;
+            case LF_VFUNCOFF:
+                if (End - Ptr < 10)
+                    return false;
+
+                Field.Type = LoadValue<uint32_t>(Ptr + 2);
+                Field.Offset = LoadValue<uint32_t>(Ptr + 6);
+                Ptr += 10;
+
+                break;
+            case LF_INDEX:
+                if (End - Ptr < 6)
+                    return false;
+
+                FieldList = LoadValue<uint32_t>(Ptr + 2);
+                Ptr += 6;
+
+                continue;
+            default:
+                return false;
+            }
+
+            if (!Callback(Field))
+                return true;
+        }
+    }
+
+    return true;
+}
+
+bool PdbTypes::FindField(const PdbUdt& Udt, std::string_view Name, uint64_t& Offset, uint32_t& Type, uint32_t Depth) const
+{
+    std::vector<std::pair<uint32_t, uint64_t>> Bases;
+    bool bFound = false;
+
+    // Members of virtual bases have no fixed offset, only non-virtual bases are searched.
+    auto Visit = [&](const PdbField& Field)
+    {
+        if (Field.Leaf == LF_BCLASS || Field.Leaf == LF_BINTERFACE)
+            Bases.emplace_back(Field.Type, Field.Offset);
+        else if (Field.Leaf == LF_MEMBER && Field.Name == Name)
+        {
+            Offset = Field.Offset;
+            Type = Field.Type;
+            bFound = true;
+        }
+
+        return !bFound;
+    };
+
+    if (!ForEachField(Udt, Visit))
+        return false;
+
+    if (bFound)
+        return true;
+
+    for (const auto& [BaseType, BaseOffset] : Bases)
+    {
+        PdbUdt Base;
+
+        if (Depth < MaxBaseDepth && ResolveUdt(BaseType, Base) && FindField(Base, Name, Offset, Type, Depth + 1))
+        {
+            Offset += BaseOffset;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PdbTypes::FindIntroducingMethod(const PdbUdt& Udt, std::string_view Method, PdbVirtualSlot& Slot, uint32_t Depth) const
+{
+    std::vector<uint32_t> Bases;
+    std::vector<uint8_t> Scratch;
+    bool bFound = false;
+
+    auto AddMethod = [&](uint16_t Attributes, uint64_t VtableOffset)
+    {
+        uint16_t Property = GetMethodProperty(Attributes);
+
+        if (Property != CV_MTvirtual && Property != CV_MTpurevirt && !IsIntroducingMethod(Attributes))
+            return;
+
+        Slot.NumVirtualOverloads++;
+
+        if (!bFound && IsIntroducingMethod(Attributes))
+        {
+            Slot.VtableOffset = VtableOffset;
+            bFound = true;
+        }
+    };
+
+    auto Visit = [&](const PdbField& Field)
+    {
+        switch (Field.Leaf)
+        {
+        case LF_BCLASS:
+        case LF_BINTERFACE:
+        case LF_VBCLASS:
+        case LF_IVBCLASS:
+            Bases.push_back(Field.Type);
+
+            break;
+        case LF_ONEMETHOD:
+            if (Field.Name == Method)
+                AddMethod(Field.Attributes, Field.Offset);
+
+            break;
+        case LF_METHOD:
+        {
+            if (Field.Name != Method)
+                break;
+
+            uint16_t Kind;
+            uint16_t Length;
+            const uint8_t* Ptr = ReadRecord(Field.Type, Kind, Length, Scratch);
+
+            if (!Ptr || Kind != LF_METHODLIST)
+                break;
+
+            const uint8_t* End = Ptr + Length;
+
+            // Overload entries: attributes, padding, method type and the vtable offset of introducing ones.
+            while (End - Ptr >= 8)
+            {
+                uint16_t Attributes = LoadValue<uint16_t>(Ptr);
+                uint64_t VtableOffset = 0;
+
+                Ptr += 8;
+
+                if (IsIntroducingMethod(Attributes))
+                {
+                    if (End - Ptr < 4)
+                        break;
+
+                    VtableOffset = LoadValue<uint32_t>(Ptr);
+                    Ptr += 4;
+                }
+
+                AddMethod(Attributes, VtableOffset);
+            }
+
+            break;
+        }
+        default:
+            break;
+        }
+
+        return true;
+    };
+
+    Slot.NumVirtualOverloads = 0;
+
+    if (!ForEachField(Udt, Visit))
+        return false;
+
+    if (bFound)
+    {
+        Slot.Introducer = Udt.Name;
+
+        return true;
+    }
+
+    // An override only has its slot in the class that introduced the method, somewhere up the hierarchy.
+    for (uint32_t BaseType : Bases)
+    {
+        PdbUdt Base;
+
+        if (Depth < MaxBaseDepth && ResolveUdt(BaseType, Base) && FindIntroducingMethod(Base, Method, Slot, Depth + 1))
+            return true;
+    }
+
+    return false;
+}
+
+bool PdbTypes::FindVirtualSlot(std::string_view TypeName, std::string_view Method, PdbVirtualSlot& Slot) const
+{
+    PdbUdt Udt;
+
+    return FindUdt(TypeName, Udt) && FindIntroducingMethod(Udt, Method, Slot, 0);
+}
+
+bool PdbTypes::FindMemberOffset(std::string_view TypeName, std::string_view MemberPath, uint64_t& Offset) const
+{
+    PdbUdt Udt;
+
+    if (!FindUdt(TypeName, Udt))
+        return false;
+
+    Offset = 0;
+
+    for (size_t Start = 0;;)
+    {
+        size_t Dot = MemberPath.find('.', Start);
+        std::string_view Name = MemberPath.substr(Start, Dot == std::string_view::npos ? std::string_view::npos : Dot - Start);
+        uint64_t FieldOffset;
+        uint32_t FieldType;
+
+        if (Name.empty() || !FindField(Udt, Name, FieldOffset, FieldType, 0))
+            return false;
+
+        Offset += FieldOffset;
+
+        if (Dot == std::string_view::npos)
+            return true;
+
+        if (!ResolveUdt(FieldType, Udt))
+            return false;
+
+        Start = Dot + 1;
+    }
+}
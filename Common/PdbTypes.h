@@ -0,0 +1,69 @@
+#pragma once
+
+#include "MsfFile.h"
+#include "PdbFormat.h"
+
+#include <functional>
+#include <string_view>
+
+struct PdbUdt
+{
+    uint32_t TypeIndex = 0;
+    uint16_t Kind = 0;
+    uint16_t Property = 0;
+    uint32_t FieldList = 0;
+    uint64_t Size = 0;
+    std::string Name;
+};
+
+struct PdbField
+{
+    uint16_t Leaf = 0;
+    uint16_t Attributes = 0;
+    uint32_t Type = 0;
+    uint64_t Offset = 0;
+    std::string_view Name;
+};
+
+struct PdbVirtualSlot
+{
+    // Byte offset of the entry inside the vtable of the class that introduced the method.
+    uint64_t VtableOffset = 0;
+    std::string Introducer;
+    uint32_t NumVirtualOverloads = 0;
+};
+
+// Type lookups against the TPI stream without walking it: a name is hashed into the TPI hash stream bucket
+// that holds its UDT definition, and a record is reached by seeking from the nearest entry of the index
+// offset buffer. Only the records that are actually visited get decoded.
+class PdbTypes
+{
+public:
+    bool Open(const MsfFile& Msf);
+    bool IsOpen() const { return Msf != nullptr; }
+
+    // Complete definition of a class/struct/union/interface by name, forward references are skipped.
+    bool FindUdt(std::string_view Name, PdbUdt& Udt) const;
+
+    // Byte offset of a data member inside a UDT. MemberPath may descend into nested members ("Pcb.ApcState"),
+    // members of non-virtual base classes are found as well.
+    bool FindMemberOffset(std::string_view TypeName, std::string_view MemberPath, uint64_t& Offset) const;
+
+    // vtable entry of a virtual method, taken from the introducing LF_ONEMETHOD/LF_METHODLIST entry of the class
+    // or, for overrides and inherited methods, of its (virtual) base classes.
+    bool FindVirtualSlot(std::string_view TypeName, std::string_view Method, PdbVirtualSlot& Slot) const;
+
+private:
+    const uint8_t* ReadRecord(uint32_t TypeIndex, uint16_t& Kind, uint16_t& Length, std::vector<uint8_t>& Scratch) const;
+    bool LoadUdt(uint32_t TypeIndex, PdbUdt& Udt) const;
+    bool ResolveUdt(uint32_t TypeIndex, PdbUdt& Udt) const;
+    bool ForEachField(const PdbUdt& Udt, const std::function<bool(const PdbField&)>& Callback) const;
+    bool FindField(const PdbUdt& Udt, std::string_view Name, uint64_t& Offset, uint32_t& Type, uint32_t Depth) const;
+    bool FindIntroducingMethod(const PdbUdt& Udt, std::string_view Method, PdbVirtualSlot& Slot, uint32_t Depth) const;
+
+    const MsfFile* Msf = nullptr;
+    TpiStreamHeader Header = {};
+    std::vector<uint32_t> BucketStart;
+    std::vector<uint32_t> BucketTypes;
+    std::vector<std::pair<uint32_t, uint32_t>> IndexOffsets;
+};
@@ -0,0 +1,270 @@
+#include "PeCache.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const char PeCacheMagic[8] = { 'A', 'e', 'P', 'D', 'B', 'P', 'e', 'C' };
+
+uint64_t PeCache::HashSymbols(const std::vector<std::wstring>& Symbols)
+{
+    uint64_t Hash = 0xCBF29CE484222325ull;
+
+    for (const std::wstring& Symbol : Symbols)
+    {
+        for (char Char : WideToUtf8(Symbol) + ',')
+        {
+            Hash ^= static_cast<uint8_t>(Char);
+            Hash *= 0x100000001B3ull;
+        }
+    }
+
+    return Hash;
+}
+
+// Offsets are stored as "Name\0Value\0" pairs; neither holds a NUL.
+static std::string JoinOffsets(const std::map<std::wstring, std::wstring>& Offsets)
+{
+    std::string Joined;
+
+    for (const auto& [Name, Value] : Offsets)
+    {
+        Joined += WideToUtf8(Name);
+        Joined += '\0';
+        Joined += WideToUtf8(Value);
+        Joined += '\0';
+    }
+
+    return Joined;
+}
+
+static std::map<std::wstring, std::wstring> SplitOffsets(std::string_view Joined)
+{
+    std::map<std::wstring, std::wstring> Offsets;
+
+    while (!Joined.empty())
+    {
+        size_t NameEnd = Joined.find('\0');
+        size_t ValueEnd = NameEnd == std::string_view::npos ? NameEnd : Joined.find('\0', NameEnd + 1);
+
+        if (ValueEnd == std::string_view::npos)
+            break;
+
+        Offsets[Utf8ToWide(std::string(Joined.substr(0, NameEnd)))] = Utf8ToWide(std::string(Joined.substr(NameEnd + 1, ValueEnd - NameEnd - 1)));
+        Joined.remove_prefix(ValueEnd + 1);
+    }
+
+    return Offsets;
+}
+
+bool PeCache::Open(const std::filesystem::path& CachePath)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    Path = CachePath;
+    Pending.clear();
+
+    return Map();
+}
+
+bool PeCache::Map()
+{
+    File.Close();
+    Entries = nullptr;
+    NumEntries = 0;
+
+    if (!File.Open(Path) || File.Size() < sizeof(PeCacheHeader))
+    {
+        File.Close();
+
+        return false;
+    }
+
+    const PeCacheHeader* Header = reinterpret_cast<const PeCacheHeader*>(File.Data());
+    uint64_t EntriesEnd = sizeof(PeCacheHeader) + static_cast<uint64_t>(Header->NumEntries) * sizeof(PeCacheEntry);
+
+    bool bValid = memcmp(Header->Magic, PeCacheMagic, sizeof(PeCacheMagic)) == 0 && Header->Version == Version &&
+        EntriesEnd <= Header->StringsOffset && Header->StringsOffset + Header->StringsSize <= File.Size();
+
+    const PeCacheEntry* Table = reinterpret_cast<const PeCacheEntry*>(File.Data() + sizeof(PeCacheHeader));
+
+    for (uint32_t i = 0; bValid && i < Header->NumEntries; i++)
+    {
+        const PeCacheEntry& Entry = Table[i];
+
+        bValid = static_cast<uint64_t>(Entry.PathOffset) + Entry.PathLength <= Header->StringsSize &&
+            static_cast<uint64_t>(Entry.PdbNameOffset) + Entry.PdbNameLength <= Header->StringsSize &&
+            static_cast<uint64_t>(Entry.SignatureOffset) + Entry.SignatureLength <= Header->StringsSize &&
+            static_cast<uint64_t>(Entry.OutputPathOffset) + Entry.OutputPathLength <= Header->StringsSize &&
+            static_cast<uint64_t>(Entry.OffsetsOffset) + Entry.OffsetsLength <= Header->StringsSize;
+    }
+
+    // An unreadable cache is dropped; every PE is then read once more and the file rewritten on Save().
+    if (!bValid)
+    {
+        File.Close();
+
+        return false;
+    }
+
+    Entries = Table;
+    Strings = reinterpret_cast<const char*>(File.Data() + Header->StringsOffset);
+    NumEntries = Header->NumEntries;
+
+    return true;
+}
+
+bool PeCache::Find(std::string_view FilePath, const FileIdentity& Identity, PeCacheRecord& Record) const
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    auto NewEntry = Pending.find(FilePath);
+
+    if (NewEntry != Pending.end())
+    {
+        Record = NewEntry->second;
+    }
+    else
+    {
+        const PeCacheEntry* End = Entries + NumEntries;
+        const PeCacheEntry* It = std::lower_bound(Entries, End, FilePath, [this](const PeCacheEntry& Entry, std::string_view Name)
+        {
+            return GetString(Entry.PathOffset, Entry.PathLength) < Name;
+        });
+
+        if (It == End || GetString(It->PathOffset, It->PathLength) != FilePath)
+        {
+            AddStat(StatCounter::PeCacheMisses);
+
+            return false;
+        }
+
+        Record = GetRecord(*It);
+    }
+
+    bool bHit = Record.Identity == Identity;
+
+    AddStat(bHit ? StatCounter::PeCacheHits : StatCounter::PeCacheMisses);
+
+    return bHit;
+}
+
+PeCacheRecord PeCache::GetRecord(const PeCacheEntry& Entry) const
+{
+    PeCacheRecord Record;
+
+    Record.Identity = Entry.Identity;
+    Record.PdbName = GetString(Entry.PdbNameOffset, Entry.PdbNameLength);
+    Record.Signature = GetString(Entry.SignatureOffset, Entry.SignatureLength);
+    Record.SymbolsHash = Entry.SymbolsHash;
+    Record.OutputPath = GetString(Entry.OutputPathOffset, Entry.OutputPathLength);
+    Record.Format = static_cast<OffsetsFormat>(Entry.Format);
+    Record.Offsets = SplitOffsets(GetString(Entry.OffsetsOffset, Entry.OffsetsLength));
+
+    return Record;
+}
+
+void PeCache::Add(std::string_view FilePath, const PeCacheRecord& Record)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    Pending[std::string(FilePath)] = Record;
+}
+
+bool PeCache::Save()
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    if (Pending.empty() || Path.empty())
+        return true;
+
+    std::map<std::string, PeCacheRecord, std::less<>> Merged;
+
+    for (uint32_t i = 0; i < NumEntries; i++)
+    {
+        const PeCacheEntry& Entry = Entries[i];
+
+        Merged.emplace(std::string(GetString(Entry.PathOffset, Entry.PathLength)), GetRecord(Entry));
+    }
+
+    for (const auto& [FilePath, Record] : Pending)
+        Merged[FilePath] = Record;
+
+    std::vector<PeCacheEntry> Table;
+    std::string Names;
+
+    auto AddString = [&Names](const std::string& Str, uint32_t& Offset, uint32_t& Length)
+    {
+        Offset = static_cast<uint32_t>(Names.size());
+        Length = static_cast<uint32_t>(Str.size());
+        Names += Str;
+    };
+
+    for (const auto& [FilePath, Record] : Merged)
+    {
+        PeCacheEntry Entry = {};
+
+        AddString(FilePath, Entry.PathOffset, Entry.PathLength);
+        AddString(Record.PdbName, Entry.PdbNameOffset, Entry.PdbNameLength);
+        AddString(Record.Signature, Entry.SignatureOffset, Entry.SignatureLength);
+        AddString(Record.OutputPath, Entry.OutputPathOffset, Entry.OutputPathLength);
+        AddString(JoinOffsets(Record.Offsets), Entry.OffsetsOffset, Entry.OffsetsLength);
+        Entry.Identity = Record.Identity;
+        Entry.SymbolsHash = Record.SymbolsHash;
+        Entry.Format = static_cast<uint32_t>(Record.Format);
+        Table.push_back(Entry);
+    }
+
+    PeCacheHeader Header = {};
+
+    memcpy(Header.Magic, PeCacheMagic, sizeof(PeCacheMagic));
+    Header.Version = Version;
+    Header.NumEntries = static_cast<uint32_t>(Table.size());
+    Header.StringsOffset = sizeof(PeCacheHeader) + Table.size() * sizeof(PeCacheEntry);
+    Header.StringsSize = Names.size();
+
+    std::filesystem::path TempPath = Path;
+    std::error_code Error;
+
+    TempPath += L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+        if (!Out.is_open())
+            return false;
+
+        Out.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        Out.write(reinterpret_cast<const char*>(Table.data()), Table.size() * sizeof(PeCacheEntry));
+        Out.write(Names.data(), Names.size());
+
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(TempPath, Error);
+
+            return false;
+        }
+    }
+
+    // Windows cannot replace a mapped file.
+    File.Close();
+    Entries = nullptr;
+    NumEntries = 0;
+
+    std::filesystem::rename(TempPath, Path, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+        Map();
+
+        return false;
+    }
+
+    Pending.clear();
+    Map();
+
+    return true;
+}
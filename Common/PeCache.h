@@ -0,0 +1,80 @@
+#pragma once
+
+#include "OffsetsOutput.h"
+
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+struct PeCacheHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t NumEntries;
+    uint64_t StringsOffset;
+    uint64_t StringsSize;
+};
+
+struct PeCacheEntry
+{
+    uint32_t PathOffset;
+    uint32_t PathLength;
+    uint32_t PdbNameOffset;
+    uint32_t PdbNameLength;
+    uint32_t SignatureOffset;
+    uint32_t SignatureLength;
+    FileIdentity Identity;
+    uint64_t SymbolsHash;
+    uint32_t OutputPathOffset;
+    uint32_t OutputPathLength;
+    uint32_t OffsetsOffset;
+    uint32_t OffsetsLength;
+    uint32_t Format;
+    uint32_t Reserved;
+};
+
+struct PeCacheRecord
+{
+    FileIdentity Identity;
+    std::string PdbName;
+    std::string Signature;
+    // Fingerprint of the symbol list last written to the binary's offsets section.
+    uint64_t SymbolsHash = 0;
+    // The offsets file that section went to and the values it was written with.
+    std::string OutputPath;
+    OffsetsFormat Format = OffsetsFormat::Ini;
+    std::map<std::wstring, std::wstring> Offsets;
+};
+
+// What the updater last saw of every PE: the file's identity (size, write time, file ID), the PDB name and
+// "<GUID><age>" read from its debug directory and the offsets section last written for it. While the identity
+// matches, the PE headers don't have to be read again. Entries are sorted by path; changes are kept in memory until Save() merges them into the file.
+class PeCache
+{
+public:
+    static constexpr uint32_t Version = 2;
+
+    static uint64_t HashSymbols(const std::vector<std::wstring>& Symbols);
+
+    bool Open(const std::filesystem::path& CachePath);
+    // Fails if the path is unknown or the file changed since it was recorded; in the latter case Record still holds
+    // what was recorded.
+    bool Find(std::string_view Path, const FileIdentity& Identity, PeCacheRecord& Record) const;
+    void Add(std::string_view Path, const PeCacheRecord& Record);
+    bool Save();
+
+private:
+    bool Map();
+    PeCacheRecord GetRecord(const PeCacheEntry& Entry) const;
+    std::string_view GetString(uint32_t Offset, uint32_t Length) const { return std::string_view(Strings + Offset, Length); }
+
+    std::filesystem::path Path;
+    MappedFile File;
+    const PeCacheEntry* Entries = nullptr;
+    const char* Strings = nullptr;
+    uint32_t NumEntries = 0;
+    std::map<std::string, PeCacheRecord, std::less<>> Pending;
+    // The updater records results from its download and parse threads.
+    mutable std::mutex Lock;
+};
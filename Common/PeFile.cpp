@@ -0,0 +1,284 @@
+#include "PeFile.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+static constexpr uint16_t DosSignature = 0x5A4D;
+static constexpr uint32_t NtSignature = 0x00004550;
+static constexpr uint16_t Pe32Magic = 0x10B;
+static constexpr uint16_t Pe32PlusMagic = 0x20B;
+static constexpr uint32_t CodeViewRsds = 0x53445352;
+static constexpr uint32_t DebugTypeCodeView = 2;
+static constexpr uint32_t DebugDirectoryIndex = 6;
+
+static constexpr uint32_t DosHeaderSize = 64;
+static constexpr uint32_t LfanewOffset = 0x3C;
+static constexpr uint32_t FileHeaderSize = 20;
+static constexpr uint32_t SectionHeaderSize = 40;
+static constexpr uint32_t DebugEntrySize = 28;
+static constexpr uint32_t RsdsHeaderSize = 24;
+
+static constexpr uint32_t MaxOptionalHeaderSize = 0x1000;
+static constexpr uint32_t MaxDebugEntries = 64;
+static constexpr uint32_t MaxCodeViewSize = 0x1000;
+
+struct SectionRange
+{
+    uint32_t VirtualAddress;
+    uint32_t VirtualSize;
+    uint32_t RawSize;
+    uint32_t RawPointer;
+};
+
+class PeReader
+{
+public:
+    bool Open(const std::filesystem::path& Path)
+    {
+        std::error_code Ec;
+
+        FileSize = std::filesystem::file_size(Path, Ec);
+
+        if (Ec)
+            return false;
+
+        File.open(Path, std::ios::binary);
+
+        return File.is_open();
+    }
+
+    bool ReadAt(uint64_t Offset, uint32_t Size, std::vector<uint8_t>& Buffer)
+    {
+        if (Offset > FileSize || Size > FileSize - Offset)
+            return false;
+
+        Buffer.resize(Size);
+        File.clear();
+        File.seekg(static_cast<std::streamoff>(Offset));
+
+        return File.read(reinterpret_cast<char*>(Buffer.data()), Size).good();
+    }
+
+    // Maps [Rva, Rva + Size) to a file offset. The whole range has to be backed by raw data of one section
+    // (or lie inside the headers) and that raw data has to be inside the file.
+    bool RvaToOffset(uint32_t Rva, uint32_t Size, uint64_t& Offset) const
+    {
+        uint64_t End = static_cast<uint64_t>(Rva) + Size;
+
+        if (End <= SizeOfHeaders)
+        {
+            Offset = Rva;
+
+            return End <= FileSize;
+        }
+
+        for (const SectionRange& Section : Sections)
+        {
+            uint32_t Extent = Section.VirtualSize ? Section.VirtualSize : Section.RawSize;
+
+            if (Rva < Section.VirtualAddress || Rva - Section.VirtualAddress >= Extent)
+                continue;
+
+            uint64_t InSection = Rva - Section.VirtualAddress;
+
+            if (InSection + Size > Section.RawSize)
+                return false;
+
+            Offset = Section.RawPointer + InSection;
+
+            return Offset + Size <= FileSize;
+        }
+
+        return false;
+    }
+
+    uint32_t SizeOfHeaders = 0;
+    std::vector<SectionRange> Sections;
+
+private:
+    std::ifstream File;
+    uint64_t FileSize = 0;
+};
+
+static PeStatus Fail(PeStatus Status, std::string& Error, const char* Message)
+{
+    Error = Message;
+
+    return Status;
+}
+
+PeStatus ReadPeDebugInfo(const std::filesystem::path& Path, PeDebugInfo& Info, std::string& Error)
+{
+    ScopedTimer Timer("PE read");
+    std::error_code Ec;
+
+    AddStat(StatCounter::PeFilesRead);
+
+    if (!std::filesystem::is_regular_file(Path, Ec))
+        return Fail(PeStatus::NotFound, Error, "File not found");
+
+    PeReader Reader;
+    std::vector<uint8_t> Buffer;
+
+    if (!Reader.Open(Path))
+        return Fail(PeStatus::ReadFailed, Error, "Cannot open file");
+
+    if (!Reader.ReadAt(0, DosHeaderSize, Buffer) || LoadValue<uint16_t>(Buffer.data()) != DosSignature)
+        return Fail(PeStatus::BadDosHeader, Error, "Not a valid PE file");
+
+    uint32_t NtOffset = LoadValue<uint32_t>(Buffer.data() + LfanewOffset);
+
+    if (!Reader.ReadAt(NtOffset, sizeof(uint32_t) + FileHeaderSize, Buffer) || LoadValue<uint32_t>(Buffer.data()) != NtSignature)
+        return Fail(PeStatus::BadNtHeaders, Error, "Not a valid PE file (NT signature)");
+
+    const uint8_t* FileHeader = Buffer.data() + sizeof(uint32_t);
+    uint16_t NumSections = LoadValue<uint16_t>(FileHeader + 2);
+    uint16_t OptionalSize = LoadValue<uint16_t>(FileHeader + 16);
+
+    Info.Machine = LoadValue<uint16_t>(FileHeader);
+
+    uint64_t OptionalOffset = static_cast<uint64_t>(NtOffset) + sizeof(uint32_t) + FileHeaderSize;
+
+    if (OptionalSize < sizeof(uint16_t) || OptionalSize > MaxOptionalHeaderSize || !Reader.ReadAt(OptionalOffset, OptionalSize, Buffer))
+        return Fail(PeStatus::BadNtHeaders, Error, "Not a valid PE file (optional header)");
+
+    const uint8_t* Optional = Buffer.data();
+    uint16_t Magic = LoadValue<uint16_t>(Optional);
+
+    if (Magic != Pe32Magic && Magic != Pe32PlusMagic)
+        return Fail(PeStatus::BadNtHeaders, Error, "Not a valid PE file (optional header magic)");
+
+    Info.bPe32Plus = Magic == Pe32PlusMagic;
+
+    // SizeOfHeaders sits at the same place in both layouts, the data directories move by the wider ImageBase
+    // and stack/heap sizes of PE32+.
+    uint32_t HeadersField = 60;
+    uint32_t DirCountField = Info.bPe32Plus ? 108 : 92;
+    uint32_t DebugDirField = DirCountField + sizeof(uint32_t) + DebugDirectoryIndex * 8;
+
+    if (OptionalSize < DirCountField + sizeof(uint32_t))
+        return Fail(PeStatus::BadNtHeaders, Error, "Not a valid PE file (optional header is truncated)");
+
+    if (LoadValue<uint32_t>(Optional + DirCountField) <= DebugDirectoryIndex || OptionalSize < DebugDirField + 8)
+        return Fail(PeStatus::NoDebugDirectory, Error, "No debug directory found");
+
+    uint32_t DebugDirRva = LoadValue<uint32_t>(Optional + DebugDirField);
+    uint32_t DebugDirSize = LoadValue<uint32_t>(Optional + DebugDirField + 4);
+
+    Reader.SizeOfHeaders = LoadValue<uint32_t>(Optional + HeadersField);
+
+    if (!DebugDirRva || DebugDirSize < DebugEntrySize)
+        return Fail(PeStatus::NoDebugDirectory, Error, "No debug directory found");
+
+    if (!Reader.ReadAt(OptionalOffset + OptionalSize, NumSections * SectionHeaderSize, Buffer))
+        return Fail(PeStatus::BadNtHeaders, Error, "Not a valid PE file (section table)");
+
+    for (uint16_t i = 0; i < NumSections; i++)
+    {
+        const uint8_t* Section = Buffer.data() + i * SectionHeaderSize;
+
+        Reader.Sections.push_back({ LoadValue<uint32_t>(Section + 12), LoadValue<uint32_t>(Section + 8),
+            LoadValue<uint32_t>(Section + 16), LoadValue<uint32_t>(Section + 20) });
+    }
+
+    uint32_t NumEntries = std::min(DebugDirSize / DebugEntrySize, MaxDebugEntries);
+    uint64_t DebugDirOffset = 0;
+
+    if (!Reader.RvaToOffset(DebugDirRva, NumEntries * DebugEntrySize, DebugDirOffset) || !Reader.ReadAt(DebugDirOffset, NumEntries * DebugEntrySize, Buffer))
+        return Fail(PeStatus::BadDebugDirectory, Error, "Debug directory section not found");
+
+    std::vector<uint8_t> Entries = std::move(Buffer);
+
+    for (uint32_t i = 0; i < NumEntries; i++)
+    {
+        const uint8_t* Entry = Entries.data() + i * DebugEntrySize;
+        uint32_t DataSize = LoadValue<uint32_t>(Entry + 16);
+        uint32_t DataRva = LoadValue<uint32_t>(Entry + 20);
+        uint64_t DataOffset = LoadValue<uint32_t>(Entry + 24);
+
+        if (LoadValue<uint32_t>(Entry + 12) != DebugTypeCodeView || DataSize <= RsdsHeaderSize)
+            continue;
+
+        DataSize = std::min(DataSize, MaxCodeViewSize);
+
+        if (!DataOffset && !Reader.RvaToOffset(DataRva, DataSize, DataOffset))
+            continue;
+
+        if (!Reader.ReadAt(DataOffset, DataSize, Buffer) || LoadValue<uint32_t>(Buffer.data()) != CodeViewRsds)
+            continue;
+
+        const char* Name = reinterpret_cast<const char*>(Buffer.data() + RsdsHeaderSize);
+        size_t NameLength = strnlen(Name, DataSize - RsdsHeaderSize);
+
+        if (!NameLength || NameLength == DataSize - RsdsHeaderSize)
+            continue;
+
+        memcpy(&Info.Guid, Buffer.data() + sizeof(uint32_t), sizeof(Info.Guid));
+        Info.Age = LoadValue<uint32_t>(Buffer.data() + sizeof(uint32_t) + sizeof(Info.Guid));
+        Info.PdbPath.assign(Name, NameLength);
+
+        return PeStatus::Ok;
+    }
+
+    return Fail(PeStatus::NoCodeView, Error, "No CodeView debug information found");
+}
+
+std::string PeDebugInfo::GetPdbFileName() const
+{
+    size_t Pos = PdbPath.find_last_of("\\/");
+
+    return (Pos != std::string::npos) ? PdbPath.substr(Pos + 1) : PdbPath;
+}
+
+std::string PeDebugInfo::GetSignature() const
+{
+    char Buffer[48];
+
+    snprintf(Buffer, sizeof(Buffer), "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X%X", Guid.Data1, Guid.Data2, Guid.Data3,
+        Guid.Data4[0], Guid.Data4[1], Guid.Data4[2], Guid.Data4[3], Guid.Data4[4], Guid.Data4[5], Guid.Data4[6], Guid.Data4[7], Age);
+
+    return Buffer;
+}
+
+bool GetPeSections(const uint8_t* Image, uint64_t Size, std::vector<PeSection>& Sections)
+{
+    Sections.clear();
+
+    if (Size < DosHeaderSize || LoadValue<uint16_t>(Image) != DosSignature)
+        return false;
+
+    uint64_t NtOffset = LoadValue<uint32_t>(Image + LfanewOffset);
+
+    if (NtOffset + sizeof(uint32_t) + FileHeaderSize > Size || LoadValue<uint32_t>(Image + NtOffset) != NtSignature)
+        return false;
+
+    const uint8_t* FileHeader = Image + NtOffset + sizeof(uint32_t);
+    uint16_t NumSections = LoadValue<uint16_t>(FileHeader + 2);
+    uint64_t TableOffset = NtOffset + sizeof(uint32_t) + FileHeaderSize + LoadValue<uint16_t>(FileHeader + 16);
+
+    if (TableOffset + static_cast<uint64_t>(NumSections) * SectionHeaderSize > Size)
+        return false;
+
+    for (uint16_t i = 0; i < NumSections; i++)
+    {
+        const uint8_t* Header = Image + TableOffset + i * SectionHeaderSize;
+        PeSection Section;
+
+        Section.VirtualSize = LoadValue<uint32_t>(Header + 8);
+        Section.VirtualAddress = LoadValue<uint32_t>(Header + 12);
+        Section.RawSize = LoadValue<uint32_t>(Header + 16);
+        Section.RawPointer = LoadValue<uint32_t>(Header + 20);
+        Section.Characteristics = LoadValue<uint32_t>(Header + 36);
+
+        if (Section.RawPointer >= Size)
+            Section.RawSize = 0;
+        else
+            Section.RawSize = static_cast<uint32_t>(std::min<uint64_t>(Section.RawSize, Size - Section.RawPointer));
+
+        Sections.push_back(Section);
+    }
+
+    return true;
+}
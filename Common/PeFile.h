@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Platform.h"
+#include "CodeView.h"
+
+#include <vector>
+
+enum class PeStatus
+{
+    Ok,
+    NotFound,
+    ReadFailed,
+    BadDosHeader,
+    BadNtHeaders,
+    NoDebugDirectory,
+    BadDebugDirectory,
+    NoCodeView,
+};
+
+struct PeDebugInfo
+{
+    uint16_t Machine = 0;
+    bool bPe32Plus = false;
+    PdbGuid Guid = {};
+    uint32_t Age = 0;
+    std::string PdbPath;
+
+    // File name part of the PDB path stored in the image.
+    std::string GetPdbFileName() const;
+    // GUID and age as used by symbol servers: "<32 hex digits><age in hex>".
+    std::string GetSignature() const;
+};
+
+// Reads the RSDS CodeView record of a PE32/PE32+ image with a few small positioned reads (DOS header, NT headers,
+// section table, debug directory, CodeView record) instead of mapping the file. Every offset and size taken from
+// the image is checked against the file size and the section it belongs to.
+PeStatus ReadPeDebugInfo(const std::filesystem::path& Path, PeDebugInfo& Info, std::string& Error);
+
+struct PeSection
+{
+    uint32_t VirtualAddress = 0;
+    uint32_t VirtualSize = 0;
+    uint32_t RawPointer = 0;
+    uint32_t RawSize = 0;
+    uint32_t Characteristics = 0;
+
+    // IMAGE_SCN_CNT_CODE or IMAGE_SCN_MEM_EXECUTE.
+    bool IsExecutable() const { return (Characteristics & 0x20000020) != 0; }
+};
+
+// Section table of an image that is already in memory (a mapped file). Raw data ranges are clamped to the file.
+bool GetPeSections(const uint8_t* Image, uint64_t Size, std::vector<PeSection>& Sections);
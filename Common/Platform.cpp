@@ -0,0 +1,511 @@
+#include "Platform.h"
+
+#include <algorithm>
+#include <vector>
+#include <clocale>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+std::filesystem::path GetExecutablePath()
+{
+#ifdef _WIN32
+    wchar_t Buffer[MAX_PATH];
+
+    if (!GetModuleFileNameW(NULL, Buffer, MAX_PATH))
+        return {};
+
+    return std::filesystem::path(Buffer);
+#else
+    std::error_code Error;
+    std::filesystem::path Path = std::filesystem::read_symlink("/proc/self/exe", Error);
+
+    return Error ? std::filesystem::path() : Path;
+#endif
+}
+
+std::string WideToUtf8(const std::wstring& Str)
+{
+    std::string Result;
+    Result.reserve(Str.size());
+
+    for (size_t i = 0; i < Str.size(); i++)
+    {
+        uint32_t Code = static_cast<uint32_t>(Str[i]);
+
+        if (sizeof(wchar_t) == 2 && Code >= 0xD800 && Code <= 0xDBFF && i + 1 < Str.size())
+        {
+            uint32_t Low = static_cast<uint32_t>(Str[i + 1]);
+
+            if (Low >= 0xDC00 && Low <= 0xDFFF)
+            {
+                Code = 0x10000 + ((Code - 0xD800) << 10) + (Low - 0xDC00);
+                i++;
+            }
+        }
+
+        if (Code < 0x80)
+        {
+            Result += static_cast<char>(Code);
+        }
+        else if (Code < 0x800)
+        {
+            Result += static_cast<char>(0xC0 | (Code >> 6));
+            Result += static_cast<char>(0x80 | (Code & 0x3F));
+        }
+        else if (Code < 0x10000)
+        {
+            Result += static_cast<char>(0xE0 | (Code >> 12));
+            Result += static_cast<char>(0x80 | ((Code >> 6) & 0x3F));
+            Result += static_cast<char>(0x80 | (Code & 0x3F));
+        }
+        else
+        {
+            Result += static_cast<char>(0xF0 | (Code >> 18));
+            Result += static_cast<char>(0x80 | ((Code >> 12) & 0x3F));
+            Result += static_cast<char>(0x80 | ((Code >> 6) & 0x3F));
+            Result += static_cast<char>(0x80 | (Code & 0x3F));
+        }
+    }
+
+    return Result;
+}
+
+std::wstring Utf8ToWide(const std::string& Str)
+{
+    std::wstring Result;
+    Result.reserve(Str.size());
+
+    for (size_t i = 0; i < Str.size();)
+    {
+        uint8_t Lead = static_cast<uint8_t>(Str[i]);
+        uint32_t Code = 0;
+        size_t Length = 1;
+
+        if (Lead < 0x80)
+            Code = Lead;
+        else if ((Lead & 0xE0) == 0xC0)
+            Code = Lead & 0x1F, Length = 2;
+        else if ((Lead & 0xF0) == 0xE0)
+            Code = Lead & 0x0F, Length = 3;
+        else if ((Lead & 0xF8) == 0xF0)
+            Code = Lead & 0x07, Length = 4;
+        else
+            Code = 0xFFFD;
+
+        if (i + Length > Str.size())
+        {
+            Code = 0xFFFD;
+            Length = Str.size() - i;
+        }
+
+        for (size_t j = 1; j < Length && Code != 0xFFFD; j++)
+            Code = (Code << 6) | (static_cast<uint8_t>(Str[i + j]) & 0x3F);
+
+        i += Length;
+
+        if (sizeof(wchar_t) == 2 && Code >= 0x10000)
+        {
+            Code -= 0x10000;
+            Result += static_cast<wchar_t>(0xD800 + (Code >> 10));
+            Result += static_cast<wchar_t>(0xDC00 + (Code & 0x3FF));
+        }
+        else
+        {
+            Result += static_cast<wchar_t>(Code);
+        }
+    }
+
+    return Result;
+}
+
+int RunWideMain(int argc, char* argv[], int (*WideMain)(int, wchar_t*[]))
+{
+    setlocale(LC_ALL, "C.UTF-8");
+
+    std::vector<std::wstring> Args;
+    std::vector<wchar_t*> WideArgv;
+
+    Args.reserve(argc);
+
+    for (int i = 0; i < argc; i++)
+        Args.push_back(Utf8ToWide(argv[i]));
+
+    for (std::wstring& Arg : Args)
+        WideArgv.push_back(Arg.data());
+
+    WideArgv.push_back(nullptr);
+
+    return WideMain(argc, WideArgv.data());
+}
+
+MappedFile::MappedFile(MappedFile&& Other) noexcept
+{
+    *this = std::move(Other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& Other) noexcept
+{
+    if (this != &Other)
+    {
+        Close();
+
+        Base = Other.Base;
+        FileSize = Other.FileSize;
+        Other.Base = nullptr;
+        Other.FileSize = 0;
+
+#ifdef _WIN32
+        hFile = Other.hFile;
+        hMapping = Other.hMapping;
+        Other.hFile = nullptr;
+        Other.hMapping = nullptr;
+#endif
+    }
+
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool GetFileIdentity(const std::filesystem::path& Path, FileIdentity& Identity)
+{
+#ifdef _WIN32
+    // No access rights requested: only metadata is queried, the file contents are never touched.
+    HANDLE File = CreateFileW(Path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    BY_HANDLE_FILE_INFORMATION Info;
+    bool bResult = GetFileInformationByHandle(File, &Info) != FALSE;
+
+    CloseHandle(File);
+
+    if (!bResult || (Info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+
+    Identity.Size = (static_cast<uint64_t>(Info.nFileSizeHigh) << 32) | Info.nFileSizeLow;
+    Identity.WriteTime = static_cast<int64_t>((static_cast<uint64_t>(Info.ftLastWriteTime.dwHighDateTime) << 32) | Info.ftLastWriteTime.dwLowDateTime);
+    Identity.Volume = Info.dwVolumeSerialNumber;
+    Identity.FileId = (static_cast<uint64_t>(Info.nFileIndexHigh) << 32) | Info.nFileIndexLow;
+#else
+    struct stat St;
+
+    if (stat(Path.c_str(), &St) != 0 || !S_ISREG(St.st_mode))
+        return false;
+
+    Identity.Size = static_cast<uint64_t>(St.st_size);
+    Identity.WriteTime = static_cast<int64_t>(St.st_mtim.tv_sec) * 1000000000 + St.st_mtim.tv_nsec;
+    Identity.Volume = static_cast<uint64_t>(St.st_dev);
+    Identity.FileId = static_cast<uint64_t>(St.st_ino);
+#endif
+
+    return true;
+}
+
+uint32_t GetCurrentPid()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<uint32_t>(getpid());
+#endif
+}
+
+bool FileLock::Lock(const std::filesystem::path& Path)
+{
+    Unlock();
+
+#ifdef _WIN32
+    HANDLE File = CreateFileW(Path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    OVERLAPPED Overlapped = {};
+
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    if (!LockFileEx(File, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &Overlapped))
+    {
+        CloseHandle(File);
+
+        return false;
+    }
+
+    hFile = File;
+#else
+    int File = open(Path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    int Result;
+
+    if (File < 0)
+        return false;
+
+    while ((Result = flock(File, LOCK_EX)) != 0 && errno == EINTR)
+        ;
+
+    if (Result != 0)
+    {
+        close(File);
+
+        return false;
+    }
+
+    Fd = File;
+#endif
+
+    return true;
+}
+
+void FileLock::Unlock()
+{
+#ifdef _WIN32
+    if (!hFile)
+        return;
+
+    OVERLAPPED Overlapped = {};
+
+    UnlockFileEx(hFile, 0, 1, 0, &Overlapped);
+    CloseHandle(hFile);
+    hFile = nullptr;
+#else
+    if (Fd < 0)
+        return;
+
+    flock(Fd, LOCK_UN);
+    close(Fd);
+    Fd = -1;
+#endif
+}
+
+bool MappedFile::Open(const std::filesystem::path& Path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE File = CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER Size;
+
+    if (!GetFileSizeEx(File, &Size) || Size.QuadPart == 0)
+    {
+        CloseHandle(File);
+
+        return false;
+    }
+
+    HANDLE Mapping = CreateFileMappingW(File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (!Mapping)
+    {
+        CloseHandle(File);
+
+        return false;
+    }
+
+    void* View = MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!View)
+    {
+        CloseHandle(Mapping);
+        CloseHandle(File);
+
+        return false;
+    }
+
+    hFile = File;
+    hMapping = Mapping;
+    Base = static_cast<const uint8_t*>(View);
+    FileSize = static_cast<uint64_t>(Size.QuadPart);
+#else
+    int Fd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (Fd < 0)
+        return false;
+
+    struct stat St;
+
+    if (fstat(Fd, &St) != 0 || St.st_size == 0)
+    {
+        close(Fd);
+
+        return false;
+    }
+
+    void* View = mmap(nullptr, static_cast<size_t>(St.st_size), PROT_READ, MAP_SHARED, Fd, 0);
+
+    close(Fd);
+
+    if (View == MAP_FAILED)
+        return false;
+
+    Base = static_cast<const uint8_t*>(View);
+    FileSize = static_cast<uint64_t>(St.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!Base)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(Base);
+    CloseHandle(hMapping);
+    CloseHandle(hFile);
+
+    hMapping = nullptr;
+    hFile = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(Base), static_cast<size_t>(FileSize));
+#endif
+
+    Base = nullptr;
+    FileSize = 0;
+}
+
+ReadOnlyFile::ReadOnlyFile(ReadOnlyFile&& Other) noexcept
+{
+    *this = std::move(Other);
+}
+
+ReadOnlyFile& ReadOnlyFile::operator=(ReadOnlyFile&& Other) noexcept
+{
+    if (this != &Other)
+    {
+        Close();
+
+        FileSize = Other.FileSize;
+        Other.FileSize = 0;
+
+#ifdef _WIN32
+        hFile = Other.hFile;
+        Other.hFile = nullptr;
+#else
+        Fd = Other.Fd;
+        Other.Fd = -1;
+#endif
+    }
+
+    return *this;
+}
+
+ReadOnlyFile::~ReadOnlyFile()
+{
+    Close();
+}
+
+bool ReadOnlyFile::Open(const std::filesystem::path& Path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE File = CreateFileW(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+    if (File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER Size;
+
+    if (!GetFileSizeEx(File, &Size) || Size.QuadPart == 0)
+    {
+        CloseHandle(File);
+
+        return false;
+    }
+
+    hFile = File;
+    FileSize = static_cast<uint64_t>(Size.QuadPart);
+#else
+    int File = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (File < 0)
+        return false;
+
+    struct stat St;
+
+    if (fstat(File, &St) != 0 || St.st_size == 0)
+    {
+        close(File);
+
+        return false;
+    }
+
+    // Page-sized reads all over the file: keep the kernel from reading ahead on its own.
+    posix_fadvise(File, 0, 0, POSIX_FADV_RANDOM);
+
+    Fd = File;
+    FileSize = static_cast<uint64_t>(St.st_size);
+#endif
+
+    return true;
+}
+
+void ReadOnlyFile::Close()
+{
+    if (!FileSize)
+        return;
+
+#ifdef _WIN32
+    CloseHandle(hFile);
+    hFile = nullptr;
+#else
+    close(Fd);
+    Fd = -1;
+#endif
+
+    FileSize = 0;
+}
+
+bool ReadOnlyFile::ReadAt(uint64_t Offset, void* Buffer, size_t Size) const
+{
+    if (Offset > FileSize || Size > FileSize - Offset)
+        return false;
+
+    uint8_t* Cursor = static_cast<uint8_t*>(Buffer);
+
+    while (Size)
+    {
+#ifdef _WIN32
+        // The offset travels in the OVERLAPPED, so concurrent reads on the shared handle don't race on its file pointer.
+        OVERLAPPED Overlapped = {};
+        DWORD Chunk = static_cast<DWORD>(std::min<size_t>(Size, 1u << 30));
+        DWORD Read = 0;
+
+        Overlapped.Offset = static_cast<DWORD>(Offset);
+        Overlapped.OffsetHigh = static_cast<DWORD>(Offset >> 32);
+
+        if (!ReadFile(hFile, Cursor, Chunk, &Read, &Overlapped) || !Read)
+            return false;
+#else
+        ssize_t Read = pread(Fd, Cursor, Size, static_cast<off_t>(Offset));
+
+        if (Read < 0 && errno == EINTR)
+            continue;
+
+        if (Read <= 0)
+            return false;
+#endif
+
+        Cursor += Read;
+        Offset += Read;
+        Size -= Read;
+    }
+
+    return true;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cwchar>
+#include <string>
+#include <filesystem>
+
+#ifndef _WIN32
+#include <strings.h>
+
+#define printf_s printf
+#define wprintf_s wprintf
+#define sprintf_s(Buffer, ...) snprintf(Buffer, sizeof(Buffer), __VA_ARGS__)
+#define _wcsicmp wcscasecmp
+#endif
+
+std::filesystem::path GetExecutablePath();
+
+std::string WideToUtf8(const std::wstring& Str);
+std::wstring Utf8ToWide(const std::string& Str);
+
+int RunWideMain(int argc, char* argv[], int (*WideMain)(int, wchar_t*[]));
+
+// Size, last write time and file ID (device/volume + inode/file index) of a file, without reading it.
+struct FileIdentity
+{
+    uint64_t Size = 0;
+    int64_t WriteTime = 0;
+    uint64_t Volume = 0;
+    uint64_t FileId = 0;
+
+    bool operator==(const FileIdentity&) const = default;
+};
+
+bool GetFileIdentity(const std::filesystem::path& Path, FileIdentity& Identity);
+
+uint32_t GetCurrentPid();
+
+// Exclusive lock on a file that exists only to be locked, so processes sharing a directory take turns. The file is
+// created if needed and left in place; the lock goes with Unlock() or the object.
+class FileLock
+{
+public:
+    FileLock() = default;
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+    ~FileLock() { Unlock(); }
+
+    // Blocks until the lock is taken.
+    bool Lock(const std::filesystem::path& Path);
+    void Unlock();
+
+private:
+#ifdef _WIN32
+    void* hFile = nullptr;
+#else
+    int Fd = -1;
+#endif
+};
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& Other) noexcept;
+    MappedFile& operator=(MappedFile&& Other) noexcept;
+    ~MappedFile();
+
+    bool Open(const std::filesystem::path& Path);
+    void Close();
+
+    const uint8_t* Data() const { return Base; }
+    uint64_t Size() const { return FileSize; }
+    bool IsOpen() const { return Base != nullptr; }
+
+private:
+    const uint8_t* Base = nullptr;
+    uint64_t FileSize = 0;
+
+#ifdef _WIN32
+    void* hFile = nullptr;
+    void* hMapping = nullptr;
+#endif
+};
+
+// Positional reads without mapping the file, for files too large to map as a whole. ReadAt is safe to call from
+// any number of threads at once.
+class ReadOnlyFile
+{
+public:
+    ReadOnlyFile() = default;
+    ReadOnlyFile(const ReadOnlyFile&) = delete;
+    ReadOnlyFile& operator=(const ReadOnlyFile&) = delete;
+    ReadOnlyFile(ReadOnlyFile&& Other) noexcept;
+    ReadOnlyFile& operator=(ReadOnlyFile&& Other) noexcept;
+    ~ReadOnlyFile();
+
+    bool Open(const std::filesystem::path& Path);
+    void Close();
+
+    // Fails unless all Size bytes could be read.
+    bool ReadAt(uint64_t Offset, void* Buffer, size_t Size) const;
+
+    uint64_t Size() const { return FileSize; }
+    bool IsOpen() const { return FileSize != 0; }
+
+#ifndef _WIN32
+    // For I/O the class doesn't wrap (io_uring).
+    int GetDescriptor() const { return Fd; }
+#endif
+
+private:
+    uint64_t FileSize = 0;
+
+#ifdef _WIN32
+    void* hFile = nullptr;
+#else
+    int Fd = -1;
+#endif
+};
@@ -0,0 +1,575 @@
+#include "SignatureScan.h"
+#include "CodeView.h"
+#include "PeFile.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#include <immintrin.h>
+#define AEPDB_X86 1
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AEPDB_TARGET(Isa)
+#else
+#define AEPDB_TARGET(Isa) __attribute__((target(Isa)))
+#endif
+#endif
+
+// Bytes that show up all over x64 code (ModRM/REX prefixes, padding, common opcodes), most frequent first. Anchors
+// avoid them; ties between uncommon bytes go to the lower value, which keeps the anchor byte sets of many patterns
+// small.
+static constexpr uint8_t CommonBytes[] = { 0x00, 0xFF, 0xCC, 0x48, 0x8B, 0x89, 0x0F, 0x4C, 0x24, 0x44, 0x90, 0xE8, 0x85, 0xC0,
+    0x8D, 0x83, 0x01, 0x49, 0x41, 0x4D, 0x74, 0x75, 0xEB, 0xC3, 0x33, 0x08, 0x10, 0x20, 0x28, 0x30, 0x38, 0x40 };
+
+static uint32_t GetBytePenalty(uint8_t Byte)
+{
+    const uint8_t* Common = std::find(std::begin(CommonBytes), std::end(CommonBytes), Byte);
+
+    if (Common != std::end(CommonBytes))
+        return 512 - static_cast<uint32_t>(Common - std::begin(CommonBytes));
+
+    return Byte;
+}
+
+static int GetHexDigit(char Char)
+{
+    if (Char >= '0' && Char <= '9')
+        return Char - '0';
+
+    if (Char >= 'a' && Char <= 'f')
+        return Char - 'a' + 10;
+
+    if (Char >= 'A' && Char <= 'F')
+        return Char - 'A' + 10;
+
+    return -1;
+}
+
+bool BytePattern::Parse(std::string_view Text, std::string& Error)
+{
+    Bytes.clear();
+    Mask.clear();
+
+    size_t Pos = 0;
+
+    while (Pos < Text.size())
+    {
+        if (std::isspace(static_cast<unsigned char>(Text[Pos])))
+        {
+            Pos++;
+
+            continue;
+        }
+
+        size_t End = Pos;
+
+        while (End < Text.size() && !std::isspace(static_cast<unsigned char>(Text[End])))
+            End++;
+
+        std::string_view Token = Text.substr(Pos, End - Pos);
+
+        Pos = End;
+
+        if (Token == "?" || Token == "??")
+        {
+            Bytes.push_back(0);
+            Mask.push_back(0);
+
+            continue;
+        }
+
+        if (Token.size() != 2 || GetHexDigit(Token[0]) < 0 || GetHexDigit(Token[1]) < 0)
+        {
+            Error = "Bad pattern byte '" + std::string(Token) + "'";
+
+            return false;
+        }
+
+        Bytes.push_back(static_cast<uint8_t>(GetHexDigit(Token[0]) << 4 | GetHexDigit(Token[1])));
+        Mask.push_back(0xFF);
+    }
+
+    uint32_t BestPenalty = UINT32_MAX;
+
+    for (uint32_t i = 0; i + 1 < Bytes.size(); i++)
+    {
+        if (!Mask[i] || !Mask[i + 1])
+            continue;
+
+        uint32_t Penalty = GetBytePenalty(Bytes[i]) << 10 | GetBytePenalty(Bytes[i + 1]);
+
+        if (Penalty < BestPenalty)
+        {
+            BestPenalty = Penalty;
+            Anchor = i;
+        }
+    }
+
+    if (BestPenalty == UINT32_MAX)
+    {
+        Error = Bytes.empty() ? "Empty pattern" : "Pattern needs two adjacent fixed bytes";
+
+        return false;
+    }
+
+    return true;
+}
+
+bool BytePattern::Match(const uint8_t* Data) const
+{
+    for (size_t i = 0; i < Bytes.size(); i++)
+    {
+        if ((Data[i] & Mask[i]) != Bytes[i])
+            return false;
+    }
+
+    return true;
+}
+
+SignatureScanner::SignatureScanner(std::vector<BytePattern> ScanPatterns) : Patterns(std::move(ScanPatterns)), AnchorBits(65536 / 64)
+{
+    for (uint32_t i = 0; i < Patterns.size(); i++)
+    {
+        uint16_t Pair = Patterns[i].GetAnchorPair();
+        uint8_t Bytes[2] = { static_cast<uint8_t>(Pair), static_cast<uint8_t>(Pair >> 8) };
+
+        AnchorBits[Pair >> 6] |= 1ull << (Pair & 63);
+        AnchorPatterns.emplace_back(Pair, i);
+
+        for (uint32_t j = 0; j < 2; j++)
+            SetRows[j * 2 + (Bytes[j] >> 7)][Bytes[j] & 0x0F] |= static_cast<uint8_t>(1 << ((Bytes[j] >> 4) & 7));
+    }
+
+    std::sort(AnchorPatterns.begin(), AnchorPatterns.end());
+}
+
+ScanLevel SignatureScanner::GetBestLevel()
+{
+#ifdef AEPDB_X86
+#ifdef _MSC_VER
+    int Info[4];
+
+    __cpuid(Info, 0);
+
+    if (Info[0] < 7)
+        return ScanLevel::Scalar;
+
+    __cpuid(Info, 1);
+
+    bool bSse42 = (Info[2] & (1 << 20)) != 0;
+    bool bOsSavesAvx = (Info[2] & (1 << 27)) != 0 && (Info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+
+    __cpuidex(Info, 7, 0);
+
+    if (bOsSavesAvx && (Info[1] & (1 << 5)))
+        return ScanLevel::Avx2;
+
+    return bSse42 ? ScanLevel::Sse42 : ScanLevel::Scalar;
+#else
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return ScanLevel::Avx2;
+
+    return __builtin_cpu_supports("sse4.2") ? ScanLevel::Sse42 : ScanLevel::Scalar;
+#endif
+#else
+    return ScanLevel::Scalar;
+#endif
+}
+
+const char* SignatureScanner::GetLevelName(ScanLevel Level)
+{
+    switch (Level)
+    {
+    case ScanLevel::Avx2:
+        return "AVX2";
+    case ScanLevel::Sse42:
+        return "SSE4.2";
+    default:
+        return "scalar";
+    }
+}
+
+void SignatureScanner::CheckCandidate(const uint8_t* Data, size_t Size, size_t Position, const std::function<void(uint32_t, size_t)>& OnMatch) const
+{
+    uint16_t Pair = static_cast<uint16_t>(Data[Position] | (Data[Position + 1] << 8));
+
+    if (!HasAnchor(Pair))
+        return;
+
+    auto First = std::lower_bound(AnchorPatterns.begin(), AnchorPatterns.end(), std::make_pair(Pair, 0u));
+
+    for (auto Entry = First; Entry != AnchorPatterns.end() && Entry->first == Pair; ++Entry)
+    {
+        const BytePattern& Pattern = Patterns[Entry->second];
+
+        if (Position < Pattern.Anchor || Position - Pattern.Anchor + Pattern.Bytes.size() > Size)
+            continue;
+
+        if (Pattern.Match(Data + Position - Pattern.Anchor))
+            OnMatch(Entry->second, Position - Pattern.Anchor);
+    }
+}
+
+#ifdef AEPDB_X86
+// Lanes whose byte is in the set given by the two row tables.
+AEPDB_TARGET("sse4.2") static inline __m128i IsInByteSet(__m128i Block, __m128i RowsLow, __m128i RowsHigh)
+{
+    const __m128i NibbleMask = _mm_set1_epi8(0x0F);
+    const __m128i BitsLow = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i BitsHigh = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m128i Low = _mm_and_si128(Block, NibbleMask);
+    __m128i High = _mm_and_si128(_mm_srli_epi16(Block, 4), NibbleMask);
+    __m128i Bits = _mm_or_si128(_mm_and_si128(_mm_shuffle_epi8(RowsLow, Low), _mm_shuffle_epi8(BitsLow, High)),
+        _mm_and_si128(_mm_shuffle_epi8(RowsHigh, Low), _mm_shuffle_epi8(BitsHigh, High)));
+
+    return _mm_xor_si128(_mm_cmpeq_epi8(Bits, _mm_setzero_si128()), _mm_set1_epi8(-1));
+}
+
+AEPDB_TARGET("sse4.2") size_t SignatureScanner::ScanSse42(const uint8_t* Data, size_t Size, const std::function<void(uint32_t, size_t)>& OnMatch) const
+{
+    const __m128i Rows[4] = { _mm_load_si128(reinterpret_cast<const __m128i*>(SetRows[0])), _mm_load_si128(reinterpret_cast<const __m128i*>(SetRows[1])),
+        _mm_load_si128(reinterpret_cast<const __m128i*>(SetRows[2])), _mm_load_si128(reinterpret_cast<const __m128i*>(SetRows[3])) };
+    size_t i = 0;
+
+    // The second anchor byte of the last position is read from the next block, hence the extra byte.
+    for (; i + 17 <= Size; i += 16)
+    {
+        __m128i First = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + i));
+        __m128i Second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Data + i + 1));
+        uint32_t Candidates = static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(IsInByteSet(First, Rows[0], Rows[1]), IsInByteSet(Second, Rows[2], Rows[3]))));
+
+        while (Candidates)
+        {
+            CheckCandidate(Data, Size, i + std::countr_zero(Candidates), OnMatch);
+            Candidates &= Candidates - 1;
+        }
+    }
+
+    return i;
+}
+
+AEPDB_TARGET("avx2") static inline __m256i IsInByteSet(__m256i Block, __m256i RowsLow, __m256i RowsHigh)
+{
+    const __m256i NibbleMask = _mm256_set1_epi8(0x0F);
+    const __m256i BitsLow = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i BitsHigh = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    __m256i Low = _mm256_and_si256(Block, NibbleMask);
+    __m256i High = _mm256_and_si256(_mm256_srli_epi16(Block, 4), NibbleMask);
+    __m256i Bits = _mm256_or_si256(_mm256_and_si256(_mm256_shuffle_epi8(RowsLow, Low), _mm256_shuffle_epi8(BitsLow, High)),
+        _mm256_and_si256(_mm256_shuffle_epi8(RowsHigh, Low), _mm256_shuffle_epi8(BitsHigh, High)));
+
+    return _mm256_xor_si256(_mm256_cmpeq_epi8(Bits, _mm256_setzero_si256()), _mm256_set1_epi8(-1));
+}
+
+AEPDB_TARGET("avx2") size_t SignatureScanner::ScanAvx2(const uint8_t* Data, size_t Size, const std::function<void(uint32_t, size_t)>& OnMatch) const
+{
+    // Shuffles look up within each 128-bit lane, so both lanes get the same tables.
+    __m256i Rows[4];
+
+    for (uint32_t j = 0; j < 4; j++)
+        Rows[j] = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(SetRows[j])));
+
+    size_t i = 0;
+
+    for (; i + 33 <= Size; i += 32)
+    {
+        __m256i First = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + i));
+        __m256i Second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Data + i + 1));
+        uint32_t Candidates = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_and_si256(IsInByteSet(First, Rows[0], Rows[1]), IsInByteSet(Second, Rows[2], Rows[3]))));
+
+        while (Candidates)
+        {
+            CheckCandidate(Data, Size, i + std::countr_zero(Candidates), OnMatch);
+            Candidates &= Candidates - 1;
+        }
+    }
+
+    return i;
+}
+#else
+size_t SignatureScanner::ScanSse42(const uint8_t*, size_t, const std::function<void(uint32_t, size_t)>&) const
+{
+    return 0;
+}
+
+size_t SignatureScanner::ScanAvx2(const uint8_t*, size_t, const std::function<void(uint32_t, size_t)>&) const
+{
+    return 0;
+}
+#endif
+
+void SignatureScanner::Scan(const uint8_t* Data, size_t Size, const std::function<void(uint32_t, size_t)>& OnMatch, ScanLevel Level) const
+{
+    if (Patterns.empty() || Size < 2)
+        return;
+
+    size_t i = 0;
+
+    if (Level == ScanLevel::Avx2)
+        i = ScanAvx2(Data, Size, OnMatch);
+    else if (Level == ScanLevel::Sse42)
+        i = ScanSse42(Data, Size, OnMatch);
+
+    for (; i + 1 < Size; i++)
+        CheckCandidate(Data, Size, i, OnMatch);
+}
+
+static std::string_view Trim(std::string_view Text)
+{
+    size_t First = Text.find_first_not_of(" \t\r");
+
+    if (First == std::string_view::npos)
+        return {};
+
+    return Text.substr(First, Text.find_last_not_of(" \t\r") - First + 1);
+}
+
+static std::string ToLower(std::string_view Text)
+{
+    std::string Lower(Text);
+
+    for (char& Char : Lower)
+        Char = static_cast<char>(std::tolower(static_cast<unsigned char>(Char)));
+
+    return Lower;
+}
+
+static bool ParseSignature(std::string_view Line, Signature& Entry, std::string& Error)
+{
+    size_t Equals = Line.find('=');
+
+    if (Equals == std::string_view::npos || Trim(Line.substr(0, Equals)).empty())
+    {
+        Error = "Expected 'Symbol = <pattern>'";
+
+        return false;
+    }
+
+    Entry.Symbol = std::string(Trim(Line.substr(0, Equals)));
+
+    std::string PatternText;
+    std::string_view Rest = Line.substr(Equals + 1);
+
+    while (!(Rest = Trim(Rest)).empty())
+    {
+        size_t End = Rest.find_first_of(" \t");
+        std::string Token(Rest.substr(0, End));
+
+        Rest = End == std::string_view::npos ? std::string_view() : Rest.substr(End);
+
+        if (Token.size() > 1 && (Token[0] == '+' || Token[0] == '-'))
+        {
+            char* Last;
+
+            Entry.Adjustment = std::strtoll(Token.c_str(), &Last, 0);
+
+            if (*Last)
+            {
+                Error = "Bad offset '" + Token + "'";
+
+                return false;
+            }
+        }
+        else if (Token.starts_with("rel32@"))
+        {
+            char* Last;
+
+            Entry.Rel32Position = static_cast<int32_t>(std::strtol(Token.c_str() + 6, &Last, 0));
+
+            if (*Last || Entry.Rel32Position < 0)
+            {
+                Error = "Bad displacement position '" + Token + "'";
+
+                return false;
+            }
+        }
+        else
+        {
+            PatternText += Token;
+            PatternText += ' ';
+        }
+    }
+
+    if (!Entry.Pattern.Parse(PatternText, Error))
+        return false;
+
+    if (Entry.Rel32Position >= 0 && static_cast<size_t>(Entry.Rel32Position) + 4 > Entry.Pattern.Bytes.size())
+    {
+        Error = "Displacement past the end of the pattern";
+
+        return false;
+    }
+
+    return true;
+}
+
+bool SignatureFile::Load(const std::filesystem::path& Path, std::string& Error)
+{
+    std::ifstream In(Path);
+
+    Modules.clear();
+
+    if (!In.is_open())
+    {
+        Error = "Can't open " + Path.string();
+
+        return false;
+    }
+
+    std::vector<Signature>* Module = nullptr;
+    std::string Line;
+    uint32_t LineNumber = 0;
+
+    while (std::getline(In, Line))
+    {
+        LineNumber++;
+
+        std::string_view Text = Trim(std::string_view(Line).substr(0, Line.find_first_of("#;")));
+
+        if (Text.empty())
+            continue;
+
+        std::string LineError;
+
+        if (Text.front() == '[' && Text.back() == ']')
+        {
+            Module = &Modules[ToLower(Trim(Text.substr(1, Text.size() - 2)))];
+
+            continue;
+        }
+
+        Signature Entry;
+
+        if (!Module)
+            LineError = "Signature outside of a [module] section";
+        else if (ParseSignature(Text, Entry, LineError))
+            Module->push_back(std::move(Entry));
+
+        if (!LineError.empty())
+        {
+            Error = Path.filename().string() + ":" + std::to_string(LineNumber) + ": " + LineError;
+            Modules.clear();
+
+            return false;
+        }
+    }
+
+    if (Modules.empty())
+    {
+        Error = "No signatures in " + Path.string();
+
+        return false;
+    }
+
+    return true;
+}
+
+const std::vector<Signature>* SignatureFile::Find(const std::filesystem::path& PePath) const
+{
+    auto Module = Modules.find(ToLower(PePath.filename().string()));
+
+    return Module != Modules.end() ? &Module->second : nullptr;
+}
+
+bool ResolveSignatureOffsets(const SignatureFile& Signatures, const std::filesystem::path& PePath, const std::vector<std::wstring>& Names,
+    std::map<std::wstring, std::wstring>& Offsets)
+{
+    ScopedTimer Timer("Signature scan");
+    const std::vector<Signature>* Module = Signatures.Find(PePath);
+    MappedFile Image;
+    std::vector<PeSection> Sections;
+
+    if (!Module || !Image.Open(PePath) || !GetPeSections(Image.Data(), Image.Size(), Sections))
+    {
+        printf_s("[-] Can't scan %ls for signatures! :(\n\n", PePath.filename().wstring().c_str());
+
+        AddStat(StatCounter::SymbolsMissing, Names.size());
+
+        return false;
+    }
+
+    bool bIsSuccess = true;
+    std::vector<const Signature*> Wanted;
+    std::vector<BytePattern> Patterns;
+
+    for (const std::wstring& Sym : Names)
+    {
+        std::string Name = WideToUtf8(Sym);
+        auto Entry = std::find_if(Module->begin(), Module->end(), [&](const Signature& Candidate) { return Candidate.Symbol == Name; });
+
+        if (Entry == Module->end())
+        {
+            printf_s("[-] No signature for '%ls'! :(\n\n", Sym.c_str());
+
+            AddStat(StatCounter::SymbolsMissing);
+            bIsSuccess = false;
+
+            continue;
+        }
+
+        Wanted.push_back(&*Entry);
+        Patterns.push_back(Entry->Pattern);
+    }
+
+    // All signatures are looked for in a single pass over each executable section.
+    SignatureScanner Scanner(std::move(Patterns));
+    ScanLevel Level = SignatureScanner::GetBestLevel();
+    std::vector<uint32_t> NumMatches(Wanted.size());
+    std::vector<uint64_t> Rvas(Wanted.size());
+
+    for (const PeSection& Section : Sections)
+    {
+        if (!Section.IsExecutable() || !Section.RawSize)
+            continue;
+
+        const uint8_t* Data = Image.Data() + Section.RawPointer;
+        size_t Size = Section.VirtualSize ? std::min(Section.RawSize, Section.VirtualSize) : Section.RawSize;
+
+        Scanner.Scan(Data, Size, [&](uint32_t Id, size_t Offset)
+            {
+                const Signature& Entry = *Wanted[Id];
+                uint64_t Rva = Section.VirtualAddress + Offset;
+
+                if (Entry.Rel32Position >= 0)
+                    Rva += Entry.Rel32Position + 4 + static_cast<int64_t>(LoadValue<int32_t>(Data + Offset + Entry.Rel32Position));
+
+                Rvas[Id] = Rva + Entry.Adjustment;
+                NumMatches[Id]++;
+            }, Level);
+    }
+
+    for (size_t i = 0; i < Wanted.size(); i++)
+    {
+        std::wstring Sym = Utf8ToWide(Wanted[i]->Symbol);
+
+        if (NumMatches[i] != 1)
+        {
+            if (NumMatches[i])
+                printf_s("[-] Signature for '%ls' is ambiguous (%u matches)! :(\n\n", Sym.c_str(), NumMatches[i]);
+            else
+                printf_s("[-] Signature for '%ls' not found! :(\n\n", Sym.c_str());
+
+            AddStat(StatCounter::SymbolsMissing);
+            bIsSuccess = false;
+
+            continue;
+        }
+
+        printf_s("[+] Found symbol '%ls' by signature -> Offset: %llu\n", Sym.c_str(), static_cast<unsigned long long>(Rvas[i]));
+
+        Offsets[Sym] = std::to_wstring(Rvas[i]);
+        AddStat(StatCounter::SymbolsResolved);
+    }
+
+    return bIsSuccess;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <functional>
+#include <map>
+#include <string_view>
+#include <vector>
+
+// Byte pattern in the usual "48 8B 05 ?? ?? ?? ?? C3" notation, '?' or "??" is a wildcard byte. Candidates are
+// found through the Anchor: two adjacent fixed bytes, picked to be as uncommon in machine code as possible.
+struct BytePattern
+{
+    std::vector<uint8_t> Bytes;
+    // 0xFF where the byte has to match, 0 for wildcards.
+    std::vector<uint8_t> Mask;
+    uint32_t Anchor = 0;
+
+    bool Parse(std::string_view Text, std::string& Error);
+    bool Match(const uint8_t* Data) const;
+    uint16_t GetAnchorPair() const { return static_cast<uint16_t>(Bytes[Anchor] | (Bytes[Anchor + 1] << 8)); }
+};
+
+enum class ScanLevel
+{
+    Scalar,
+    Sse42,
+    Avx2,
+};
+
+// Finds any number of patterns in one pass over the data. The SIMD paths test 16 (SSE4.2) or 32 (AVX2) positions at
+// a time: two shuffle lookups per byte tell whether a byte is the first byte of any anchor, two more whether the next
+// one can follow as the second. Positions passing both, or every position on the scalar path, are tested against a
+// 64K-bit set of the exact anchor pairs, then looked up by their anchor and verified byte by byte.
+class SignatureScanner
+{
+public:
+    explicit SignatureScanner(std::vector<BytePattern> ScanPatterns);
+
+    static ScanLevel GetBestLevel();
+    static const char* GetLevelName(ScanLevel Level);
+
+    // Calls OnMatch(pattern index, offset of the match) for every match, in no particular order across patterns.
+    void Scan(const uint8_t* Data, size_t Size, const std::function<void(uint32_t, size_t)>& OnMatch, ScanLevel Level) const;
+
+private:
+    bool HasAnchor(uint16_t Pair) const { return (AnchorBits[Pair >> 6] >> (Pair & 63)) & 1; }
+    void CheckCandidate(const uint8_t* Data, size_t Size, size_t Position, const std::function<void(uint32_t, size_t)>& OnMatch) const;
+    size_t ScanSse42(const uint8_t* Data, size_t Size, const std::function<void(uint32_t, size_t)>& OnMatch) const;
+    size_t ScanAvx2(const uint8_t* Data, size_t Size, const std::function<void(uint32_t, size_t)>& OnMatch) const;
+
+    std::vector<BytePattern> Patterns;
+    std::vector<uint64_t> AnchorBits;
+    // (anchor pair, pattern index), sorted by pair.
+    std::vector<std::pair<uint16_t, uint32_t>> AnchorPatterns;
+    // 256-bit sets of the first and of the second anchor bytes, as rows by low nibble: bits for high nibbles 0-7 in
+    // SetRows[0]/[2], 8-15 in SetRows[1]/[3].
+    alignas(16) uint8_t SetRows[4][16] = {};
+};
+
+// One entry of a signature file. The symbol's RVA is the match, optionally followed through a rel32 displacement at
+// Rel32Position (RIP-relative operands, call/jmp targets), plus Adjustment.
+struct Signature
+{
+    std::string Symbol;
+    BytePattern Pattern;
+    int64_t Adjustment = 0;
+    int32_t Rel32Position = -1;
+};
+
+// Signatures per module: "[ntoskrnl.exe]" section headers followed by "Symbol = <pattern> [+/-Offset] [rel32@Position]"
+// lines, '#' and ';' start comments. Module names are matched case-insensitively.
+class SignatureFile
+{
+public:
+    bool Load(const std::filesystem::path& Path, std::string& Error);
+    bool IsLoaded() const { return !Modules.empty(); }
+    const std::vector<Signature>* Find(const std::filesystem::path& PePath) const;
+
+private:
+    std::map<std::string, std::vector<Signature>> Modules;
+};
+
+// Fallback for binaries without a usable PDB: scans the executable sections of the PE once for the signatures of all
+// requested names and fills Offsets like SymbolResolver::ResolveOffsets. Names without a signature, and signatures that
+// match nowhere or more than once, are reported and make it fail.
+bool ResolveSignatureOffsets(const SignatureFile& Signatures, const std::filesystem::path& PePath, const std::vector<std::wstring>& Names,
+    std::map<std::wstring, std::wstring>& Offsets);
@@ -0,0 +1,452 @@
+#include "SparsePdb.h"
+#include "MsfFile.h"
+#include "PdbFormat.h"
+#include "CodeView.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint32_t SuperBlockFetchSize = 4096;
+static constexpr uint32_t MaxGapBytes = 16 * 1024;
+static constexpr uint32_t NilStreamSize = 0xFFFFFFFF;
+static constexpr uint32_t ModInfoHeaderSize = 64;
+static constexpr uint32_t ProcRecordSize = 4 + 34;
+
+class RemoteMsf
+{
+public:
+    RemoteMsf(HttpTransport& Transport, const std::string& Url, SparseFetchStats& Stats) : Transport(Transport), Url(Url), Stats(Stats) {}
+
+    bool Open(HttpResponse& Response);
+    bool FetchStreams(const std::vector<uint32_t>& Streams, HttpResponse& Response);
+    bool FetchStreamRanges(const std::vector<std::pair<uint32_t, uint32_t>>& Ranges, uint32_t RangeSize, HttpResponse& Response);
+    bool ReadStream(uint32_t Stream, std::vector<uint8_t>& Out, bool bAllowMissing = false) const;
+
+    uint32_t GetBlockSize() const { return BlockSize; }
+    uint32_t GetStreamCount() const { return static_cast<uint32_t>(StreamSizes.size()); }
+    uint32_t GetStreamSize(uint32_t Stream) const { return Stream < StreamSizes.size() && StreamSizes[Stream] != NilStreamSize ? StreamSizes[Stream] : 0; }
+
+private:
+    bool Fail(HttpResponse& Response, const char* Message);
+    bool FetchRange(uint64_t Offset, uint64_t Size, std::vector<uint8_t>& Out, bool bAllowShort, HttpResponse& Response);
+    bool FetchBlocks(std::vector<uint32_t> Needed, HttpResponse& Response);
+    bool GatherBlocks(const uint32_t* List, uint32_t Count, uint32_t Size, std::vector<uint8_t>& Out, bool bAllowMissing = false) const;
+
+    HttpTransport& Transport;
+    std::string Url;
+    SparseFetchStats& Stats;
+
+    uint32_t BlockSize = 0;
+    uint32_t NumBlocks = 0;
+    std::vector<uint32_t> StreamSizes;
+    std::vector<std::vector<uint32_t>> StreamBlocks;
+    std::unordered_map<uint32_t, std::vector<uint8_t>> Blocks;
+};
+
+bool RemoteMsf::Fail(HttpResponse& Response, const char* Message)
+{
+    Response.Error = Message;
+
+    return false;
+}
+
+bool RemoteMsf::FetchRange(uint64_t Offset, uint64_t Size, std::vector<uint8_t>& Out, bool bAllowShort, HttpResponse& Response)
+{
+    Out.clear();
+    Out.reserve(static_cast<size_t>(Size));
+
+    auto OnBody = [&](const char* Data, size_t Length) -> bool
+    {
+        if (Response.StatusCode != 206)
+        {
+            Response.Error = "Server does not support range requests";
+
+            return false;
+        }
+
+        if (Out.size() + Length > Size)
+        {
+            Response.Error = "Server sent more data than requested";
+
+            return false;
+        }
+
+        Out.insert(Out.end(), Data, Data + Length);
+
+        return true;
+    };
+
+    bool bResult = Transport.Get(Url, Offset, Size, OnBody, Response);
+
+    Stats.Requests++;
+    Stats.BytesFetched += Response.Bytes;
+    AddStat(StatCounter::HttpRequests);
+    AddStat(StatCounter::BytesDownloaded, Response.Bytes);
+
+    if (!bResult)
+        return false;
+
+    if (Response.StatusCode != 206 || (Out.size() != Size && !bAllowShort))
+        return Fail(Response, "Short or unexpected range response");
+
+    // Later ranges go straight to the redirect target instead of bouncing off the symbol server again.
+    if (!Response.FinalUrl.empty())
+        Url = Response.FinalUrl;
+
+    return true;
+}
+
+bool RemoteMsf::Open(HttpResponse& Response)
+{
+    std::vector<uint8_t> Data;
+
+    if (!FetchRange(0, SuperBlockFetchSize, Data, true, Response))
+        return false;
+
+    MsfSuperBlock Super;
+
+    if (Data.size() < sizeof(Super))
+        return Fail(Response, "File is too small for MSF superblock");
+
+    memcpy(&Super, Data.data(), sizeof(Super));
+
+    if (memcmp(Super.FileMagic, MsfMagic, sizeof(Super.FileMagic)) != 0)
+        return Fail(Response, "Not an MSF 7.00 file");
+
+    if (Super.BlockSize < 512 || Super.BlockSize > 65536 || (Super.BlockSize & (Super.BlockSize - 1)) != 0)
+        return Fail(Response, "Invalid MSF block size");
+
+    BlockSize = Super.BlockSize;
+    NumBlocks = Super.NumBlocks;
+    Stats.RemoteSize = static_cast<uint64_t>(NumBlocks) * BlockSize;
+
+    for (uint32_t Offset = 0; Offset + BlockSize <= Data.size(); Offset += BlockSize)
+        Blocks[Offset / BlockSize].assign(Data.begin() + Offset, Data.begin() + Offset + BlockSize);
+
+    uint32_t NumDirBlocks = (Super.NumDirectoryBytes + BlockSize - 1) / BlockSize;
+
+    if (!Super.NumDirectoryBytes || Super.BlockMapAddr >= NumBlocks || NumDirBlocks * sizeof(uint32_t) > BlockSize)
+        return Fail(Response, "Invalid MSF stream directory location");
+
+    std::vector<uint8_t> BlockMap;
+
+    if (!FetchRange(static_cast<uint64_t>(Super.BlockMapAddr) * BlockSize, NumDirBlocks * sizeof(uint32_t), BlockMap, false, Response))
+        return false;
+
+    std::vector<uint32_t> DirBlocks(NumDirBlocks);
+
+    for (uint32_t i = 0; i < NumDirBlocks; i++)
+        DirBlocks[i] = LoadValue<uint32_t>(BlockMap.data() + i * sizeof(uint32_t));
+
+    std::vector<uint8_t> Directory;
+
+    if (!FetchBlocks(DirBlocks, Response))
+        return false;
+
+    if (!GatherBlocks(DirBlocks.data(), NumDirBlocks, Super.NumDirectoryBytes, Directory))
+        return Fail(Response, "MSF stream directory points outside of file");
+
+    const uint8_t* Cursor = Directory.data();
+    const uint8_t* End = Directory.data() + Directory.size();
+    uint32_t NumStreams = LoadValue<uint32_t>(Cursor);
+
+    Cursor += sizeof(uint32_t);
+
+    if (NumStreams > static_cast<uint64_t>(End - Cursor) / sizeof(uint32_t))
+        return Fail(Response, "Corrupted MSF stream directory");
+
+    StreamSizes.resize(NumStreams);
+    StreamBlocks.resize(NumStreams);
+
+    for (uint32_t i = 0; i < NumStreams; i++, Cursor += sizeof(uint32_t))
+        StreamSizes[i] = LoadValue<uint32_t>(Cursor);
+
+    for (uint32_t i = 0; i < NumStreams; i++)
+    {
+        uint32_t Count = static_cast<uint32_t>((static_cast<uint64_t>(GetStreamSize(i)) + BlockSize - 1) / BlockSize);
+
+        if (Count > static_cast<uint64_t>(End - Cursor) / sizeof(uint32_t))
+            return Fail(Response, "Corrupted MSF stream directory");
+
+        for (uint32_t j = 0; j < Count; j++, Cursor += sizeof(uint32_t))
+            StreamBlocks[i].push_back(LoadValue<uint32_t>(Cursor));
+    }
+
+    return true;
+}
+
+bool RemoteMsf::FetchBlocks(std::vector<uint32_t> Needed, HttpResponse& Response)
+{
+    Needed.erase(std::remove_if(Needed.begin(), Needed.end(), [this](uint32_t Block) { return Blocks.count(Block) != 0; }), Needed.end());
+    std::sort(Needed.begin(), Needed.end());
+    Needed.erase(std::unique(Needed.begin(), Needed.end()), Needed.end());
+
+    if (!Needed.empty() && Needed.back() >= NumBlocks)
+        return Fail(Response, "MSF stream points outside of file");
+
+    uint32_t MaxGap = std::max<uint32_t>(MaxGapBytes / BlockSize, 1);
+    std::vector<uint8_t> Data;
+
+    // Nearby blocks are coalesced into one request; the few gap blocks are cheaper than another round trip.
+    for (size_t i = 0; i < Needed.size();)
+    {
+        size_t j = i + 1;
+
+        while (j < Needed.size() && Needed[j] - Needed[j - 1] <= MaxGap)
+            j++;
+
+        uint32_t First = Needed[i];
+        uint32_t Count = Needed[j - 1] - First + 1;
+
+        if (!FetchRange(static_cast<uint64_t>(First) * BlockSize, static_cast<uint64_t>(Count) * BlockSize, Data, false, Response))
+            return false;
+
+        for (uint32_t k = 0; k < Count; k++)
+            Blocks[First + k].assign(Data.begin() + static_cast<size_t>(k) * BlockSize, Data.begin() + static_cast<size_t>(k + 1) * BlockSize);
+
+        i = j;
+    }
+
+    return true;
+}
+
+bool RemoteMsf::FetchStreams(const std::vector<uint32_t>& Streams, HttpResponse& Response)
+{
+    std::vector<uint32_t> Needed;
+
+    for (uint32_t Stream : Streams)
+    {
+        if (Stream < StreamBlocks.size())
+            Needed.insert(Needed.end(), StreamBlocks[Stream].begin(), StreamBlocks[Stream].end());
+    }
+
+    return FetchBlocks(std::move(Needed), Response);
+}
+
+bool RemoteMsf::FetchStreamRanges(const std::vector<std::pair<uint32_t, uint32_t>>& Ranges, uint32_t RangeSize, HttpResponse& Response)
+{
+    std::vector<uint32_t> Needed;
+
+    for (const auto& [Stream, Offset] : Ranges)
+    {
+        uint32_t Size = GetStreamSize(Stream);
+
+        if (Offset >= Size)
+            continue;
+
+        uint32_t Last = std::min<uint64_t>(static_cast<uint64_t>(Offset) + RangeSize, Size) - 1;
+
+        for (uint32_t Block = Offset / BlockSize; Block <= Last / BlockSize; Block++)
+            Needed.push_back(StreamBlocks[Stream][Block]);
+    }
+
+    return FetchBlocks(std::move(Needed), Response);
+}
+
+bool RemoteMsf::GatherBlocks(const uint32_t* List, uint32_t Count, uint32_t Size, std::vector<uint8_t>& Out, bool bAllowMissing) const
+{
+    Out.assign(Size, 0);
+
+    for (uint32_t i = 0, Copied = 0; i < Count && Copied < Size; i++)
+    {
+        auto It = Blocks.find(List[i]);
+        uint32_t Chunk = std::min(BlockSize, Size - Copied);
+
+        if (It != Blocks.end())
+            memcpy(Out.data() + Copied, It->second.data(), Chunk);
+        else if (!bAllowMissing)
+            return false;
+
+        Copied += Chunk;
+    }
+
+    return true;
+}
+
+bool RemoteMsf::ReadStream(uint32_t Stream, std::vector<uint8_t>& Out, bool bAllowMissing) const
+{
+    if (Stream >= StreamBlocks.size())
+        return false;
+
+    return GatherBlocks(StreamBlocks[Stream].data(), static_cast<uint32_t>(StreamBlocks[Stream].size()), GetStreamSize(Stream), Out, bAllowMissing);
+}
+
+static bool WriteCompactMsf(const RemoteMsf& Remote, const std::vector<bool>& Keep, const std::vector<bool>& Partial, const std::filesystem::path& Path,
+    SparseFetchStats& Stats, std::string& Error)
+{
+    MsfWriter Writer(Remote.GetBlockSize());
+
+    for (uint32_t i = 0; i < Remote.GetStreamCount(); i++)
+    {
+        std::vector<uint8_t> Contents;
+
+        if (!Keep[i])
+        {
+            Writer.AddNilStream();
+
+            continue;
+        }
+
+        if (!Remote.ReadStream(i, Contents, Partial[i]))
+        {
+            Error = "Stream " + std::to_string(i) + " was not fetched";
+
+            return false;
+        }
+
+        Writer.AddStream(std::move(Contents));
+        Stats.StreamsKept++;
+    }
+
+    std::filesystem::path TempPath = Path;
+    std::error_code RenameError;
+
+    TempPath += ".sparse";
+
+    if (!Writer.Write(TempPath, Error))
+    {
+        std::filesystem::remove(TempPath, RenameError);
+
+        return false;
+    }
+
+    std::filesystem::rename(TempPath, Path, RenameError);
+
+    if (RenameError)
+    {
+        Error = "Cannot move download into place: " + RenameError.message();
+        std::filesystem::remove(TempPath, RenameError);
+
+        return false;
+    }
+
+    return true;
+}
+
+bool FetchSparsePdb(HttpTransport& Transport, const std::string& Url, const std::filesystem::path& Path, bool bTypes, SparseFetchStats& Stats,
+    HttpResponse& Response)
+{
+    RemoteMsf Remote(Transport, Url, Stats);
+    std::vector<uint8_t> Dbi;
+
+    Stats = {};
+
+    if (!Remote.Open(Response) || !Remote.FetchStreams({ PdbInfoStream, PdbDbiStream }, Response))
+        return false;
+
+    DbiStreamHeader Header;
+
+    if (!Remote.ReadStream(PdbDbiStream, Dbi) || Dbi.size() < sizeof(Header))
+    {
+        Response.Error = "Missing DBI stream";
+
+        return false;
+    }
+
+    memcpy(&Header, Dbi.data(), sizeof(Header));
+
+    std::vector<uint32_t> Streams = { PdbInfoStream, PdbDbiStream, Header.GlobalStreamIndex, Header.PublicStreamIndex, Header.SymRecordStream };
+    uint64_t DbgHeaderOffset = GetDbiDebugHeaderOffset(Header);
+    uint32_t NumDbgStreams = std::min<uint32_t>(static_cast<uint32_t>(Header.OptionalDbgHeaderSize) / sizeof(uint16_t), DbgStreamCount);
+
+    if (DbgHeaderOffset + NumDbgStreams * sizeof(uint16_t) <= Dbi.size())
+    {
+        for (uint32_t Index : { DbgSectionHdr, DbgSectionHdrOrig, DbgOmapFromSrc })
+        {
+            if (Index < NumDbgStreams)
+                Streams.push_back(LoadValue<uint16_t>(Dbi.data() + DbgHeaderOffset + Index * sizeof(uint16_t)));
+        }
+    }
+
+    if (bTypes && PdbTpiStream < Remote.GetStreamCount())
+    {
+        std::vector<uint8_t> Tpi;
+        TpiStreamHeader TpiHeader;
+
+        if (!Remote.FetchStreams({ PdbTpiStream }, Response))
+            return false;
+
+        Streams.push_back(PdbTpiStream);
+
+        if (Remote.ReadStream(PdbTpiStream, Tpi) && Tpi.size() >= sizeof(TpiHeader))
+        {
+            memcpy(&TpiHeader, Tpi.data(), sizeof(TpiHeader));
+            Streams.push_back(TpiHeader.HashStreamIndex);
+        }
+    }
+
+    Streams.erase(std::remove_if(Streams.begin(), Streams.end(), [&Remote](uint32_t Stream) { return Stream == NilStreamIndex || Stream >= Remote.GetStreamCount(); }), Streams.end());
+
+    if (!Remote.FetchStreams(Streams, Response))
+        return false;
+
+    std::vector<bool> Keep(Remote.GetStreamCount(), false);
+    std::vector<bool> Partial(Remote.GetStreamCount(), false);
+
+    for (uint32_t Stream : Streams)
+        Keep[Stream] = Remote.GetStreamSize(Stream) != 0;
+
+    // S_PROCREF records point into module symbol streams. Only the pages holding the referenced
+    // procedure records are fetched, the rest of those streams is left zero-filled.
+    std::vector<uint16_t> ModuleStreams;
+    std::vector<std::pair<uint32_t, uint32_t>> ProcRecords;
+    std::vector<uint8_t> Records;
+    uint32_t ModInfoSize = static_cast<uint32_t>(std::max(Header.ModInfoSize, 0));
+
+    if (sizeof(Header) + static_cast<uint64_t>(ModInfoSize) <= Dbi.size())
+    {
+        const uint8_t* ModInfo = Dbi.data() + sizeof(Header);
+
+        for (uint32_t Offset = 0; Offset + ModInfoHeaderSize <= ModInfoSize;)
+        {
+            uint32_t Cursor = Offset + ModInfoHeaderSize;
+
+            ModuleStreams.push_back(LoadValue<uint16_t>(ModInfo + Offset + 34));
+
+            for (int i = 0; i < 2; i++)
+            {
+                while (Cursor < ModInfoSize && ModInfo[Cursor])
+                    Cursor++;
+
+                Cursor++;
+            }
+
+            Offset = (Cursor + 3) & ~3u;
+        }
+    }
+
+    if (Header.SymRecordStream < Remote.GetStreamCount() && Remote.ReadStream(Header.SymRecordStream, Records))
+    {
+        for (size_t Offset = 0; Offset + 4 <= Records.size();)
+        {
+            uint16_t Length = LoadValue<uint16_t>(Records.data() + Offset);
+            uint16_t Kind = LoadValue<uint16_t>(Records.data() + Offset + 2);
+
+            if (Length < 2 || Offset + 2 + Length > Records.size())
+                break;
+
+            if ((Kind == S_PROCREF || Kind == S_LPROCREF) && Length >= 12)
+            {
+                uint32_t SymOffset = LoadValue<uint32_t>(Records.data() + Offset + 8);
+                uint16_t Module = LoadValue<uint16_t>(Records.data() + Offset + 12);
+
+                if (Module && Module <= ModuleStreams.size() && ModuleStreams[Module - 1] < Remote.GetStreamCount())
+                {
+                    ProcRecords.emplace_back(ModuleStreams[Module - 1], SymOffset);
+                    Keep[ModuleStreams[Module - 1]] = true;
+                    Partial[ModuleStreams[Module - 1]] = true;
+                }
+            }
+
+            Offset += Length + 2;
+        }
+    }
+
+    if (!Remote.FetchStreamRanges(ProcRecords, ProcRecordSize, Response))
+        return false;
+
+    return WriteCompactMsf(Remote, Keep, Partial, Path, Stats, Response.Error);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "HttpClient.h"
+
+struct SparseFetchStats
+{
+    uint64_t RemoteSize = 0;
+    uint64_t BytesFetched = 0;
+    uint32_t Requests = 0;
+    uint32_t StreamsKept = 0;
+};
+
+// Fetches only what symbol resolution needs from a remote PDB with Range requests: superblock, stream directory,
+// PDB info, DBI, publics/globals hash tables, symbol records, section headers and OMAP. The result is written as
+// a compact MSF file in which every other stream (types, modules, ...) is nil, so PdbFile opens it like any other PDB.
+// bTypes also keeps the TPI stream and its hash stream for "Type::Member" queries.
+bool FetchSparsePdb(HttpTransport& Transport, const std::string& Url, const std::filesystem::path& Path, bool bTypes, SparseFetchStats& Stats,
+    HttpResponse& Response);
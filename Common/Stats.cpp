@@ -0,0 +1,185 @@
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+static constexpr size_t NumCounters = static_cast<size_t>(StatCounter::Count);
+
+// Summary label and trace argument name of every counter, in StatCounter order.
+static constexpr const char* CounterNames[NumCounters][2] =
+{
+    { "PE files read", "pe_files_read" },
+    { "HTTP requests", "http_requests" },
+    { "Bytes downloaded", "bytes_downloaded" },
+    { "MSF pages read", "pages_read" },
+    { "Page cache hits", "page_cache_hits" },
+    { "Page cache misses", "page_cache_misses" },
+    { "Bytes prefetched", "bytes_prefetched" },
+    { "Symbol index hits", "index_hits" },
+    { "Symbol index misses", "index_misses" },
+    { "Type cache hits", "type_cache_hits" },
+    { "Type cache misses", "type_cache_misses" },
+    { "PE cache hits", "pe_cache_hits" },
+    { "PE cache misses", "pe_cache_misses" },
+    { "Symbol cache tier hits", "symbol_tier_hits" },
+    { "Known misses skipped", "symbol_misses_skipped" },
+    { "Symbols resolved", "symbols_resolved" },
+    { "Symbols missing", "symbols_missing" },
+};
+
+struct PhaseTotals
+{
+    const char* Name;
+    uint64_t Calls = 0;
+    uint64_t TotalNs = 0;
+    uint64_t MaxNs = 0;
+};
+
+struct TraceEvent
+{
+    const char* Name;
+    uint32_t ThreadId;
+    uint64_t StartNs;
+    uint64_t DurationNs;
+};
+
+static std::atomic<uint64_t> Counters[NumCounters] = {};
+static std::atomic<uint32_t> NextThreadId{ 1 };
+
+static std::mutex StatsLock;
+static std::chrono::steady_clock::time_point Origin;
+static std::filesystem::path TraceFile;
+static std::vector<PhaseTotals> Phases;
+static std::vector<TraceEvent> Events;
+
+static uint32_t GetTraceThreadId()
+{
+    static thread_local uint32_t ThreadId = NextThreadId++;
+
+    return ThreadId;
+}
+
+void EnableStats(const std::filesystem::path& TracePath)
+{
+    std::lock_guard<std::mutex> Guard(StatsLock);
+
+    if (!bStatsEnabled)
+        Origin = std::chrono::steady_clock::now();
+
+    if (!TracePath.empty())
+        TraceFile = TracePath;
+
+    bStatsEnabled = true;
+}
+
+void RecordStat(StatCounter Counter, uint64_t Value)
+{
+    Counters[static_cast<size_t>(Counter)].fetch_add(Value, std::memory_order_relaxed);
+}
+
+void RecordPhase(const char* Name, std::chrono::steady_clock::time_point Start, std::chrono::steady_clock::time_point End)
+{
+    uint64_t Duration = std::chrono::duration_cast<std::chrono::nanoseconds>(End - Start).count();
+    uint32_t ThreadId = GetTraceThreadId();
+
+    std::lock_guard<std::mutex> Guard(StatsLock);
+
+    // Only a handful of distinct phases exist; names are compared by content since literals may not be pooled.
+    auto It = std::find_if(Phases.begin(), Phases.end(), [Name](const PhaseTotals& Phase) { return strcmp(Phase.Name, Name) == 0; });
+
+    if (It == Phases.end())
+        It = Phases.insert(Phases.end(), PhaseTotals{ Name });
+
+    It->Calls++;
+    It->TotalNs += Duration;
+    It->MaxNs = std::max(It->MaxNs, Duration);
+
+    if (!TraceFile.empty())
+        Events.push_back({ Name, ThreadId, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Start - Origin).count()), Duration });
+}
+
+bool ParseStatsOption(int argc, wchar_t* argv[], int& Index)
+{
+    if (_wcsicmp(argv[Index], L"--stats") == 0)
+    {
+        EnableStats({});
+
+        return true;
+    }
+
+    if (_wcsicmp(argv[Index], L"--trace") != 0 || Index + 1 >= argc)
+        return false;
+
+    EnableStats(argv[++Index]);
+
+    return true;
+}
+
+static bool WriteTrace(const std::filesystem::path& Path, uint64_t EndNs)
+{
+    std::string Json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char Line[256];
+
+    snprintf(Line, sizeof(Line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"%s\"}}",
+        WideToUtf8(GetExecutablePath().stem().wstring()).c_str());
+    Json += Line;
+
+    // Timestamps are microseconds since stats were enabled.
+    for (const TraceEvent& Event : Events)
+    {
+        snprintf(Line, sizeof(Line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", Event.Name, Event.ThreadId,
+            Event.StartNs / 1000.0, Event.DurationNs / 1000.0);
+        Json += Line;
+    }
+
+    snprintf(Line, sizeof(Line), ",\n{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":%.3f,\"args\":{", EndNs / 1000.0);
+    Json += Line;
+
+    for (size_t i = 0; i < NumCounters; i++)
+    {
+        snprintf(Line, sizeof(Line), "%s\"%s\":%llu", i ? "," : "", CounterNames[i][1], static_cast<unsigned long long>(Counters[i].load()));
+        Json += Line;
+    }
+
+    Json += "}}\n]}\n";
+
+    std::ofstream Out(Path, std::ios::binary | std::ios::trunc);
+
+    Out.write(Json.data(), Json.size());
+    Out.flush();
+
+    return Out.good();
+}
+
+void FinishStats()
+{
+    if (!bStatsEnabled)
+        return;
+
+    std::lock_guard<std::mutex> Guard(StatsLock);
+
+    uint64_t EndNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Origin).count();
+
+    printf_s("[*] Stats (%.3f s total):\n", EndNs / 1e9);
+    printf_s("    %-24s %8s %12s %12s\n", "Phase", "Calls", "Total ms", "Max ms");
+
+    for (const PhaseTotals& Phase : Phases)
+        printf_s("    %-24s %8llu %12.3f %12.3f\n", Phase.Name, static_cast<unsigned long long>(Phase.Calls), Phase.TotalNs / 1e6, Phase.MaxNs / 1e6);
+
+    for (size_t i = 0; i < NumCounters; i++)
+    {
+        if (uint64_t Value = Counters[i].load())
+            printf_s("    %-24s %8llu\n", CounterNames[i][0], static_cast<unsigned long long>(Value));
+    }
+
+    if (TraceFile.empty())
+        printf_s("\n");
+    else if (WriteTrace(TraceFile, EndNs))
+        printf_s("[+] Trace written to %ls\n\n", TraceFile.wstring().c_str());
+    else
+        printf_s("[-] Failed to write trace %ls! :(\n\n", TraceFile.wstring().c_str());
+}
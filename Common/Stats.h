@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <atomic>
+#include <chrono>
+
+enum class StatCounter
+{
+    PeFilesRead,
+    HttpRequests,
+    BytesDownloaded,
+    PagesRead,
+    PageCacheHits,
+    PageCacheMisses,
+    BytesPrefetched,
+    IndexHits,
+    IndexMisses,
+    TypeCacheHits,
+    TypeCacheMisses,
+    PeCacheHits,
+    PeCacheMisses,
+    SymbolTierHits,
+    SymbolMissesSkipped,
+    SymbolsResolved,
+    SymbolsMissing,
+    Count
+};
+
+// Run-wide instrumentation shared by all tools: scoped phase timers and counters, printed by FinishStats and
+// optionally recorded as Chrome trace events (chrome://tracing, Perfetto). Everything is off until EnableStats
+// is called; a disabled probe is a single relaxed load.
+inline std::atomic<bool> bStatsEnabled{ false };
+
+// An empty TracePath only collects the --stats summary.
+void EnableStats(const std::filesystem::path& TracePath);
+
+void RecordStat(StatCounter Counter, uint64_t Value);
+void RecordPhase(const char* Name, std::chrono::steady_clock::time_point Start, std::chrono::steady_clock::time_point End);
+
+inline void AddStat(StatCounter Counter, uint64_t Value = 1)
+{
+    if (bStatsEnabled.load(std::memory_order_relaxed))
+        RecordStat(Counter, Value);
+}
+
+// Times the enclosing scope as one phase. Name must outlive the run (a string literal).
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char* Name) : Name(Name), bActive(bStatsEnabled.load(std::memory_order_relaxed))
+    {
+        if (bActive)
+            Start = std::chrono::steady_clock::now();
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer()
+    {
+        if (bActive)
+            RecordPhase(Name, Start, std::chrono::steady_clock::now());
+    }
+
+private:
+    const char* Name;
+    bool bActive;
+    std::chrono::steady_clock::time_point Start;
+};
+
+// Handles "--stats" and "--trace <file>" for the tools' option parsers. Returns false if Argv[Index] is neither,
+// otherwise consumes the option (and its value) and advances Index past it.
+bool ParseStatsOption(int argc, wchar_t* argv[], int& Index);
+
+// Prints the phase and counter summary and writes the trace file, if any. No-op when stats are disabled.
+void FinishStats();
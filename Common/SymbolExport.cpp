@@ -0,0 +1,445 @@
+#include "SymbolExport.h"
+#include "Stats.h"
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+
+static const char SymbolExportMagic[8] = { 'A', 'e', 'P', 'D', 'B', 'S', 'y', 'm' };
+static constexpr uint32_t ChunksPerWorker = 4;
+
+// As decoded, names in the chunk's own buffer.
+struct ChunkSymbol
+{
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint32_t Rva;
+    uint32_t Offset;
+    uint32_t Size;
+    uint16_t Section;
+    uint16_t Kind;
+};
+
+struct ExportChunk
+{
+    std::string Names;
+    std::vector<ChunkSymbol> Symbols;
+    // Chunk-local symbol indices by name shard.
+    std::vector<std::vector<uint32_t>> ShardSymbols;
+    uint32_t Base = 0;
+};
+
+struct ExportSymbol
+{
+    std::string_view Name;
+    uint32_t Rva;
+    uint32_t Offset;
+    uint32_t Size;
+    uint16_t Section;
+    uint16_t Kind;
+    uint32_t Shard;
+    // Offset in the shard's heap until the shards are laid out.
+    uint32_t NameOffset;
+};
+
+static void ParallelFor(WorkStealingPool& Pool, size_t Count, const std::function<void(size_t)>& Fn)
+{
+    for (size_t i = 0; i < Count; i++)
+        Pool.Submit([&Fn, i](uint32_t) { Fn(i); });
+
+    Pool.Wait();
+}
+
+static uint64_t AlignTo8(uint64_t Value)
+{
+    return (Value + 7) & ~7ull;
+}
+
+const char* GetSymbolKindName(uint16_t Kind)
+{
+    switch (Kind)
+    {
+    case S_PUB32: return "public";
+    case S_GDATA32: return "data";
+    case S_LDATA32: return "static data";
+    case S_PROCREF: return "function";
+    case S_LPROCREF: return "static function";
+    default: return "other";
+    }
+}
+
+// to_chars rather than snprintf: number formatting is most of the CSV's cost.
+static void AppendNumber(uint32_t Value, char Separator, std::string& Out)
+{
+    char Digits[16];
+    std::to_chars_result Converted = std::to_chars(Digits, Digits + sizeof(Digits), Value);
+
+    Out.append(Digits, Converted.ptr);
+    Out += Separator;
+}
+
+static void AppendCsvRow(const ExportSymbol& Symbol, std::string& Out)
+{
+    Out += '"';
+
+    for (char Char : Symbol.Name)
+    {
+        if (Char == '"')
+            Out += '"';
+
+        Out += Char;
+    }
+
+    Out += "\",";
+    AppendNumber(Symbol.Rva, ',', Out);
+    AppendNumber(Symbol.Section, ',', Out);
+    Out += GetSymbolKindName(Symbol.Kind);
+    Out += ',';
+    AppendNumber(Symbol.Size, '\n', Out);
+}
+
+bool ExportSymbols(const PdbFile& Pdb, const std::filesystem::path& OutputPath, SymbolExportFormat Format, SymbolExportResult& Result, std::string& Error)
+{
+    ScopedTimer Timer("Symbol export");
+    WorkStealingPool Pool;
+    uint32_t NumShards = Pool.GetWorkerCount();
+    std::vector<uint32_t> Boundaries = Pdb.SplitSymbolRecords(NumShards * ChunksPerWorker);
+    std::vector<ExportChunk> Chunks(Boundaries.size() - 1);
+
+    // Decode: each chunk of records into its own symbol list and name buffer.
+    ParallelFor(Pool, Chunks.size(), [&](size_t Index)
+    {
+        ExportChunk& Chunk = Chunks[Index];
+
+        // Address space only: records are longer than their names and than 16 bytes, untouched pages cost nothing.
+        Chunk.ShardSymbols.resize(NumShards);
+        Chunk.Names.reserve(Boundaries[Index + 1] - Boundaries[Index]);
+        Chunk.Symbols.reserve((Boundaries[Index + 1] - Boundaries[Index]) / 16);
+
+        Pdb.EnumerateSymbols(Boundaries[Index], Boundaries[Index + 1], [&](const PdbSymbol& Symbol)
+        {
+            uint32_t Local = static_cast<uint32_t>(Chunk.Symbols.size());
+
+            Chunk.Symbols.push_back({ static_cast<uint32_t>(Chunk.Names.size()), static_cast<uint32_t>(Symbol.Name.size()), Symbol.Rva, Symbol.Offset,
+                Symbol.Size, Symbol.Section, Symbol.Kind });
+            Chunk.Names += Symbol.Name;
+            Chunk.ShardSymbols[std::hash<std::string_view>()(Symbol.Name) % NumShards].push_back(Local);
+        });
+    });
+
+    uint64_t NumSymbols = 0;
+
+    for (ExportChunk& Chunk : Chunks)
+    {
+        Chunk.Base = static_cast<uint32_t>(NumSymbols);
+        NumSymbols += Chunk.Symbols.size();
+    }
+
+    if (NumSymbols > UINT32_MAX)
+    {
+        Error = "Too many symbols";
+
+        return false;
+    }
+
+    std::vector<ExportSymbol> Symbols(NumSymbols);
+    // (RVA << 32) | symbol index, so that sorting the keys sorts by RVA and keeps record order among equal RVAs.
+    std::vector<uint64_t> Order(NumSymbols);
+
+    ParallelFor(Pool, Chunks.size(), [&](size_t Index)
+    {
+        ExportChunk& Chunk = Chunks[Index];
+
+        for (uint32_t i = 0; i < Chunk.Symbols.size(); i++)
+        {
+            const ChunkSymbol& From = Chunk.Symbols[i];
+            uint32_t Global = Chunk.Base + i;
+
+            Symbols[Global] = { std::string_view(Chunk.Names).substr(From.NameOffset, From.NameLength), From.Rva, From.Offset, From.Size, From.Section, From.Kind, 0, 0 };
+            Order[Global] = static_cast<uint64_t>(From.Rva) << 32 | Global;
+        }
+
+        std::sort(Order.begin() + Chunk.Base, Order.begin() + Chunk.Base + Chunk.Symbols.size());
+        std::vector<ChunkSymbol>().swap(Chunk.Symbols);
+    });
+
+    // Merge the sorted runs pairwise, all pairs of a round in parallel.
+    std::vector<size_t> Runs;
+    std::vector<uint64_t> Merged(NumSymbols);
+
+    for (const ExportChunk& Chunk : Chunks)
+        Runs.push_back(Chunk.Base);
+
+    Runs.push_back(NumSymbols);
+
+    while (Runs.size() > 2)
+    {
+        std::vector<size_t> NextRuns;
+
+        ParallelFor(Pool, Runs.size() / 2, [&](size_t Pair)
+        {
+            size_t Begin = Runs[Pair * 2];
+            size_t Middle = Runs[Pair * 2 + 1];
+            size_t End = Pair * 2 + 2 < Runs.size() ? Runs[Pair * 2 + 2] : Middle;
+
+            std::merge(Order.begin() + Begin, Order.begin() + Middle, Order.begin() + Middle, Order.begin() + End, Merged.begin() + Begin);
+        });
+
+        for (size_t i = 0; i < Runs.size(); i += 2)
+            NextRuns.push_back(Runs[i]);
+
+        if (NextRuns.back() != NumSymbols)
+            NextRuns.push_back(NumSymbols);
+
+        Order.swap(Merged);
+        Runs.swap(NextRuns);
+    }
+
+    // Names into one heap per shard, sizes along the sorted order; both touch disjoint fields.
+    std::vector<std::string> Heaps(NumShards);
+    std::vector<uint64_t> NumNames(NumShards);
+    std::vector<PdbSectionContribution> Contributions = Pdb.GetSectionContributions();
+    size_t Stride = std::max<size_t>((NumSymbols + Chunks.size() - 1) / std::max<size_t>(Chunks.size(), 1), 1);
+    size_t NumRanges = (NumSymbols + Stride - 1) / Stride;
+
+    ParallelFor(Pool, NumShards + NumRanges, [&](size_t Task)
+    {
+        if (Task >= NumShards)
+        {
+            size_t End = std::min<size_t>((Task - NumShards + 1) * Stride, NumSymbols);
+
+            for (size_t i = (Task - NumShards) * Stride; i < End; i++)
+            {
+                ExportSymbol& Symbol = Symbols[static_cast<uint32_t>(Order[i])];
+
+                if (Symbol.Size)
+                    continue;
+
+                size_t Next = i + 1;
+
+                while (Next < NumSymbols && Symbols[static_cast<uint32_t>(Order[Next])].Rva == Symbol.Rva)
+                    Next++;
+
+                bool bNextInSection = Next < NumSymbols && Symbols[static_cast<uint32_t>(Order[Next])].Section == Symbol.Section;
+
+                Symbol.Size = Pdb.InferSymbolSize(Symbol.Section, Symbol.Offset, Symbol.Rva, bNextInSection ? Symbols[static_cast<uint32_t>(Order[Next])].Rva : 0,
+                    Contributions);
+            }
+
+            return;
+        }
+
+        std::string& Heap = Heaps[Task];
+        size_t NumCandidates = 0;
+        size_t HeapSize = 0;
+
+        for (const ExportChunk& Chunk : Chunks)
+        {
+            for (uint32_t Local : Chunk.ShardSymbols[Task])
+                HeapSize += Symbols[Chunk.Base + Local].Name.size() + 1;
+
+            NumCandidates += Chunk.ShardSymbols[Task].size();
+        }
+
+        // Open addressing over symbol index + 1 (0 is a free slot), at most half full.
+        std::vector<uint32_t> Slots(std::bit_ceil(NumCandidates * 2 + 1));
+        size_t SlotMask = Slots.size() - 1;
+
+        Heap.reserve(HeapSize);
+
+        for (const ExportChunk& Chunk : Chunks)
+        {
+            for (uint32_t Local : Chunk.ShardSymbols[Task])
+            {
+                ExportSymbol& Symbol = Symbols[Chunk.Base + Local];
+                size_t Slot = (std::hash<std::string_view>()(Symbol.Name) / NumShards) & SlotMask;
+
+                while (Slots[Slot] && Symbols[Slots[Slot] - 1].Name != Symbol.Name)
+                    Slot = (Slot + 1) & SlotMask;
+
+                Symbol.Shard = static_cast<uint32_t>(Task);
+
+                if (Slots[Slot])
+                {
+                    Symbol.NameOffset = Symbols[Slots[Slot] - 1].NameOffset;
+
+                    continue;
+                }
+
+                Slots[Slot] = Chunk.Base + Local + 1;
+                Symbol.NameOffset = static_cast<uint32_t>(Heap.size());
+                Heap += Symbol.Name;
+                Heap += '\0';
+                NumNames[Task]++;
+            }
+        }
+    });
+
+    std::vector<uint64_t> HeapBase(NumShards + 1);
+
+    for (uint32_t i = 0; i < NumShards; i++)
+    {
+        HeapBase[i + 1] = HeapBase[i] + Heaps[i].size();
+        Result.NumNames += NumNames[i];
+    }
+
+    if (HeapBase.back() > UINT32_MAX)
+    {
+        Error = "Name heap too large";
+
+        return false;
+    }
+
+    std::ofstream Out(OutputPath, std::ios::binary | std::ios::trunc);
+
+    if (!Out.is_open())
+    {
+        Error = "Can't create " + OutputPath.string();
+
+        return false;
+    }
+
+    Result.NumSymbols = NumSymbols;
+    Result.BytesWritten = 0;
+
+    if (Format == SymbolExportFormat::Csv)
+    {
+        static constexpr char CsvHeader[] = "name,rva,section,kind,size\n";
+        // Rows are formatted in batches, one per worker at a time, so the text buffers stay small and are reused.
+        static constexpr size_t CsvBatchRows = 65536;
+        std::vector<std::string> Text(NumShards);
+
+        Out.write(CsvHeader, sizeof(CsvHeader) - 1);
+        Result.BytesWritten += sizeof(CsvHeader) - 1;
+
+        for (size_t First = 0; First < NumSymbols; First += CsvBatchRows * NumShards)
+        {
+            ParallelFor(Pool, NumShards, [&](size_t Batch)
+            {
+                size_t Begin = std::min<size_t>(First + Batch * CsvBatchRows, NumSymbols);
+                size_t End = std::min<size_t>(Begin + CsvBatchRows, NumSymbols);
+
+                Text[Batch].clear();
+
+                for (size_t i = Begin; i < End; i++)
+                    AppendCsvRow(Symbols[static_cast<uint32_t>(Order[i])], Text[Batch]);
+            });
+
+            for (const std::string& Part : Text)
+            {
+                Out.write(Part.data(), Part.size());
+                Result.BytesWritten += Part.size();
+            }
+        }
+    }
+    else
+    {
+        SymbolExportHeader Header = {};
+
+        memcpy(Header.Magic, SymbolExportMagic, sizeof(Header.Magic));
+        Header.Version = SymbolExportFile::Version;
+        Header.NumSymbols = static_cast<uint32_t>(NumSymbols);
+        Header.NamesColumn = AlignTo8(sizeof(Header));
+        Header.RvaColumn = AlignTo8(Header.NamesColumn + NumSymbols * sizeof(uint32_t));
+        Header.SectionColumn = AlignTo8(Header.RvaColumn + NumSymbols * sizeof(uint32_t));
+        Header.KindColumn = AlignTo8(Header.SectionColumn + NumSymbols * sizeof(uint16_t));
+        Header.SizeColumn = AlignTo8(Header.KindColumn + NumSymbols * sizeof(uint16_t));
+        Header.HeapOffset = AlignTo8(Header.SizeColumn + NumSymbols * sizeof(uint32_t));
+        Header.HeapSize = HeapBase.back();
+
+        // One column at a time through a single buffer, each filled in parallel ranges.
+        static constexpr char Padding[8] = {};
+        std::vector<uint8_t> Column(NumSymbols * sizeof(uint32_t));
+        uint64_t Written = sizeof(Header);
+
+        Out.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+
+        auto WriteColumn = [&](uint64_t ColumnOffset, size_t EntrySize, const std::function<void(const ExportSymbol&, uint8_t*)>& Fill)
+        {
+            ParallelFor(Pool, NumRanges, [&](size_t Range)
+            {
+                size_t End = std::min<size_t>((Range + 1) * Stride, NumSymbols);
+
+                for (size_t i = Range * Stride; i < End; i++)
+                    Fill(Symbols[static_cast<uint32_t>(Order[i])], Column.data() + i * EntrySize);
+            });
+
+            Out.write(Padding, ColumnOffset - Written);
+            Out.write(reinterpret_cast<const char*>(Column.data()), NumSymbols * EntrySize);
+            Written = ColumnOffset + NumSymbols * EntrySize;
+        };
+
+        WriteColumn(Header.NamesColumn, sizeof(uint32_t), [&](const ExportSymbol& Symbol, uint8_t* Entry)
+        {
+            uint32_t NameOffset = static_cast<uint32_t>(HeapBase[Symbol.Shard] + Symbol.NameOffset);
+
+            memcpy(Entry, &NameOffset, sizeof(NameOffset));
+        });
+        WriteColumn(Header.RvaColumn, sizeof(uint32_t), [](const ExportSymbol& Symbol, uint8_t* Entry) { memcpy(Entry, &Symbol.Rva, sizeof(Symbol.Rva)); });
+        WriteColumn(Header.SectionColumn, sizeof(uint16_t), [](const ExportSymbol& Symbol, uint8_t* Entry) { memcpy(Entry, &Symbol.Section, sizeof(Symbol.Section)); });
+        WriteColumn(Header.KindColumn, sizeof(uint16_t), [](const ExportSymbol& Symbol, uint8_t* Entry) { memcpy(Entry, &Symbol.Kind, sizeof(Symbol.Kind)); });
+        WriteColumn(Header.SizeColumn, sizeof(uint32_t), [](const ExportSymbol& Symbol, uint8_t* Entry) { memcpy(Entry, &Symbol.Size, sizeof(Symbol.Size)); });
+        Out.write(Padding, Header.HeapOffset - Written);
+        Result.BytesWritten += Header.HeapOffset;
+
+        for (const std::string& Heap : Heaps)
+        {
+            Out.write(Heap.data(), Heap.size());
+            Result.BytesWritten += Heap.size();
+        }
+    }
+
+    if (!Out.good())
+    {
+        Error = "Failed to write " + OutputPath.string();
+
+        return false;
+    }
+
+    return true;
+}
+
+bool SymbolExportFile::Open(const std::filesystem::path& Path)
+{
+    Header = nullptr;
+
+    if (!File.Open(Path) || File.Size() < sizeof(SymbolExportHeader))
+    {
+        File.Close();
+
+        return false;
+    }
+
+    const SymbolExportHeader* Candidate = reinterpret_cast<const SymbolExportHeader*>(File.Data());
+    uint64_t Count = Candidate->NumSymbols;
+    auto Fits = [&](uint64_t Offset, uint64_t EntrySize) { return Offset >= sizeof(SymbolExportHeader) && Offset + Count * EntrySize <= Candidate->HeapOffset; };
+
+    bool bValid = memcmp(Candidate->Magic, SymbolExportMagic, sizeof(SymbolExportMagic)) == 0 && Candidate->Version == Version &&
+        Candidate->HeapOffset <= File.Size() && Candidate->HeapSize <= File.Size() - Candidate->HeapOffset && Fits(Candidate->NamesColumn, sizeof(uint32_t)) &&
+        Fits(Candidate->RvaColumn, sizeof(uint32_t)) && Fits(Candidate->SectionColumn, sizeof(uint16_t)) && Fits(Candidate->KindColumn, sizeof(uint16_t)) &&
+        Fits(Candidate->SizeColumn, sizeof(uint32_t)) && (!Candidate->HeapSize || File.Data()[Candidate->HeapOffset + Candidate->HeapSize - 1] == '\0');
+
+    if (!bValid)
+    {
+        File.Close();
+
+        return false;
+    }
+
+    Header = Candidate;
+
+    return true;
+}
+
+std::string_view SymbolExportFile::GetName(uint32_t Index) const
+{
+    uint32_t Offset = LoadValue<uint32_t>(File.Data() + Header->NamesColumn + Index * sizeof(uint32_t));
+
+    if (Offset >= Header->HeapSize)
+        return {};
+
+    return reinterpret_cast<const char*>(File.Data() + Header->HeapOffset + Offset);
+}
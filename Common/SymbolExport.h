@@ -0,0 +1,64 @@
+#pragma once
+
+#include "PdbFile.h"
+
+#include <string_view>
+
+struct SymbolExportHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t NumSymbols;
+    // File offsets of the columns, NumSymbols entries each: uint32 name offsets into the heap, uint32 RVAs, uint16
+    // sections, uint16 CodeView record kinds, uint32 sizes.
+    uint64_t NamesColumn;
+    uint64_t RvaColumn;
+    uint64_t SectionColumn;
+    uint64_t KindColumn;
+    uint64_t SizeColumn;
+    // Every distinct name once, NUL-terminated.
+    uint64_t HeapOffset;
+    uint64_t HeapSize;
+};
+
+enum class SymbolExportFormat
+{
+    Columnar,
+    Csv,
+};
+
+struct SymbolExportResult
+{
+    uint64_t NumSymbols = 0;
+    uint64_t NumNames = 0;
+    uint64_t BytesWritten = 0;
+};
+
+// Writes every symbol of the PDB's symbol record stream (publics, global/static data, procedure references) sorted
+// by RVA. Symbols without a size of their own get the one SymbolIndex would infer. The record stream is split into
+// record-aligned chunks that are decoded, sorted and written on a worker pool; names are deduplicated in shards by
+// hash. The CSV has a "name,rva,section,kind,size" header, names are always quoted.
+bool ExportSymbols(const PdbFile& Pdb, const std::filesystem::path& OutputPath, SymbolExportFormat Format, SymbolExportResult& Result, std::string& Error);
+
+const char* GetSymbolKindName(uint16_t Kind);
+
+// Reader for the columnar export: map the file and index the columns.
+class SymbolExportFile
+{
+public:
+    static constexpr uint32_t Version = 1;
+
+    bool Open(const std::filesystem::path& Path);
+    bool IsOpen() const { return Header != nullptr; }
+
+    uint32_t GetCount() const { return Header->NumSymbols; }
+    std::string_view GetName(uint32_t Index) const;
+    uint32_t GetRva(uint32_t Index) const { return LoadValue<uint32_t>(File.Data() + Header->RvaColumn + Index * sizeof(uint32_t)); }
+    uint16_t GetSection(uint32_t Index) const { return LoadValue<uint16_t>(File.Data() + Header->SectionColumn + Index * sizeof(uint16_t)); }
+    uint16_t GetKind(uint32_t Index) const { return LoadValue<uint16_t>(File.Data() + Header->KindColumn + Index * sizeof(uint16_t)); }
+    uint32_t GetSize(uint32_t Index) const { return LoadValue<uint32_t>(File.Data() + Header->SizeColumn + Index * sizeof(uint32_t)); }
+
+private:
+    MappedFile File;
+    const SymbolExportHeader* Header = nullptr;
+};
@@ -0,0 +1,626 @@
+#include "SymbolIndex.h"
+#include "Stats.h"
+#include "Undecorate.h"
+
+#include <algorithm>
+#include <bit>
+#include <fstream>
+
+#ifdef _MSC_VER
+#include <xmmintrin.h>
+#endif
+
+static const char SymbolIndexMagic[8] = { 'A', 'e', 'P', 'D', 'B', 'I', 'd', 'x' };
+static constexpr uint32_t BloomBitsPerSymbol = 10;
+static constexpr uint32_t BloomHashes = 6;
+static constexpr uint16_t MachineI386 = 0x014C;
+static constexpr size_t AddressBatch = 16;
+// Address trees up to this size are searched without prefetching, about what the L2 cache of a core holds.
+static constexpr uint64_t AddressPrefetchThreshold = 1 << 20;
+
+static uint32_t NextPowerOfTwo(uint64_t Value)
+{
+    uint32_t Result = 1;
+
+    while (Result < Value)
+        Result <<= 1;
+
+    return Result;
+}
+
+static uint64_t AlignTo8(uint64_t Value)
+{
+    return (Value + 7) & ~7ull;
+}
+
+static uint64_t AlignTo64(uint64_t Value)
+{
+    return (Value + 63) & ~63ull;
+}
+
+static void PrefetchRead(const void* Address)
+{
+#ifdef _MSC_VER
+    _mm_prefetch(static_cast<const char*>(Address), _MM_HINT_T0);
+#else
+    __builtin_prefetch(Address);
+#endif
+}
+
+// An in-order walk of the implicit tree hands out the sorted values, which places them in Eytzinger order.
+static void FillEytzinger(const std::vector<uint32_t>& Sorted, std::vector<uint32_t>& Tree, size_t Node, size_t& Next)
+{
+    if (Node >= Tree.size())
+        return;
+
+    FillEytzinger(Sorted, Tree, 2 * Node, Next);
+    Tree[Node] = Sorted[Next++];
+    FillEytzinger(Sorted, Tree, 2 * Node + 1, Next);
+}
+
+static int SymbolKindPriority(uint16_t Kind)
+{
+    switch (Kind)
+    {
+    case S_PUB32: return 0;
+    case S_GDATA32: case S_LDATA32: return 1;
+    default: return 2;
+    }
+}
+
+uint64_t SymbolIndex::HashName(std::string_view Name)
+{
+    uint64_t Hash = 0xCBF29CE484222325ull;
+
+    for (char Char : Name)
+    {
+        Hash ^= static_cast<uint8_t>(Char);
+        Hash *= 0x100000001B3ull;
+    }
+
+    return Hash ^ (Hash >> 29);
+}
+
+std::filesystem::path SymbolIndex::GetIndexPath(const std::filesystem::path& PdbPath)
+{
+    std::filesystem::path Path(PdbPath);
+
+    return Path.replace_extension(L".idx");
+}
+
+bool SymbolIndex::Build(const PdbFile& Pdb, uint64_t PdbSize, const std::filesystem::path& IndexPath)
+{
+    std::vector<PdbSymbol> Symbols;
+
+    Pdb.EnumerateSymbols([&](const PdbSymbol& Symbol)
+    {
+        if (!Symbol.Name.empty() && Symbol.Name.size() < UINT32_MAX)
+            Symbols.push_back(Symbol);
+    });
+
+    std::stable_sort(Symbols.begin(), Symbols.end(), [](const PdbSymbol& Left, const PdbSymbol& Right)
+    {
+        if (Left.Name != Right.Name)
+            return Left.Name < Right.Name;
+
+        return SymbolKindPriority(Left.Kind) < SymbolKindPriority(Right.Kind);
+    });
+
+    Symbols.erase(std::unique(Symbols.begin(), Symbols.end(), [](const PdbSymbol& Left, const PdbSymbol& Right)
+    {
+        return Left.Name == Right.Name;
+    }), Symbols.end());
+
+    std::vector<uint32_t> ByAddress(Symbols.size());
+
+    for (uint32_t i = 0; i < ByAddress.size(); i++)
+        ByAddress[i] = i;
+
+    std::sort(ByAddress.begin(), ByAddress.end(), [&](uint32_t Left, uint32_t Right)
+    {
+        return Symbols[Left].Rva < Symbols[Right].Rva;
+    });
+
+    std::vector<PdbSectionContribution> Contributions = Pdb.GetSectionContributions();
+
+    for (size_t i = 0; i < ByAddress.size(); i++)
+    {
+        PdbSymbol& Symbol = Symbols[ByAddress[i]];
+
+        if (Symbol.Size)
+            continue;
+
+        size_t Next = i + 1;
+
+        while (Next < ByAddress.size() && Symbols[ByAddress[Next]].Rva == Symbol.Rva)
+            Next++;
+
+        bool bNextInSection = Next < ByAddress.size() && Symbols[ByAddress[Next]].Section == Symbol.Section;
+
+        Symbol.Size = Pdb.InferSymbolSize(Symbol.Section, Symbol.Offset, Symbol.Rva, bNextInSection ? Symbols[ByAddress[Next]].Rva : 0, Contributions);
+    }
+
+    // One symbol per start address, preferring publics like name lookups do; absolute symbols have no address.
+    std::vector<uint32_t> ByStart;
+
+    for (uint32_t i = 0; i < Symbols.size(); i++)
+    {
+        if (Symbols[i].Section)
+            ByStart.push_back(i);
+    }
+
+    std::stable_sort(ByStart.begin(), ByStart.end(), [&](uint32_t Left, uint32_t Right)
+    {
+        if (Symbols[Left].Rva != Symbols[Right].Rva)
+            return Symbols[Left].Rva < Symbols[Right].Rva;
+
+        return SymbolKindPriority(Symbols[Left].Kind) < SymbolKindPriority(Symbols[Right].Kind);
+    });
+
+    ByStart.erase(std::unique(ByStart.begin(), ByStart.end(), [&](uint32_t Left, uint32_t Right)
+    {
+        return Symbols[Left].Rva == Symbols[Right].Rva;
+    }), ByStart.end());
+
+    std::vector<uint32_t> AddressEntries(ByStart.size() + 1);
+    std::vector<uint32_t> AddressKeys(ByStart.size() + 1);
+    size_t NextAddress = 0;
+
+    FillEytzinger(ByStart, AddressEntries, 1, NextAddress);
+
+    for (size_t i = 1; i < AddressEntries.size(); i++)
+        AddressKeys[i] = Symbols[AddressEntries[i]].Rva;
+
+    SymbolIndexHeader Header = {};
+    uint32_t NumSymbols = static_cast<uint32_t>(Symbols.size());
+
+    memcpy(Header.Magic, SymbolIndexMagic, sizeof(Header.Magic));
+    Header.Version = Version;
+    Header.Machine = Pdb.GetMachine();
+    Header.Guid = Pdb.GetGuid();
+    Header.Age = Pdb.GetAge();
+    Header.NumSymbols = NumSymbols;
+    Header.PdbSize = PdbSize;
+    Header.NumSlots = NextPowerOfTwo(std::max<uint64_t>(static_cast<uint64_t>(NumSymbols) * 2, 16));
+    Header.BloomWords = NextPowerOfTwo(std::max<uint64_t>(static_cast<uint64_t>(NumSymbols) * BloomBitsPerSymbol / 64, 1));
+    Header.EntriesOffset = sizeof(SymbolIndexHeader);
+    Header.SlotsOffset = Header.EntriesOffset + AlignTo8(static_cast<uint64_t>(NumSymbols) * sizeof(SymbolIndexEntry));
+    Header.BloomOffset = Header.SlotsOffset + static_cast<uint64_t>(Header.NumSlots) * sizeof(SymbolIndexSlot);
+    Header.NumAddresses = static_cast<uint32_t>(ByStart.size());
+    Header.AddressesOffset = AlignTo64(Header.BloomOffset + static_cast<uint64_t>(Header.BloomWords) * sizeof(uint64_t));
+    Header.StringsOffset = Header.AddressesOffset + 2 * AddressKeys.size() * sizeof(uint32_t);
+
+    std::vector<SymbolIndexEntry> Entries(NumSymbols);
+    std::vector<SymbolIndexSlot> Slots(Header.NumSlots);
+    std::vector<uint64_t> Bloom(Header.BloomWords);
+    std::string Strings;
+
+    uint32_t SlotMask = Header.NumSlots - 1;
+    uint64_t BloomMask = static_cast<uint64_t>(Header.BloomWords) * 64 - 1;
+
+    for (uint32_t i = 0; i < NumSymbols; i++)
+    {
+        const PdbSymbol& Symbol = Symbols[i];
+
+        if (Strings.size() + Symbol.Name.size() + 1 > UINT32_MAX)
+            return false;
+
+        Entries[i] = { static_cast<uint32_t>(Strings.size()), static_cast<uint32_t>(Symbol.Name.size()), Symbol.Rva, Symbol.Size,
+            Symbol.Offset, Symbol.Section, Symbol.Kind };
+
+        Strings += Symbol.Name;
+        Strings += '\0';
+
+        uint64_t Hash = HashName(Symbol.Name);
+        uint32_t Slot = static_cast<uint32_t>(Hash) & SlotMask;
+
+        while (Slots[Slot].Entry)
+            Slot = (Slot + 1) & SlotMask;
+
+        Slots[Slot] = { static_cast<uint32_t>(Hash >> 32), i + 1 };
+
+        uint64_t BloomHash = Hash;
+        uint64_t BloomStep = (Hash >> 32) | 1;
+
+        for (uint32_t j = 0; j < BloomHashes; j++, BloomHash += BloomStep)
+            Bloom[(BloomHash & BloomMask) / 64] |= 1ull << (BloomHash & 63);
+    }
+
+    Header.StringsSize = Strings.size();
+
+    std::filesystem::path TempPath = IndexPath;
+    TempPath += L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+        if (!Out.is_open())
+            return false;
+
+        static const char Padding[64] = {};
+
+        Out.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        Out.write(reinterpret_cast<const char*>(Entries.data()), Entries.size() * sizeof(SymbolIndexEntry));
+        Out.write(Padding, Header.SlotsOffset - Header.EntriesOffset - Entries.size() * sizeof(SymbolIndexEntry));
+        Out.write(reinterpret_cast<const char*>(Slots.data()), Slots.size() * sizeof(SymbolIndexSlot));
+        Out.write(reinterpret_cast<const char*>(Bloom.data()), Bloom.size() * sizeof(uint64_t));
+        Out.write(Padding, Header.AddressesOffset - Header.BloomOffset - Bloom.size() * sizeof(uint64_t));
+        Out.write(reinterpret_cast<const char*>(AddressKeys.data()), AddressKeys.size() * sizeof(uint32_t));
+        Out.write(reinterpret_cast<const char*>(AddressEntries.data()), AddressEntries.size() * sizeof(uint32_t));
+        Out.write(Strings.data(), Strings.size());
+
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(TempPath);
+
+            return false;
+        }
+    }
+
+    std::error_code Error;
+
+    std::filesystem::rename(TempPath, IndexPath, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    return true;
+}
+
+bool SymbolIndex::Open(const std::filesystem::path& IndexPath, uint64_t PdbSize, const PdbGuid& Guid, uint32_t Age)
+{
+    if (!File.Open(IndexPath) || File.Size() < sizeof(SymbolIndexHeader))
+    {
+        File.Close();
+
+        return false;
+    }
+
+    const SymbolIndexHeader* Candidate = reinterpret_cast<const SymbolIndexHeader*>(File.Data());
+    uint64_t Size = File.Size();
+
+    bool bValid = memcmp(Candidate->Magic, SymbolIndexMagic, sizeof(SymbolIndexMagic)) == 0 && Candidate->Version == Version &&
+        Candidate->PdbSize == PdbSize && memcmp(&Candidate->Guid, &Guid, sizeof(PdbGuid)) == 0 && Candidate->Age == Age && Candidate->NumSlots && !(Candidate->NumSlots & (Candidate->NumSlots - 1)) &&
+        Candidate->BloomWords && !(Candidate->BloomWords & (Candidate->BloomWords - 1)) &&
+        Candidate->EntriesOffset + static_cast<uint64_t>(Candidate->NumSymbols) * sizeof(SymbolIndexEntry) <= Candidate->SlotsOffset &&
+        Candidate->SlotsOffset + static_cast<uint64_t>(Candidate->NumSlots) * sizeof(SymbolIndexSlot) <= Candidate->BloomOffset &&
+        Candidate->BloomOffset + static_cast<uint64_t>(Candidate->BloomWords) * sizeof(uint64_t) <= Candidate->AddressesOffset &&
+        Candidate->AddressesOffset + 2 * (static_cast<uint64_t>(Candidate->NumAddresses) + 1) * sizeof(uint32_t) <= Candidate->StringsOffset &&
+        Candidate->StringsOffset + Candidate->StringsSize <= Size && Candidate->NumSymbols < Candidate->NumSlots &&
+        Candidate->NumAddresses <= Candidate->NumSymbols && !(Candidate->EntriesOffset % 8) && !(Candidate->SlotsOffset % 8) &&
+        !(Candidate->BloomOffset % 8) && !(Candidate->AddressesOffset % 8);
+
+    if (!bValid)
+    {
+        File.Close();
+
+        return false;
+    }
+
+    Header = Candidate;
+    Entries = reinterpret_cast<const SymbolIndexEntry*>(File.Data() + Header->EntriesOffset);
+    Slots = reinterpret_cast<const SymbolIndexSlot*>(File.Data() + Header->SlotsOffset);
+    Bloom = reinterpret_cast<const uint64_t*>(File.Data() + Header->BloomOffset);
+    Strings = reinterpret_cast<const char*>(File.Data() + Header->StringsOffset);
+    AddressKeys = reinterpret_cast<const uint32_t*>(File.Data() + Header->AddressesOffset);
+    AddressEntries = AddressKeys + Header->NumAddresses + 1;
+    AddressDepth = static_cast<uint32_t>(std::bit_width(Header->NumAddresses));
+
+    for (uint32_t i = 0; i < Header->NumSymbols; i++)
+    {
+        if (static_cast<uint64_t>(Entries[i].NameOffset) + Entries[i].NameLength > Header->StringsSize)
+        {
+            File.Close();
+
+            return false;
+        }
+    }
+
+    for (uint32_t i = 1; i <= Header->NumAddresses; i++)
+    {
+        if (AddressEntries[i] >= Header->NumSymbols)
+        {
+            File.Close();
+
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool SymbolIndex::MayContain(const std::string& Name) const
+{
+    uint64_t Hash = HashName(Name);
+    uint64_t Step = (Hash >> 32) | 1;
+    uint64_t Mask = static_cast<uint64_t>(Header->BloomWords) * 64 - 1;
+
+    for (uint32_t i = 0; i < BloomHashes; i++, Hash += Step)
+    {
+        if (!(Bloom[(Hash & Mask) / 64] & (1ull << (Hash & 63))))
+            return false;
+    }
+
+    return true;
+}
+
+bool SymbolIndex::FindExact(std::string_view Name, PdbSymbol& Symbol) const
+{
+    uint64_t Hash = HashName(Name);
+    uint32_t Mask = Header->NumSlots - 1;
+    uint32_t Tag = static_cast<uint32_t>(Hash >> 32);
+
+    for (uint32_t Slot = static_cast<uint32_t>(Hash) & Mask; Slots[Slot].Entry; Slot = (Slot + 1) & Mask)
+    {
+        if (Slots[Slot].Hash != Tag || Slots[Slot].Entry > Header->NumSymbols)
+            continue;
+
+        const SymbolIndexEntry& Entry = Entries[Slots[Slot].Entry - 1];
+
+        if (GetName(Entry) != Name)
+            continue;
+
+        LoadSymbol(Entry, Symbol);
+
+        return true;
+    }
+
+    return false;
+}
+
+void SymbolIndex::LoadSymbol(const SymbolIndexEntry& Entry, PdbSymbol& Symbol) const
+{
+    Symbol.Name.assign(GetName(Entry));
+    Symbol.Kind = Entry.Kind;
+    Symbol.Section = Entry.Section;
+    Symbol.Offset = Entry.Offset;
+    Symbol.Rva = Entry.Rva;
+    Symbol.Size = Entry.Size;
+}
+
+bool SymbolIndex::Find(const std::string& Name, PdbSymbol& Symbol) const
+{
+    if (MayContain(Name) && FindExact(Name, Symbol))
+        return true;
+
+    if (Header->Machine == MachineI386)
+    {
+        std::string Decorated = "_" + Name;
+
+        return MayContain(Decorated) && FindExact(Decorated, Symbol);
+    }
+
+    return false;
+}
+
+void SymbolIndex::BuildUndecorated() const
+{
+    ScopedTimer Timer("Undecorated index build");
+
+    // Decorated names all start with '?', one contiguous run of the sorted table.
+    const SymbolIndexEntry* End = Entries + Header->NumSymbols;
+    auto ByName = [&](const SymbolIndexEntry& Entry, std::string_view Value) { return GetName(Entry) < Value; };
+    const SymbolIndexEntry* First = std::lower_bound(Entries, End, std::string_view("?"), ByName);
+    const SymbolIndexEntry* Last = std::lower_bound(First, End, std::string_view("@"), ByName);
+
+    UndecoratedSlots.assign(NextPowerOfTwo(std::max<uint64_t>(static_cast<uint64_t>(Last - First) * 4, 16)), {});
+
+    uint32_t Mask = static_cast<uint32_t>(UndecoratedSlots.size()) - 1;
+    Undecorator Undecorate;
+    std::string NameOnly;
+    std::string Signature;
+    std::string Normalized;
+
+    auto Insert = [&](const std::string& Key, uint32_t Entry)
+    {
+        uint64_t Hash = HashName(Key);
+        uint32_t Slot = static_cast<uint32_t>(Hash) & Mask;
+
+        while (UndecoratedSlots[Slot].Entry)
+            Slot = (Slot + 1) & Mask;
+
+        UndecoratedSlots[Slot] = { static_cast<uint32_t>(Hash >> 32), Entry + 1 };
+    };
+
+    for (const SymbolIndexEntry* Entry = First; Entry != Last; Entry++)
+    {
+        uint32_t Index = static_cast<uint32_t>(Entry - Entries);
+
+        if (!Undecorate.Undecorate(GetName(*Entry), Undecorator::Form::NameOnly, NameOnly) ||
+            !Undecorate.Undecorate(GetName(*Entry), Undecorator::Form::Signature, Signature))
+            continue;
+
+        NormalizeUndecoratedName(NameOnly, Normalized);
+        Insert(Normalized, Index);
+
+        // Data symbols have no signature, their two forms are the same.
+        if (Signature != NameOnly)
+        {
+            NormalizeUndecoratedName(Signature, Normalized);
+            Insert(Normalized, Index);
+        }
+    }
+}
+
+bool SymbolIndex::FindUndecorated(std::string_view Name, PdbSymbol& Symbol, uint32_t& NumMatches) const
+{
+    std::call_once(UndecoratedBuilt, [this]() { BuildUndecorated(); });
+
+    std::string Query;
+    std::string Candidate;
+    std::string Normalized;
+    Undecorator Undecorate;
+    Undecorator::Form QueryForm = Name.find('(') != std::string_view::npos ? Undecorator::Form::Signature : Undecorator::Form::NameOnly;
+    uint32_t Mask = static_cast<uint32_t>(UndecoratedSlots.size()) - 1;
+    uint32_t Best = UINT32_MAX;
+
+    NormalizeUndecoratedName(Name, Query);
+
+    uint64_t Hash = HashName(Query);
+    uint32_t Tag = static_cast<uint32_t>(Hash >> 32);
+
+    NumMatches = 0;
+
+    for (uint32_t Slot = static_cast<uint32_t>(Hash) & Mask; UndecoratedSlots[Slot].Entry; Slot = (Slot + 1) & Mask)
+    {
+        uint32_t Index = UndecoratedSlots[Slot].Entry - 1;
+
+        if (UndecoratedSlots[Slot].Hash != Tag || !Undecorate.Undecorate(GetName(Entries[Index]), QueryForm, Candidate))
+            continue;
+
+        NormalizeUndecoratedName(Candidate, Normalized);
+
+        if (Normalized != Query)
+            continue;
+
+        NumMatches++;
+        Best = std::min(Best, Index);
+    }
+
+    if (!NumMatches)
+        return false;
+
+    LoadSymbol(Entries[Best], Symbol);
+
+    return true;
+}
+
+void SymbolIndex::FindMatches(const NamePattern& Pattern, std::vector<PdbSymbol>& Symbols) const
+{
+    std::string_view Prefix = Pattern.GetPrefix();
+    std::string_view Literal = Pattern.GetInnerLiteral();
+    const SymbolIndexEntry* End = Entries + Header->NumSymbols;
+
+    // Names sharing the literal prefix form one contiguous run of the sorted table.
+    const SymbolIndexEntry* First = std::lower_bound(Entries, End, Prefix, [&](const SymbolIndexEntry& Entry, std::string_view Value)
+    {
+        return GetName(Entry) < Value;
+    });
+    const SymbolIndexEntry* Last = std::partition_point(First, End, [&](const SymbolIndexEntry& Entry)
+    {
+        return GetName(Entry).substr(0, Prefix.size()) == Prefix;
+    });
+
+    if (First == Last)
+        return;
+
+    if (Literal.empty())
+    {
+        for (const SymbolIndexEntry* Entry = First; Entry != Last; Entry++)
+        {
+            if (Pattern.Match(GetName(*Entry)))
+                LoadSymbol(*Entry, Symbols.emplace_back());
+        }
+
+        return;
+    }
+
+    // The names of the run are stored back to back and NUL separated, so one substring scan over that slice of
+    // the string pool finds every candidate without touching the names that cannot match.
+    const char* Begin = Strings + First->NameOffset;
+    const char* Stop = Strings + (Last - 1)->NameOffset + (Last - 1)->NameLength;
+
+    for (const char* Hit = FindSubstring(Begin, Stop - Begin, Literal); Hit; Hit = FindSubstring(Begin, Stop - Begin, Literal))
+    {
+        uint32_t HitOffset = static_cast<uint32_t>(Hit - Strings);
+        const SymbolIndexEntry* Entry = std::upper_bound(First, Last, HitOffset, [](uint32_t Value, const SymbolIndexEntry& Candidate)
+        {
+            return Value < Candidate.NameOffset;
+        }) - 1;
+
+        if (Pattern.Match(GetName(*Entry)))
+            LoadSymbol(*Entry, Symbols.emplace_back());
+
+        Begin = Strings + Entry->NameOffset + Entry->NameLength;
+
+        if (Begin >= Stop)
+            break;
+    }
+}
+
+SymbolAddressMatch SymbolIndex::MatchAddress(uint32_t Rva, uint32_t Node) const
+{
+    SymbolAddressMatch Match;
+
+    if (!Node)
+        return Match;
+
+    const SymbolIndexEntry& Entry = Entries[AddressEntries[Node]];
+    uint32_t Displacement = Rva - Entry.Rva;
+
+    if (Displacement < Entry.Size || !Displacement)
+    {
+        Match.Entry = AddressEntries[Node];
+        Match.Displacement = Displacement;
+    }
+
+    return Match;
+}
+
+bool SymbolIndex::FindAddress(uint32_t Rva, PdbSymbol& Symbol, uint32_t& Displacement) const
+{
+    SymbolAddressMatch Match;
+
+    FindAddresses(&Rva, 1, &Match);
+
+    if (Match.Entry == UINT32_MAX)
+        return false;
+
+    LoadSymbol(Entries[Match.Entry], Symbol);
+    Displacement = Match.Displacement;
+
+    return true;
+}
+
+void SymbolIndex::FindAddresses(const uint32_t* Rvas, size_t Count, SymbolAddressMatch* Matches) const
+{
+    uint32_t NumAddresses = Header->NumAddresses;
+    // A tree that stays in the caches gains nothing from prefetching, the prefetches would only cost instructions.
+    bool bPrefetchTree = NumAddresses * sizeof(uint32_t) > AddressPrefetchThreshold;
+
+    for (size_t Base = 0; Base < Count; Base += AddressBatch)
+    {
+        size_t Lanes = std::min(AddressBatch, Count - Base);
+        uint32_t Node[AddressBatch];
+
+        std::fill_n(Node, Lanes, 1u);
+
+        // Every search takes AddressDepth steps and a node past the end counts as greater than any RVA, so the lanes
+        // run without a branch: going right appends a 1 to the node number, going left a 0. The descendants of node k
+        // four levels down are 16k..16k+15, one cache line of the 64-byte aligned array, so prefetching it hides most
+        // of the misses of the deep levels.
+        for (uint32_t Level = 0; Level < AddressDepth; Level++)
+        {
+            for (size_t i = 0; i < Lanes; i++)
+            {
+                uint32_t Current = Node[i];
+                uint32_t bRight = (Current <= NumAddresses) & (AddressKeys[std::min(Current, NumAddresses)] <= Rvas[Base + i]);
+
+                Node[i] = 2 * Current + bRight;
+
+                if (bPrefetchTree)
+                    PrefetchRead(AddressKeys + std::min<uint64_t>(16ull * Node[i], NumAddresses));
+            }
+        }
+
+        // The greatest start address not above the RVA is where the search last went right: drop the left turns
+        // after it, then that turn itself. A search that never went right ends at 0, no symbol.
+        for (size_t i = 0; i < Lanes; i++)
+            Node[i] >>= std::countr_zero(Node[i]) + 1;
+
+        // The matched entries are scattered too; touch them all before the first one is read.
+        for (size_t i = 0; i < Lanes; i++)
+            PrefetchRead(AddressEntries + Node[i]);
+
+        for (size_t i = 0; i < Lanes; i++)
+            PrefetchRead(Entries + AddressEntries[Node[i]]);
+
+        for (size_t i = 0; i < Lanes; i++)
+            Matches[Base + i] = MatchAddress(Rvas[Base + i], Node[i]);
+    }
+}
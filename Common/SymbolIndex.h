@@ -0,0 +1,110 @@
+#pragma once
+
+#include "PdbFile.h"
+#include "NamePattern.h"
+
+struct SymbolIndexHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint16_t Machine;
+    uint16_t Reserved;
+    PdbGuid Guid;
+    uint32_t Age;
+    uint32_t NumSymbols;
+    uint64_t PdbSize;
+    uint32_t NumSlots;
+    uint32_t BloomWords;
+    uint64_t EntriesOffset;
+    uint64_t SlotsOffset;
+    uint64_t BloomOffset;
+    uint64_t StringsOffset;
+    uint64_t StringsSize;
+    uint64_t AddressesOffset;
+    uint32_t NumAddresses;
+    uint32_t Padding;
+};
+
+struct SymbolIndexEntry
+{
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint32_t Rva;
+    uint32_t Size;
+    uint32_t Offset;
+    uint16_t Section;
+    uint16_t Kind;
+};
+
+struct SymbolIndexSlot
+{
+    uint32_t Hash;
+    uint32_t Entry;
+};
+
+// Entry index of the symbol containing an address (UINT32_MAX if none) and the offset into it.
+struct SymbolAddressMatch
+{
+    uint32_t Entry = UINT32_MAX;
+    uint32_t Displacement = 0;
+};
+
+// On-disk name -> RVA index stored next to a PDB. Entries and names are sorted by name,
+// exact lookups go through an open-addressing hash table guarded by a Bloom filter.
+// The reverse direction (RVA -> containing symbol) uses the symbol start addresses in Eytzinger order
+// (a 1-based implicit binary tree, children of node k at 2k and 2k+1), so the first levels of every search share
+// a few cache lines and each further level is one predictable load. Symbol sizes the records do not give are
+// inferred from the next symbol and capped at the end of the module's section contribution.
+class SymbolIndex
+{
+public:
+    static constexpr uint32_t Version = 2;
+
+    static std::filesystem::path GetIndexPath(const std::filesystem::path& PdbPath);
+    static bool Build(const PdbFile& Pdb, uint64_t PdbSize, const std::filesystem::path& IndexPath);
+
+    // Fails unless the index was built from a PDB of this size, GUID and age.
+    bool Open(const std::filesystem::path& IndexPath, uint64_t PdbSize, const PdbGuid& Guid, uint32_t Age);
+    bool IsOpen() const { return File.IsOpen(); }
+    uint64_t GetFileSize() const { return File.Size(); }
+
+    bool Find(const std::string& Name, PdbSymbol& Symbol) const;
+    bool MayContain(const std::string& Name) const;
+    // Exact match on the undecorated form of MSVC-decorated names, either the qualified name ("Bar::Foo") or the full
+    // signature ("Bar::Foo(int) const"). The side index behind it is built in memory on the first call. NumMatches
+    // counts the overloads sharing the name; the one returned comes first in name order.
+    bool FindUndecorated(std::string_view Name, PdbSymbol& Symbol, uint32_t& NumMatches) const;
+    void FindMatches(const NamePattern& Pattern, std::vector<PdbSymbol>& Symbols) const;
+
+    bool FindAddress(uint32_t Rva, PdbSymbol& Symbol, uint32_t& Displacement) const;
+    // Interleaves the searches of a batch level by level so their cache misses overlap.
+    void FindAddresses(const uint32_t* Rvas, size_t Count, SymbolAddressMatch* Matches) const;
+
+    const SymbolIndexHeader& GetHeader() const { return *Header; }
+    uint32_t GetSymbolCount() const { return Header->NumSymbols; }
+    const SymbolIndexEntry& GetEntry(uint32_t Index) const { return Entries[Index]; }
+    std::string_view GetName(const SymbolIndexEntry& Entry) const { return std::string_view(Strings + Entry.NameOffset, Entry.NameLength); }
+
+    static uint64_t HashName(std::string_view Name);
+
+private:
+    bool FindExact(std::string_view Name, PdbSymbol& Symbol) const;
+    void LoadSymbol(const SymbolIndexEntry& Entry, PdbSymbol& Symbol) const;
+    SymbolAddressMatch MatchAddress(uint32_t Rva, uint32_t Node) const;
+    void BuildUndecorated() const;
+
+    MappedFile File;
+    const SymbolIndexHeader* Header = nullptr;
+    const SymbolIndexEntry* Entries = nullptr;
+    const SymbolIndexSlot* Slots = nullptr;
+    const uint64_t* Bloom = nullptr;
+    const char* Strings = nullptr;
+    const uint32_t* AddressKeys = nullptr;
+    const uint32_t* AddressEntries = nullptr;
+    uint32_t AddressDepth = 0;
+
+    // Normalized undecorated names (see NormalizeUndecoratedName) of the decorated entries, hashed like the on-disk
+    // slots. Candidates are confirmed by undecorating them again, so only hashes are kept.
+    mutable std::once_flag UndecoratedBuilt;
+    mutable std::vector<SymbolIndexSlot> UndecoratedSlots;
+};
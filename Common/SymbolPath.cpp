@@ -0,0 +1,199 @@
+#include "SymbolPath.h"
+
+#include <ctime>
+#include <cwctype>
+#include <fstream>
+#include <sstream>
+
+static bool HasPrefix(const std::wstring& Str, const wchar_t* Prefix)
+{
+    for (size_t i = 0; Prefix[i]; i++)
+    {
+        if (i >= Str.size() || static_cast<wchar_t>(std::towlower(Str[i])) != Prefix[i])
+            return false;
+    }
+
+    return true;
+}
+
+static std::vector<std::wstring> SplitTrimmed(const std::wstring& Text, wchar_t Separator)
+{
+    std::vector<std::wstring> Parts;
+    std::wstringstream Stream(Text);
+    std::wstring Part;
+
+    while (std::getline(Stream, Part, Separator))
+    {
+        size_t First = Part.find_first_not_of(L" \t");
+        size_t Last = Part.find_last_not_of(L" \t");
+
+        Parts.push_back(First == std::wstring::npos ? std::wstring() : Part.substr(First, Last - First + 1));
+    }
+
+    return Parts;
+}
+
+static void AddTier(const std::wstring& Location, std::vector<SymbolTier>& Tiers)
+{
+    SymbolTier Tier;
+
+    if (HasPrefix(Location, L"http://") || HasPrefix(Location, L"https://"))
+    {
+        Tier.Server = WideToUtf8(Location);
+
+        if (Tier.Server.back() != '/')
+            Tier.Server += '/';
+    }
+    else
+    {
+        Tier.Directory = Location;
+    }
+
+    Tiers.push_back(std::move(Tier));
+}
+
+bool ParseSymbolPath(const std::wstring& Text, std::vector<SymbolTier>& Tiers, std::string& Error)
+{
+    Tiers.clear();
+
+    for (const std::wstring& Element : SplitTrimmed(Text, L';'))
+    {
+        if (Element.empty())
+            continue;
+
+        if (HasPrefix(Element, L"srv*") || HasPrefix(Element, L"cache*"))
+        {
+            std::vector<std::wstring> Locations = SplitTrimmed(Element.substr(Element.find(L'*') + 1), L'*');
+
+            // "srv**Url" asks dbghelp for its default downstream store; the local store already plays that role.
+            for (const std::wstring& Location : Locations)
+            {
+                if (!Location.empty())
+                    AddTier(Location, Tiers);
+            }
+
+            continue;
+        }
+
+        if (Element.find(L'*') != std::wstring::npos)
+        {
+            Error = "Unsupported symbol path element: " + WideToUtf8(Element);
+
+            return false;
+        }
+
+        AddTier(Element, Tiers);
+    }
+
+    if (Tiers.empty())
+    {
+        Error = "Empty symbol path";
+
+        return false;
+    }
+
+    return true;
+}
+
+bool SymbolMissCache::Open(const std::filesystem::path& CachePath, uint32_t TtlSeconds)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    Path = CachePath;
+    Ttl = TtlSeconds;
+    Expiry.clear();
+    bDirty = false;
+
+    std::ifstream In(Path);
+
+    if (!In.is_open())
+        return false;
+
+    int64_t Now = static_cast<int64_t>(std::time(nullptr));
+    std::string Line;
+
+    while (std::getline(In, Line))
+    {
+        size_t Tab = Line.find('\t');
+
+        if (Tab == std::string::npos)
+            continue;
+
+        int64_t Expires = std::strtoll(Line.c_str(), nullptr, 10);
+
+        // Entries past their expiry are dropped; so is everything once the TTL is shortened below what is left.
+        if (Expires > Now && Expires - Now <= static_cast<int64_t>(Ttl))
+            Expiry[Line.substr(Tab + 1)] = Expires;
+        else
+            bDirty = true;
+    }
+
+    return true;
+}
+
+bool SymbolMissCache::Save()
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    if (!bDirty || Path.empty())
+        return true;
+
+    std::filesystem::path TempPath = Path;
+    std::error_code Error;
+
+    TempPath += L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::trunc);
+
+        if (!Out.is_open())
+            return false;
+
+        for (const auto& [Key, Expires] : Expiry)
+            Out << Expires << '\t' << Key << '\n';
+
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(TempPath, Error);
+
+            return false;
+        }
+    }
+
+    std::filesystem::rename(TempPath, Path, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    bDirty = false;
+
+    return true;
+}
+
+bool SymbolMissCache::IsMissing(const std::string& Server, const std::string& Key) const
+{
+    if (!Ttl)
+        return false;
+
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    auto Entry = Expiry.find(Server + '\t' + Key);
+
+    return Entry != Expiry.end() && Entry->second > static_cast<int64_t>(std::time(nullptr));
+}
+
+void SymbolMissCache::AddMiss(const std::string& Server, const std::string& Key)
+{
+    if (!Ttl)
+        return;
+
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    Expiry[Server + '\t' + Key] = static_cast<int64_t>(std::time(nullptr)) + Ttl;
+    bDirty = true;
+}
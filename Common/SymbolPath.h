@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// One source of PDBs behind the local store: a directory laid out like a symbol server
+// ("<Dir>/<name.pdb>/<GUID><age>/<name.pdb>", typically a cache shared on a network drive) or an HTTP symbol server.
+struct SymbolTier
+{
+    std::filesystem::path Directory;
+    // Base URL ending in '/', empty for directory tiers.
+    std::string Server;
+
+    bool IsServer() const { return !Server.empty(); }
+    std::string Describe() const { return IsServer() ? Server : WideToUtf8(Directory.wstring()); }
+};
+
+// Parses a symbol path in the _NT_SYMBOL_PATH syntax into tiers, nearest first. Elements are separated by ';' and are
+// either "srv*Dir*...*Url", "cache*Dir", a plain directory or a plain http(s) URL.
+bool ParseSymbolPath(const std::wstring& Text, std::vector<SymbolTier>& Tiers, std::string& Error);
+
+// PDBs a server answered 404 for, kept for a TTL so repeated runs do not ask again. Stored as a text file of
+// "<expiry>\t<server>\t<key>" lines; expired entries are dropped on load. A TTL of 0 disables the cache.
+class SymbolMissCache
+{
+public:
+    static constexpr uint32_t DefaultTtlSeconds = 24 * 60 * 60;
+
+    bool Open(const std::filesystem::path& CachePath, uint32_t TtlSeconds);
+    bool Save();
+
+    bool IsMissing(const std::string& Server, const std::string& Key) const;
+    void AddMiss(const std::string& Server, const std::string& Key);
+
+private:
+    std::filesystem::path Path;
+    uint32_t Ttl = DefaultTtlSeconds;
+
+    mutable std::mutex Lock;
+    // "<server>\t<key>" -> expiry (seconds since the epoch).
+    std::unordered_map<std::string, int64_t> Expiry;
+    bool bDirty = false;
+};
@@ -0,0 +1,331 @@
+#include "SymbolResolver.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <sstream>
+
+static constexpr std::string_view VirtualSlotSuffix = "@vslot";
+static constexpr std::string_view VirtualOffsetSuffix = "@voffset";
+
+std::vector<std::wstring> SplitSymbols(const std::wstring& SymbolsStr)
+{
+    std::vector<std::wstring> Symbols;
+    std::wstringstream StrStream(SymbolsStr);
+    std::wstring Symbol;
+
+    while (std::getline(StrStream, Symbol, L','))
+    {
+        size_t Start = Symbol.find_first_not_of(L" \t");
+        size_t End = Symbol.find_last_not_of(L" \t");
+
+        if (Start != std::wstring::npos && End != std::wstring::npos)
+            Symbol = Symbol.substr(Start, End - Start + 1);
+
+        if (!Symbol.empty())
+            Symbols.push_back(std::move(Symbol));
+    }
+
+    return Symbols;
+}
+
+bool SymbolResolver::Open(const std::filesystem::path& PDBPath)
+{
+    ScopedTimer Timer("PDB open");
+    std::error_code Error;
+    uint64_t PDBSize = std::filesystem::file_size(PDBPath, Error);
+    std::filesystem::path IndexPath = SymbolIndex::GetIndexPath(PDBPath);
+    PdbGuid Guid;
+    uint32_t Age;
+
+    Path = PDBPath;
+
+    // A PDB rebuilt in place often keeps its size, never its GUID and age.
+    if (PdbFile::ReadIdentity(PDBPath, Guid, Age) && Index.Open(IndexPath, PDBSize, Guid, Age))
+    {
+        AddStat(StatCounter::IndexHits);
+        printf_s("[*] Using symbol index: %ls\n", IndexPath.filename().wstring().c_str());
+        Cache.Open(TypeCache::GetCachePath(PDBPath), Index.GetHeader().Guid, Index.GetHeader().Age, PDBSize);
+
+        return true;
+    }
+
+    if (!Pdb.Open(PDBPath))
+    {
+        printf_s("[-] Failed to load PDB! :( %s\n\n", Pdb.GetError().c_str());
+
+        return false;
+    }
+
+    Cache.Open(TypeCache::GetCachePath(PDBPath), Pdb.GetGuid(), Pdb.GetAge(), PDBSize);
+    AddStat(StatCounter::IndexMisses);
+
+    bool bBuilt;
+
+    {
+        ScopedTimer BuildTimer("Symbol index build");
+
+        bBuilt = SymbolIndex::Build(Pdb, PDBSize, IndexPath);
+    }
+
+    if (bBuilt && Index.Open(IndexPath, PDBSize, Pdb.GetGuid(), Pdb.GetAge()))
+        printf_s("[+] Symbol index created: %ls (%u symbols)\n", IndexPath.filename().wstring().c_str(), Index.GetSymbolCount());
+    else
+        printf_s("[!] Failed to create symbol index, using PDB directly\n");
+
+    return true;
+}
+
+bool SymbolResolver::Find(const std::string& Name, PdbSymbol& Symbol) const
+{
+    if (Index.IsOpen() ? Index.Find(Name, Symbol) : Pdb.FindSymbol(Name, Symbol))
+        return true;
+
+    // "Type::Member" names try the type information first, see ResolveOffsets.
+    return !IsMemberQuery(Name) && FindUndecorated(Name, Symbol);
+}
+
+bool SymbolResolver::FindUndecorated(const std::string& Name, PdbSymbol& Symbol) const
+{
+    uint32_t NumMatches;
+
+    if (!Index.IsOpen() || Name.empty() || Name.front() == '?' || !Index.FindUndecorated(Name, Symbol, NumMatches))
+        return false;
+
+    if (NumMatches > 1)
+        printf_s("[!] '%s' matches %u overloads, using %s\n", Name.c_str(), NumMatches, Symbol.Name.c_str());
+
+    return true;
+}
+
+bool SymbolResolver::IsMemberQuery(std::string_view Name)
+{
+    return !Name.empty() && Name.front() != '?' && Name.find("::") != std::string_view::npos && Name.find('(') == std::string_view::npos;
+}
+
+bool SymbolResolver::IsVirtualSlotQuery(std::string_view Name)
+{
+    return IsMemberQuery(Name) && (Name.ends_with(VirtualSlotSuffix) || Name.ends_with(VirtualOffsetSuffix));
+}
+
+void SymbolResolver::LoadTypes() const
+{
+    ScopedTimer Timer("Types load");
+
+    // With the symbol index open the PDB itself was never mapped.
+    if (!Index.IsOpen())
+        Types.Open(Pdb.GetMsf());
+    else if (TypesMsf.Open(Path))
+        Types.Open(TypesMsf);
+}
+
+void SymbolResolver::LoadLines() const
+{
+    ScopedTimer Timer("Lines load");
+
+    if (!Index.IsOpen())
+        SourceLines.Open(Pdb);
+    else if (LinesPdb.Open(Path))
+        SourceLines.Open(LinesPdb);
+}
+
+bool SymbolResolver::FindLines(const uint32_t* Rvas, size_t Count, PdbSourceLine* Lines) const
+{
+    std::call_once(LinesLoaded, [this]() { LoadLines(); });
+
+    if (!SourceLines.IsOpen())
+        return false;
+
+    SourceLines.FindLines(Rvas, Count, Lines);
+
+    return true;
+}
+
+bool SymbolResolver::HasTypes() const
+{
+    std::call_once(TypesLoaded, [this]() { LoadTypes(); });
+
+    return Types.IsOpen();
+}
+
+uint32_t SymbolResolver::GetPointerSize() const
+{
+    uint16_t Machine = Index.IsOpen() ? Index.GetHeader().Machine : Pdb.GetMachine();
+
+    // x86, ARM and ARM Thumb-2, everything else is 64-bit.
+    return (Machine == 0x14C || Machine == 0x1C0 || Machine == 0x1C4) ? 4 : 8;
+}
+
+bool SymbolResolver::FindVirtualSlot(std::string_view Query, uint64_t& Value) const
+{
+    bool bByteOffset = Query.ends_with(VirtualOffsetSuffix);
+    std::string_view Name = Query.substr(0, Query.size() - (bByteOffset ? VirtualOffsetSuffix.size() : VirtualSlotSuffix.size()));
+    size_t Separator = Name.rfind("::");
+    PdbVirtualSlot Slot;
+
+    if (!Types.FindVirtualSlot(Name.substr(0, Separator), Name.substr(Separator + 2), Slot))
+        return false;
+
+    if (Slot.NumVirtualOverloads > 1)
+        printf_s("[!] '%s' has %u virtual overloads in %s, using the first one\n", std::string(Name).c_str(), Slot.NumVirtualOverloads, Slot.Introducer.c_str());
+
+    Value = bByteOffset ? Slot.VtableOffset : Slot.VtableOffset / GetPointerSize();
+
+    return true;
+}
+
+bool SymbolResolver::FindMember(const std::string& Name, uint64_t& Offset) const
+{
+    size_t Separator = Name.rfind("::");
+
+    if (Separator == std::string::npos)
+        return false;
+
+    // Cached results don't need the TPI stream at all.
+    if (Cache.Find(Name, Offset))
+        return true;
+
+    if (!HasTypes())
+        return false;
+
+    bool bFound = IsVirtualSlotQuery(Name) ? FindVirtualSlot(Name, Offset) :
+        Types.FindMemberOffset(std::string_view(Name).substr(0, Separator), std::string_view(Name).substr(Separator + 2), Offset);
+
+    if (bFound)
+        Cache.Add(Name, Offset);
+
+    return bFound;
+}
+
+bool SymbolResolver::FindAddresses(const uint32_t* Rvas, size_t Count, SymbolAddressMatch* Matches) const
+{
+    if (!Index.IsOpen())
+        return false;
+
+    Index.FindAddresses(Rvas, Count, Matches);
+
+    return true;
+}
+
+void SymbolResolver::FindMatches(const NamePattern& Pattern, std::vector<PdbSymbol>& Symbols) const
+{
+    if (Index.IsOpen())
+    {
+        Index.FindMatches(Pattern, Symbols);
+
+        return;
+    }
+
+    size_t First = Symbols.size();
+
+    Pdb.EnumerateSymbols([&](const PdbSymbol& Symbol)
+    {
+        if (Pattern.Match(Symbol.Name))
+            Symbols.push_back(Symbol);
+    });
+
+    auto ByName = [](const PdbSymbol& Left, const PdbSymbol& Right) { return Left.Name < Right.Name; };
+    auto SameName = [](const PdbSymbol& Left, const PdbSymbol& Right) { return Left.Name == Right.Name; };
+
+    std::stable_sort(Symbols.begin() + First, Symbols.end(), ByName);
+    Symbols.erase(std::unique(Symbols.begin() + First, Symbols.end(), SameName), Symbols.end());
+}
+
+bool SymbolResolver::ResolveOffsets(const std::vector<std::wstring>& Names, std::map<std::wstring, std::wstring>& Offsets) const
+{
+    ScopedTimer Timer("Resolve");
+    bool bIsSuccess = true;
+
+    for (const std::wstring& Sym : Names)
+    {
+        if (NamePattern::IsPattern(WideToUtf8(Sym)))
+        {
+            std::vector<PdbSymbol> Matches;
+
+            FindMatches(NamePattern(WideToUtf8(Sym)), Matches);
+
+            if (Matches.empty())
+            {
+                printf_s("[-] No symbols match '%ls'! :(\n\n", Sym.c_str());
+
+                AddStat(StatCounter::SymbolsMissing);
+                bIsSuccess = false;
+
+                continue;
+            }
+
+            std::string Lines;
+            char Line[64];
+
+            for (const PdbSymbol& Match : Matches)
+            {
+                snprintf(Line, sizeof(Line), "' -> Offset: %u | Section: %u:0x%X\n", Match.Rva, Match.Section, Match.Offset);
+                Lines += "    '" + Match.Name + Line;
+
+                Offsets[Utf8ToWide(Match.Name)] = std::to_wstring(Match.Rva);
+            }
+
+            printf_s("[+] Pattern '%ls' matched %zu symbol(s)\n%s", Sym.c_str(), Matches.size(), Lines.c_str());
+            AddStat(StatCounter::SymbolsResolved, Matches.size());
+
+            continue;
+        }
+
+        PdbSymbol Symbol;
+        std::string Name = WideToUtf8(Sym);
+        bool bFound = Find(Name, Symbol);
+
+        uint64_t MemberOffset;
+
+        if (!bFound && IsMemberQuery(Name) && !FindMember(Name, MemberOffset))
+        {
+            // Methods named without their signature ("Bar::Foo") are symbols rather than members.
+            bFound = !IsVirtualSlotQuery(Name) && FindUndecorated(Name, Symbol);
+
+            if (!bFound)
+            {
+                printf_s(HasTypes() ? "[-] Member '%ls' not found! :(\n\n" : "[-] Member '%ls' not found, the PDB has no type information! :(\n\n", Sym.c_str());
+
+                AddStat(StatCounter::SymbolsMissing);
+                bIsSuccess = false;
+
+                continue;
+            }
+        }
+        else if (!bFound && IsMemberQuery(Name))
+        {
+            if (!IsVirtualSlotQuery(Name))
+                printf_s("[+] Found member '%ls' -> Offset: %llu (0x%llX)\n", Sym.c_str(), static_cast<unsigned long long>(MemberOffset),
+                    static_cast<unsigned long long>(MemberOffset));
+            else if (Name.ends_with(VirtualOffsetSuffix))
+                printf_s("[+] Found virtual method '%ls' -> Vtable offset: %llu (0x%llX)\n", Sym.c_str(), static_cast<unsigned long long>(MemberOffset),
+                    static_cast<unsigned long long>(MemberOffset));
+            else
+                printf_s("[+] Found virtual method '%ls' -> Slot: %llu\n", Sym.c_str(), static_cast<unsigned long long>(MemberOffset));
+
+            Offsets[Sym] = std::to_wstring(MemberOffset);
+            AddStat(StatCounter::SymbolsResolved);
+
+            continue;
+        }
+
+        if (!bFound)
+        {
+            printf_s("[-] Symbol '%ls' not found! :(\n\n", Sym.c_str());
+
+            AddStat(StatCounter::SymbolsMissing);
+            bIsSuccess = false;
+
+            continue;
+        }
+
+        printf_s("[+] Found symbol '%ls' -> Offset: %u | Section: %u:0x%X\n", Sym.c_str(), Symbol.Rva, Symbol.Section, Symbol.Offset);
+
+        Offsets[Sym] = std::to_wstring(Symbol.Rva);
+        AddStat(StatCounter::SymbolsResolved);
+    }
+
+    if (!Cache.Save())
+        printf_s("[!] Failed to update type cache\n");
+
+    return bIsSuccess;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "PdbFile.h"
+#include "PdbLines.h"
+#include "PdbTypes.h"
+#include "SymbolIndex.h"
+#include "TypeCache.h"
+
+#include <map>
+
+std::vector<std::wstring> SplitSymbols(const std::wstring& SymbolsStr);
+
+// Resolves names against a PDB, going through its persistent symbol index when one exists.
+// Names containing '*' are resolved as patterns and contribute one offset per matching symbol. "Type::Member"
+// names that are not symbols resolve to the member offset from the TPI stream, which is only mapped on first use;
+// "Class::Method@vslot" and "Class::Method@voffset" resolve to the vtable slot index or byte offset of a virtual method.
+// Type query results are kept in a TypeCache next to the PDB. Names that match no symbol exactly are looked up by
+// their undecorated form ("Bar::Foo" or "Bar::Foo(int) const" for "?Foo@Bar@@QEBAXH@Z") through the symbol index.
+class SymbolResolver
+{
+public:
+    bool Open(const std::filesystem::path& PdbPath);
+    bool Find(const std::string& Name, PdbSymbol& Symbol) const;
+    void FindMatches(const NamePattern& Pattern, std::vector<PdbSymbol>& Symbols) const;
+    bool FindMember(const std::string& Name, uint64_t& Offset) const;
+    bool FindUndecorated(const std::string& Name, PdbSymbol& Symbol) const;
+    bool HasTypes() const;
+    bool SaveTypeCache() const { return Cache.Save(); }
+
+    static bool IsMemberQuery(std::string_view Name);
+    static bool IsVirtualSlotQuery(std::string_view Name);
+
+    bool ResolveOffsets(const std::vector<std::wstring>& Names, std::map<std::wstring, std::wstring>& Offsets) const;
+
+    // RVA -> containing symbol, batched (see SymbolIndex). Needs the symbol index; false without one.
+    bool FindAddresses(const uint32_t* Rvas, size_t Count, SymbolAddressMatch* Matches) const;
+    std::string_view GetSymbolName(uint32_t Entry) const { return Index.GetName(Index.GetEntry(Entry)); }
+    // RVA -> source file and line (see PdbLines). With the symbol index open the PDB is only mapped for this on first
+    // use; false if it has no line information.
+    bool FindLines(const uint32_t* Rvas, size_t Count, PdbSourceLine* Lines) const;
+
+    // Bytes mapped for lookups: the symbol index when one is open, the PDB otherwise. A paged PDB maps nothing, its
+    // pages count against the shared page cache limit instead.
+    uint64_t GetMappedSize() const
+    {
+        if (Index.IsOpen())
+            return Index.GetFileSize();
+
+        return Pdb.GetMsf().IsPaged() ? 0 : Pdb.GetMsf().GetFileSize();
+    }
+
+private:
+    void LoadTypes() const;
+    void LoadLines() const;
+    bool FindVirtualSlot(std::string_view Query, uint64_t& Value) const;
+    uint32_t GetPointerSize() const;
+
+    std::filesystem::path Path;
+    PdbFile Pdb;
+    SymbolIndex Index;
+
+    mutable std::once_flag TypesLoaded;
+    mutable MsfFile TypesMsf;
+    mutable PdbTypes Types;
+    mutable TypeCache Cache;
+
+    mutable std::once_flag LinesLoaded;
+    mutable PdbFile LinesPdb;
+    mutable PdbLines SourceLines;
+};
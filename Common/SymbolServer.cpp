@@ -0,0 +1,548 @@
+#include "SymbolServer.h"
+#include "PeFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+typedef SOCKET SocketHandle;
+
+static constexpr SocketHandle BadSocket = INVALID_SOCKET;
+
+static void CloseSocket(SocketHandle Socket)
+{
+    closesocket(Socket);
+}
+#else
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+typedef int SocketHandle;
+
+static constexpr SocketHandle BadSocket = -1;
+
+static void CloseSocket(SocketHandle Socket)
+{
+    close(Socket);
+}
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// A client that sends this much without a newline is not speaking the protocol.
+static constexpr size_t MaxRequestLength = 1024 * 1024;
+
+static bool SendAll(SocketHandle Socket, const std::string& Data)
+{
+    size_t Sent = 0;
+
+    while (Sent < Data.size())
+    {
+        int Chunk = static_cast<int>(std::min<size_t>(Data.size() - Sent, 1 << 20));
+        int Result = send(Socket, Data.data() + Sent, Chunk, MSG_NOSIGNAL);
+
+        if (Result <= 0)
+            return false;
+
+        Sent += Result;
+    }
+
+    return true;
+}
+
+static std::vector<std::string> SplitFields(const std::string& Line)
+{
+    std::vector<std::string> Fields;
+    size_t Start = 0;
+
+    for (;;)
+    {
+        size_t End = Line.find('\t', Start);
+
+        Fields.push_back(Line.substr(Start, End == std::string::npos ? std::string::npos : End - Start));
+
+        if (End == std::string::npos)
+            break;
+
+        Start = End + 1;
+    }
+
+    return Fields;
+}
+
+SymbolServer::SymbolServer(const std::filesystem::path& SymbolsPath, uint64_t MemoryBudget) : Budget(MemoryBudget)
+{
+    Store.Open(SymbolsPath, true);
+}
+
+bool SymbolServer::Run(const std::filesystem::path& SocketPath)
+{
+#ifdef _WIN32
+    WSADATA WsaData;
+
+    if (WSAStartup(MAKEWORD(2, 2), &WsaData) != 0)
+    {
+        printf_s("[-] Failed to initialize Winsock! :(\n");
+
+        return false;
+    }
+#else
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    sockaddr_un Address = {};
+    std::string PathStr = WideToUtf8(SocketPath.wstring());
+
+    if (PathStr.empty() || PathStr.size() >= sizeof(Address.sun_path))
+    {
+        printf_s("[-] Socket path is too long! :( Path: %ls\n", SocketPath.wstring().c_str());
+
+        return false;
+    }
+
+    Address.sun_family = AF_UNIX;
+    memcpy(Address.sun_path, PathStr.c_str(), PathStr.size() + 1);
+
+    SocketHandle Listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (Listener == BadSocket)
+    {
+        printf_s("[-] Failed to create socket! :(\n");
+
+        return false;
+    }
+
+    // A socket file left behind by a previous run would make bind fail.
+    std::error_code Error;
+    std::filesystem::remove(SocketPath, Error);
+
+    if (bind(Listener, reinterpret_cast<const sockaddr*>(&Address), sizeof(Address)) != 0 || listen(Listener, SOMAXCONN) != 0)
+    {
+        printf_s("[-] Failed to listen on %ls! :(\n", SocketPath.wstring().c_str());
+        CloseSocket(Listener);
+
+        return false;
+    }
+
+    printf_s("[+] Listening on %ls (cache budget: %llu MB)\n", SocketPath.wstring().c_str(), static_cast<unsigned long long>(Budget >> 20));
+
+    for (;;)
+    {
+        SocketHandle Client = accept(Listener, nullptr, nullptr);
+
+        if (Client == BadSocket)
+        {
+#ifndef _WIN32
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+#endif
+            printf_s("[-] Failed to accept connection! :(\n");
+
+            break;
+        }
+
+        std::thread(&SymbolServer::ServeClient, this, static_cast<intptr_t>(Client)).detach();
+    }
+
+    CloseSocket(Listener);
+    std::filesystem::remove(SocketPath, Error);
+
+    return false;
+}
+
+void SymbolServer::ServeClient(intptr_t Handle)
+{
+    SocketHandle Client = static_cast<SocketHandle>(Handle);
+    std::string Buffer;
+    char Chunk[16384];
+
+    for (;;)
+    {
+        int Received = recv(Client, Chunk, sizeof(Chunk), 0);
+
+        if (Received <= 0)
+            break;
+
+        Buffer.append(Chunk, Received);
+
+        // Everything that arrived in one read is answered with one write, so pipelined batches cost one round trip.
+        std::string Response;
+        size_t Start = 0;
+        size_t End;
+
+        while ((End = Buffer.find('\n', Start)) != std::string::npos)
+        {
+            std::string Line = Buffer.substr(Start, End - Start);
+
+            if (!Line.empty() && Line.back() == '\r')
+                Line.pop_back();
+
+            Response += HandleRequest(Line);
+            Start = End + 1;
+        }
+
+        Buffer.erase(0, Start);
+
+        bool bTooLong = Buffer.size() > MaxRequestLength;
+
+        if (bTooLong)
+            Response += "ERR\tRequest too long\n\n";
+
+        if (!SendAll(Client, Response) || bTooLong)
+            break;
+    }
+
+    CloseSocket(Client);
+}
+
+std::string SymbolServer::HandleRequest(const std::string& Line)
+{
+    if (Line.empty())
+        return {};
+
+    std::vector<std::string> Fields = SplitFields(Line);
+
+    if (Fields[0] == "RESOLVE" && Fields.size() == 3)
+        return Resolve(Fields[1], Fields[2]);
+
+    if (Fields[0] == "STATS" && Fields.size() == 1)
+        return FormatStats();
+
+    Requests++;
+    Failed++;
+
+    return "ERR\tUnknown request\n\n";
+}
+
+bool SymbolServer::ResolveIdentity(const std::string& Identity, std::filesystem::path& PdbPath, std::string& Error)
+{
+    size_t Slash = Identity.find_first_of("/\\");
+
+    if (Slash != std::string::npos && Slash == Identity.rfind('/') && SymbolStore::IsSignature(std::string_view(Identity).substr(Slash + 1)))
+    {
+        PdbPath = Store.GetPdbPath(Identity.substr(0, Slash), Identity.substr(Slash + 1));
+    }
+    else
+    {
+        std::filesystem::path Path(Utf8ToWide(Identity));
+
+        if (_wcsicmp(Path.extension().wstring().c_str(), L".pdb") == 0)
+        {
+            PdbPath = Path;
+        }
+        else
+        {
+            PeDebugInfo Info;
+
+            if (ReadPeDebugInfo(Path, Info, Error) != PeStatus::Ok)
+                return false;
+
+            PdbPath = Store.GetPdbPath(Info.GetPdbFileName(), Info.GetSignature());
+        }
+    }
+
+    std::error_code Ec;
+
+    if (!std::filesystem::is_regular_file(PdbPath, Ec))
+    {
+        Error = "PDB not found: " + WideToUtf8(PdbPath.wstring());
+
+        return false;
+    }
+
+    return true;
+}
+
+std::shared_ptr<SymbolServer::CacheEntry> SymbolServer::Acquire(const std::filesystem::path& PdbPath, bool& bHit)
+{
+    std::error_code Error;
+    std::filesystem::path Canonical = std::filesystem::weakly_canonical(PdbPath, Error);
+    std::string Key = WideToUtf8((Error ? PdbPath : Canonical).wstring());
+    std::filesystem::file_time_type WriteTime = std::filesystem::last_write_time(PdbPath, Error);
+
+    if (Error)
+        return nullptr;
+
+    uint64_t FileSize = std::filesystem::file_size(PdbPath, Error);
+
+    if (Error)
+        return nullptr;
+
+    // A PDB replaced in place (same path, new contents) drops the stale entry instead of answering from it.
+    auto Lookup = [&]() -> std::shared_ptr<CacheEntry>
+    {
+        std::lock_guard<std::mutex> Guard(CacheLock);
+        auto It = Entries.find(Key);
+
+        if (It == Entries.end())
+            return nullptr;
+
+        std::shared_ptr<CacheEntry> Entry = *It->second;
+
+        if (Entry->WriteTime != WriteTime || Entry->FileSize != FileSize)
+        {
+            ResidentBytes -= Entry->MappedSize;
+            Lru.erase(It->second);
+            Entries.erase(It);
+
+            return nullptr;
+        }
+
+        Lru.splice(Lru.begin(), Lru, It->second);
+
+        return Entry;
+    };
+
+    bHit = true;
+
+    if (std::shared_ptr<CacheEntry> Entry = Lookup())
+        return Entry;
+
+    // Loads are serialized so two clients asking for the same cold PDB do not build its index twice.
+    std::lock_guard<std::mutex> Guard(LoadLock);
+
+    if (std::shared_ptr<CacheEntry> Entry = Lookup())
+        return Entry;
+
+    bHit = false;
+
+    std::shared_ptr<CacheEntry> Entry = std::make_shared<CacheEntry>();
+
+    if (!Entry->Resolver.Open(PdbPath))
+        return nullptr;
+
+    Entry->Key = Key;
+    Entry->WriteTime = WriteTime;
+    Entry->FileSize = FileSize;
+    Entry->MappedSize = Entry->Resolver.GetMappedSize();
+
+    Insert(Entry);
+
+    return Entry;
+}
+
+void SymbolServer::Insert(const std::shared_ptr<CacheEntry>& Entry)
+{
+    std::lock_guard<std::mutex> Guard(CacheLock);
+
+    Lru.push_front(Entry);
+    Entries[Entry->Key] = Lru.begin();
+    ResidentBytes += Entry->MappedSize;
+
+    // The newest entry always stays, even when it alone is over budget. Evicted entries are unmapped
+    // once the last query still using them finishes.
+    while (ResidentBytes > Budget && Lru.size() > 1)
+    {
+        const std::shared_ptr<CacheEntry>& Oldest = Lru.back();
+
+        printf_s("[*] Evicting %s (%llu KB)\n", Oldest->Key.c_str(), static_cast<unsigned long long>(Oldest->MappedSize >> 10));
+
+        ResidentBytes -= Oldest->MappedSize;
+        Entries.erase(Oldest->Key);
+        Lru.pop_back();
+        Evictions++;
+    }
+}
+
+std::string SymbolServer::Resolve(const std::string& Identity, const std::string& Names)
+{
+    auto Start = std::chrono::steady_clock::now();
+    std::filesystem::path PdbPath;
+    std::string Error;
+
+    Requests++;
+
+    if (!ResolveIdentity(Identity, PdbPath, Error))
+    {
+        Failed++;
+
+        return "ERR\t" + Error + "\n\n";
+    }
+
+    std::vector<std::wstring> Symbols = SplitSymbols(Utf8ToWide(Names));
+
+    if (Symbols.empty())
+    {
+        Failed++;
+
+        return "ERR\tNo valid symbols\n\n";
+    }
+
+    bool bHit = false;
+    std::shared_ptr<CacheEntry> Entry = Acquire(PdbPath, bHit);
+
+    if (!Entry)
+    {
+        Failed++;
+
+        return "ERR\tFailed to load PDB: " + WideToUtf8(PdbPath.wstring()) + "\n\n";
+    }
+
+    (bHit ? Hits : Misses)++;
+
+    std::string Body;
+    size_t Found = 0;
+    size_t Missing = 0;
+
+    {
+        std::lock_guard<std::mutex> Guard(Entry->Lock);
+
+        for (const std::wstring& Symbol : Symbols)
+        {
+            std::string Name = WideToUtf8(Symbol);
+
+            if (NamePattern::IsPattern(Name))
+            {
+                std::vector<PdbSymbol> Matches;
+
+                Entry->Resolver.FindMatches(NamePattern(Name), Matches);
+
+                for (const PdbSymbol& Match : Matches)
+                    Body += Match.Name + "\t" + std::to_string(Match.Rva) + "\n";
+
+                Found += Matches.size();
+
+                if (Matches.empty())
+                {
+                    Body += Name + "\t-\n";
+                    Missing++;
+                }
+
+                continue;
+            }
+
+            PdbSymbol Match;
+            uint64_t MemberOffset;
+
+            if (Entry->Resolver.Find(Name, Match))
+            {
+                Body += Name + "\t" + std::to_string(Match.Rva) + "\n";
+                Found++;
+            }
+            else if (SymbolResolver::IsMemberQuery(Name) && Entry->Resolver.FindMember(Name, MemberOffset))
+            {
+                Body += Name + "\t" + std::to_string(MemberOffset) + "\n";
+                Found++;
+            }
+            else if (SymbolResolver::IsMemberQuery(Name) && !SymbolResolver::IsVirtualSlotQuery(Name) && Entry->Resolver.FindUndecorated(Name, Match))
+            {
+                Body += Name + "\t" + std::to_string(Match.Rva) + "\n";
+                Found++;
+            }
+            else
+            {
+                Body += Name + "\t-\n";
+                Missing++;
+            }
+        }
+
+        // Only writes when this request computed new type query results.
+        Entry->Resolver.SaveTypeCache();
+    }
+
+    uint64_t Microseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Start).count();
+
+    NamesFound += Found;
+    NamesMissing += Missing;
+    RecordLatency(Microseconds);
+
+    printf_s("[*] %ls: %zu found, %zu missing in %llu us (%s)\n", PdbPath.filename().wstring().c_str(), Found, Missing,
+        static_cast<unsigned long long>(Microseconds), bHit ? "cached" : "loaded");
+
+    return "OK\t" + std::to_string(Found) + "\t" + std::to_string(Missing) + "\t" + std::to_string(Microseconds) + "\t" +
+        (bHit ? "hit" : "miss") + "\n" + Body + "\n";
+}
+
+void SymbolServer::RecordLatency(uint64_t Microseconds)
+{
+    Latency[std::min<size_t>(std::bit_width(Microseconds), LatencyBuckets - 1)]++;
+    TotalLatency += Microseconds;
+
+    uint64_t Max = MaxLatency.load();
+
+    while (Microseconds > Max && !MaxLatency.compare_exchange_weak(Max, Microseconds))
+    {
+    }
+}
+
+std::string SymbolServer::FormatStats()
+{
+    uint64_t Counts[LatencyBuckets];
+    uint64_t Timed = 0;
+
+    for (size_t i = 0; i < LatencyBuckets; i++)
+        Timed += Counts[i] = Latency[i].load();
+
+    // Percentiles are reported as the upper bound of the power-of-two bucket they fall into.
+    auto Percentile = [&](uint64_t Permille) -> uint64_t
+    {
+        uint64_t Rank = (Timed * Permille + 999) / 1000;
+        uint64_t Seen = 0;
+
+        for (size_t i = 0; i < LatencyBuckets; i++)
+        {
+            Seen += Counts[i];
+
+            if (Timed && Seen >= Rank)
+                return 1ull << i;
+        }
+
+        return 0;
+    };
+
+    size_t NumCached;
+    uint64_t Resident;
+
+    {
+        std::lock_guard<std::mutex> Guard(CacheLock);
+
+        NumCached = Lru.size();
+        Resident = ResidentBytes;
+    }
+
+    uint64_t NumHits = Hits.load();
+    uint64_t NumMisses = Misses.load();
+    char HitRate[32];
+
+    snprintf(HitRate, sizeof(HitRate), "%.4f", NumHits + NumMisses ? static_cast<double>(NumHits) / static_cast<double>(NumHits + NumMisses) : 0.0);
+
+    std::pair<const char*, std::string> Stats[] =
+    {
+        { "requests", std::to_string(Requests.load()) },
+        { "failed", std::to_string(Failed.load()) },
+        { "names_found", std::to_string(NamesFound.load()) },
+        { "names_missing", std::to_string(NamesMissing.load()) },
+        { "cache_hits", std::to_string(NumHits) },
+        { "cache_misses", std::to_string(NumMisses) },
+        { "cache_hit_rate", HitRate },
+        { "cache_evictions", std::to_string(Evictions.load()) },
+        { "cached_pdbs", std::to_string(NumCached) },
+        { "resident_bytes", std::to_string(Resident) },
+        { "budget_bytes", std::to_string(Budget) },
+        { "latency_avg_us", std::to_string(Timed ? TotalLatency.load() / Timed : 0) },
+        { "latency_p50_us", std::to_string(Percentile(500)) },
+        { "latency_p99_us", std::to_string(Percentile(990)) },
+        { "latency_max_us", std::to_string(MaxLatency.load()) },
+    };
+
+    std::string Response = "OK\n";
+
+    for (const auto& [Key, Value] : Stats)
+        Response += std::string(Key) + "\t" + Value + "\n";
+
+    return Response + "\n";
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "SymbolResolver.h"
+#include "SymbolStore.h"
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Long-running resolver behind a local Unix-domain socket. Opened PDBs/indexes stay resident in an LRU bounded by
+// the mapped size, so a query costs a lookup instead of a process start and a PDB load.
+//
+// Line protocol (UTF-8, one request per line, fields separated by tabs, requests may be pipelined):
+//   RESOLVE <identity> <Name1, Type::Member, ...>  identity: "<name.pdb>/<signature>", a PE path or a PDB path
+//   STATS
+// Every response is a status line ("OK ..." or "ERR <message>"), optional "<key>\t<value>" lines and an empty line.
+class SymbolServer
+{
+public:
+    static constexpr uint64_t DefaultBudget = 512ull * 1024 * 1024;
+
+    SymbolServer(const std::filesystem::path& SymbolsPath, uint64_t MemoryBudget);
+
+    bool Run(const std::filesystem::path& SocketPath);
+
+    std::string HandleRequest(const std::string& Line);
+
+private:
+    struct CacheEntry
+    {
+        std::string Key;
+        std::filesystem::file_time_type WriteTime;
+        uint64_t FileSize = 0;
+        uint64_t MappedSize = 0;
+        SymbolResolver Resolver;
+        // PdbFile loads module streams lazily, so lookups on one entry are serialized.
+        std::mutex Lock;
+    };
+
+    void ServeClient(intptr_t Client);
+    bool ResolveIdentity(const std::string& Identity, std::filesystem::path& PdbPath, std::string& Error);
+    std::shared_ptr<CacheEntry> Acquire(const std::filesystem::path& PdbPath, bool& bHit);
+    void Insert(const std::shared_ptr<CacheEntry>& Entry);
+    std::string Resolve(const std::string& Identity, const std::string& Names);
+    std::string FormatStats();
+    void RecordLatency(uint64_t Microseconds);
+
+    SymbolStore Store;
+    uint64_t Budget;
+
+    std::mutex CacheLock;
+    std::mutex LoadLock;
+    std::list<std::shared_ptr<CacheEntry>> Lru;
+    std::unordered_map<std::string, std::list<std::shared_ptr<CacheEntry>>::iterator> Entries;
+    uint64_t ResidentBytes = 0;
+
+    static constexpr size_t LatencyBuckets = 32;
+
+    std::atomic<uint64_t> Requests{ 0 };
+    std::atomic<uint64_t> Failed{ 0 };
+    std::atomic<uint64_t> NamesFound{ 0 };
+    std::atomic<uint64_t> NamesMissing{ 0 };
+    std::atomic<uint64_t> Hits{ 0 };
+    std::atomic<uint64_t> Misses{ 0 };
+    std::atomic<uint64_t> Evictions{ 0 };
+    std::atomic<uint64_t> TotalLatency{ 0 };
+    std::atomic<uint64_t> MaxLatency{ 0 };
+    // Bucket i counts queries that took less than 2^i microseconds (and at least 2^(i-1)).
+    std::atomic<uint64_t> Latency[LatencyBuckets] = {};
+};
@@ -0,0 +1,557 @@
+#include "SymbolStore.h"
+#include "MsfFile.h"
+#include "PdbFormat.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+static const char SymbolStoreMagic[8] = { 'A', 'e', 'P', 'D', 'B', 'S', 't', 'r' };
+static const wchar_t ManifestName[] = L"manifest.bin";
+static const wchar_t LockName[] = L"manifest.lock";
+
+static std::string ToLower(std::string_view Str)
+{
+    std::string Result(Str);
+
+    for (char& Char : Result)
+    {
+        if (Char >= 'A' && Char <= 'Z')
+            Char = static_cast<char>(Char - 'A' + 'a');
+    }
+
+    return Result;
+}
+
+static uint64_t HashKey(std::string_view Key)
+{
+    uint64_t Hash = 0xCBF29CE484222325ull;
+
+    for (char Char : Key)
+    {
+        Hash ^= static_cast<uint8_t>(Char);
+        Hash *= 0x100000001B3ull;
+    }
+
+    return Hash ^ (Hash >> 29);
+}
+
+static uint64_t AlignTo8(uint64_t Value)
+{
+    return (Value + 7) & ~7ull;
+}
+
+static std::filesystem::path ToPath(const std::string& Str)
+{
+    return std::filesystem::path(Utf8ToWide(Str));
+}
+
+static std::string FromPath(const std::filesystem::path& Path)
+{
+    return WideToUtf8(Path.wstring());
+}
+
+// A rebuild has no record of how a PDB was fetched. A sparse fetch never keeps stream 0 (the old MSF directory), which
+// linkers always write, and keeps the type stream only when it was asked for the types.
+static PdbContents ProbeContents(const std::filesystem::path& PdbPath)
+{
+    MsfFile Msf;
+
+    if (!Msf.Open(PdbPath) || !Msf.IsNilStream(0))
+        return PdbContents::Full;
+
+    return Msf.GetStreamSize(PdbTpiStream) ? PdbContents::SymbolsAndTypes : PdbContents::Symbols;
+}
+
+static bool Covers(PdbContents Contents, PdbContents Needed)
+{
+    return Contents == PdbContents::Full || Needed == PdbContents::Symbols || Contents == Needed;
+}
+
+bool SymbolStore::IsSignature(std::string_view Signature)
+{
+    if (Signature.size() < 33 || Signature.size() > 40)
+        return false;
+
+    return std::all_of(Signature.begin(), Signature.end(), [](char Char)
+    {
+        return (Char >= '0' && Char <= '9') || (Char >= 'A' && Char <= 'F') || (Char >= 'a' && Char <= 'f');
+    });
+}
+
+void SymbolStore::ApplyChange(const std::vector<SignatureEntry>& Added, const std::vector<std::string>& Removed, std::vector<SignatureEntry>& Signatures)
+{
+    std::erase_if(Signatures, [&](const SignatureEntry& Stored) { return std::find(Removed.begin(), Removed.end(), Stored.Signature) != Removed.end(); });
+
+    for (const SignatureEntry& Signature : Added)
+    {
+        auto It = std::find_if(Signatures.begin(), Signatures.end(), [&](const SignatureEntry& Stored) { return Stored.Signature == Signature.Signature; });
+
+        if (It != Signatures.end())
+            It->Contents = Signature.Contents;
+        else
+            Signatures.push_back(Signature);
+    }
+}
+
+bool SymbolStore::Open(const std::filesystem::path& StoreRoot, bool bOpenReadOnly)
+{
+    ScopedTimer Timer("Store open");
+    std::lock_guard<std::mutex> Guard(Lock);
+    std::error_code Error;
+
+    Root = StoreRoot;
+    bReadOnly = bOpenReadOnly;
+    Changes.clear();
+    LegacyPaths.clear();
+
+    if (Load())
+        return true;
+
+    if (bReadOnly)
+    {
+        std::map<std::string, NameEntry> Entries;
+
+        Scan(Entries, false);
+
+        for (const auto& [Key, Entry] : Entries)
+            Modify(Entry.Name).Added = Entry.Signatures;
+
+        return true;
+    }
+
+    std::filesystem::create_directories(Root, Error);
+
+    return Write();
+}
+
+bool SymbolStore::Load()
+{
+    std::ifstream In(Root / ManifestName, std::ios::binary | std::ios::ate);
+    std::streamoff Size = In.is_open() ? static_cast<std::streamoff>(In.tellg()) : 0;
+
+    Header = nullptr;
+    Data.clear();
+
+    if (Size < static_cast<std::streamoff>(sizeof(SymbolStoreHeader)))
+        return false;
+
+    Data.resize(static_cast<size_t>(Size));
+    In.seekg(0);
+
+    if (!In.read(reinterpret_cast<char*>(Data.data()), Size))
+    {
+        Data.clear();
+
+        return false;
+    }
+
+    const SymbolStoreHeader* Candidate = reinterpret_cast<const SymbolStoreHeader*>(Data.data());
+
+    bool bValid = memcmp(Candidate->Magic, SymbolStoreMagic, sizeof(SymbolStoreMagic)) == 0 && Candidate->Version == Version &&
+        Candidate->NumSlots && !(Candidate->NumSlots & (Candidate->NumSlots - 1)) && Candidate->NumNames < Candidate->NumSlots &&
+        Candidate->NamesOffset + static_cast<uint64_t>(Candidate->NumNames) * sizeof(SymbolStoreName) <= Candidate->SignaturesOffset &&
+        Candidate->SignaturesOffset + static_cast<uint64_t>(Candidate->NumSignatures) * sizeof(SymbolStoreSignature) <= Candidate->SlotsOffset &&
+        Candidate->SlotsOffset + static_cast<uint64_t>(Candidate->NumSlots) * sizeof(SymbolStoreSlot) <= Candidate->StringsOffset &&
+        Candidate->StringsOffset + Candidate->StringsSize <= static_cast<uint64_t>(Size) &&
+        !(Candidate->NamesOffset % 8) && !(Candidate->SignaturesOffset % 8) && !(Candidate->SlotsOffset % 8);
+
+    if (bValid)
+    {
+        Names = reinterpret_cast<const SymbolStoreName*>(Data.data() + Candidate->NamesOffset);
+        Signatures = reinterpret_cast<const SymbolStoreSignature*>(Data.data() + Candidate->SignaturesOffset);
+        Slots = reinterpret_cast<const SymbolStoreSlot*>(Data.data() + Candidate->SlotsOffset);
+        Strings = reinterpret_cast<const char*>(Data.data() + Candidate->StringsOffset);
+
+        for (uint32_t i = 0; i < Candidate->NumNames && bValid; i++)
+        {
+            bValid = static_cast<uint64_t>(Names[i].NameOffset) + Names[i].NameLength <= Candidate->StringsSize &&
+                static_cast<uint64_t>(Names[i].FirstSignature) + Names[i].NumSignatures <= Candidate->NumSignatures;
+        }
+
+        for (uint32_t i = 0; i < Candidate->NumSignatures && bValid; i++)
+        {
+            bValid = static_cast<uint64_t>(Signatures[i].Offset) + Signatures[i].Length <= Candidate->StringsSize &&
+                Signatures[i].Contents <= static_cast<uint32_t>(PdbContents::SymbolsAndTypes);
+        }
+
+        for (uint32_t i = 0; i < Candidate->NumSlots && bValid; i++)
+            bValid = Slots[i].Name <= Candidate->NumNames;
+    }
+
+    if (!bValid)
+    {
+        Data.clear();
+
+        return false;
+    }
+
+    Header = Candidate;
+
+    return true;
+}
+
+void SymbolStore::Scan(std::map<std::string, NameEntry>& Entries, bool bMigrate)
+{
+    ScopedTimer Timer("Store rebuild");
+    std::error_code Error;
+    std::vector<std::filesystem::path> LegacyFiles;
+
+    for (const auto& Entry : std::filesystem::directory_iterator(Root, Error))
+    {
+        std::string FileName = FromPath(Entry.path().filename());
+        size_t Separator = FileName.rfind('_');
+
+        if (Entry.is_regular_file() && Separator != std::string::npos && FileName.size() > 4 &&
+            ToLower(FileName.substr(FileName.size() - 4)) == ".pdb" && IsSignature(std::string_view(FileName).substr(Separator + 1, FileName.size() - 4 - Separator - 1)))
+        {
+            LegacyFiles.push_back(Entry.path());
+        }
+    }
+
+    for (const std::filesystem::path& Legacy : LegacyFiles)
+    {
+        std::string FileName = FromPath(Legacy.filename());
+        size_t Separator = FileName.rfind('_');
+        std::string PdbName = FileName.substr(0, Separator) + ".pdb";
+        std::string Signature = FileName.substr(Separator + 1, FileName.size() - 4 - Separator - 1);
+
+        // Without migration the old file is used where it is.
+        if (!bMigrate)
+        {
+            NameEntry& Stored = Entries[ToLower(PdbName)];
+
+            if (Stored.Name.empty())
+                Stored.Name = PdbName;
+
+            ApplyChange({ { Signature, ProbeContents(Legacy) } }, {}, Stored.Signatures);
+            LegacyPaths[ToLower(PdbName) + "/" + Signature] = Legacy;
+
+            continue;
+        }
+
+        std::filesystem::path Target = Root / ToPath(PdbName) / ToPath(Signature) / ToPath(PdbName);
+
+        std::filesystem::create_directories(Target.parent_path(), Error);
+        std::filesystem::rename(Legacy, Target, Error);
+
+        if (Error)
+            continue;
+
+        std::filesystem::path LegacyIndex = Legacy;
+        std::filesystem::path TargetIndex = Target;
+
+        std::filesystem::rename(LegacyIndex.replace_extension(L".idx"), TargetIndex.replace_extension(L".idx"), Error);
+    }
+
+    for (const auto& Entry : std::filesystem::directory_iterator(Root, Error))
+    {
+        if (!Entry.is_directory())
+            continue;
+
+        std::filesystem::path PdbFileName = Entry.path().filename();
+        std::string PdbName = FromPath(PdbFileName);
+
+        for (const auto& Child : std::filesystem::directory_iterator(Entry.path(), Error))
+        {
+            std::string Signature = FromPath(Child.path().filename());
+
+            if (!Child.is_directory() || !IsSignature(Signature) || !std::filesystem::is_regular_file(Child.path() / PdbFileName, Error))
+                continue;
+
+            NameEntry& Stored = Entries[ToLower(PdbName)];
+
+            Stored.Name = PdbName;
+            ApplyChange({ { Signature, ProbeContents(Child.path() / PdbFileName) } }, {}, Stored.Signatures);
+        }
+    }
+}
+
+bool SymbolStore::FindLoaded(const std::string& Key, NameEntry& Entry) const
+{
+    if (!Header)
+        return false;
+
+    uint64_t Hash = HashKey(Key);
+    uint32_t SlotMask = Header->NumSlots - 1;
+
+    for (uint32_t Slot = static_cast<uint32_t>(Hash) & SlotMask; Slots[Slot].Name; Slot = (Slot + 1) & SlotMask)
+    {
+        if (Slots[Slot].Hash != static_cast<uint32_t>(Hash >> 32))
+            continue;
+
+        const SymbolStoreName& Name = Names[Slots[Slot].Name - 1];
+        std::string_view Stored(Strings + Name.NameOffset, Name.NameLength);
+
+        if (ToLower(Stored) != Key)
+            continue;
+
+        Entry.Name = Stored;
+        Entry.Signatures.clear();
+
+        for (uint32_t i = 0; i < Name.NumSignatures; i++)
+        {
+            const SymbolStoreSignature& Signature = Signatures[Name.FirstSignature + i];
+
+            Entry.Signatures.push_back({ std::string(Strings + Signature.Offset, Signature.Length), static_cast<PdbContents>(Signature.Contents) });
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+const SymbolStore::NameEntry* SymbolStore::Find(const std::string& Key, NameEntry& Scratch) const
+{
+    bool bLoaded = FindLoaded(Key, Scratch);
+    auto It = Changes.find(Key);
+
+    if (It == Changes.end())
+        return bLoaded ? &Scratch : nullptr;
+
+    if (!bLoaded)
+    {
+        Scratch.Name = It->second.Name;
+        Scratch.Signatures.clear();
+    }
+
+    ApplyChange(It->second.Added, It->second.Removed, Scratch.Signatures);
+
+    return &Scratch;
+}
+
+SymbolStore::NameChange& SymbolStore::Modify(const std::string& PdbName)
+{
+    NameChange& Change = Changes[ToLower(PdbName)];
+
+    if (Change.Name.empty())
+        Change.Name = PdbName;
+
+    return Change;
+}
+
+std::filesystem::path SymbolStore::GetPdbPath(const std::string& PdbName, const std::string& Signature) const
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    auto Legacy = LegacyPaths.find(ToLower(PdbName) + "/" + Signature);
+
+    if (Legacy != LegacyPaths.end())
+        return Legacy->second;
+
+    NameEntry Scratch;
+    const NameEntry* Entry = Find(ToLower(PdbName), Scratch);
+    std::filesystem::path Name = ToPath(Entry ? Entry->Name : PdbName);
+
+    return Root / Name / ToPath(Signature) / Name;
+}
+
+bool SymbolStore::Contains(const std::string& PdbName, const std::string& Signature, PdbContents Needed) const
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    NameEntry Scratch;
+    const NameEntry* Entry = Find(ToLower(PdbName), Scratch);
+
+    if (!Entry)
+        return false;
+
+    auto It = std::find_if(Entry->Signatures.begin(), Entry->Signatures.end(), [&](const SignatureEntry& Stored) { return Stored.Signature == Signature; });
+
+    return It != Entry->Signatures.end() && Covers(It->Contents, Needed);
+}
+
+std::vector<std::string> SymbolStore::GetSignatures(const std::string& PdbName) const
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    NameEntry Scratch;
+    const NameEntry* Entry = Find(ToLower(PdbName), Scratch);
+    std::vector<std::string> Result;
+
+    for (size_t i = 0; Entry && i < Entry->Signatures.size(); i++)
+        Result.push_back(Entry->Signatures[i].Signature);
+
+    return Result;
+}
+
+void SymbolStore::Add(const std::string& PdbName, const std::string& Signature, PdbContents Contents)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    NameChange& Change = Modify(PdbName);
+
+    std::erase(Change.Removed, Signature);
+    ApplyChange({ { Signature, Contents } }, {}, Change.Added);
+}
+
+bool SymbolStore::Remove(const std::string& PdbName, const std::string& Signature)
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+    NameEntry Scratch;
+    const NameEntry* Entry = Find(ToLower(PdbName), Scratch);
+    std::filesystem::path NameDir = Root / ToPath(Entry ? Entry->Name : PdbName);
+    std::error_code Error;
+
+    if (bReadOnly)
+        return false;
+
+    NameChange& Change = Modify(PdbName);
+
+    ApplyChange({}, { Signature }, Change.Added);
+
+    if (std::find(Change.Removed.begin(), Change.Removed.end(), Signature) == Change.Removed.end())
+        Change.Removed.push_back(Signature);
+
+    std::filesystem::remove_all(NameDir / ToPath(Signature), Error);
+
+    if (Error)
+        return false;
+
+    if (std::filesystem::is_empty(NameDir, Error))
+        std::filesystem::remove(NameDir, Error);
+
+    return true;
+}
+
+bool SymbolStore::Save()
+{
+    std::lock_guard<std::mutex> Guard(Lock);
+
+    if (bReadOnly)
+        return false;
+
+    if (Changes.empty() && Header)
+        return true;
+
+    return Write();
+}
+
+bool SymbolStore::Write()
+{
+    ScopedTimer Timer("Store write");
+    FileLock WriteLock;
+    std::map<std::string, NameEntry> All;
+
+    // Other processes write the manifest too: it is read again under the lock and only the changes of this one are
+    // replayed over it. The tree is walked when there is no usable manifest to start from.
+    if (!WriteLock.Lock(Root / LockName))
+        return false;
+
+    if (Load())
+    {
+        for (uint32_t i = 0; i < Header->NumNames; i++)
+        {
+            std::string Key = ToLower(std::string_view(Strings + Names[i].NameOffset, Names[i].NameLength));
+
+            FindLoaded(Key, All[Key]);
+        }
+    }
+    else
+    {
+        Scan(All, true);
+    }
+
+    for (const auto& [Key, Change] : Changes)
+    {
+        NameEntry& Entry = All[Key];
+
+        if (Entry.Name.empty())
+            Entry.Name = Change.Name;
+
+        ApplyChange(Change.Added, Change.Removed, Entry.Signatures);
+    }
+
+    std::erase_if(All, [](const auto& Item) { return Item.second.Signatures.empty(); });
+
+    SymbolStoreHeader NewHeader = {};
+    std::vector<SymbolStoreName> NewNames;
+    std::vector<SymbolStoreSignature> NewSignatures;
+    std::vector<uint64_t> NewHashes;
+    std::string NewStrings;
+
+    for (const auto& [Key, Entry] : All)
+    {
+        NewNames.push_back({ static_cast<uint32_t>(NewStrings.size()), static_cast<uint32_t>(Entry.Name.size()),
+            static_cast<uint32_t>(NewSignatures.size()), static_cast<uint32_t>(Entry.Signatures.size()) });
+        NewHashes.push_back(HashKey(Key));
+        NewStrings += Entry.Name;
+
+        for (const SignatureEntry& Signature : Entry.Signatures)
+        {
+            NewSignatures.push_back({ static_cast<uint32_t>(NewStrings.size()), static_cast<uint32_t>(Signature.Signature.size()), static_cast<uint32_t>(Signature.Contents) });
+            NewStrings += Signature.Signature;
+        }
+    }
+
+    uint32_t NumSlots = 16;
+
+    while (NumSlots < NewNames.size() * 2)
+        NumSlots <<= 1;
+
+    std::vector<SymbolStoreSlot> NewSlots(NumSlots);
+
+    for (uint32_t i = 0; i < NewNames.size(); i++)
+    {
+        uint32_t Slot = static_cast<uint32_t>(NewHashes[i]) & (NumSlots - 1);
+
+        while (NewSlots[Slot].Name)
+            Slot = (Slot + 1) & (NumSlots - 1);
+
+        NewSlots[Slot] = { static_cast<uint32_t>(NewHashes[i] >> 32), i + 1 };
+    }
+
+    memcpy(NewHeader.Magic, SymbolStoreMagic, sizeof(SymbolStoreMagic));
+    NewHeader.Version = Version;
+    NewHeader.NumNames = static_cast<uint32_t>(NewNames.size());
+    NewHeader.NumSignatures = static_cast<uint32_t>(NewSignatures.size());
+    NewHeader.NumSlots = NumSlots;
+    NewHeader.NamesOffset = AlignTo8(sizeof(SymbolStoreHeader));
+    NewHeader.SignaturesOffset = AlignTo8(NewHeader.NamesOffset + NewNames.size() * sizeof(SymbolStoreName));
+    NewHeader.SlotsOffset = AlignTo8(NewHeader.SignaturesOffset + NewSignatures.size() * sizeof(SymbolStoreSignature));
+    NewHeader.StringsOffset = NewHeader.SlotsOffset + NewSlots.size() * sizeof(SymbolStoreSlot);
+    NewHeader.StringsSize = NewStrings.size();
+
+    std::filesystem::path ManifestPath = Root / ManifestName;
+    std::filesystem::path TempPath = ManifestPath;
+    std::error_code Error;
+
+    TempPath += L"." + std::to_wstring(GetCurrentPid()) + L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+        if (!Out.is_open())
+            return false;
+
+        static const char Padding[8] = {};
+
+        Out.write(reinterpret_cast<const char*>(&NewHeader), sizeof(NewHeader));
+        Out.write(Padding, NewHeader.NamesOffset - sizeof(NewHeader));
+        Out.write(reinterpret_cast<const char*>(NewNames.data()), NewNames.size() * sizeof(SymbolStoreName));
+        Out.write(Padding, NewHeader.SignaturesOffset - NewHeader.NamesOffset - NewNames.size() * sizeof(SymbolStoreName));
+        Out.write(reinterpret_cast<const char*>(NewSignatures.data()), NewSignatures.size() * sizeof(SymbolStoreSignature));
+        Out.write(Padding, NewHeader.SlotsOffset - NewHeader.SignaturesOffset - NewSignatures.size() * sizeof(SymbolStoreSignature));
+        Out.write(reinterpret_cast<const char*>(NewSlots.data()), NewSlots.size() * sizeof(SymbolStoreSlot));
+        Out.write(NewStrings.data(), NewStrings.size());
+
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(TempPath, Error);
+
+            return false;
+        }
+    }
+
+    std::filesystem::rename(TempPath, ManifestPath, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+
+        return false;
+    }
+
+    Changes.clear();
+
+    return Load();
+}
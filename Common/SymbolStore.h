@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Platform.h"
+
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct SymbolStoreHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t NumNames;
+    uint32_t NumSignatures;
+    uint32_t NumSlots;
+    uint64_t NamesOffset;
+    uint64_t SignaturesOffset;
+    uint64_t SlotsOffset;
+    uint64_t StringsOffset;
+    uint64_t StringsSize;
+};
+
+struct SymbolStoreName
+{
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint32_t FirstSignature;
+    uint32_t NumSignatures;
+};
+
+struct SymbolStoreSignature
+{
+    uint32_t Offset;
+    uint32_t Length;
+    uint32_t Contents;
+};
+
+struct SymbolStoreSlot
+{
+    uint32_t Hash;
+    uint32_t Name;
+};
+
+// What a stored PDB holds: the whole file, or only what a sparse fetch keeps (see SparsePdb.h).
+enum class PdbContents : uint32_t
+{
+    Full,
+    Symbols,
+    SymbolsAndTypes,
+};
+
+// Symbol server style directory layout "<Root>/<name.pdb>/<GUID><age>/<name.pdb>" with a manifest that maps a PDB
+// name (case-insensitive) to the signatures present and what each of them holds, so presence checks never walk the
+// directory. The manifest is read into memory once and probed there; the file itself is never held open, so other
+// processes can replace it. Changes are kept in memory until Save(), which merges them into the manifest on disk
+// under a lock file: several tools can share a store at once. A missing or unreadable manifest is rebuilt from the
+// directory tree, moving old flat "<name>_<signature>.pdb" files into place on the way.
+class SymbolStore
+{
+public:
+    static constexpr uint32_t Version = 2;
+
+    // A read-only store never creates, moves or writes anything: without a usable manifest the tree is only walked
+    // in memory, old flat files are found where they are, and Save() fails.
+    bool Open(const std::filesystem::path& StoreRoot, bool bOpenReadOnly = false);
+    bool Save();
+
+    std::filesystem::path GetPdbPath(const std::string& PdbName, const std::string& Signature) const;
+    // False also when the stored PDB is sparse and holds less than Needed.
+    bool Contains(const std::string& PdbName, const std::string& Signature, PdbContents Needed = PdbContents::Full) const;
+    std::vector<std::string> GetSignatures(const std::string& PdbName) const;
+
+    // Adding a signature that is already present replaces what it holds.
+    void Add(const std::string& PdbName, const std::string& Signature, PdbContents Contents = PdbContents::Full);
+    bool Remove(const std::string& PdbName, const std::string& Signature);
+
+    static bool IsSignature(std::string_view Signature);
+
+private:
+    struct SignatureEntry
+    {
+        std::string Signature;
+        PdbContents Contents;
+    };
+
+    struct NameEntry
+    {
+        std::string Name;
+        std::vector<SignatureEntry> Signatures;
+    };
+
+    // What this process added and removed under a name, replayed over whatever the manifest holds when it is written.
+    struct NameChange
+    {
+        std::string Name;
+        std::vector<SignatureEntry> Added;
+        std::vector<std::string> Removed;
+    };
+
+    static void ApplyChange(const std::vector<SignatureEntry>& Added, const std::vector<std::string>& Removed, std::vector<SignatureEntry>& Signatures);
+
+    bool Load();
+    void Scan(std::map<std::string, NameEntry>& Entries, bool bMigrate);
+    bool Write();
+    bool FindLoaded(const std::string& Key, NameEntry& Entry) const;
+    const NameEntry* Find(const std::string& Key, NameEntry& Scratch) const;
+    NameChange& Modify(const std::string& PdbName);
+
+    std::filesystem::path Root;
+    bool bReadOnly = false;
+    std::vector<uint8_t> Data;
+    const SymbolStoreHeader* Header = nullptr;
+    const SymbolStoreName* Names = nullptr;
+    const SymbolStoreSignature* Signatures = nullptr;
+    const SymbolStoreSlot* Slots = nullptr;
+    const char* Strings = nullptr;
+
+    std::unordered_map<std::string, NameChange> Changes;
+    // Old flat files a read-only store uses in place, by "<lower-case name>/<signature>".
+    std::map<std::string, std::filesystem::path> LegacyPaths;
+    mutable std::mutex Lock;
+};
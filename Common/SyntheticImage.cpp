@@ -0,0 +1,591 @@
+#include "SyntheticImage.h"
+#include "MsfFile.h"
+#include "PdbFile.h"
+#include "PdbFormat.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+static constexpr uint32_t PdbInfoVersion = 20000404;
+static constexpr uint32_t DbiVersion = 19990903;
+static constexpr uint16_t DbiBuildNumber = 0x8E00;
+static constexpr uint32_t TpiVersion = 20040203;
+static constexpr uint32_t TpiNumHashBuckets = 0x3FFFF;
+static constexpr uint32_t TpiIndexOffsetInterval = 8192;
+static constexpr uint32_t TypeIndexBegin = 0x1000;
+static constexpr uint32_t TypeUInt64 = 0x0023;
+static constexpr uint16_t MemberAccessPublic = 3;
+static constexpr uint32_t PublicFunctionFlag = 2;
+static constexpr uint32_t ModuleSignatureC13 = 4;
+static constexpr uint32_t LineIsStatement = 0x80000000;
+static constexpr uint32_t GsiBitmapWords = (GsiHashTable::NumHashBuckets + 1 + 31) / 32;
+
+static constexpr uint32_t PublicSpacing = 16;
+static constexpr uint32_t TextRva = 0x1000;
+static constexpr uint32_t SectionAlignment = 0x1000;
+static constexpr uint32_t FileAlignment = 0x200;
+static constexpr uint32_t SizeOfHeaders = 0x400;
+static constexpr uint32_t NtHeadersOffset = 0x80;
+static constexpr uint32_t DebugEntrySize = 28;
+static constexpr uint32_t RsdsHeaderSize = 24;
+
+struct SyntheticLayout
+{
+    uint32_t TextSize;
+    uint32_t RdataRva;
+    uint32_t DataRva;
+    uint32_t ImageSize;
+};
+
+static SyntheticLayout GetLayout(const SyntheticImageOptions& Options)
+{
+    SyntheticLayout Layout;
+    uint64_t CodeSize = static_cast<uint64_t>(Options.NumPublics) * PublicSpacing;
+
+    Layout.TextSize = static_cast<uint32_t>(std::max<uint64_t>((CodeSize + SectionAlignment - 1) / SectionAlignment * SectionAlignment, SectionAlignment));
+    Layout.RdataRva = TextRva + Layout.TextSize;
+    Layout.DataRva = Layout.RdataRva + SectionAlignment;
+    Layout.ImageSize = Layout.DataRva + SectionAlignment;
+
+    return Layout;
+}
+
+template <typename T>
+static void AppendValue(std::vector<uint8_t>& Data, T Value)
+{
+    uint8_t Bytes[sizeof(T)];
+
+    memcpy(Bytes, &Value, sizeof(T));
+    Data.insert(Data.end(), Bytes, Bytes + sizeof(T));
+}
+
+template <typename T>
+static void StoreValue(std::vector<uint8_t>& Data, size_t Offset, T Value)
+{
+    memcpy(Data.data() + Offset, &Value, sizeof(T));
+}
+
+static void AppendName(std::vector<uint8_t>& Data, const std::string& Name)
+{
+    Data.insert(Data.end(), Name.begin(), Name.end());
+    Data.push_back(0);
+}
+
+// Type records and their sub-records are aligned with LF_PAD bytes (0xF0 + bytes left), symbol records with zeros.
+static void AlignRecord(std::vector<uint8_t>& Data, size_t Start, bool bTypePadding)
+{
+    for (size_t Padding = (4 - (Data.size() - Start) % 4) % 4; Padding > 0; Padding--)
+        Data.push_back(bTypePadding ? static_cast<uint8_t>(0xF0 + Padding) : 0);
+}
+
+static void AppendRecord(std::vector<uint8_t>& Stream, uint16_t Kind, const std::vector<uint8_t>& Body, bool bTypePadding)
+{
+    size_t Start = Stream.size();
+
+    AppendValue<uint16_t>(Stream, 0);
+    AppendValue<uint16_t>(Stream, Kind);
+    Stream.insert(Stream.end(), Body.begin(), Body.end());
+    AlignRecord(Stream, Start, bTypePadding);
+    StoreValue<uint16_t>(Stream, Start, static_cast<uint16_t>(Stream.size() - Start - sizeof(uint16_t)));
+}
+
+static std::vector<uint8_t> BuildSectionHeaders(const SyntheticImageOptions& Options)
+{
+    SyntheticLayout Layout = GetLayout(Options);
+    PdbSectionHeader Sections[3] = {};
+    std::vector<uint8_t> Data(sizeof(Sections));
+
+    memcpy(Sections[0].Name, ".text", 5);
+    Sections[0].VirtualSize = Layout.TextSize;
+    Sections[0].VirtualAddress = TextRva;
+    Sections[0].SizeOfRawData = FileAlignment;
+    Sections[0].PointerToRawData = SizeOfHeaders;
+    Sections[0].Characteristics = 0x60000020;
+
+    memcpy(Sections[1].Name, ".rdata", 6);
+    Sections[1].VirtualSize = FileAlignment;
+    Sections[1].VirtualAddress = Layout.RdataRva;
+    Sections[1].SizeOfRawData = FileAlignment;
+    Sections[1].PointerToRawData = SizeOfHeaders + FileAlignment;
+    Sections[1].Characteristics = 0x40000040;
+
+    memcpy(Sections[2].Name, ".data", 5);
+    Sections[2].VirtualSize = SectionAlignment;
+    Sections[2].VirtualAddress = Layout.DataRva;
+    Sections[2].Characteristics = 0xC0000040;
+
+    memcpy(Data.data(), Sections, sizeof(Sections));
+
+    return Data;
+}
+
+std::string GetSyntheticPublicName(uint32_t Index)
+{
+    char Name[64];
+
+    // The name shapes of system PDBs: decorated methods, exported routines, internal functions and data.
+    switch (Index % 4)
+    {
+    case 0: snprintf(Name, sizeof(Name), "?Method%u@Class%u@@QEAAXXZ", Index, Index / 64); break;
+    case 1: snprintf(Name, sizeof(Name), "NtBenchRoutine%u", Index); break;
+    case 2: snprintf(Name, sizeof(Name), "KiBenchDispatch%u", Index); break;
+    default: snprintf(Name, sizeof(Name), "g_BenchData%u", Index); break;
+    }
+
+    return Name;
+}
+
+uint32_t GetSyntheticPublicRva(uint32_t Index)
+{
+    return TextRva + Index * PublicSpacing;
+}
+
+std::string GetSyntheticSourceFile(uint32_t Module)
+{
+    return "C:\\bench\\src\\module" + std::to_string(Module) + ".cpp";
+}
+
+uint32_t GetSyntheticLine(uint32_t Index, uint32_t Displacement)
+{
+    return 100 + (Index % SyntheticPublicsPerModule) * 2 + (Displacement >= PublicSpacing / 2 ? 1 : 0);
+}
+
+std::string GetSyntheticTypeName(uint32_t Index)
+{
+    return "BenchType" + std::to_string(Index);
+}
+
+static std::vector<uint8_t> BuildPublics(const std::vector<std::pair<uint32_t, uint32_t>>& SortedRecords, const std::vector<uint32_t>& AddrMap)
+{
+    std::vector<uint8_t> Hash;
+    uint32_t Bitmap[GsiBitmapWords] = {};
+    std::vector<uint32_t> BucketStarts;
+
+    for (size_t i = 0; i < SortedRecords.size(); i++)
+    {
+        uint32_t Bucket = SortedRecords[i].first;
+
+        if (!(Bitmap[Bucket / 32] & (1u << (Bucket % 32))))
+        {
+            Bitmap[Bucket / 32] |= 1u << (Bucket % 32);
+            BucketStarts.push_back(static_cast<uint32_t>(i * GsiBucketOffsetScale));
+        }
+    }
+
+    GsiHashHeader Header = { GsiHashSignature, GsiHashVersion, static_cast<uint32_t>(SortedRecords.size() * GsiHashRecordSize),
+        static_cast<uint32_t>(sizeof(Bitmap) + BucketStarts.size() * sizeof(uint32_t)) };
+
+    Hash.insert(Hash.end(), reinterpret_cast<const uint8_t*>(&Header), reinterpret_cast<const uint8_t*>(&Header + 1));
+
+    // Hash records hold the symbol record offset + 1 and a reference count.
+    for (const auto& [Bucket, Offset] : SortedRecords)
+    {
+        AppendValue<uint32_t>(Hash, Offset + 1);
+        AppendValue<uint32_t>(Hash, 1);
+    }
+
+    Hash.insert(Hash.end(), reinterpret_cast<const uint8_t*>(Bitmap), reinterpret_cast<const uint8_t*>(Bitmap + GsiBitmapWords));
+
+    for (uint32_t Start : BucketStarts)
+        AppendValue<uint32_t>(Hash, Start);
+
+    PublicsStreamHeader Publics = {};
+    std::vector<uint8_t> Data;
+
+    Publics.SymHash = static_cast<uint32_t>(Hash.size());
+    Publics.AddrMap = static_cast<uint32_t>(AddrMap.size() * sizeof(uint32_t));
+
+    Data.reserve(sizeof(Publics) + Hash.size() + Publics.AddrMap);
+    Data.insert(Data.end(), reinterpret_cast<const uint8_t*>(&Publics), reinterpret_cast<const uint8_t*>(&Publics + 1));
+    Data.insert(Data.end(), Hash.begin(), Hash.end());
+    Data.insert(Data.end(), reinterpret_cast<const uint8_t*>(AddrMap.data()), reinterpret_cast<const uint8_t*>(AddrMap.data() + AddrMap.size()));
+
+    return Data;
+}
+
+static std::vector<uint8_t> BuildTpiHeader(uint32_t TypeIndexEnd, uint32_t RecordBytes, uint16_t HashStream, uint32_t NumHashValues, uint32_t NumIndexOffsets)
+{
+    TpiStreamHeader Header = {};
+    std::vector<uint8_t> Data(sizeof(Header));
+
+    Header.Version = TpiVersion;
+    Header.HeaderSize = sizeof(TpiStreamHeader);
+    Header.TypeIndexBegin = TypeIndexBegin;
+    Header.TypeIndexEnd = TypeIndexEnd;
+    Header.TypeRecordBytes = RecordBytes;
+    Header.HashStreamIndex = HashStream;
+    Header.HashAuxStreamIndex = NilStreamIndex;
+    Header.HashKeySize = sizeof(uint32_t);
+    Header.NumHashBuckets = TpiNumHashBuckets;
+    Header.HashValueBufferOffset = 0;
+    Header.HashValueBufferLength = NumHashValues * sizeof(uint32_t);
+    Header.IndexOffsetBufferOffset = static_cast<int32_t>(Header.HashValueBufferLength);
+    Header.IndexOffsetBufferLength = NumIndexOffsets * 2 * sizeof(uint32_t);
+    Header.HashAdjBufferOffset = static_cast<int32_t>(Header.HashValueBufferLength + Header.IndexOffsetBufferLength);
+    memcpy(Data.data(), &Header, sizeof(Header));
+
+    return Data;
+}
+
+static bool BuildTypes(MsfWriter& Writer, const SyntheticImageOptions& Options, std::string& Error)
+{
+    std::vector<uint8_t> Records;
+    std::vector<uint32_t> Hashes;
+    std::vector<std::pair<uint32_t, uint32_t>> IndexOffsets;
+    std::vector<uint8_t> Body;
+    uint32_t TypeIndex = TypeIndexBegin;
+
+    auto AddType = [&](uint16_t Kind, uint32_t Hash)
+    {
+        if (IndexOffsets.empty() || Records.size() - IndexOffsets.back().second >= TpiIndexOffsetInterval)
+            IndexOffsets.emplace_back(TypeIndex, static_cast<uint32_t>(Records.size()));
+
+        AppendRecord(Records, Kind, Body, true);
+        Hashes.push_back(Hash);
+
+        return TypeIndex++;
+    };
+
+    for (uint32_t i = 0; i < Options.NumTypes; i++)
+    {
+        Body.clear();
+
+        for (uint32_t Member = 0; Member < SyntheticMembersPerType; Member++)
+        {
+            size_t Start = Body.size();
+
+            AppendValue<uint16_t>(Body, LF_MEMBER);
+            AppendValue<uint16_t>(Body, MemberAccessPublic);
+            AppendValue<uint32_t>(Body, TypeUInt64);
+            AppendValue<uint16_t>(Body, static_cast<uint16_t>(Member * sizeof(uint64_t)));
+            AppendName(Body, "Field" + std::to_string(Member));
+            AlignRecord(Body, Start, true);
+        }
+
+        // Only UDT definitions are hashed by name, anything else just needs to land in some bucket.
+        uint32_t FieldList = AddType(LF_FIELDLIST, (TypeIndex * 2654435761u) % TpiNumHashBuckets);
+        std::string Name = GetSyntheticTypeName(i);
+
+        Body.clear();
+        AppendValue<uint16_t>(Body, static_cast<uint16_t>(SyntheticMembersPerType));
+        AppendValue<uint16_t>(Body, 0);
+        AppendValue<uint32_t>(Body, FieldList);
+        AppendValue<uint32_t>(Body, 0);
+        AppendValue<uint32_t>(Body, 0);
+        AppendValue<uint16_t>(Body, static_cast<uint16_t>(SyntheticMembersPerType * sizeof(uint64_t)));
+        AppendName(Body, Name);
+        AddType(LF_STRUCTURE, GsiHashTable::HashName(Name) % TpiNumHashBuckets);
+    }
+
+    if (Records.size() > UINT32_MAX - sizeof(TpiStreamHeader))
+    {
+        Error = "Too many types";
+
+        return false;
+    }
+
+    std::vector<uint8_t> HashStream;
+
+    for (uint32_t Hash : Hashes)
+        AppendValue<uint32_t>(HashStream, Hash);
+
+    for (const auto& [Index, Offset] : IndexOffsets)
+    {
+        AppendValue<uint32_t>(HashStream, Index);
+        AppendValue<uint32_t>(HashStream, Offset);
+    }
+
+    uint16_t HashStreamIndex = static_cast<uint16_t>(Writer.AddStream(std::move(HashStream)));
+    std::vector<uint8_t> Tpi = BuildTpiHeader(TypeIndex, static_cast<uint32_t>(Records.size()), HashStreamIndex,
+        static_cast<uint32_t>(Hashes.size()), static_cast<uint32_t>(IndexOffsets.size()));
+
+    Tpi.insert(Tpi.end(), Records.begin(), Records.end());
+    Writer.SetStream(PdbTpiStream, std::move(Tpi));
+    Writer.SetStream(PdbIpiStream, BuildTpiHeader(TypeIndexBegin, 0, NilStreamIndex, 0, 0));
+
+    return true;
+}
+
+// C13 signature and no symbol records, then a checksums subsection with the module's one source file and a lines
+// subsection with one block covering all of its publics.
+static std::vector<uint8_t> BuildModuleStream(const SyntheticImageOptions& Options, uint32_t Module, uint32_t FileName)
+{
+    std::vector<uint8_t> Stream;
+    uint32_t First = Module * SyntheticPublicsPerModule;
+    uint32_t Count = std::min(SyntheticPublicsPerModule, Options.NumPublics - First);
+
+    AppendValue<uint32_t>(Stream, ModuleSignatureC13);
+
+    AppendValue<uint32_t>(Stream, DEBUG_S_FILECHKSMS);
+    AppendValue<uint32_t>(Stream, 8);
+    AppendValue<uint32_t>(Stream, FileName);
+    AppendValue<uint32_t>(Stream, 0);
+
+    AppendValue<uint32_t>(Stream, DEBUG_S_LINES);
+    AppendValue<uint32_t>(Stream, 24 + Count * 16);
+    AppendValue<uint32_t>(Stream, GetSyntheticPublicRva(First) - TextRva);
+    AppendValue<uint16_t>(Stream, 1);
+    AppendValue<uint16_t>(Stream, 0);
+    AppendValue<uint32_t>(Stream, Count * PublicSpacing);
+    AppendValue<uint32_t>(Stream, 0);
+    AppendValue<uint32_t>(Stream, Count * 2);
+    AppendValue<uint32_t>(Stream, 12 + Count * 16);
+
+    for (uint32_t i = 0; i < Count * 2; i++)
+    {
+        uint32_t Displacement = (i % 2) * (PublicSpacing / 2);
+
+        AppendValue<uint32_t>(Stream, (i / 2) * PublicSpacing + Displacement);
+        AppendValue<uint32_t>(Stream, GetSyntheticLine(First + i / 2, Displacement) | LineIsStatement);
+    }
+
+    return Stream;
+}
+
+// Module info records and section contributions for every module, and the "/names" stream with their source files.
+static bool BuildModules(MsfWriter& Writer, const SyntheticImageOptions& Options, std::vector<uint8_t>& ModInfo,
+    std::vector<uint8_t>& Contributions, uint32_t& NamesStream)
+{
+    uint32_t NumModules = (Options.NumPublics + SyntheticPublicsPerModule - 1) / SyntheticPublicsPerModule;
+    std::vector<uint8_t> Strings(1, 0);
+
+    if (NumModules > NilStreamIndex / 2)
+        return false;
+
+    AppendValue<uint32_t>(Contributions, SectionContribVer60);
+
+    for (uint32_t Module = 0; Module < NumModules; Module++)
+    {
+        std::string Source = GetSyntheticSourceFile(Module);
+        std::string Object = "module" + std::to_string(Module) + ".obj";
+        std::vector<uint8_t> Stream = BuildModuleStream(Options, Module, static_cast<uint32_t>(Strings.size()));
+        uint32_t C13Size = static_cast<uint32_t>(Stream.size()) - sizeof(uint32_t);
+        uint32_t First = Module * SyntheticPublicsPerModule;
+        SectionContribEntry Entry = {};
+
+        Strings.insert(Strings.end(), Source.begin(), Source.end());
+        Strings.push_back(0);
+
+        Entry.Section = 1;
+        Entry.Offset = static_cast<int32_t>(GetSyntheticPublicRva(First) - TextRva);
+        Entry.Size = static_cast<int32_t>(std::min(SyntheticPublicsPerModule, Options.NumPublics - First) * PublicSpacing);
+        Entry.Characteristics = 0x60000020;
+        Entry.ModuleIndex = static_cast<uint16_t>(Module);
+        AppendValue<SectionContribEntry>(Contributions, Entry);
+
+        // Header: unused word, first contribution, flags, stream, symbol/C11/C13 sizes, file count and name indices.
+        AppendValue<uint32_t>(ModInfo, 0);
+        AppendValue<SectionContribEntry>(ModInfo, Entry);
+        AppendValue<uint16_t>(ModInfo, 0);
+        AppendValue<uint16_t>(ModInfo, static_cast<uint16_t>(Writer.AddStream(std::move(Stream))));
+        AppendValue<uint32_t>(ModInfo, sizeof(uint32_t));
+        AppendValue<uint32_t>(ModInfo, 0);
+        AppendValue<uint32_t>(ModInfo, C13Size);
+        AppendValue<uint16_t>(ModInfo, 1);
+        AppendValue<uint16_t>(ModInfo, 0);
+        AppendValue<uint32_t>(ModInfo, 0);
+        AppendValue<uint32_t>(ModInfo, 0);
+        AppendValue<uint32_t>(ModInfo, 0);
+        AppendName(ModInfo, Object);
+        AppendName(ModInfo, Object);
+
+        while (ModInfo.size() % 4)
+            ModInfo.push_back(0);
+    }
+
+    std::vector<uint8_t> Names;
+    PdbStringTableHeader Header = { PdbStringTableSignature, 1, static_cast<uint32_t>(Strings.size()) };
+
+    // The hash buckets that normally follow the strings are left empty; lookups go by offset.
+    AppendValue<PdbStringTableHeader>(Names, Header);
+    Names.insert(Names.end(), Strings.begin(), Strings.end());
+    AppendValue<uint32_t>(Names, 0);
+    AppendValue<uint32_t>(Names, NumModules);
+    NamesStream = Writer.AddStream(std::move(Names));
+
+    return true;
+}
+
+bool WriteSyntheticPdb(const std::filesystem::path& Path, const SyntheticImageOptions& Options, std::string& Error)
+{
+    MsfWriter Writer(Options.BlockSize);
+
+    // Old directory, PDB info, TPI, DBI and IPI come first at their fixed indices.
+    for (uint32_t i = 0; i <= PdbIpiStream; i++)
+        Writer.AddStream({});
+
+    std::vector<uint8_t> Records;
+    std::vector<uint8_t> Body;
+    std::vector<std::pair<uint32_t, uint32_t>> Hashed;
+    std::vector<uint32_t> AddrMap;
+
+    Hashed.reserve(Options.NumPublics);
+    AddrMap.reserve(Options.NumPublics);
+
+    for (uint32_t i = 0; i < Options.NumPublics; i++)
+    {
+        std::string Name = GetSyntheticPublicName(i);
+
+        if (Records.size() > UINT32_MAX / 2)
+        {
+            Error = "Too many public symbols";
+
+            return false;
+        }
+
+        Hashed.emplace_back(GsiHashTable::HashName(Name) % GsiHashTable::NumHashBuckets, static_cast<uint32_t>(Records.size()));
+        AddrMap.push_back(static_cast<uint32_t>(Records.size()));
+
+        Body.clear();
+        AppendValue<uint32_t>(Body, i % 4 == 3 ? 0 : PublicFunctionFlag);
+        AppendValue<uint32_t>(Body, GetSyntheticPublicRva(i) - TextRva);
+        AppendValue<uint16_t>(Body, 1);
+        AppendName(Body, Name);
+        AppendRecord(Records, S_PUB32, Body, false);
+    }
+
+    // Publics are generated in address order, so the address map is the record order; the hash wants bucket order.
+    std::stable_sort(Hashed.begin(), Hashed.end(), [](const auto& Left, const auto& Right) { return Left.first < Right.first; });
+
+    uint16_t SymRecordStream = static_cast<uint16_t>(Writer.AddStream(std::move(Records)));
+    uint16_t PublicStream = static_cast<uint16_t>(Writer.AddStream(BuildPublics(Hashed, AddrMap)));
+    uint16_t SectionStream = static_cast<uint16_t>(Writer.AddStream(BuildSectionHeaders(Options)));
+
+    Hashed = {};
+    AddrMap = {};
+
+    if (!BuildTypes(Writer, Options, Error))
+        return false;
+
+    std::vector<uint8_t> ModInfo;
+    std::vector<uint8_t> Contributions;
+    uint32_t NamesStream;
+
+    if (!BuildModules(Writer, Options, ModInfo, Contributions, NamesStream))
+    {
+        Error = "Too many modules";
+
+        return false;
+    }
+
+    std::vector<uint8_t> Info;
+
+    // Version, signature, age and GUID, then the named stream map: the name buffer and a one-bucket hash table
+    // (size, capacity, present and deleted bit vectors, the entry) mapping "/names" to its stream.
+    AppendValue<uint32_t>(Info, PdbInfoVersion);
+    AppendValue<uint32_t>(Info, 0);
+    AppendValue<uint32_t>(Info, Options.Age);
+    AppendValue<PdbGuid>(Info, Options.Guid);
+    AppendValue<uint32_t>(Info, 7);
+    Info.insert(Info.end(), { '/', 'n', 'a', 'm', 'e', 's', 0 });
+
+    for (uint32_t Value : { 1u, 1u, 1u, 1u, 0u, 0u, NamesStream, 0u })
+        AppendValue<uint32_t>(Info, Value);
+
+    Writer.SetStream(PdbInfoStream, std::move(Info));
+
+    DbiStreamHeader Dbi = {};
+    std::vector<uint8_t> DbiData(sizeof(Dbi));
+
+    Dbi.VersionSignature = -1;
+    Dbi.VersionHeader = DbiVersion;
+    Dbi.Age = Options.Age;
+    Dbi.GlobalStreamIndex = NilStreamIndex;
+    Dbi.BuildNumber = DbiBuildNumber;
+    Dbi.PublicStreamIndex = PublicStream;
+    Dbi.SymRecordStream = SymRecordStream;
+    Dbi.ModInfoSize = static_cast<int32_t>(ModInfo.size());
+    Dbi.SectionContributionSize = static_cast<int32_t>(Contributions.size());
+    Dbi.OptionalDbgHeaderSize = DbgStreamCount * sizeof(uint16_t);
+    Dbi.Machine = Options.Machine;
+    memcpy(DbiData.data(), &Dbi, sizeof(Dbi));
+    DbiData.insert(DbiData.end(), ModInfo.begin(), ModInfo.end());
+    DbiData.insert(DbiData.end(), Contributions.begin(), Contributions.end());
+
+    for (uint32_t i = 0; i < DbgStreamCount; i++)
+        AppendValue<uint16_t>(DbiData, i == DbgSectionHdr ? SectionStream : NilStreamIndex);
+
+    Writer.SetStream(PdbDbiStream, std::move(DbiData));
+
+    return Writer.Write(Path, Error);
+}
+
+bool WriteSyntheticPe(const std::filesystem::path& Path, const SyntheticImageOptions& Options, const std::string& PdbName, std::string& Error)
+{
+    SyntheticLayout Layout = GetLayout(Options);
+    bool bPe32 = Options.Machine == 0x14C || Options.Machine == 0x1C0 || Options.Machine == 0x1C4;
+    uint32_t OptionalSize = bPe32 ? 224 : 240;
+    uint32_t CodeViewSize = static_cast<uint32_t>(RsdsHeaderSize + PdbName.size() + 1);
+    uint32_t RdataRaw = SizeOfHeaders + FileAlignment;
+
+    if (DebugEntrySize + CodeViewSize > FileAlignment)
+    {
+        Error = "PDB name is too long";
+
+        return false;
+    }
+
+    std::vector<uint8_t> Image(SizeOfHeaders + 2 * FileAlignment);
+    size_t FileHeader = NtHeadersOffset + sizeof(uint32_t);
+    size_t Optional = FileHeader + 20;
+    size_t DataDirectories = Optional + (bPe32 ? 92 : 108);
+
+    StoreValue<uint16_t>(Image, 0, 0x5A4D);
+    StoreValue<uint32_t>(Image, 0x3C, NtHeadersOffset);
+    StoreValue<uint32_t>(Image, NtHeadersOffset, 0x00004550);
+
+    StoreValue<uint16_t>(Image, FileHeader, Options.Machine);
+    StoreValue<uint16_t>(Image, FileHeader + 2, 3);
+    StoreValue<uint16_t>(Image, FileHeader + 16, static_cast<uint16_t>(OptionalSize));
+    StoreValue<uint16_t>(Image, FileHeader + 18, bPe32 ? 0x0102 : 0x0022);
+
+    StoreValue<uint16_t>(Image, Optional, bPe32 ? 0x10B : 0x20B);
+    StoreValue<uint32_t>(Image, Optional + 4, Layout.TextSize);
+    StoreValue<uint32_t>(Image, Optional + 16, TextRva);
+    StoreValue<uint32_t>(Image, Optional + 20, TextRva);
+
+    if (bPe32)
+        StoreValue<uint32_t>(Image, Optional + 28, 0x00400000);
+    else
+        StoreValue<uint64_t>(Image, Optional + 24, 0x140000000);
+
+    StoreValue<uint32_t>(Image, Optional + 32, SectionAlignment);
+    StoreValue<uint32_t>(Image, Optional + 36, FileAlignment);
+    StoreValue<uint16_t>(Image, Optional + 40, 6);
+    StoreValue<uint16_t>(Image, Optional + 48, 6);
+    StoreValue<uint32_t>(Image, Optional + 56, Layout.ImageSize);
+    StoreValue<uint32_t>(Image, Optional + 60, SizeOfHeaders);
+    StoreValue<uint16_t>(Image, Optional + 68, 3);
+    StoreValue<uint32_t>(Image, DataDirectories, 16);
+
+    // Data directory 6: the debug directory, placed at the start of .rdata.
+    StoreValue<uint32_t>(Image, DataDirectories + sizeof(uint32_t) + 6 * 8, Layout.RdataRva);
+    StoreValue<uint32_t>(Image, DataDirectories + sizeof(uint32_t) + 6 * 8 + 4, DebugEntrySize);
+
+    std::vector<uint8_t> Sections = BuildSectionHeaders(Options);
+
+    memcpy(Image.data() + Optional + OptionalSize, Sections.data(), Sections.size());
+    std::fill(Image.begin() + SizeOfHeaders, Image.begin() + RdataRaw, static_cast<uint8_t>(0xCC));
+
+    StoreValue<uint32_t>(Image, RdataRaw + 12, 2);
+    StoreValue<uint32_t>(Image, RdataRaw + 16, CodeViewSize);
+    StoreValue<uint32_t>(Image, RdataRaw + 20, Layout.RdataRva + DebugEntrySize);
+    StoreValue<uint32_t>(Image, RdataRaw + 24, RdataRaw + DebugEntrySize);
+
+    StoreValue<uint32_t>(Image, RdataRaw + DebugEntrySize, 0x53445352);
+    StoreValue<PdbGuid>(Image, RdataRaw + DebugEntrySize + 4, Options.Guid);
+    StoreValue<uint32_t>(Image, RdataRaw + DebugEntrySize + 20, Options.Age);
+    memcpy(Image.data() + RdataRaw + DebugEntrySize + RsdsHeaderSize, PdbName.c_str(), PdbName.size() + 1);
+
+    std::ofstream Out(Path, std::ios::binary | std::ios::trunc);
+
+    if (!Out.is_open() || !Out.write(reinterpret_cast<const char*>(Image.data()), static_cast<std::streamsize>(Image.size())))
+    {
+        Error = "Failed to write " + Path.filename().string();
+
+        return false;
+    }
+
+    return true;
+}
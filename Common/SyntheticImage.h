@@ -0,0 +1,37 @@
+#pragma once
+
+#include "CodeView.h"
+#include "Platform.h"
+
+struct SyntheticImageOptions
+{
+    uint32_t NumPublics = 1000;
+    uint32_t NumTypes = 10000;
+    uint32_t BlockSize = 4096;
+    uint16_t Machine = 0x8664;
+    uint32_t Age = 1;
+    PdbGuid Guid = { 0x12345678, 0x1234, 0x5678, { 0x9A, 0xBC, 0xDE, 0xF0, 0x12, 0x34, 0x56, 0x78 } };
+};
+
+// Every synthetic type is a structure of this many 8-byte members named Field0, Field1, ...
+inline constexpr uint32_t SyntheticMembersPerType = 8;
+
+// Publics are grouped into modules (object files) of this many, each built from one source file.
+inline constexpr uint32_t SyntheticPublicsPerModule = 1024;
+
+// Names and addresses are derived from the index, so queries can be generated without keeping the symbol list.
+std::string GetSyntheticPublicName(uint32_t Index);
+uint32_t GetSyntheticPublicRva(uint32_t Index);
+std::string GetSyntheticTypeName(uint32_t Index);
+std::string GetSyntheticSourceFile(uint32_t Module);
+// Line of an address Displacement bytes into a public; every public has two line records.
+uint32_t GetSyntheticLine(uint32_t Index, uint32_t Displacement);
+
+// Writes a PDB with the streams the parser reads: PDB info, DBI with section headers, NumPublics S_PUB32 records
+// behind a publics GSI hash table and address map, and a TPI stream of NumTypes structures with its hash stream.
+// Symbols are spread over every hash bucket like in a linker-produced PDB. Each module gets a section contribution
+// and a module stream with C13 file checksums and lines; source file names go to the "/names" stream.
+bool WriteSyntheticPdb(const std::filesystem::path& Path, const SyntheticImageOptions& Options, std::string& Error);
+
+// Writes a PE32 (x86/ARM) or PE32+ image whose debug directory holds an RSDS record with the options' GUID and age.
+bool WriteSyntheticPe(const std::filesystem::path& Path, const SyntheticImageOptions& Options, const std::string& PdbName, std::string& Error);
@@ -0,0 +1,173 @@
+#include "TypeCache.h"
+#include "Stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+static const char TypeCacheMagic[8] = { 'A', 'e', 'P', 'D', 'B', 'T', 'y', 'p' };
+
+std::filesystem::path TypeCache::GetCachePath(const std::filesystem::path& PdbPath)
+{
+    std::filesystem::path Path(PdbPath);
+
+    return Path.replace_extension(L".tyc");
+}
+
+bool TypeCache::Open(const std::filesystem::path& CachePath, const PdbGuid& Guid, uint32_t Age, uint64_t PdbSize)
+{
+    Path = CachePath;
+    memcpy(Identity.Magic, TypeCacheMagic, sizeof(TypeCacheMagic));
+    Identity.Version = Version;
+    Identity.Guid = Guid;
+    Identity.Age = Age;
+    Identity.PdbSize = PdbSize;
+
+    return Map();
+}
+
+bool TypeCache::Map()
+{
+    File.Close();
+    Entries = nullptr;
+    NumEntries = 0;
+
+    if (!File.Open(Path) || File.Size() < sizeof(TypeCacheHeader))
+    {
+        File.Close();
+
+        return false;
+    }
+
+    const TypeCacheHeader* Header = reinterpret_cast<const TypeCacheHeader*>(File.Data());
+    uint64_t EntriesEnd = sizeof(TypeCacheHeader) + static_cast<uint64_t>(Header->NumEntries) * sizeof(TypeCacheEntry);
+
+    // A cache written for another build of the PDB (same name, different GUID/age) is ignored and replaced on Save().
+    bool bValid = memcmp(Header->Magic, TypeCacheMagic, sizeof(TypeCacheMagic)) == 0 && Header->Version == Version &&
+        memcmp(&Header->Guid, &Identity.Guid, sizeof(PdbGuid)) == 0 && Header->Age == Identity.Age && Header->PdbSize == Identity.PdbSize &&
+        EntriesEnd <= Header->StringsOffset && Header->StringsOffset + Header->StringsSize <= File.Size();
+
+    Entries = reinterpret_cast<const TypeCacheEntry*>(File.Data() + sizeof(TypeCacheHeader));
+    Strings = reinterpret_cast<const char*>(File.Data() + (bValid ? Header->StringsOffset : 0));
+
+    for (uint32_t i = 0; bValid && i < Header->NumEntries; i++)
+        bValid = static_cast<uint64_t>(Entries[i].NameOffset) + Entries[i].NameLength <= Header->StringsSize;
+
+    if (!bValid)
+    {
+        File.Close();
+        Entries = nullptr;
+
+        return false;
+    }
+
+    NumEntries = Header->NumEntries;
+
+    return true;
+}
+
+bool TypeCache::Find(std::string_view Query, uint64_t& Value) const
+{
+    auto NewEntry = Pending.find(Query);
+
+    if (NewEntry != Pending.end())
+    {
+        AddStat(StatCounter::TypeCacheHits);
+        Value = NewEntry->second;
+
+        return true;
+    }
+
+    auto GetName = [this](const TypeCacheEntry& Entry) { return std::string_view(Strings + Entry.NameOffset, Entry.NameLength); };
+    const TypeCacheEntry* End = Entries + NumEntries;
+    const TypeCacheEntry* It = std::lower_bound(Entries, End, Query, [&](const TypeCacheEntry& Entry, std::string_view Name) { return GetName(Entry) < Name; });
+
+    if (It == End || GetName(*It) != Query)
+    {
+        AddStat(StatCounter::TypeCacheMisses);
+
+        return false;
+    }
+
+    AddStat(StatCounter::TypeCacheHits);
+    Value = It->Value;
+
+    return true;
+}
+
+void TypeCache::Add(std::string_view Query, uint64_t Value)
+{
+    Pending[std::string(Query)] = Value;
+}
+
+bool TypeCache::Save()
+{
+    if (Pending.empty() || Path.empty())
+        return true;
+
+    std::map<std::string, uint64_t, std::less<>> Merged;
+
+    for (uint32_t i = 0; i < NumEntries; i++)
+        Merged.emplace(std::string(Strings + Entries[i].NameOffset, Entries[i].NameLength), Entries[i].Value);
+
+    for (const auto& [Query, Value] : Pending)
+        Merged[Query] = Value;
+
+    std::vector<TypeCacheEntry> Table;
+    std::string Names;
+
+    for (const auto& [Query, Value] : Merged)
+    {
+        Table.push_back({ static_cast<uint32_t>(Names.size()), static_cast<uint32_t>(Query.size()), Value });
+        Names += Query;
+    }
+
+    TypeCacheHeader Header = Identity;
+
+    Header.NumEntries = static_cast<uint32_t>(Table.size());
+    Header.StringsOffset = sizeof(TypeCacheHeader) + Table.size() * sizeof(TypeCacheEntry);
+    Header.StringsSize = Names.size();
+
+    std::filesystem::path TempPath = Path;
+    std::error_code Error;
+
+    TempPath += L".tmp";
+
+    {
+        std::ofstream Out(TempPath, std::ios::binary | std::ios::trunc);
+
+        if (!Out.is_open())
+            return false;
+
+        Out.write(reinterpret_cast<const char*>(&Header), sizeof(Header));
+        Out.write(reinterpret_cast<const char*>(Table.data()), Table.size() * sizeof(TypeCacheEntry));
+        Out.write(Names.data(), Names.size());
+
+        if (!Out.good())
+        {
+            Out.close();
+            std::filesystem::remove(TempPath, Error);
+
+            return false;
+        }
+    }
+
+    // The old file stays mapped until here so a failed write leaves the cache usable; Windows cannot replace a mapped file.
+    File.Close();
+    Entries = nullptr;
+    NumEntries = 0;
+
+    std::filesystem::rename(TempPath, Path, Error);
+
+    if (Error)
+    {
+        std::filesystem::remove(TempPath, Error);
+        Map();
+
+        return false;
+    }
+
+    Pending.clear();
+
+    return Map();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "CodeView.h"
+#include "Platform.h"
+
+#include <map>
+#include <string_view>
+
+struct TypeCacheHeader
+{
+    char Magic[8];
+    uint32_t Version;
+    uint32_t Age;
+    PdbGuid Guid;
+    uint64_t PdbSize;
+    uint32_t NumEntries;
+    uint32_t Reserved;
+    uint64_t StringsOffset;
+    uint64_t StringsSize;
+};
+
+struct TypeCacheEntry
+{
+    uint32_t NameOffset;
+    uint32_t NameLength;
+    uint64_t Value;
+};
+
+// Results of type queries ("Type::Member", "Class::Method@vslot") stored next to the symbol index. The file is
+// tied to the PDB's GUID, age and size; entries are sorted by query so a lookup is a binary search in the mapping.
+// New results are kept in memory until Save() merges them into the file.
+class TypeCache
+{
+public:
+    static constexpr uint32_t Version = 1;
+
+    static std::filesystem::path GetCachePath(const std::filesystem::path& PdbPath);
+
+    bool Open(const std::filesystem::path& CachePath, const PdbGuid& Guid, uint32_t Age, uint64_t PdbSize);
+    bool Find(std::string_view Query, uint64_t& Value) const;
+    void Add(std::string_view Query, uint64_t Value);
+    bool Save();
+
+private:
+    bool Map();
+
+    std::filesystem::path Path;
+    TypeCacheHeader Identity = {};
+    MappedFile File;
+    const TypeCacheEntry* Entries = nullptr;
+    const char* Strings = nullptr;
+    uint32_t NumEntries = 0;
+    std::map<std::string, uint64_t, std::less<>> Pending;
+};
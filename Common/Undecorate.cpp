@@ -0,0 +1,945 @@
+#include "Undecorate.h"
+
+#include <cctype>
+#include <charconv>
+
+static bool IsIdentifierChar(char Char)
+{
+    return isalnum(static_cast<uint8_t>(Char)) || Char == '_' || Char == '$';
+}
+
+static const char* GetBasicTypeName(char Code)
+{
+    switch (Code)
+    {
+    case 'C': return "signed char";
+    case 'D': return "char";
+    case 'E': return "unsigned char";
+    case 'F': return "short";
+    case 'G': return "unsigned short";
+    case 'H': return "int";
+    case 'I': return "unsigned int";
+    case 'J': return "long";
+    case 'K': return "unsigned long";
+    case 'M': return "float";
+    case 'N': return "double";
+    case 'O': return "long double";
+    case 'X': return "void";
+    default: return nullptr;
+    }
+}
+
+static const char* GetExtendedTypeName(char Code)
+{
+    switch (Code)
+    {
+    case 'D': return "__int8";
+    case 'E': return "unsigned __int8";
+    case 'F': return "__int16";
+    case 'G': return "unsigned __int16";
+    case 'H': return "__int32";
+    case 'I': return "unsigned __int32";
+    case 'J': return "__int64";
+    case 'K': return "unsigned __int64";
+    case 'L': return "__int128";
+    case 'M': return "unsigned __int128";
+    case 'N': return "bool";
+    case 'Q': return "char8_t";
+    case 'S': return "char16_t";
+    case 'U': return "char32_t";
+    case 'W': return "wchar_t";
+    default: return nullptr;
+    }
+}
+
+// "?<code>" operator names; '0', '1' and 'B' (constructor, destructor, conversion) are handled by the caller.
+static const char* GetOperatorName(char Code)
+{
+    switch (Code)
+    {
+    case '2': return "operator new";
+    case '3': return "operator delete";
+    case '4': return "operator=";
+    case '5': return "operator>>";
+    case '6': return "operator<<";
+    case '7': return "operator!";
+    case '8': return "operator==";
+    case '9': return "operator!=";
+    case 'A': return "operator[]";
+    case 'C': return "operator->";
+    case 'D': return "operator*";
+    case 'E': return "operator++";
+    case 'F': return "operator--";
+    case 'G': return "operator-";
+    case 'H': return "operator+";
+    case 'I': return "operator&";
+    case 'J': return "operator->*";
+    case 'K': return "operator/";
+    case 'L': return "operator%";
+    case 'M': return "operator<";
+    case 'N': return "operator<=";
+    case 'O': return "operator>";
+    case 'P': return "operator>=";
+    case 'Q': return "operator,";
+    case 'R': return "operator()";
+    case 'S': return "operator~";
+    case 'T': return "operator^";
+    case 'U': return "operator|";
+    case 'V': return "operator&&";
+    case 'W': return "operator||";
+    case 'X': return "operator*=";
+    case 'Y': return "operator+=";
+    case 'Z': return "operator-=";
+    default: return nullptr;
+    }
+}
+
+// "?_<code>" names.
+static const char* GetSpecialName(char Code)
+{
+    switch (Code)
+    {
+    case '0': return "operator/=";
+    case '1': return "operator%=";
+    case '2': return "operator>>=";
+    case '3': return "operator<<=";
+    case '4': return "operator&=";
+    case '5': return "operator|=";
+    case '6': return "operator^=";
+    case '7': return "`vftable'";
+    case '8': return "`vbtable'";
+    case '9': return "`vcall'";
+    case 'A': return "`typeof'";
+    case 'B': return "`local static guard'";
+    case 'D': return "`vbase destructor'";
+    case 'E': return "`vector deleting destructor'";
+    case 'F': return "`default constructor closure'";
+    case 'G': return "`scalar deleting destructor'";
+    case 'H': return "`vector constructor iterator'";
+    case 'I': return "`vector destructor iterator'";
+    case 'J': return "`vector vbase constructor iterator'";
+    case 'K': return "`virtual displacement map'";
+    case 'L': return "`eh vector constructor iterator'";
+    case 'M': return "`eh vector destructor iterator'";
+    case 'N': return "`eh vector vbase constructor iterator'";
+    case 'O': return "`copy constructor closure'";
+    case 'S': return "`local vftable'";
+    case 'T': return "`local vftable constructor closure'";
+    case 'U': return "operator new[]";
+    case 'V': return "operator delete[]";
+    case 'X': return "`placement delete closure'";
+    case 'Y': return "`placement delete[] closure'";
+    default: return nullptr;
+    }
+}
+
+// "?__<code>" names.
+static const char* GetExtraSpecialName(char Code)
+{
+    switch (Code)
+    {
+    case 'A': return "`managed vector constructor iterator'";
+    case 'B': return "`managed vector destructor iterator'";
+    case 'C': return "`eh vector copy constructor iterator'";
+    case 'D': return "`eh vector vbase copy constructor iterator'";
+    case 'G': return "`vector copy constructor iterator'";
+    case 'H': return "`vector vbase copy constructor iterator'";
+    case 'I': return "`managed vector copy constructor iterator'";
+    case 'J': return "`local static thread guard'";
+    case 'L': return "operator co_await";
+    case 'M': return "operator<=>";
+    default: return nullptr;
+    }
+}
+
+bool Undecorator::Consume(char Char)
+{
+    if (Pos >= Input.size() || Input[Pos] != Char)
+        return false;
+
+    Pos++;
+
+    return true;
+}
+
+bool Undecorator::Consume(std::string_view Prefix)
+{
+    if (Input.substr(Pos, Prefix.size()) != Prefix)
+        return false;
+
+    Pos += Prefix.size();
+
+    return true;
+}
+
+char Undecorator::Next()
+{
+    return Pos < Input.size() ? Input[Pos++] : '\0';
+}
+
+void Undecorator::AddName(Span Name)
+{
+    for (uint32_t i = 0; i < Refs.NumNames; i++)
+    {
+        if (View(Refs.Names[i]) == View(Name))
+            return;
+    }
+
+    if (Refs.NumNames < 10)
+        Refs.Names[Refs.NumNames++] = Name;
+}
+
+bool Undecorator::ParseNumber(int64_t& Value)
+{
+    bool bNegative = Consume('?');
+    char Char = Next();
+
+    if (Char >= '0' && Char <= '9')
+    {
+        Value = Char - '0' + 1;
+    }
+    else
+    {
+        uint64_t Result = 0;
+
+        // Hex digits 'A'..'P', terminated by '@'.
+        for (; Char != '@'; Char = Next())
+        {
+            if (Char < 'A' || Char > 'P')
+                return false;
+
+            Result = Result * 16 + (Char - 'A');
+        }
+
+        Value = static_cast<int64_t>(Result);
+    }
+
+    if (bNegative)
+        Value = -Value;
+
+    return true;
+}
+
+bool Undecorator::ParseSimpleName(Span& Name)
+{
+    size_t At = Input.find('@', Pos);
+
+    if (At == std::string_view::npos || At == Pos)
+        return false;
+
+    uint32_t Start = Begin();
+
+    Put(Input.substr(Pos, At - Pos));
+    Pos = At + 1;
+    Name = End(Start);
+
+    return true;
+}
+
+bool Undecorator::ParseTemplateName(Span& Name)
+{
+    // Template arguments have their own back-reference tables.
+    BackRefs Outer = Refs;
+    Special OuterKind = NameKind;
+    Span Base;
+    Span Args[MaxFragments];
+    uint32_t NumArgs = 0;
+
+    Refs = {};
+
+    if (Consume('?'))
+    {
+        if (!ParseSpecialName(Base) || NameKind != OuterKind)
+            return false;
+    }
+    else if (!ParseSimpleName(Base))
+    {
+        return false;
+    }
+    else
+    {
+        AddName(Base);
+    }
+
+    while (!Consume('@'))
+    {
+        if (Pos >= Input.size() || NumArgs >= MaxFragments)
+            return false;
+
+        // Empty parameter packs.
+        if (Consume("$$V") || Consume("$$Z") || Consume("$S"))
+            continue;
+
+        if (Consume("$0"))
+        {
+            int64_t Value;
+            char Digits[24];
+
+            if (!ParseNumber(Value))
+                return false;
+
+            uint32_t Start = Begin();
+
+            Put(std::string_view(Digits, std::to_chars(Digits, Digits + sizeof(Digits), Value).ptr - Digits));
+            Args[NumArgs++] = End(Start);
+
+            continue;
+        }
+
+        // Pointers to symbols, non-type parameter placeholders and the like are not needed for matching.
+        if (Input[Pos] == '$' && Input.substr(Pos, 2) != "$$")
+            return false;
+
+        if (!ParseType(Args[NumArgs++]))
+            return false;
+    }
+
+    uint32_t Start = Begin();
+
+    Put(Base);
+    Put("<");
+
+    for (uint32_t i = 0; i < NumArgs; i++)
+    {
+        if (i)
+            Put(",");
+
+        Put(Args[i]);
+    }
+
+    if (Arena.back() == '>')
+        Put(" ");
+
+    Put(">");
+    Name = End(Start);
+    Refs = Outer;
+
+    return true;
+}
+
+bool Undecorator::ParseSpecialName(Span& Name)
+{
+    char Code = Next();
+    const char* Text = nullptr;
+
+    if (Code == '0' || Code == '1' || Code == 'B')
+    {
+        NameKind = Code == '0' ? Special::Constructor : Code == '1' ? Special::Destructor : Special::Conversion;
+        Name = {};
+
+        return true;
+    }
+
+    if (Code == '_')
+    {
+        Code = Next();
+        Text = Code == '_' ? GetExtraSpecialName(Next()) : GetSpecialName(Code);
+    }
+    else
+    {
+        Text = GetOperatorName(Code);
+    }
+
+    if (!Text)
+        return false;
+
+    uint32_t Start = Begin();
+
+    Put(Text);
+    Name = End(Start);
+
+    return true;
+}
+
+bool Undecorator::ParseFragment(Span& Fragment)
+{
+    if (Pos >= Input.size())
+        return false;
+
+    char Char = Input[Pos];
+
+    if (Char >= '0' && Char <= '9')
+    {
+        Pos++;
+
+        if (static_cast<uint32_t>(Char - '0') >= Refs.NumNames)
+            return false;
+
+        Fragment = Refs.Names[Char - '0'];
+
+        return true;
+    }
+
+    if (Consume("?$"))
+    {
+        if (!ParseTemplateName(Fragment))
+            return false;
+
+        AddName(Fragment);
+
+        return true;
+    }
+
+    if (Consume("?A"))
+    {
+        size_t At = Input.find('@', Pos);
+
+        if (At == std::string_view::npos)
+            return false;
+
+        uint32_t Start = Begin();
+
+        Put("`anonymous namespace'");
+        Pos = At + 1;
+        Fragment = End(Start);
+        AddName(Fragment);
+
+        return true;
+    }
+
+    // Locally scoped names ("?1??Function@@...") would need the enclosing function undecorated as well.
+    if (Char == '?')
+        return false;
+
+    if (!ParseSimpleName(Fragment))
+        return false;
+
+    AddName(Fragment);
+
+    return true;
+}
+
+bool Undecorator::ParseQualifiedName(Span& Name)
+{
+    Span Fragments[MaxFragments];
+    uint32_t NumFragments = 0;
+
+    do
+    {
+        if (NumFragments >= MaxFragments || !ParseFragment(Fragments[NumFragments++]))
+            return false;
+    } while (!Consume('@'));
+
+    uint32_t Start = Begin();
+
+    for (uint32_t i = NumFragments; i-- > 0;)
+    {
+        Put(Fragments[i]);
+
+        if (i)
+            Put("::");
+    }
+
+    Name = End(Start);
+
+    return true;
+}
+
+bool Undecorator::ParseCvQualifier(bool& bConst, bool& bVolatile)
+{
+    char Code = Next();
+
+    if (Code < 'A' || Code > 'D')
+        return false;
+
+    bConst = Code == 'B' || Code == 'D';
+    bVolatile = Code == 'C' || Code == 'D';
+
+    return true;
+}
+
+void Undecorator::SkipPointerModifiers()
+{
+    // __ptr64, __unaligned, __restrict.
+    while (Consume('E') || Consume('F') || Consume('I'))
+    {
+    }
+}
+
+bool Undecorator::ParseType(Span& Type)
+{
+    char Code = Next();
+    uint32_t Start;
+
+    if (const char* Basic = GetBasicTypeName(Code))
+    {
+        Start = Begin();
+        Put(Basic);
+        Type = End(Start);
+
+        return true;
+    }
+
+    switch (Code)
+    {
+    case '_':
+    {
+        const char* Extended = GetExtendedTypeName(Next());
+
+        if (!Extended)
+            return false;
+
+        Start = Begin();
+        Put(Extended);
+        Type = End(Start);
+
+        return true;
+    }
+    case 'T':
+    case 'U':
+    case 'V':
+        return ParseQualifiedName(Type);
+    case 'W':
+        return Next() >= '0' && ParseQualifiedName(Type);
+    case 'P':
+    case 'Q':
+    case 'R':
+    case 'S':
+        return ParseIndirection("*", Code == 'Q' || Code == 'S', Code == 'R' || Code == 'S', Type);
+    case 'A':
+    case 'B':
+        return ParseIndirection("&", false, Code == 'B', Type);
+    case '?':
+        return ParseCvType(Type);
+    case '$':
+        if (Consume("$Q"))
+            return ParseIndirection("&&", false, false, Type);
+
+        if (Consume("$R"))
+            return ParseIndirection("&&", false, true, Type);
+
+        if (Consume("$T"))
+        {
+            Start = Begin();
+            Put("std::nullptr_t");
+            Type = End(Start);
+
+            return true;
+        }
+
+        if (Consume("$C"))
+            return ParseCvType(Type);
+
+        if (Consume("$A6"))
+            return ParseFunctionType({}, Type);
+
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool Undecorator::ParseCvType(Span& Type)
+{
+    bool bConst;
+    bool bVolatile;
+    Span Inner;
+
+    if (!ParseCvQualifier(bConst, bVolatile) || !ParseType(Inner))
+        return false;
+
+    uint32_t Start = Begin();
+
+    Put(Inner);
+    Put(bConst ? " const" : "");
+    Put(bVolatile ? " volatile" : "");
+    Type = End(Start);
+
+    return true;
+}
+
+bool Undecorator::ParseIndirection(std::string_view Declarator, bool bPointerConst, bool bPointerVolatile, Span& Type)
+{
+    uint32_t Start = Begin();
+
+    SkipPointerModifiers();
+
+    // Function pointer: "ret (*)(params)".
+    if (Consume('6'))
+    {
+        Put(Declarator);
+        Put(bPointerConst ? " const" : "");
+        Put(bPointerVolatile ? " volatile" : "");
+
+        return ParseFunctionType(End(Start), Type);
+    }
+
+    // Member function pointer: "ret (Class::*)(params) const".
+    if (Consume('8'))
+    {
+        Span Class;
+        bool bConst;
+        bool bVolatile;
+
+        if (!ParseQualifiedName(Class))
+            return false;
+
+        SkipPointerModifiers();
+
+        if (!ParseCvQualifier(bConst, bVolatile))
+            return false;
+
+        Start = Begin();
+        Put(Class);
+        Put("::");
+        Put(Declarator);
+
+        Span Function;
+
+        if (!ParseFunctionType(End(Start), Function))
+            return false;
+
+        Start = Begin();
+        Put(Function);
+        Put(bConst ? " const" : "");
+        Put(bVolatile ? " volatile" : "");
+        Type = End(Start);
+
+        return true;
+    }
+
+    bool bConst;
+    bool bVolatile;
+
+    if (!ParseCvQualifier(bConst, bVolatile))
+        return false;
+
+    // Pointer to array: "int (*)[4][2]".
+    if (Consume('Y'))
+    {
+        int64_t NumDimensions;
+        std::string Dimensions;
+        char Digits[24];
+
+        if (!ParseNumber(NumDimensions) || NumDimensions <= 0 || NumDimensions > MaxFragments)
+            return false;
+
+        for (int64_t i = 0; i < NumDimensions; i++)
+        {
+            int64_t Dimension;
+
+            if (!ParseNumber(Dimension))
+                return false;
+
+            Dimensions += '[';
+            Dimensions.append(Digits, std::to_chars(Digits, Digits + sizeof(Digits), Dimension).ptr);
+            Dimensions += ']';
+        }
+
+        Span Element;
+
+        if (!ParseType(Element))
+            return false;
+
+        Start = Begin();
+        Put(Element);
+        Put(bConst ? " const" : "");
+        Put(bVolatile ? " volatile" : "");
+        Put(" (");
+        Put(Declarator);
+        Put(")");
+        Put(Dimensions);
+        Type = End(Start);
+
+        return true;
+    }
+
+    Span Pointee;
+
+    if (!ParseType(Pointee))
+        return false;
+
+    Start = Begin();
+    Put(Pointee);
+    Put(bConst ? " const" : "");
+    Put(bVolatile ? " volatile" : "");
+    Put(" ");
+    Put(Declarator);
+    Put(bPointerConst ? " const" : "");
+    Put(bPointerVolatile ? " volatile" : "");
+    Type = End(Start);
+
+    return true;
+}
+
+bool Undecorator::ParseFunctionType(Span Declarator, Span& Type)
+{
+    char Convention = Next();
+    Span Return;
+    Span Parameters;
+
+    if (Convention < 'A' || Convention > 'Z' || !ParseType(Return) || !ParseParameters(Parameters))
+        return false;
+
+    if (!Consume('Z') && !Consume("_E"))
+        return false;
+
+    uint32_t Start = Begin();
+
+    Put(Return);
+
+    if (Declarator.Length)
+    {
+        Put(" (");
+        Put(Declarator);
+        Put(")");
+    }
+
+    Put("(");
+    Put(Parameters);
+    Put(")");
+    Type = End(Start);
+
+    return true;
+}
+
+bool Undecorator::ParseParameters(Span& Parameters)
+{
+    uint32_t Start;
+
+    if (Consume('X'))
+    {
+        Start = Begin();
+        Put("void");
+        Parameters = End(Start);
+
+        return true;
+    }
+
+    Span Types[MaxFragments];
+    uint32_t NumTypes = 0;
+    bool bVariadic = false;
+
+    while (!Consume('@'))
+    {
+        if (Consume('Z'))
+        {
+            bVariadic = true;
+
+            break;
+        }
+
+        if (Pos >= Input.size() || NumTypes >= MaxFragments)
+            return false;
+
+        char Char = Input[Pos];
+
+        if (Char >= '0' && Char <= '9')
+        {
+            Pos++;
+
+            if (static_cast<uint32_t>(Char - '0') >= Refs.NumTypes)
+                return false;
+
+            Types[NumTypes++] = Refs.Types[Char - '0'];
+
+            continue;
+        }
+
+        size_t TypeStart = Pos;
+
+        if (!ParseType(Types[NumTypes]))
+            return false;
+
+        // Single-character types are never back-referenced.
+        if (Pos - TypeStart > 1 && Refs.NumTypes < 10)
+            Refs.Types[Refs.NumTypes++] = Types[NumTypes];
+
+        NumTypes++;
+    }
+
+    Start = Begin();
+
+    for (uint32_t i = 0; i < NumTypes; i++)
+    {
+        if (i)
+            Put(",");
+
+        Put(Types[i]);
+    }
+
+    if (bVariadic)
+        Put(NumTypes ? ",..." : "...");
+
+    Parameters = End(Start);
+
+    return true;
+}
+
+bool Undecorator::Undecorate(std::string_view Decorated, Form NameForm, std::string& Output)
+{
+    Input = Decorated;
+    Pos = 0;
+    Arena.clear();
+    Refs = {};
+    NameKind = Special::None;
+
+    if (!Consume('?'))
+        return false;
+
+    Span Head;
+    Span Scopes[MaxFragments];
+    uint32_t NumScopes = 0;
+
+    // The unqualified name comes first, then its scopes innermost first. Only a plain leading name is remembered for
+    // back-references.
+    if (Consume("?$"))
+    {
+        if (!ParseTemplateName(Head))
+            return false;
+    }
+    else if (Consume('?'))
+    {
+        if (!ParseSpecialName(Head))
+            return false;
+    }
+    else
+    {
+        if (!ParseSimpleName(Head))
+            return false;
+
+        AddName(Head);
+    }
+
+    while (!Consume('@'))
+    {
+        if (NumScopes >= MaxFragments || !ParseFragment(Scopes[NumScopes++]))
+            return false;
+    }
+
+    if (NameKind != Special::None && !NumScopes)
+        return false;
+
+    // Function encodings start with an access/class letter; data, vftables and the like with a digit.
+    bool bFunction = Pos < Input.size() && Input[Pos] >= 'A' && Input[Pos] <= 'Z';
+    bool bSignature = NameForm == Form::Signature && bFunction;
+    Span Return;
+    Span Parameters;
+    bool bConst = false;
+    bool bVolatile = false;
+
+    if (NameKind == Special::Conversion && !bFunction)
+        return false;
+
+    if (bSignature || NameKind == Special::Conversion)
+    {
+        char Class = Next();
+        bool bGlobal = Class == 'Y' || Class == 'Z';
+        bool bStatic = Class == 'C' || Class == 'D' || Class == 'K' || Class == 'L' || Class == 'S' || Class == 'T';
+
+        // Adjustor thunks carry the this-adjustment.
+        if (Class == 'G' || Class == 'H' || Class == 'O' || Class == 'P' || Class == 'W' || Class == 'X')
+        {
+            int64_t Adjustment;
+
+            if (!ParseNumber(Adjustment))
+                return false;
+        }
+
+        if (!bGlobal && !bStatic)
+        {
+            SkipPointerModifiers();
+
+            // Ref-qualifiers ('&', '&&') do not take part in overload matching here.
+            if (!Consume('G'))
+                Consume('H');
+
+            if (!ParseCvQualifier(bConst, bVolatile))
+                return false;
+        }
+
+        char Convention = Next();
+
+        if (Convention < 'A' || Convention > 'Z')
+            return false;
+
+        // '@' marks constructors and destructors, which have no return type.
+        if (!Consume('@') && !ParseType(Return))
+            return false;
+
+        if (!ParseParameters(Parameters))
+            return false;
+
+        if (!Consume('Z') && !Consume("_E"))
+            return false;
+    }
+
+    uint32_t Start = Begin();
+
+    for (uint32_t i = NumScopes; i-- > 0;)
+    {
+        Put(Scopes[i]);
+        Put("::");
+    }
+
+    switch (NameKind)
+    {
+    case Special::Constructor:
+        Put(Scopes[0]);
+        break;
+    case Special::Destructor:
+        Put("~");
+        Put(Scopes[0]);
+        break;
+    case Special::Conversion:
+        Put("operator ");
+        Put(Return);
+        break;
+    default:
+        Put(Head);
+        break;
+    }
+
+    if (bSignature)
+    {
+        Put("(");
+        Put(Parameters);
+        Put(")");
+        Put(bConst ? " const" : "");
+        Put(bVolatile ? " volatile" : "");
+    }
+
+    Output.assign(View(End(Start)));
+
+    return true;
+}
+
+void NormalizeUndecoratedName(std::string_view Name, std::string& Output)
+{
+    Output.clear();
+
+    for (size_t i = 0; i < Name.size();)
+    {
+        char Char = Name[i];
+
+        if (!IsIdentifierChar(Char))
+        {
+            if (!isspace(static_cast<uint8_t>(Char)))
+                Output += Char;
+
+            i++;
+
+            continue;
+        }
+
+        size_t WordEnd = i;
+
+        while (WordEnd < Name.size() && IsIdentifierChar(Name[WordEnd]))
+            WordEnd++;
+
+        std::string_view Word = Name.substr(i, WordEnd - i);
+
+        i = WordEnd;
+
+        if (Word == "class" || Word == "struct" || Word == "union" || Word == "enum" || Word == "__ptr64")
+            continue;
+
+        if (!Output.empty() && IsIdentifierChar(Output.back()))
+            Output += ' ';
+
+        Output += Word;
+    }
+
+    for (size_t At = Output.find("(void)"); At != std::string::npos; At = Output.find("(void)", At))
+        Output.replace(At, 6, "()");
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Native undecorator for MSVC C++ names ("?Foo@Bar@@QEBAXHPEBD@Z"), the part of DbgHelp's UnDecorateSymbolName
+// needed to match names, available on every platform. NameOnly gives the qualified name ("Bar::Foo"), Signature adds
+// the parameter list and method qualifiers ("Bar::Foo(int,char const *) const"). Types are spelled like undname
+// does, without class/struct/union/enum keywords, calling conventions and __ptr64. Returns false for names that are
+// not MSVC-decorated or use an encoding this undecorator does not know (RTTI descriptors, string literals, ...).
+// An instance reuses its buffers, so undecorating many names in a row does not allocate.
+class Undecorator
+{
+public:
+    enum class Form
+    {
+        NameOnly,
+        Signature,
+    };
+
+    bool Undecorate(std::string_view Decorated, Form NameForm, std::string& Output);
+
+private:
+    struct Span
+    {
+        uint32_t Offset = 0;
+        uint32_t Length = 0;
+    };
+
+    struct BackRefs
+    {
+        Span Names[10];
+        uint32_t NumNames = 0;
+        Span Types[10];
+        uint32_t NumTypes = 0;
+    };
+
+    static constexpr uint32_t MaxFragments = 32;
+
+    bool Consume(char Char);
+    bool Consume(std::string_view Prefix);
+    char Next();
+
+    uint32_t Begin() const { return static_cast<uint32_t>(Arena.size()); }
+    Span End(uint32_t Start) const { return { Start, static_cast<uint32_t>(Arena.size()) - Start }; }
+    void Put(std::string_view Text) { Arena += Text; }
+    void Put(Span Piece) { Arena.append(Arena, Piece.Offset, Piece.Length); }
+    std::string_view View(Span Piece) const { return std::string_view(Arena).substr(Piece.Offset, Piece.Length); }
+    void AddName(Span Name);
+
+    bool ParseNumber(int64_t& Value);
+    bool ParseSimpleName(Span& Name);
+    bool ParseTemplateName(Span& Name);
+    bool ParseFragment(Span& Fragment);
+    bool ParseQualifiedName(Span& Name);
+    bool ParseSpecialName(Span& Name);
+    bool ParseType(Span& Type);
+    bool ParseCvType(Span& Type);
+    bool ParseIndirection(std::string_view Declarator, bool bPointerConst, bool bPointerVolatile, Span& Type);
+    bool ParseFunctionType(Span Declarator, Span& Type);
+    bool ParseParameters(Span& Parameters);
+    bool ParseCvQualifier(bool& bConst, bool& bVolatile);
+    void SkipPointerModifiers();
+
+    std::string_view Input;
+    size_t Pos = 0;
+    std::string Arena;
+    BackRefs Refs;
+
+    // Set while parsing the symbol name: constructors/destructors take their name from the class, conversion
+    // operators from the return type.
+    enum class Special
+    {
+        None,
+        Constructor,
+        Destructor,
+        Conversion,
+    };
+
+    Special NameKind = Special::None;
+};
+
+// Canonical spelling used to compare undecorated names: spaces only remain between two identifier characters,
+// class/struct/union/enum keywords and __ptr64 are dropped and "(void)" becomes "()".
+void NormalizeUndecoratedName(std::string_view Name, std::string& Output);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Unbounded multi-producer/multi-consumer queue used between pipeline stages.
+template <typename T>
+class WorkQueue
+{
+public:
+    void Push(T Item)
+    {
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+
+            Items.push_back(std::move(Item));
+        }
+
+        Available.notify_one();
+    }
+
+    bool Pop(T& Item)
+    {
+        std::unique_lock<std::mutex> Guard(Lock);
+
+        Available.wait(Guard, [this]() { return bClosed || !Items.empty(); });
+
+        if (Items.empty())
+            return false;
+
+        Item = std::move(Items.front());
+        Items.pop_front();
+
+        return true;
+    }
+
+    void Close()
+    {
+        {
+            std::lock_guard<std::mutex> Guard(Lock);
+
+            bClosed = true;
+        }
+
+        Available.notify_all();
+    }
+
+private:
+    std::mutex Lock;
+    std::condition_variable Available;
+    std::deque<T> Items;
+    bool bClosed = false;
+};
@@ -0,0 +1,130 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+static thread_local const WorkStealingPool* CurrentPool = nullptr;
+static thread_local uint32_t CurrentWorker = 0;
+
+WorkStealingPool::WorkStealingPool(uint32_t NumWorkers)
+{
+    if (!NumWorkers)
+        NumWorkers = std::max(1u, std::thread::hardware_concurrency());
+
+    for (uint32_t i = 0; i < NumWorkers; i++)
+        Queues.push_back(std::make_unique<WorkerQueue>());
+
+    for (uint32_t i = 0; i < NumWorkers; i++)
+        Workers.emplace_back(&WorkStealingPool::WorkerMain, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> Guard(IdleLock);
+
+        bStopping = true;
+    }
+
+    WorkAvailable.notify_all();
+
+    for (std::thread& Worker : Workers)
+        Worker.join();
+}
+
+void WorkStealingPool::Submit(Task Item)
+{
+    uint32_t Target = CurrentPool == this ? CurrentWorker : NextQueue++ % GetWorkerCount();
+
+    Outstanding++;
+
+    {
+        std::lock_guard<std::mutex> Guard(Queues[Target]->Lock);
+
+        Queues[Target]->Tasks.push_back(std::move(Item));
+        Queued++;
+    }
+
+    // Taking the lock orders this wake-up against a worker that is about to wait.
+    {
+        std::lock_guard<std::mutex> Guard(IdleLock);
+    }
+
+    WorkAvailable.notify_one();
+}
+
+void WorkStealingPool::Wait()
+{
+    std::unique_lock<std::mutex> Guard(IdleLock);
+
+    AllDone.wait(Guard, [this]() { return Outstanding.load() == 0; });
+}
+
+bool WorkStealingPool::Pop(uint32_t Worker, Task& Item)
+{
+    WorkerQueue& Queue = *Queues[Worker];
+    std::lock_guard<std::mutex> Guard(Queue.Lock);
+
+    if (Queue.Tasks.empty())
+        return false;
+
+    Item = std::move(Queue.Tasks.back());
+    Queue.Tasks.pop_back();
+    Queued--;
+
+    return true;
+}
+
+bool WorkStealingPool::Steal(uint32_t Worker, Task& Item)
+{
+    for (uint32_t i = 1; i < GetWorkerCount(); i++)
+    {
+        WorkerQueue& Queue = *Queues[(Worker + i) % GetWorkerCount()];
+        std::lock_guard<std::mutex> Guard(Queue.Lock);
+
+        if (Queue.Tasks.empty())
+            continue;
+
+        Item = std::move(Queue.Tasks.front());
+        Queue.Tasks.pop_front();
+        Queued--;
+
+        return true;
+    }
+
+    return false;
+}
+
+void WorkStealingPool::WorkerMain(uint32_t Worker)
+{
+    CurrentPool = this;
+    CurrentWorker = Worker;
+
+    for (;;)
+    {
+        Task Item;
+
+        if (Pop(Worker, Item) || Steal(Worker, Item))
+        {
+            Item(Worker);
+            Item = nullptr;
+
+            if (--Outstanding == 0)
+            {
+                std::lock_guard<std::mutex> Guard(IdleLock);
+
+                AllDone.notify_all();
+            }
+
+            continue;
+        }
+
+        std::unique_lock<std::mutex> Guard(IdleLock);
+
+        WorkAvailable.wait(Guard, [this]() { return bStopping || Queued.load() > 0; });
+
+        if (bStopping && Queued.load() == 0)
+            return;
+    }
+}
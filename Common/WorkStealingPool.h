@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker runs its newest task first (depth-first, so a
+// directory walk stays local) and an idle worker steals the oldest task of another one. Tasks may submit more
+// tasks; they land on the submitting worker's deque. The worker index passed to a task lets callers keep
+// per-worker results that are merged once Wait() returns, without any shared lock.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void(uint32_t Worker)>;
+
+    // 0 workers means one per hardware thread.
+    explicit WorkStealingPool(uint32_t NumWorkers = 0);
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    ~WorkStealingPool();
+
+    uint32_t GetWorkerCount() const { return static_cast<uint32_t>(Queues.size()); }
+
+    void Submit(Task Item);
+    // Blocks until every submitted task, including tasks submitted by tasks, has finished.
+    void Wait();
+
+private:
+    struct WorkerQueue
+    {
+        std::mutex Lock;
+        std::deque<Task> Tasks;
+    };
+
+    bool Pop(uint32_t Worker, Task& Item);
+    bool Steal(uint32_t Worker, Task& Item);
+    void WorkerMain(uint32_t Worker);
+
+    std::vector<std::unique_ptr<WorkerQueue>> Queues;
+    std::vector<std::thread> Workers;
+
+    // Queued counts tasks sitting in a deque, Outstanding those not finished yet (queued or running).
+    std::atomic<uint64_t> Queued{ 0 };
+    std::atomic<uint64_t> Outstanding{ 0 };
+    std::atomic<uint32_t> NextQueue{ 0 };
+
+    std::mutex IdleLock;
+    std::condition_variable WorkAvailable;
+    std::condition_variable AllDone;
+    bool bStopping = false;
+};